@@ -0,0 +1,387 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host model of a SIMCOM SIM5320 on the cell UART, answering commands with the
+// replies that the fona.c state machine expects.  Behind it is a stand-in for the
+// service's UDP, TCP and HTTP listeners, which hands what it receives to service.c
+// and answers requests with service_reply(), taking time that grows with the bytes
+// that have to cross the air in each direction.  Like a real server, it keeps TCP
+// and HTTP connections open across requests until they have been idle for a while.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nrf.h"
+#include "gpio.h"
+#include "sim.h"
+
+// Network timing
+#define CELL_COMMAND_MS     10
+#define CELL_RTT_MS         600
+#define CELL_BYTES_PER_MS   2
+#define CELL_SERVER_IDLE_MS 60000
+
+// Command line being received from the app
+static char command[256];
+static uint16_t command_length = 0;
+
+// Data being received from the app after a '>' prompt, and where it is headed
+#define LINK_UDP    0
+#define LINK_TCP    1
+#define LINK_HTTP   2
+static uint8_t data[2048];
+static uint16_t data_length = 0;
+static uint16_t data_expected = 0;
+static uint16_t data_link = LINK_UDP;
+
+// What the service has replied over TCP or HTTP, waiting to be read
+static uint8_t reply[1024];
+static uint16_t reply_length = 0;
+static uint32_t reply_ms = 0;
+
+// Connections to the service, which it closes once they've been idle for a while
+static bool tcp_open = false;
+static bool http_open = false;
+static uint64_t link_idle_at = SIM_NEVER;
+
+// TCP replies on their way back from the service.  These arrive on their own time,
+// while the app may be busy with other commands, so they are delivered by cell_event()
+// rather than being queued on the UART behind the replies to those commands.
+#define CELL_REPLIES 8
+typedef struct {
+    uint64_t when;
+    uint16_t length;
+    uint8_t data[256];
+} cell_reply_t;
+static cell_reply_t replies[CELL_REPLIES];
+static uint16_t replies_count = 0;
+
+void cell_reset() {
+    command_length = 0;
+    data_length = 0;
+    data_expected = 0;
+    reply_length = 0;
+    tcp_open = false;
+    http_open = false;
+    link_idle_at = SIM_NEVER;
+    replies_count = 0;
+}
+
+static bool starts_with(char *str, char *prefix) {
+    return (strncmp(str, prefix, strlen(prefix)) == 0);
+}
+
+// Time for bytes to cross the air
+static uint32_t air_ms(uint16_t bytes) {
+    return (bytes / CELL_BYTES_PER_MS);
+}
+
+// Note that a connection to the service was used, postponing its closure
+static void cell_link_used() {
+    link_idle_at = sim_now() + SIM_MS_TO_TICKS(CELL_SERVER_IDLE_MS);
+}
+
+// Time of the next thing that the network will do on its own
+uint64_t cell_next_event() {
+    if (replies_count > 0 && replies[0].when < link_idle_at)
+        return replies[0].when;
+    return link_idle_at;
+}
+
+// Deliver TCP replies that have arrived, and close connections that have gone idle
+void cell_event(uint64_t now) {
+    char line[32];
+
+    while (replies_count > 0 && replies[0].when <= now) {
+        uint16_t length = replies[0].length;
+        if (reply_length + length > sizeof(reply))
+            length = sizeof(reply) - reply_length;
+        memcpy(&reply[reply_length], replies[0].data, length);
+        reply_length += length;
+        memmove(&replies[0], &replies[1], (replies_count-1) * sizeof(replies[0]));
+        replies_count--;
+        sprintf(line, "+IPD%u", length);
+        sdk_uart_receive(line, 0);
+        cell_link_used();
+    }
+
+    if (link_idle_at <= now) {
+        link_idle_at = SIM_NEVER;
+        if (tcp_open)
+            sdk_uart_receive("+IPCLOSE: 1,1", 0);
+        if (http_open)
+            sdk_uart_receive("+CHTTPSNOTIFY: PEER CLOSED", 0);
+        tcp_open = http_open = false;
+        reply_length = 0;
+    }
+
+}
+
+// Hand an HTTP request's body to the service, returning true if it was binary
+static bool cell_http_request(uint8_t *request, uint16_t length) {
+    char *header = (char *) request;
+    char body[sizeof(data)+1];
+    bool binary;
+    uint16_t i;
+
+    for (i=0; i+4<=length; i++)
+        if (memcmp(&request[i], "\r\n\r\n", 4) == 0)
+            break;
+    if (i+4 > length)
+        return false;
+    request[i] = '\0';
+    binary = (strstr(header, "Content-Type: application/octet-stream") != NULL);
+    i += 4;
+
+    if (binary) {
+        service_receive_bytes(&request[i], length-i);
+    } else {
+        memcpy(body, &request[i], length-i);
+        body[length-i] = '\0';
+        service_receive(body);
+    }
+
+    return binary;
+}
+
+// Build the HTTP response, whose body is in the same form as the request's
+static void cell_http_response(bool binary) {
+    uint8_t body[sizeof(reply)];
+    uint16_t i, length;
+    char header[128];
+
+    length = service_reply(body, sizeof(body)/2);
+    sprintf(header, "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %u\r\n\r\n",
+            binary ? "application/octet-stream" : "text/plain", binary ? length : length*2);
+    reply_length = strlen(header);
+    memcpy(reply, header, reply_length);
+    for (i=0; i<length && reply_length+2 <= sizeof(reply); i++) {
+        if (binary)
+            reply[reply_length++] = body[i];
+        else {
+            sprintf((char *) &reply[reply_length], "%02X", body[i]);
+            reply_length += 2;
+        }
+    }
+}
+
+// Data following a '>' prompt has all arrived
+static void cell_data_received() {
+    uint8_t body[sizeof(replies[0].data)];
+    uint16_t length;
+
+    sim_counters()->cell_sends++;
+    sim_counters()->cell_bytes_tx += data_length;
+
+    switch (data_link) {
+
+    case LINK_UDP:
+        service_receive_bytes(data, data_length);
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        break;
+
+    case LINK_TCP:
+        service_receive_bytes(data, data_length);
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        sim_counters()->cell_round_trips++;
+        cell_link_used();
+        length = service_reply(body, sizeof(body));
+        sim_counters()->cell_bytes_rx += length;
+        if (length != 0 && replies_count < CELL_REPLIES) {
+            replies[replies_count].when = sim_now() + SIM_MS_TO_TICKS(CELL_RTT_MS + air_ms(data_length + length));
+            replies[replies_count].length = length;
+            memcpy(replies[replies_count].data, body, length);
+            replies_count++;
+        }
+        break;
+
+    case LINK_HTTP:
+        cell_http_response(cell_http_request(data, data_length));
+        sim_counters()->cell_bytes_rx += reply_length;
+        sim_counters()->cell_round_trips++;
+        cell_link_used();
+        reply_ms = CELL_RTT_MS + air_ms(data_length + reply_length);
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        break;
+
+    }
+
+    data_length = 0;
+}
+
+// Begin receiving data after a '>' prompt
+static void cell_data_expect(uint16_t link, uint16_t length) {
+    data_link = link;
+    data_length = 0;
+    data_expected = length;
+    if (data_expected > sizeof(data))
+        data_expected = sizeof(data);
+    sdk_uart_receive_bytes((uint8_t *) ">", 1, CELL_COMMAND_MS);
+}
+
+// Give the app what the service replied over TCP, as binary or as hex
+static void cell_tcp_read(int mode, uint16_t length) {
+    char line[sizeof(replies[0].data)*2+1];
+    uint16_t i;
+
+    if (length > reply_length)
+        length = reply_length;
+    if (length > sizeof(replies[0].data))
+        length = sizeof(replies[0].data);
+    sprintf(line, "+CIPRXGET: %d,1,%u,%u", mode, length, reply_length - length);
+    sdk_uart_receive(line, CELL_COMMAND_MS);
+    if (mode == 2) {
+        sdk_uart_receive_bytes(reply, length, CELL_COMMAND_MS);
+        sdk_uart_receive("", CELL_COMMAND_MS);
+    } else {
+        for (i=0; i<length; i++)
+            sprintf(&line[i*2], "%02X", reply[i]);
+        line[length*2] = '\0';
+        sdk_uart_receive(line, CELL_COMMAND_MS);
+    }
+    sdk_uart_receive("OK", CELL_COMMAND_MS);
+
+    // What remains is left for the next read
+    reply_length -= length;
+    memmove(reply, &reply[length], reply_length);
+}
+
+// Give the app the service's HTTP response
+static void cell_http_read() {
+    char line[32];
+    sdk_uart_receive("OK", CELL_COMMAND_MS);
+    if (reply_length != 0) {
+        sprintf(line, "+CHTTPSRECV: DATA,%u", reply_length);
+        sdk_uart_receive(line, CELL_COMMAND_MS);
+        sdk_uart_receive_bytes(reply, reply_length, CELL_COMMAND_MS);
+        sdk_uart_receive("", CELL_COMMAND_MS);
+    }
+    sdk_uart_receive("+CHTTPSRECV: 0", CELL_COMMAND_MS);
+    reply_length = 0;
+}
+
+static void cell_command(char *cmd) {
+
+    sim_counters()->cell_commands++;
+
+    if (starts_with(cmd, "at+creset")) {
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        sdk_uart_receive("START", 8000);
+        sdk_uart_receive("+CPIN: READY", 1000);
+        sdk_uart_receive("PB DONE", 3000);
+
+    } else if (starts_with(cmd, "at+cpsi=5")) {
+        sdk_uart_receive("+CPSI: WCDMA,Online,001-01,0x0001,1,WCDMA IMT 2000,0,10688,0,0.0,57,33,18,500", CELL_COMMAND_MS);
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+
+    } else if (starts_with(cmd, "ati")) {
+        sdk_uart_receive("Manufacturer: SIMCOM INCORPORATED", CELL_COMMAND_MS);
+        sdk_uart_receive("Model: SIMCOM_SIM5320A", CELL_COMMAND_MS);
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+
+    } else if (starts_with(cmd, "at+ciccid")) {
+        sdk_uart_receive("+ICCID: 8901260000000000001", CELL_COMMAND_MS);
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+
+    } else if (starts_with(cmd, "at+netopen")) {
+        sim_counters()->cell_round_trips++;
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        sdk_uart_receive("+NETOPEN: 0", 1500);
+
+    } else if (starts_with(cmd, "at+cdnsgip=")) {
+        char line[128];
+        sim_counters()->cell_round_trips++;
+        sprintf(line, "+CDNSGIP: 1,%s,\"10.0.0.1\"", &cmd[strlen("at+cdnsgip=")]);
+        sdk_uart_receive(line, CELL_RTT_MS);
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+
+    } else if (starts_with(cmd, "at+cipopen=1,")) {
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        if (tcp_open) {
+            // Operation not allowed, because the link is already in use
+            sdk_uart_receive("+CIPOPEN: 1,4", CELL_COMMAND_MS);
+        } else {
+            tcp_open = true;
+            sim_counters()->cell_sessions++;
+            sim_counters()->cell_round_trips++;
+            cell_link_used();
+            sdk_uart_receive("+CIPOPEN: 1,0", CELL_RTT_MS);
+        }
+
+    } else if (starts_with(cmd, "at+cipclose=1")) {
+        tcp_open = false;
+        reply_length = 0;
+        replies_count = 0;
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        sdk_uart_receive("+CIPCLOSE: 1,0", CELL_COMMAND_MS);
+
+    } else if (starts_with(cmd, "at+cipsend=0,")) {
+        cell_data_expect(LINK_UDP, atoi(&cmd[strlen("at+cipsend=0,")]));
+
+    } else if (starts_with(cmd, "at+cipsend=1,")) {
+        if (tcp_open)
+            cell_data_expect(LINK_TCP, atoi(&cmd[strlen("at+cipsend=1,")]));
+        else
+            sdk_uart_receive("ERROR", CELL_COMMAND_MS);
+
+    } else if (starts_with(cmd, "at+ciprxget=2,1,") || starts_with(cmd, "at+ciprxget=3,1,")) {
+        cell_tcp_read(cmd[strlen("at+ciprxget=")] - '0', atoi(&cmd[strlen("at+ciprxget=2,1,")]));
+
+    } else if (starts_with(cmd, "at+chttpsopse=")) {
+        http_open = true;
+        sim_counters()->cell_sessions++;
+        sim_counters()->cell_round_trips++;
+        cell_link_used();
+        sdk_uart_receive("OK", CELL_RTT_MS);
+
+    } else if (starts_with(cmd, "at+chttpsclse")) {
+        http_open = false;
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+
+    } else if (starts_with(cmd, "at+chttpssend=")) {
+        cell_data_expect(LINK_HTTP, atoi(&cmd[strlen("at+chttpssend=")]));
+
+    } else if (starts_with(cmd, "at+chttpssend")) {
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+        sdk_uart_receive("+CHTTPS: RECV EVENT", reply_ms);
+
+    } else if (starts_with(cmd, "at+chttpsrecv=")) {
+        cell_http_read();
+
+    } else {
+        sdk_uart_receive("OK", CELL_COMMAND_MS);
+    }
+
+}
+
+// Accumulate bytes sent by the app, processing each line as it completes
+void cell_tx_byte(uint8_t databyte) {
+
+    if (gpio_current_uart() != UART_FONA)
+        return;
+
+    if (data_expected > 0) {
+        data[data_length++] = databyte;
+        if (--data_expected == 0)
+            cell_data_received();
+        return;
+    }
+
+    if (databyte == '\n')
+        return;
+
+    if (databyte == '\r') {
+        command[command_length] = '\0';
+        if (sim_verbose())
+            printf("[cell] %s\n", command);
+        if (command_length > 0)
+            cell_command(command);
+        command_length = 0;
+        return;
+    }
+
+    if (command_length < sizeof(command)-1)
+        command[command_length++] = (char) databyte;
+
+}
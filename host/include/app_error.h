@@ -0,0 +1,36 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the SDK error handler
+
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf.h"
+#include "sdk_errors.h"
+#include "nordic_common.h"
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name);
+void app_error_handler_bare(uint32_t error_code);
+void app_error_fault_handler(uint32_t id, uint32_t pc, uint32_t info);
+
+#define APP_ERROR_HANDLER(ERR_CODE)                                         \
+    do                                                                      \
+    {                                                                       \
+        app_error_handler((ERR_CODE), __LINE__, (uint8_t*) __FILE__);       \
+    } while (0)
+
+#define APP_ERROR_CHECK(ERR_CODE)                                           \
+    do                                                                      \
+    {                                                                       \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE);                         \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS)                                  \
+        {                                                                   \
+            APP_ERROR_HANDLER(LOCAL_ERR_CODE);                              \
+        }                                                                   \
+    } while (0)
+
+#endif // APP_ERROR_H__
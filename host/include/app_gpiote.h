@@ -0,0 +1,32 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the GPIOTE user library
+
+#ifndef APP_GPIOTE_H__
+#define APP_GPIOTE_H__
+
+#include "nrf.h"
+#include "sdk_errors.h"
+
+typedef uint8_t app_gpiote_user_id_t;
+typedef void (*app_gpiote_event_handler_t)(uint32_t const * p_event_pins_low_to_high,
+                                           uint32_t const * p_event_pins_high_to_low);
+
+#define APP_GPIOTE_INIT(MAX_USERS)                                          \
+    do                                                                      \
+    {                                                                       \
+        uint32_t ERR_CODE = app_gpiote_init((MAX_USERS), NULL);             \
+        APP_ERROR_CHECK(ERR_CODE);                                          \
+    } while (0)
+
+uint32_t app_gpiote_init(uint8_t max_users, void * p_buffer);
+uint32_t app_gpiote_user_register(app_gpiote_user_id_t * p_user_id,
+                                  uint32_t const * p_pins_low_to_high_mask,
+                                  uint32_t const * p_pins_high_to_low_mask,
+                                  app_gpiote_event_handler_t event_handler);
+uint32_t app_gpiote_user_enable(app_gpiote_user_id_t user_id);
+uint32_t app_gpiote_user_disable(app_gpiote_user_id_t user_id);
+
+#endif // APP_GPIOTE_H__
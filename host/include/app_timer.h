@@ -0,0 +1,58 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the application timer library, running on the simulator's
+// virtual RTC rather than on RTC1.
+
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_util.h"
+#include "app_error.h"
+
+#define APP_TIMER_CLOCK_FREQ            32768
+#define APP_TIMER_MIN_TIMEOUT_TICKS     5
+#define APP_TIMER_MAX_CNT_VAL           0x00FFFFFF
+#define APP_TIMER_NODE_SIZE             48
+#define APP_TIMER_SCHED_EVT_SIZE        (sizeof(void *) * 2)
+
+#define APP_TIMER_TICKS(MS, PRESCALER)                                      \
+            ((uint32_t)ROUNDED_DIV((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ,   \
+                                   1000 * ((PRESCALER) + 1)))
+
+typedef struct app_timer_t { uint32_t data[CEIL_DIV(APP_TIMER_NODE_SIZE, sizeof(uint32_t))]; } app_timer_t;
+typedef app_timer_t * app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)                                             \
+    static app_timer_t timer_id##_data = { {0} };                           \
+    static const app_timer_id_t timer_id = &timer_id##_data
+
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+typedef uint32_t (*app_timer_evt_schedule_func_t) (app_timer_timeout_handler_t timeout_handler,
+                                                   void *                      p_context);
+
+typedef enum {
+    APP_TIMER_MODE_SINGLE_SHOT,
+    APP_TIMER_MODE_REPEATED
+} app_timer_mode_t;
+
+#define APP_TIMER_INIT(PRESCALER, OP_QUEUE_SIZE, SCHEDULER_FUNC)            \
+    do                                                                      \
+    {                                                                       \
+        uint32_t ERR_CODE = app_timer_init((PRESCALER), (OP_QUEUE_SIZE) + 1,\
+                                           NULL, SCHEDULER_FUNC);           \
+        APP_ERROR_CHECK(ERR_CODE);                                          \
+    } while (0)
+
+uint32_t app_timer_init(uint32_t prescaler, uint8_t op_queue_size, void * p_buffer, app_timer_evt_schedule_func_t evt_schedule_func);
+uint32_t app_timer_create(app_timer_id_t const * p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_stop_all(void);
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t *p_ticks_diff);
+
+#endif // APP_TIMER_H__
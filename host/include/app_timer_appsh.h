@@ -0,0 +1,19 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for dispatching timer timeouts through the scheduler
+
+#ifndef APP_TIMER_APPSH_H
+#define APP_TIMER_APPSH_H
+
+#include "app_timer.h"
+#include "app_scheduler.h"
+
+uint32_t app_timer_evt_schedule(app_timer_timeout_handler_t timeout_handler, void * p_context);
+
+#define APP_TIMER_APPSH_INIT(PRESCALER, OP_QUEUE_SIZE, USE_SCHEDULER)       \
+    APP_TIMER_INIT(PRESCALER, OP_QUEUE_SIZE,                                \
+                   (USE_SCHEDULER) ? app_timer_evt_schedule : NULL)
+
+#endif // APP_TIMER_APPSH_H
@@ -0,0 +1,67 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the TWI transaction manager.  The simulated bus has no
+// devices on it, so every transaction completes with an address NACK.
+
+#ifndef APP_TWI_H__
+#define APP_TWI_H__
+
+#include <stdint.h>
+#include "nrf_drv_twi.h"
+#include "sdk_errors.h"
+
+#define APP_TWI_NO_STOP     0x01
+
+#define APP_TWI_WRITE(address, p_data, length, flags) \
+    APP_TWI_TRANSFER(APP_TWI_WRITE_OP(address), p_data, length, flags)
+#define APP_TWI_READ(address, p_data, length, flags) \
+    APP_TWI_TRANSFER(APP_TWI_READ_OP(address), p_data, length, flags)
+#define APP_TWI_TRANSFER(_operation, _p_data, _length, _flags) \
+{                                                              \
+    .p_data    = (uint8_t *)(_p_data),                         \
+    .length    = _length,                                      \
+    .operation = _operation,                                   \
+    .flags     = _flags                                        \
+}
+#define APP_TWI_WRITE_OP(address)      (((address) << 1) | 0)
+#define APP_TWI_READ_OP(address)       (((address) << 1) | 1)
+#define APP_TWI_IS_READ_OP(operation)  ((operation) & 1)
+#define APP_TWI_OP_ADDRESS(operation)  ((operation) >> 1)
+
+typedef void (* app_twi_callback_t)(ret_code_t result, void * p_user_data);
+
+typedef struct {
+    uint8_t * p_data;
+    uint8_t   length;
+    uint8_t   operation;
+    uint8_t   flags;
+} app_twi_transfer_t;
+
+typedef struct {
+    app_twi_callback_t         callback;
+    void *                     p_user_data;
+    app_twi_transfer_t const * p_transfers;
+    uint8_t                    number_of_transfers;
+} app_twi_transaction_t;
+
+typedef struct {
+    uint8_t busy;
+    nrf_drv_twi_t const twi;
+} app_twi_t;
+
+#define APP_TWI_INSTANCE(twi_idx) { .busy = 0, .twi = NRF_DRV_TWI_INSTANCE(twi_idx) }
+
+#define APP_TWI_INIT(p_app_twi, p_twi_config, queue_size, err_code) \
+    do {                                                            \
+        err_code = app_twi_init(p_app_twi, p_twi_config,            \
+                                queue_size, NULL);                  \
+    } while (0)
+
+ret_code_t app_twi_init(app_twi_t * p_app_twi, nrf_drv_twi_config_t const * p_twi_config, uint8_t queue_size, app_twi_transaction_t const * * p_queue_buffer);
+void app_twi_uninit(app_twi_t * p_app_twi);
+ret_code_t app_twi_schedule(app_twi_t * p_app_twi, app_twi_transaction_t const * p_transaction);
+bool app_twi_is_idle(app_twi_t * p_app_twi);
+
+#endif // APP_TWI_H__
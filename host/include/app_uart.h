@@ -0,0 +1,63 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the FIFO UART library, wired to the simulated modems
+
+#ifndef APP_UART_H__
+#define APP_UART_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_util_platform.h"
+
+#define UART_PIN_DISCONNECTED 0xFFFFFFFF
+
+typedef enum {
+    APP_UART_FLOW_CONTROL_DISABLED,
+    APP_UART_FLOW_CONTROL_ENABLED,
+} app_uart_flow_control_t;
+
+typedef struct {
+    uint32_t                rx_pin_no;
+    uint32_t                tx_pin_no;
+    uint32_t                rts_pin_no;
+    uint32_t                cts_pin_no;
+    app_uart_flow_control_t flow_control;
+    bool                    use_parity;
+    uint32_t                baud_rate;
+} app_uart_comm_params_t;
+
+typedef struct {
+    uint8_t * rx_buf;
+    uint32_t  rx_buf_size;
+    uint8_t * tx_buf;
+    uint32_t  tx_buf_size;
+} app_uart_buffers_t;
+
+typedef enum {
+    APP_UART_DATA_READY,
+    APP_UART_FIFO_ERROR,
+    APP_UART_COMMUNICATION_ERROR,
+    APP_UART_TX_EMPTY,
+    APP_UART_DATA,
+} app_uart_evt_type_t;
+
+typedef struct {
+    app_uart_evt_type_t evt_type;
+    union {
+        uint32_t error_communication;
+        uint32_t error_code;
+        uint8_t  value;
+    } data;
+} app_uart_evt_t;
+
+typedef void (* app_uart_event_handler_t) (app_uart_evt_t * p_app_uart_event);
+
+uint32_t app_uart_init(const app_uart_comm_params_t * p_comm_params, app_uart_buffers_t * p_buffers, app_uart_event_handler_t error_handler, app_irq_priority_t irq_priority);
+uint32_t app_uart_get(uint8_t * p_byte);
+uint32_t app_uart_put(uint8_t byte);
+uint32_t app_uart_flush(void);
+uint32_t app_uart_close(void);
+
+#endif // APP_UART_H__
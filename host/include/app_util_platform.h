@@ -0,0 +1,26 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for platform utilities.  There are no interrupts preempting
+// the host, so critical regions are empty.
+
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+#include "nrf.h"
+#include "app_error.h"
+
+typedef enum {
+    APP_IRQ_PRIORITY_HIGHEST = 2,
+    APP_IRQ_PRIORITY_HIGH    = 3,
+    APP_IRQ_PRIORITY_MID     = 4,
+    APP_IRQ_PRIORITY_LOW     = 6,
+    APP_IRQ_PRIORITY_LOWEST  = 7,
+    APP_IRQ_PRIORITY_THREAD  = 15,
+} app_irq_priority_t;
+
+#define CRITICAL_REGION_ENTER()     {
+#define CRITICAL_REGION_EXIT()      }
+
+#endif // APP_UTIL_PLATFORM_H__
@@ -0,0 +1,67 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for flash storage, backed by a simulated flash array that
+// keeps the nRF52's erase-to-ones and program-clears-bits semantics.  As with
+// the SoftDevice, operations are queued and complete later, at interrupt level.
+
+#ifndef FSTORAGE_H__
+#define FSTORAGE_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+
+typedef enum {
+    FS_SUCCESS,
+    FS_ERR_NOT_INITIALIZED,
+    FS_ERR_INVALID_CFG,
+    FS_ERR_NULL_ARG,
+    FS_ERR_INVALID_ARG,
+    FS_ERR_INVALID_ADDR,
+    FS_ERR_UNALIGNED_ADDR,
+    FS_ERR_QUEUE_FULL,
+    FS_ERR_OPERATION_TIMEOUT,
+    FS_ERR_INTERNAL,
+    FS_ERR_FAILURE_SINCE_LAST
+} fs_ret_t;
+
+typedef enum {
+    FS_EVT_STORE,
+    FS_EVT_ERASE
+} fs_evt_id_t;
+
+typedef struct {
+    fs_evt_id_t id;
+    void *      p_context;
+    union {
+        struct {
+            uint32_t const * p_data;
+            uint16_t         length_words;
+        } store;
+        struct {
+            uint16_t first_page;
+            uint16_t last_page;
+        } erase;
+    };
+} fs_evt_t;
+
+typedef void (*fs_cb_t)(fs_evt_t const * const evt, fs_ret_t result);
+
+typedef struct {
+    uint32_t const * p_start_addr;
+    uint32_t const * p_end_addr;
+    fs_cb_t  const   callback;
+    uint8_t  const   num_pages;
+    uint8_t  const   priority;
+} fs_config_t;
+
+// Registered configurations are gathered by the linker, as on the device
+#define FS_REGISTER_CFG(cfg_var) __attribute__((section("fs_data"))) __attribute__((used)) cfg_var
+
+fs_ret_t fs_init(void);
+fs_ret_t fs_store(fs_config_t const * const p_config, uint32_t const * const p_dest, uint32_t const * const p_src, uint16_t const length_words, void * p_context);
+fs_ret_t fs_erase(fs_config_t const * const p_config, uint32_t const * const p_page_addr, uint16_t const num_pages, void * p_context);
+void fs_sys_event_handler(uint32_t sys_evt);
+
+#endif // FSTORAGE_H__
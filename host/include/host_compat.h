@@ -0,0 +1,16 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Declarations that newlib provides on the device but glibc does not.
+// This is force-included into every host compilation unit.
+
+#ifndef HOST_COMPAT_H__
+#define HOST_COMPAT_H__
+
+#include <stddef.h>
+
+size_t strlcpy(char *dst, const char *src, size_t siz);
+size_t strlcat(char *dst, const char *src, size_t siz);
+
+#endif // HOST_COMPAT_H__
@@ -0,0 +1,55 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the nRF52 device header, providing just enough of CMSIS
+// for the firmware to compile natively without touching any registers.
+
+#ifndef NRF_H
+#define NRF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef __ASM
+#define __ASM               __asm
+#endif
+#ifndef __INLINE
+#define __INLINE            inline
+#endif
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE     static inline
+#endif
+#ifndef __WEAK
+#define __WEAK              __attribute__((weak))
+#endif
+#ifndef __ALIGN
+#define __ALIGN(n)          __attribute__((aligned(n)))
+#endif
+#ifndef __PACKED
+#define __PACKED            __attribute__((packed))
+#endif
+
+// Only one GPIO port on the nRF52832
+#define GPIO_COUNT 1
+
+// UART baud rate register values, as in nrf52_bitfields.h
+#define UART_BAUDRATE_BAUDRATE_Baud9600   (0x00275000UL)
+#define UART_BAUDRATE_BAUDRATE_Baud19200  (0x004EA000UL)
+#define UART_BAUDRATE_BAUDRATE_Baud57600  (0x00EBF000UL)
+#define UART_BAUDRATE_BAUDRATE_Baud115200 (0x01D7E000UL)
+
+// Interrupt and core register access has no meaning on the host
+typedef enum {
+    FPU_IRQn = 38,
+} IRQn_Type;
+__STATIC_INLINE uint32_t __get_FPSCR(void) { return 0; }
+__STATIC_INLINE void __set_FPSCR(uint32_t fpscr) { (void) fpscr; }
+__STATIC_INLINE void NVIC_ClearPendingIRQ(IRQn_Type irq) { (void) irq; }
+__STATIC_INLINE void __WFE(void) {}
+__STATIC_INLINE void __SEV(void) {}
+void NVIC_SystemReset(void);
+
+#endif // NRF_H
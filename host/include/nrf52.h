@@ -0,0 +1,12 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the nRF52 register definitions
+
+#ifndef NRF52_H
+#define NRF52_H
+
+#include "nrf.h"
+
+#endif // NRF52_H
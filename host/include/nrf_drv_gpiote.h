@@ -0,0 +1,38 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the GPIOTE driver, modelling the IN channels whose
+// events can be routed through PPI
+
+#ifndef NRF_DRV_GPIOTE__
+#define NRF_DRV_GPIOTE__
+
+#include "nrf_gpiote.h"
+#include "nrf_gpio.h"
+#include "sdk_errors.h"
+
+typedef uint32_t nrf_drv_gpiote_pin_t;
+typedef void (*nrf_drv_gpiote_evt_handler_t)(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+typedef struct {
+    nrf_gpiote_polarity_t sense;
+    nrf_gpio_pin_pull_t pull;
+    bool is_watcher;
+    bool hi_accuracy;
+} nrf_drv_gpiote_in_config_t;
+
+#define GPIOTE_CONFIG_IN_SENSE_LOTOHI(hi_accu)  \
+    {                                           \
+        .is_watcher = false,                    \
+        .hi_accuracy = hi_accu,                 \
+        .pull = NRF_GPIO_PIN_NOPULL,            \
+        .sense = NRF_GPIOTE_POLARITY_LOTOHI,    \
+    }
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const *p_config, nrf_drv_gpiote_evt_handler_t evt_handler);
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable);
+// On the chip this is a 32-bit register address, which doesn't fit in a uint32_t here
+uintptr_t nrf_drv_gpiote_in_event_addr_get(nrf_drv_gpiote_pin_t pin);
+
+#endif // NRF_DRV_GPIOTE__
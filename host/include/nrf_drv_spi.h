@@ -0,0 +1,27 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the SPI master driver
+
+#ifndef NRF_DRV_SPI_H__
+#define NRF_DRV_SPI_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+
+typedef struct {
+    uint8_t drv_inst_idx;
+} nrf_drv_spi_t;
+
+typedef enum {
+    NRF_DRV_SPI_EVENT_DONE,
+} nrf_drv_spi_evt_type_t;
+
+typedef struct {
+    nrf_drv_spi_evt_type_t type;
+} nrf_drv_spi_evt_t;
+
+typedef void (*nrf_drv_spi_handler_t)(nrf_drv_spi_evt_t const * p_event);
+
+#endif // NRF_DRV_SPI_H__
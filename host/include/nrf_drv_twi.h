@@ -0,0 +1,43 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the TWI master driver
+
+#ifndef NRF_DRV_TWI_H__
+#define NRF_DRV_TWI_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "app_util_platform.h"
+#include "sdk_errors.h"
+
+typedef enum {
+    NRF_TWI_FREQ_100K = 0x01980000UL,
+    NRF_TWI_FREQ_250K = 0x04000000UL,
+    NRF_TWI_FREQ_400K = 0x06680000UL,
+} nrf_twi_frequency_t;
+
+typedef struct {
+    uint8_t drv_inst_idx;
+} nrf_drv_twi_t;
+
+typedef struct {
+    uint32_t            scl;
+    uint32_t            sda;
+    nrf_twi_frequency_t frequency;
+    uint8_t             interrupt_priority;
+    bool                clear_bus_init;
+    bool                hold_bus_uninit;
+} nrf_drv_twi_config_t;
+
+#define NRF_DRV_TWI_INSTANCE(id) { .drv_inst_idx = (id) }
+
+ret_code_t nrf_drv_twi_init(nrf_drv_twi_t const * p_instance, nrf_drv_twi_config_t const * p_config, void * event_handler, void * p_context);
+void nrf_drv_twi_uninit(nrf_drv_twi_t const * p_instance);
+void nrf_drv_twi_enable(nrf_drv_twi_t const * p_instance);
+void nrf_drv_twi_disable(nrf_drv_twi_t const * p_instance);
+ret_code_t nrf_drv_twi_tx(nrf_drv_twi_t const * p_instance, uint8_t address, uint8_t const * p_data, uint8_t length, bool no_stop);
+ret_code_t nrf_drv_twi_rx(nrf_drv_twi_t const * p_instance, uint8_t address, uint8_t * p_data, uint8_t length);
+
+#endif // NRF_DRV_TWI_H__
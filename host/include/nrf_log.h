@@ -0,0 +1,13 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the SDK logger, which is never enabled on the host
+
+#ifndef NRF_LOG_H_
+#define NRF_LOG_H_
+
+#define NRF_LOG_ENABLED 0
+#define NRF_LOG_RAW_INFO(...)
+
+#endif // NRF_LOG_H_
@@ -0,0 +1,15 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for SoftDevice NVIC access
+
+#ifndef NRF_NVIC_H__
+#define NRF_NVIC_H__
+
+#include "nrf.h"
+#include "nrf_error.h"
+
+uint32_t sd_nvic_SystemReset(void);
+
+#endif // NRF_NVIC_H__
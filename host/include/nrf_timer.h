@@ -0,0 +1,66 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the TIMER HAL, modelling just the counter mode that we use
+
+#ifndef NRF_TIMER_H__
+#define NRF_TIMER_H__
+
+#include "nrf.h"
+
+#define TIMER_CC_COUNT 6
+
+// Task registers are laid out as on the chip, so that tasks have addresses for PPI
+typedef struct {
+    volatile uint32_t TASKS_START;
+    volatile uint32_t TASKS_STOP;
+    volatile uint32_t TASKS_COUNT;
+    volatile uint32_t TASKS_CLEAR;
+    volatile uint32_t TASKS_SHUTDOWN;
+    volatile uint32_t TASKS_CAPTURE[TIMER_CC_COUNT];
+    volatile uint32_t CC[TIMER_CC_COUNT];
+    volatile uint32_t MODE;
+    volatile uint32_t BITMODE;
+    uint32_t counter;
+    bool running;
+} NRF_TIMER_Type;
+
+extern NRF_TIMER_Type sim_timer1;
+extern NRF_TIMER_Type sim_timer2;
+#define NRF_TIMER1 (&sim_timer1)
+#define NRF_TIMER2 (&sim_timer2)
+
+typedef enum {
+    NRF_TIMER_TASK_START    = offsetof(NRF_TIMER_Type, TASKS_START),
+    NRF_TIMER_TASK_STOP     = offsetof(NRF_TIMER_Type, TASKS_STOP),
+    NRF_TIMER_TASK_COUNT    = offsetof(NRF_TIMER_Type, TASKS_COUNT),
+    NRF_TIMER_TASK_CLEAR    = offsetof(NRF_TIMER_Type, TASKS_CLEAR),
+    NRF_TIMER_TASK_SHUTDOWN = offsetof(NRF_TIMER_Type, TASKS_SHUTDOWN),
+    NRF_TIMER_TASK_CAPTURE0 = offsetof(NRF_TIMER_Type, TASKS_CAPTURE[0]),
+} nrf_timer_task_t;
+
+typedef enum {
+    NRF_TIMER_MODE_TIMER = 0,
+    NRF_TIMER_MODE_COUNTER = 1,
+    NRF_TIMER_MODE_LOW_POWER_COUNTER = 2,
+} nrf_timer_mode_t;
+
+typedef enum {
+    NRF_TIMER_BIT_WIDTH_16 = 0,
+    NRF_TIMER_BIT_WIDTH_8 = 1,
+    NRF_TIMER_BIT_WIDTH_24 = 2,
+    NRF_TIMER_BIT_WIDTH_32 = 3,
+} nrf_timer_bit_width_t;
+
+typedef enum {
+    NRF_TIMER_CC_CHANNEL0 = 0,
+} nrf_timer_cc_channel_t;
+
+void nrf_timer_task_trigger(NRF_TIMER_Type *p_reg, nrf_timer_task_t task);
+uint32_t *nrf_timer_task_address_get(NRF_TIMER_Type *p_reg, nrf_timer_task_t task);
+void nrf_timer_mode_set(NRF_TIMER_Type *p_reg, nrf_timer_mode_t mode);
+void nrf_timer_bit_width_set(NRF_TIMER_Type *p_reg, nrf_timer_bit_width_t bit_width);
+uint32_t nrf_timer_cc_read(NRF_TIMER_Type *p_reg, nrf_timer_cc_channel_t cc_channel);
+
+#endif // NRF_TIMER_H__
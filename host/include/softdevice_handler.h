@@ -0,0 +1,14 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the SoftDevice handler
+
+#ifndef SOFTDEVICE_HANDLER_H__
+#define SOFTDEVICE_HANDLER_H__
+
+#include "nrf.h"
+#include "sdk_errors.h"
+#include "nrf_soc.h"
+
+#endif // SOFTDEVICE_HANDLER_H__
@@ -0,0 +1,158 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host model of a Microchip RN2483 on the LoRa UART, answering commands
+// with the replies and timing that the lora.c state machine expects.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nrf.h"
+#include "gpio.h"
+#include "sim.h"
+
+// Command line being received from the app
+static char command[512];
+static uint16_t command_length = 0;
+
+// Radio settings that affect airtime, at the module's power-on defaults
+static uint16_t radio_sf = 12;
+static uint16_t radio_bw = 125;
+static uint32_t radio_wdt_ms = 15000;
+
+void modem_reset() {
+    command_length = 0;
+    radio_sf = 12;
+    radio_bw = 125;
+    radio_wdt_ms = 15000;
+}
+
+// Semtech time-on-air for explicit header, CR 4/5, CRC on, 8-symbol preamble
+static uint32_t airtime_ms(uint16_t payload_bytes) {
+    double tsym = (double) (1 << radio_sf) / radio_bw;
+    int de = (radio_sf >= 11 && radio_bw == 125) ? 1 : 0;
+    double num = 8.0 * payload_bytes - 4.0 * radio_sf + 28 + 16;
+    double symbols = ceil(num / (4.0 * (radio_sf - 2 * de)));
+    if (symbols < 0)
+        symbols = 0;
+    symbols = 8 + symbols * 5;
+    return (uint32_t) ((12.25 + symbols) * tsym);
+}
+
+// The service's reply to a confirmed uplink, as the module reports the downlink
+static char *modem_downlink() {
+    static char line[160];
+    uint8_t reply[64];
+    uint16_t i, length;
+
+    length = service_reply(reply, sizeof(reply));
+    if (length == 0)
+        return "mac_tx_ok";
+    strcpy(line, "mac_rx 1 ");
+    for (i=0; i<length; i++)
+        sprintf(&line[strlen(line)], "%02X", reply[i]);
+    return line;
+}
+
+static bool starts_with(char *str, char *prefix) {
+    return (strncmp(str, prefix, strlen(prefix)) == 0);
+}
+
+// Count and time a transmit whose hex payload is the final token
+static void radio_transmit(char *hex, char *done) {
+    char *payload = strrchr(hex, ' ');
+    uint16_t bytes = (payload == NULL) ? 0 : strlen(payload+1) / 2;
+    sim_counters()->radio_transmissions++;
+    sim_counters()->radio_payload_bytes += bytes;
+    if (payload != NULL)
+        service_receive(payload+1);
+    sdk_uart_receive("ok", 5);
+    sdk_uart_receive(done, airtime_ms(bytes));
+}
+
+static void modem_command(char *cmd) {
+
+    if (starts_with(cmd, "sys get ver") || starts_with(cmd, "sys reset")) {
+        sdk_uart_receive("RN2483 1.0.1 Dec 15 2015 09:38:09", 10);
+
+    } else if (starts_with(cmd, "sys get hweui")) {
+        sdk_uart_receive("0004A30B001A2B3C", 10);
+
+    } else if (starts_with(cmd, "sys sleep ")) {
+        sdk_uart_receive("ok", atoi(&cmd[10]));
+
+    } else if (starts_with(cmd, "radio set sf sf")) {
+        radio_sf = atoi(&cmd[15]);
+        sdk_uart_receive("ok", 5);
+
+    } else if (starts_with(cmd, "radio set bw ")) {
+        radio_bw = atoi(&cmd[13]);
+        sdk_uart_receive("ok", 5);
+
+    } else if (starts_with(cmd, "radio set wdt ")) {
+        radio_wdt_ms = atoi(&cmd[14]);
+        sdk_uart_receive("ok", 5);
+
+    } else if (starts_with(cmd, "radio tx ")) {
+        radio_transmit(cmd, "radio_tx_ok");
+
+    } else if (starts_with(cmd, "mac tx cnf ")) {
+        // A confirmed uplink is answered by the service in the receive window
+        radio_transmit(cmd, modem_downlink());
+
+    } else if (starts_with(cmd, "mac tx ")) {
+        radio_transmit(cmd, "mac_tx_ok");
+
+    } else if (starts_with(cmd, "radio rx ")) {
+        // Nobody is out there, so the receive window always times out
+        sdk_uart_receive("ok", 5);
+        sdk_uart_receive("radio_err", radio_wdt_ms);
+
+    } else if (starts_with(cmd, "radio get snr")) {
+        char snr[8];
+        sprintf(snr, "%d", sim_snr());
+        sdk_uart_receive(snr, 5);
+
+    } else if (starts_with(cmd, "mac set dr ")) {
+        // EU868 data rates, DR0 being SF12
+        radio_sf = 12 - atoi(&cmd[11]);
+        sdk_uart_receive("ok", 5);
+
+    } else if (starts_with(cmd, "mac join ")) {
+        sdk_uart_receive("ok", 5);
+        sdk_uart_receive("accepted", 6000);
+
+    } else if (starts_with(cmd, "mac pause")) {
+        sdk_uart_receive("4294967245", 5);
+
+    } else {
+        sdk_uart_receive("ok", 5);
+    }
+
+}
+
+// Accumulate bytes sent by the app, processing each line as it completes
+void modem_tx_byte(uint8_t databyte) {
+
+    if (gpio_current_uart() != UART_LORA)
+        return;
+
+    if (databyte == '\n')
+        return;
+
+    if (databyte == '\r') {
+        command[command_length] = '\0';
+        if (sim_verbose())
+            printf("[modem] %s\n", command);
+        if (command_length > 0)
+            modem_command(command);
+        command_length = 0;
+        return;
+    }
+
+    if (command_length < sizeof(command)-1)
+        command[command_length++] = (char) databyte;
+
+}
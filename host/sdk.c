@@ -0,0 +1,855 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host implementations of the SDK services used by the app: app_timer,
+// app_scheduler, fstorage, app_uart, app_twi, GPIO/GPIOTE and the few
+// SoftDevice calls that we make.  Everything runs off the virtual clock.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "nrf.h"
+#include "nrf_gpio.h"
+#include "nrf_nvic.h"
+#include "nrf_soc.h"
+#include "ble_gap.h"
+#include "app_timer.h"
+#include "app_timer_appsh.h"
+#include "app_scheduler.h"
+#include "app_gpiote.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_timer.h"
+#include "app_uart.h"
+#include "app_twi.h"
+#include "fstorage.h"
+#include "crc32.h"
+#include "custom_board.h"
+#include "sim.h"
+
+///
+/// app_timer
+///
+
+#define MAX_TIMERS 16
+
+struct timer_s {
+    app_timer_id_t id;
+    app_timer_mode_t mode;
+    app_timer_timeout_handler_t handler;
+    bool running;
+    uint64_t expires;
+    uint64_t period;
+    void *context;
+};
+static struct timer_s timers[MAX_TIMERS];
+static uint16_t timers_created = 0;
+static app_timer_evt_schedule_func_t timer_schedule_func = NULL;
+
+// As with the SDK, RTC1 is stopped and cleared whenever no timer is running, and
+// started from zero when one is next started
+static bool rtc_running = false;
+static uint64_t rtc_started = 0;
+
+static void rtc_stop_if_idle() {
+    int i;
+    for (i=0; i<timers_created; i++)
+        if (timers[i].running)
+            return;
+    rtc_running = false;
+}
+
+uint32_t app_timer_init(uint32_t prescaler, uint8_t op_queue_size, void *p_buffer, app_timer_evt_schedule_func_t evt_schedule_func) {
+    timer_schedule_func = evt_schedule_func;
+    return NRF_SUCCESS;
+}
+
+// The timer id's storage holds the 1-based index of its slot
+static struct timer_s *timer_lookup(app_timer_id_t timer_id) {
+    uint32_t index = timer_id->data[0];
+    if (index == 0 || index > timers_created)
+        return NULL;
+    return &timers[index-1];
+}
+
+uint32_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode, app_timer_timeout_handler_t timeout_handler) {
+    struct timer_s *t = timer_lookup(*p_timer_id);
+    if (t == NULL) {
+        if (timers_created >= MAX_TIMERS)
+            return NRF_ERROR_NO_MEM;
+        t = &timers[timers_created++];
+        (*p_timer_id)->data[0] = timers_created;
+    }
+    t->id = *p_timer_id;
+    t->mode = mode;
+    t->handler = timeout_handler;
+    t->running = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context) {
+    struct timer_s *t = timer_lookup(timer_id);
+    if (t == NULL)
+        return NRF_ERROR_INVALID_STATE;
+    if (timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS)
+        return NRF_ERROR_INVALID_PARAM;
+    // As with the SDK, starting a running timer has no effect
+    if (t->running)
+        return NRF_SUCCESS;
+    if (!rtc_running) {
+        rtc_running = true;
+        rtc_started = sim_now();
+    }
+    t->running = true;
+    t->period = timeout_ticks;
+    t->expires = sim_now() + timeout_ticks;
+    t->context = p_context;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop(app_timer_id_t timer_id) {
+    struct timer_s *t = timer_lookup(timer_id);
+    if (t == NULL)
+        return NRF_ERROR_INVALID_STATE;
+    t->running = false;
+    rtc_stop_if_idle();
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop_all() {
+    int i;
+    for (i=0; i<timers_created; i++)
+        timers[i].running = false;
+    rtc_stop_if_idle();
+    return NRF_SUCCESS;
+}
+
+// RTC1 is a 24-bit counter, and the app depends upon it wrapping
+uint32_t app_timer_cnt_get() {
+    if (!rtc_running)
+        return 0;
+    return (uint32_t) ((sim_now() - rtc_started) & APP_TIMER_MAX_CNT_VAL);
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t *p_ticks_diff) {
+    *p_ticks_diff = ((ticks_to - ticks_from) & APP_TIMER_MAX_CNT_VAL);
+    return NRF_SUCCESS;
+}
+
+uint64_t sdk_timer_next_expiry() {
+    uint64_t next = SIM_NEVER;
+    int i;
+    for (i=0; i<timers_created; i++)
+        if (timers[i].running && timers[i].expires < next)
+            next = timers[i].expires;
+    return next;
+}
+
+void sdk_timer_fire(uint64_t now) {
+    int i;
+    for (i=0; i<timers_created; i++) {
+        struct timer_s *t = &timers[i];
+        if (!t->running || t->expires > now)
+            continue;
+        if (t->mode == APP_TIMER_MODE_REPEATED)
+            t->expires += t->period;
+        else {
+            t->running = false;
+            rtc_stop_if_idle();
+        }
+        sim_counters()->timer_expirations++;
+        sim_counters()->interrupts++;
+        if (timer_schedule_func != NULL)
+            timer_schedule_func(t->handler, t->context);
+        else
+            t->handler(t->context);
+    }
+}
+
+///
+/// app_scheduler
+///
+
+struct sched_event_s {
+    app_sched_event_handler_t handler;
+    uint16_t size;
+};
+static struct sched_event_s *sched_queue = NULL;
+static uint8_t *sched_data = NULL;
+static uint16_t sched_event_size = 0;
+static uint16_t sched_queue_size = 0;
+static uint16_t sched_start = 0;
+static uint16_t sched_end = 0;
+
+uint32_t app_sched_init(uint16_t max_event_size, uint16_t queue_size, void *p_evt_buffer) {
+    sched_event_size = max_event_size;
+    sched_queue_size = queue_size + 1;
+    sched_queue = calloc(sched_queue_size, sizeof(struct sched_event_s));
+    sched_data = calloc(sched_queue_size, max_event_size);
+    sched_start = sched_end = 0;
+    return NRF_SUCCESS;
+}
+
+uint16_t app_sched_queue_space_get() {
+    uint16_t used = (sched_end + sched_queue_size - sched_start) % sched_queue_size;
+    return (sched_queue_size - 1 - used);
+}
+
+bool sdk_sched_pending() {
+    return (sched_start != sched_end);
+}
+
+uint32_t app_sched_event_put(void const *p_event_data, uint16_t event_size, app_sched_event_handler_t handler) {
+    if (event_size > sched_event_size)
+        return NRF_ERROR_INVALID_LENGTH;
+    if (app_sched_queue_space_get() == 0)
+        return NRF_ERROR_NO_MEM;
+    struct sched_event_s *e = &sched_queue[sched_end];
+    e->handler = handler;
+    e->size = 0;
+    if (p_event_data != NULL && event_size > 0) {
+        memcpy(&sched_data[sched_end * sched_event_size], p_event_data, event_size);
+        e->size = event_size;
+    }
+    sched_end = (sched_end + 1) % sched_queue_size;
+    return NRF_SUCCESS;
+}
+
+void app_sched_execute() {
+    while (sched_start != sched_end) {
+        uint16_t index = sched_start;
+        struct sched_event_s *e = &sched_queue[index];
+        void *data = e->size == 0 ? NULL : &sched_data[index * sched_event_size];
+        sched_start = (sched_start + 1) % sched_queue_size;
+        sim_counters()->sched_events++;
+        e->handler(data, e->size);
+    }
+}
+
+// Dispatch timer timeouts through the scheduler, as app_timer_appsh does
+struct timer_event_s {
+    app_timer_timeout_handler_t handler;
+    void *context;
+};
+
+static void timer_event_handler(void *p_event_data, uint16_t event_size) {
+    struct timer_event_s *e = (struct timer_event_s *) p_event_data;
+    e->handler(e->context);
+}
+
+uint32_t app_timer_evt_schedule(app_timer_timeout_handler_t timeout_handler, void *p_context) {
+    struct timer_event_s e;
+    e.handler = timeout_handler;
+    e.context = p_context;
+    return app_sched_event_put(&e, sizeof(e), timer_event_handler);
+}
+
+///
+/// fstorage
+///
+
+#define FLASH_PAGE_WORDS    1024
+#define FLASH_PAGES         32
+static uint32_t flash[FLASH_PAGES * FLASH_PAGE_WORDS];
+static bool fs_initialized = false;
+
+// Configurations registered via FS_REGISTER_CFG, gathered by the linker
+extern fs_config_t __start_fs_data;
+extern fs_config_t __stop_fs_data;
+
+// Allocate pages from the top of flash downward, highest priority first
+fs_ret_t fs_init() {
+    fs_config_t *cfg;
+    uint32_t *top = &flash[FLASH_PAGES * FLASH_PAGE_WORDS];
+    uint16_t priority;
+
+    if (fs_initialized)
+        return FS_SUCCESS;
+    memset(flash, 0xff, sizeof(flash));
+
+    for (priority = 0xff; priority > 0; priority--)
+        for (cfg = &__start_fs_data; cfg < &__stop_fs_data; cfg++)
+            if (cfg->priority == priority) {
+                cfg->p_end_addr = top;
+                top -= cfg->num_pages * FLASH_PAGE_WORDS;
+                cfg->p_start_addr = top;
+            }
+    if (top < flash)
+        return FS_ERR_INVALID_CFG;
+
+    fs_initialized = true;
+    return FS_SUCCESS;
+}
+
+static fs_ret_t fs_check(fs_config_t const *cfg, uint32_t const *addr, uint32_t words) {
+    if (!fs_initialized)
+        return FS_ERR_NOT_INITIALIZED;
+    if (cfg == NULL || addr == NULL)
+        return FS_ERR_NULL_ARG;
+    if (addr < cfg->p_start_addr || addr + words > cfg->p_end_addr)
+        return FS_ERR_INVALID_ADDR;
+    return FS_SUCCESS;
+}
+
+// Operations are queued, as by the SoftDevice, and each takes effect only when it
+// completes, after roughly the nRF52's worst-case time to program or erase flash.
+// Until then the flash is untouched, and the source of a store must stay intact.
+#ifndef FS_QUEUE_SIZE
+#define FS_QUEUE_SIZE       4
+#endif
+#define FLASH_WORD_US       68
+#define FLASH_ERASE_MS      85
+
+struct fs_op_s {
+    fs_config_t const *config;
+    fs_evt_t evt;
+    uint32_t const *src;
+    uint64_t completes;
+};
+static struct fs_op_s fs_queue[FS_QUEUE_SIZE];
+static uint16_t fs_queued = 0;
+
+static fs_ret_t fs_enqueue(fs_config_t const *cfg, fs_evt_t *evt, uint32_t const *src, uint64_t ticks) {
+    struct fs_op_s *op;
+    if (fs_queued >= FS_QUEUE_SIZE)
+        return FS_ERR_QUEUE_FULL;
+    op = &fs_queue[fs_queued];
+    op->config = cfg;
+    op->evt = *evt;
+    op->src = src;
+    op->completes = (fs_queued == 0 ? sim_now() : fs_queue[fs_queued-1].completes) + (ticks == 0 ? 1 : ticks);
+    fs_queued++;
+    return FS_SUCCESS;
+}
+
+fs_ret_t fs_store(fs_config_t const * const p_config, uint32_t const * const p_dest, uint32_t const * const p_src, uint16_t const length_words, void *p_context) {
+    fs_ret_t result = fs_check(p_config, p_dest, length_words);
+    if (result != FS_SUCCESS)
+        return result;
+    fs_evt_t evt;
+    evt.id = FS_EVT_STORE;
+    evt.p_context = p_context;
+    evt.store.p_data = p_dest;
+    evt.store.length_words = length_words;
+    return fs_enqueue(p_config, &evt, p_src, ((uint64_t) length_words * FLASH_WORD_US * SIM_TICKS_PER_SECOND) / 1000000);
+}
+
+fs_ret_t fs_erase(fs_config_t const * const p_config, uint32_t const * const p_page_addr, uint16_t const num_pages, void *p_context) {
+    fs_ret_t result = fs_check(p_config, p_page_addr, num_pages * FLASH_PAGE_WORDS);
+    if (result != FS_SUCCESS)
+        return result;
+    if (((p_page_addr - flash) % FLASH_PAGE_WORDS) != 0)
+        return FS_ERR_UNALIGNED_ADDR;
+    fs_evt_t evt;
+    evt.id = FS_EVT_ERASE;
+    evt.p_context = p_context;
+    evt.erase.first_page = (p_page_addr - flash) / FLASH_PAGE_WORDS;
+    evt.erase.last_page = evt.erase.first_page + num_pages - 1;
+    return fs_enqueue(p_config, &evt, NULL, SIM_MS_TO_TICKS(num_pages * FLASH_ERASE_MS));
+}
+
+uint64_t sdk_flash_next_completion() {
+    return (fs_queued == 0 ? SIM_NEVER : fs_queue[0].completes);
+}
+
+// Carry out the operations that are done by now, calling back at interrupt level.
+// Flash can only clear bits when programmed, so a store to an unerased word ANDs.
+void sdk_flash_complete(uint64_t now) {
+    struct fs_op_s op;
+    uint32_t *dest;
+    uint16_t i, pages;
+    while (fs_queued != 0 && fs_queue[0].completes <= now) {
+        // Dequeue it first, because the callback may well queue another
+        op = fs_queue[0];
+        fs_queued--;
+        memmove(&fs_queue[0], &fs_queue[1], fs_queued * sizeof(fs_queue[0]));
+        if (op.evt.id == FS_EVT_STORE) {
+            dest = (uint32_t *) op.evt.store.p_data;
+            for (i=0; i<op.evt.store.length_words; i++)
+                dest[i] &= op.src[i];
+            sim_counters()->flash_words_written += op.evt.store.length_words;
+        } else {
+            pages = op.evt.erase.last_page - op.evt.erase.first_page + 1;
+            memset(&flash[op.evt.erase.first_page * FLASH_PAGE_WORDS], 0xff, pages * FLASH_PAGE_WORDS * sizeof(uint32_t));
+            sim_counters()->flash_pages_erased += pages;
+        }
+        sim_counters()->interrupts++;
+        if (op.config->callback != NULL)
+            op.config->callback(&op.evt, FS_SUCCESS);
+    }
+}
+
+// Operations are completed by the clock, rather than by SoftDevice system events
+void fs_sys_event_handler(uint32_t sys_evt) {
+}
+
+///
+/// app_uart
+///
+
+#define UART_RX_FIFO 1024
+static app_uart_event_handler_t uart_handler = NULL;
+static uint8_t uart_rx[UART_RX_FIFO];
+static uint16_t uart_rx_get = 0;
+static uint16_t uart_rx_put = 0;
+
+// Lines and data from the modem in flight, delivered when their time arrives
+#define UART_PENDING 16
+struct pending_s {
+    uint64_t when;
+    uint16_t length;
+    uint8_t data[512];
+};
+static struct pending_s pending[UART_PENDING];
+static uint16_t pending_count = 0;
+
+uint32_t app_uart_init(const app_uart_comm_params_t *p_comm_params, app_uart_buffers_t *p_buffers, app_uart_event_handler_t event_handler, app_irq_priority_t irq_priority) {
+    uart_handler = event_handler;
+    uart_rx_get = uart_rx_put = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_uart_close() {
+    uart_handler = NULL;
+    uart_rx_get = uart_rx_put = 0;
+    pending_count = 0;
+    modem_reset();
+    cell_reset();
+    return NRF_SUCCESS;
+}
+
+uint32_t app_uart_flush() {
+    uart_rx_get = uart_rx_put = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_uart_put(uint8_t byte) {
+    if (uart_handler == NULL)
+        return NRF_ERROR_INVALID_STATE;
+    sim_counters()->uart_bytes_tx++;
+    modem_tx_byte(byte);
+    cell_tx_byte(byte);
+    return NRF_SUCCESS;
+}
+
+uint32_t app_uart_get(uint8_t *p_byte) {
+    if (uart_rx_get == uart_rx_put)
+        return NRF_ERROR_NOT_FOUND;
+    *p_byte = uart_rx[uart_rx_get];
+    uart_rx_get = (uart_rx_get + 1) % UART_RX_FIFO;
+    return NRF_SUCCESS;
+}
+
+// Queue bytes to arrive from the peripheral after the specified delay
+void sdk_uart_receive_bytes(uint8_t *data, uint16_t length, uint32_t delay_ms) {
+    uint64_t when = sim_now() + SIM_MS_TO_TICKS(delay_ms);
+    // Keep ordering, because a UART can't deliver lines out of order
+    if (pending_count > 0 && pending[pending_count-1].when > when)
+        when = pending[pending_count-1].when;
+    if (pending_count >= UART_PENDING)
+        return;
+    if (length > sizeof(pending[0].data))
+        length = sizeof(pending[0].data);
+    pending[pending_count].when = when;
+    pending[pending_count].length = length;
+    memcpy(pending[pending_count].data, data, length);
+    pending_count++;
+}
+
+// Queue a line to arrive from the peripheral after the specified delay
+void sdk_uart_receive(char *line, uint32_t delay_ms) {
+    char terminated[sizeof(pending[0].data)];
+    snprintf(terminated, sizeof(terminated), "%s\r\n", line);
+    sdk_uart_receive_bytes((uint8_t *) terminated, strlen(terminated), delay_ms);
+}
+
+uint64_t sdk_uart_next_delivery() {
+    if (pending_count == 0)
+        return SIM_NEVER;
+    return pending[0].when;
+}
+
+void sdk_uart_deliver(uint64_t now) {
+    while (pending_count > 0 && pending[0].when <= now) {
+        uint8_t *p = pending[0].data;
+        uint16_t left = pending[0].length;
+        while (left-- > 0) {
+            uint16_t next = (uart_rx_put + 1) % UART_RX_FIFO;
+            if (next == uart_rx_get)
+                break;
+            uart_rx[uart_rx_put] = *p++;
+            uart_rx_put = next;
+            sim_counters()->uart_bytes_rx++;
+        }
+        memmove(&pending[0], &pending[1], (pending_count-1) * sizeof(pending[0]));
+        pending_count--;
+        // The app consumes a few bytes per interrupt, so keep interrupting until drained
+        while (uart_handler != NULL && uart_rx_get != uart_rx_put) {
+            app_uart_evt_t evt;
+            evt.evt_type = APP_UART_DATA_READY;
+            sim_counters()->interrupts++;
+            sim_counters()->uart_rx_interrupts++;
+            uart_handler(&evt);
+        }
+    }
+}
+
+///
+/// app_twi
+///
+
+ret_code_t nrf_drv_twi_init(nrf_drv_twi_t const *p_instance, nrf_drv_twi_config_t const *p_config, void *event_handler, void *p_context) {
+    return NRF_SUCCESS;
+}
+
+void nrf_drv_twi_uninit(nrf_drv_twi_t const *p_instance) {
+}
+
+void nrf_drv_twi_enable(nrf_drv_twi_t const *p_instance) {
+}
+
+void nrf_drv_twi_disable(nrf_drv_twi_t const *p_instance) {
+}
+
+ret_code_t nrf_drv_twi_tx(nrf_drv_twi_t const *p_instance, uint8_t address, uint8_t const *p_data, uint8_t length, bool no_stop) {
+    return NRF_ERROR_INTERNAL;
+}
+
+ret_code_t nrf_drv_twi_rx(nrf_drv_twi_t const *p_instance, uint8_t address, uint8_t *p_data, uint8_t length) {
+    return NRF_ERROR_INTERNAL;
+}
+
+ret_code_t app_twi_init(app_twi_t *p_app_twi, nrf_drv_twi_config_t const *p_twi_config, uint8_t queue_size, app_twi_transaction_t const **p_queue_buffer) {
+    p_app_twi->busy = 0;
+    return NRF_SUCCESS;
+}
+
+void app_twi_uninit(app_twi_t *p_app_twi) {
+}
+
+bool app_twi_is_idle(app_twi_t *p_app_twi) {
+    return (p_app_twi->busy == 0);
+}
+
+// Complete a transaction from the scheduler, as the TWI interrupt would
+struct twi_event_s {
+    app_twi_t *twi;
+    app_twi_transaction_t const *transaction;
+};
+
+static void twi_event_handler(void *p_event_data, uint16_t event_size) {
+    struct twi_event_s *e = (struct twi_event_s *) p_event_data;
+    e->twi->busy--;
+    if (e->transaction->callback != NULL)
+        e->transaction->callback(NRF_ERROR_INTERNAL, e->transaction->p_user_data);
+}
+
+ret_code_t app_twi_schedule(app_twi_t *p_app_twi, app_twi_transaction_t const *p_transaction) {
+    struct twi_event_s e;
+    e.twi = p_app_twi;
+    e.transaction = p_transaction;
+    if (app_sched_event_put(&e, sizeof(e), twi_event_handler) != NRF_SUCCESS)
+        return NRF_ERROR_BUSY;
+    p_app_twi->busy++;
+    return NRF_SUCCESS;
+}
+
+///
+/// GPIO and GPIOTE
+///
+
+static bool pin_out[32];
+static bool pin_in[32];
+static app_gpiote_event_handler_t gpiote_handler = NULL;
+static uint32_t gpiote_low_to_high_mask = 0;
+static bool gpiote_enabled = false;
+static uint32_t geiger_cpm = 0;
+static uint64_t geiger_next_pulse[2] = {SIM_NEVER, SIM_NEVER};
+
+void nrf_gpio_cfg_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config) {
+}
+
+void nrf_gpio_cfg_output(uint32_t pin_number) {
+}
+
+void nrf_gpio_cfg_sense_input(uint32_t pin_number, nrf_gpio_pin_pull_t pull_config, nrf_gpio_pin_sense_t sense_config) {
+}
+
+void nrf_gpio_pin_set(uint32_t pin_number) {
+    if (!pin_out[pin_number & 31])
+        sim_pin_changed(pin_number & 31, true);
+    pin_out[pin_number & 31] = true;
+}
+
+void nrf_gpio_pin_clear(uint32_t pin_number) {
+    if (pin_out[pin_number & 31])
+        sim_pin_changed(pin_number & 31, false);
+    pin_out[pin_number & 31] = false;
+}
+
+uint32_t nrf_gpio_pin_read(uint32_t pin_number) {
+    return pin_in[pin_number & 31] ? 1 : 0;
+}
+
+uint32_t nrf_gpio_pin_out_read(uint32_t pin_number) {
+    return pin_out[pin_number & 31] ? 1 : 0;
+}
+
+void sim_gpio_set_input(uint32_t pin, bool level) {
+    pin_in[pin & 31] = level;
+}
+
+// Inputs idle in their inactive state, including the active-low overcurrent sense
+void sim_gpio_init() {
+    memset(pin_in, 0, sizeof(pin_in));
+#ifdef SENSE_PIN_OVERCURRENT
+    sim_gpio_set_input(SENSE_PIN_OVERCURRENT, true);
+#endif
+}
+
+uint32_t app_gpiote_init(uint8_t max_users, void *p_buffer) {
+    return NRF_SUCCESS;
+}
+
+uint32_t app_gpiote_user_register(app_gpiote_user_id_t *p_user_id, uint32_t const *p_pins_low_to_high_mask, uint32_t const *p_pins_high_to_low_mask, app_gpiote_event_handler_t event_handler) {
+    gpiote_handler = event_handler;
+    gpiote_low_to_high_mask = p_pins_low_to_high_mask[0];
+    *p_user_id = 0;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_gpiote_user_enable(app_gpiote_user_id_t user_id) {
+    gpiote_enabled = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_gpiote_user_disable(app_gpiote_user_id_t user_id) {
+    gpiote_enabled = false;
+    return NRF_SUCCESS;
+}
+
+// Tube pulses are a Poisson process, so the gaps between them are exponential
+static uint64_t geiger_interval() {
+    double u = ((double) (sim_random() & 0xffffff) + 1.0) / 16777217.0;
+    double seconds = -log(u) * 60.0 / geiger_cpm;
+    return (uint64_t) (seconds * SIM_TICKS_PER_SECOND) + 1;
+}
+
+void sdk_gpiote_set_cpm(uint32_t cpm) {
+    geiger_cpm = cpm;
+    geiger_next_pulse[0] = geiger_next_pulse[1] = SIM_NEVER;
+    if (cpm == 0)
+        return;
+    geiger_next_pulse[0] = sim_now() + geiger_interval();
+    geiger_next_pulse[1] = sim_now() + geiger_interval();
+}
+
+uint64_t sdk_gpiote_next_pulse() {
+    return (geiger_next_pulse[0] < geiger_next_pulse[1] ? geiger_next_pulse[0] : geiger_next_pulse[1]);
+}
+
+// A pulse on a pin raises the event of the GPIOTE IN channel watching it,
+// whose PPI channels trigger their tasks without involving the CPU.
+static bool gpiote_in_event_fire(uint32_t pin);
+
+void sdk_gpiote_pulse(uint64_t now) {
+    int tube;
+    for (tube=0; tube<2; tube++) {
+        if (geiger_next_pulse[tube] > now)
+            continue;
+        geiger_next_pulse[tube] = now + geiger_interval();
+#if defined(GEIGERX) && defined(POWER_PIN_GEIGER)
+        uint32_t pin = (tube == 0 ? PIN_GEIGER0 : PIN_GEIGER1);
+        uint32_t pins = (1L << pin);
+        if (!pin_out[POWER_PIN_GEIGER])
+            continue;
+        if (gpiote_in_event_fire(pin)) {
+            sim_counters()->geiger_pulses++;
+            continue;
+        }
+        if (!gpiote_enabled || gpiote_handler == NULL)
+            continue;
+        if ((pins & gpiote_low_to_high_mask) == 0)
+            continue;
+        uint32_t none = 0;
+        sim_counters()->geiger_pulses++;
+        sim_counters()->interrupts++;
+        gpiote_handler(&pins, &none);
+#endif
+    }
+}
+
+#define GPIOTE_CH_NUM 8
+static uint32_t gpiote_in_pin[GPIOTE_CH_NUM];
+static bool gpiote_in_enabled[GPIOTE_CH_NUM];
+static uint32_t gpiote_in_events[GPIOTE_CH_NUM];
+static uint8_t gpiote_in_channels = 0;
+
+ret_code_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const *p_config, nrf_drv_gpiote_evt_handler_t evt_handler) {
+    if (!p_config->hi_accuracy || evt_handler != NULL)
+        return NRF_ERROR_NOT_SUPPORTED;
+    if (gpiote_in_channels >= GPIOTE_CH_NUM)
+        return NRF_ERROR_NO_MEM;
+    gpiote_in_pin[gpiote_in_channels++] = pin;
+    return NRF_SUCCESS;
+}
+
+static int gpiote_in_channel(uint32_t pin) {
+    int i;
+    for (i=0; i<gpiote_in_channels; i++)
+        if (gpiote_in_pin[i] == pin)
+            return i;
+    return -1;
+}
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable) {
+    int channel = gpiote_in_channel(pin);
+    if (channel >= 0)
+        gpiote_in_enabled[channel] = true;
+}
+
+uintptr_t nrf_drv_gpiote_in_event_addr_get(nrf_drv_gpiote_pin_t pin) {
+    int channel = gpiote_in_channel(pin);
+    return (channel < 0 ? 0 : (uintptr_t) &gpiote_in_events[channel]);
+}
+
+///
+/// TIMER and PPI
+///
+
+NRF_TIMER_Type sim_timer1;
+NRF_TIMER_Type sim_timer2;
+static NRF_TIMER_Type *sim_timers[] = {&sim_timer1, &sim_timer2};
+
+// The counter wraps at the width set in BITMODE, indexed by nrf_timer_bit_width_t
+static const uint32_t timer_mask[] = {0xFFFF, 0xFF, 0xFFFFFF, 0xFFFFFFFF};
+
+void nrf_timer_task_trigger(NRF_TIMER_Type *p_reg, nrf_timer_task_t task) {
+    switch (task) {
+    case NRF_TIMER_TASK_START:
+        p_reg->running = true;
+        break;
+    case NRF_TIMER_TASK_STOP:
+    case NRF_TIMER_TASK_SHUTDOWN:
+        p_reg->running = false;
+        break;
+    case NRF_TIMER_TASK_COUNT:
+        if (p_reg->running && p_reg->MODE != NRF_TIMER_MODE_TIMER)
+            p_reg->counter = (p_reg->counter + 1) & timer_mask[p_reg->BITMODE & 3];
+        break;
+    case NRF_TIMER_TASK_CLEAR:
+        p_reg->counter = 0;
+        break;
+    case NRF_TIMER_TASK_CAPTURE0:
+        p_reg->CC[0] = p_reg->counter;
+        break;
+    }
+}
+
+uint32_t *nrf_timer_task_address_get(NRF_TIMER_Type *p_reg, nrf_timer_task_t task) {
+    return (uint32_t *) ((uint8_t *) p_reg + (uint32_t) task);
+}
+
+void nrf_timer_mode_set(NRF_TIMER_Type *p_reg, nrf_timer_mode_t mode) {
+    p_reg->MODE = mode;
+}
+
+void nrf_timer_bit_width_set(NRF_TIMER_Type *p_reg, nrf_timer_bit_width_t bit_width) {
+    p_reg->BITMODE = bit_width;
+}
+
+uint32_t nrf_timer_cc_read(NRF_TIMER_Type *p_reg, nrf_timer_cc_channel_t cc_channel) {
+    return p_reg->CC[cc_channel];
+}
+
+#define PPI_CH_NUM 20
+static const volatile void *ppi_evt[PPI_CH_NUM];
+static const volatile void *ppi_task[PPI_CH_NUM];
+static uint32_t ppi_enabled = 0;
+
+uint32_t sd_ppi_channel_assign(uint8_t channel_num, const volatile void *evt_endpoint, const volatile void *task_endpoint) {
+    if (channel_num >= PPI_CH_NUM)
+        return NRF_ERROR_INVALID_PARAM;
+    ppi_evt[channel_num] = evt_endpoint;
+    ppi_task[channel_num] = task_endpoint;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ppi_channel_enable_set(uint32_t channel_enable_set_msk) {
+    ppi_enabled |= channel_enable_set_msk;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ppi_channel_enable_clr(uint32_t channel_enable_clr_msk) {
+    ppi_enabled &= ~channel_enable_clr_msk;
+    return NRF_SUCCESS;
+}
+
+// Trigger whichever timer task lives at a task address
+static void ppi_task_trigger(const volatile void *task) {
+    uint8_t *address = (uint8_t *) task;
+    int i;
+    for (i=0; i<sizeof(sim_timers)/sizeof(sim_timers[0]); i++) {
+        uint8_t *base = (uint8_t *) sim_timers[i];
+        if (address >= base && address < base + offsetof(NRF_TIMER_Type, CC))
+            nrf_timer_task_trigger(sim_timers[i], (nrf_timer_task_t) (address - base));
+    }
+}
+
+static bool gpiote_in_event_fire(uint32_t pin) {
+    int i, channel = gpiote_in_channel(pin);
+    bool routed = false;
+    if (channel < 0 || !gpiote_in_enabled[channel])
+        return false;
+    for (i=0; i<PPI_CH_NUM; i++) {
+        if ((ppi_enabled & (1L << i)) != 0 && ppi_evt[i] == &gpiote_in_events[channel]) {
+            ppi_task_trigger(ppi_task[i]);
+            routed = true;
+        }
+    }
+    return routed;
+}
+
+///
+/// SoftDevice
+///
+
+uint32_t sd_rand_application_vector_get(uint8_t *p_buff, uint8_t length) {
+    uint8_t i;
+    for (i=0; i<length; i++)
+        p_buff[i] = (uint8_t) sim_random();
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_addr_get(ble_gap_addr_t *p_addr) {
+    uint8_t i;
+    memset(p_addr, 0, sizeof(*p_addr));
+    for (i=0; i<BLE_GAP_ADDR_LEN; i++)
+        p_addr[0].addr[i] = (uint8_t) (0x10 + i);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_SystemReset() {
+    sim_exit("system reset");
+    return NRF_SUCCESS;
+}
+
+void NVIC_SystemReset() {
+    sim_exit("system reset");
+}
+
+///
+/// crc32
+///
+
+uint32_t crc32_compute(uint8_t const *p_data, uint32_t size, uint32_t const *p_crc) {
+    uint32_t crc = (p_crc == NULL) ? 0xFFFFFFFF : ~(*p_crc);
+    uint32_t i, j;
+    for (i=0; i<size; i++) {
+        crc = crc ^ p_data[i];
+        for (j=8; j>0; j--)
+            crc = (crc >> 1) ^ (0xEDB88320U & ((crc & 1) ? 0xFFFFFFFF : 0));
+    }
+    return ~crc;
+}
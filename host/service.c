@@ -0,0 +1,256 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-in for the service's handling of uplinks: it unpacks each buffered
+// message, reassembling those that were fragmented and expanding those that were
+// batched, and keeps stamps as described for STAMP_VERSION in send.c, so that a run
+// shows whether every stamped message could have been completed by the service.
+// It also builds the reply given to requests that expect one.
+
+#include <stdio.h>
+#include <string.h>
+#include "nrf.h"
+#include "send.h"
+#include "fragment.h"
+#include "batch.h"
+#include "pbarray.h"
+#include "tt.pb.h"
+#include "pb_decode.h"
+#include "pb_encode.h"
+#include "sim.h"
+
+// Stamps most recently created, as the service would cache them
+#define SERVICE_STAMPS  8
+typedef struct {
+    bool valid;
+    uint32_t device_id;
+    uint32_t stamp;
+    uint32_t version;
+    uint32_t fields;
+    ttproto_Telecast message;
+} service_stamp_t;
+static service_stamp_t stamps[SERVICE_STAMPS];
+static uint16_t next_stamp = 0;
+
+// What the service has seen
+static uint32_t messages = 0;
+static uint32_t undecodable = 0;
+static uint32_t stamps_created = 0;
+static uint32_t stamps_applied = 0;
+static uint32_t stamps_unresolved = 0;
+static uint32_t fields_restored = 0;
+static uint32_t fields_conflicting = 0;
+static uint32_t fragments = 0;
+static uint32_t reassembled = 0;
+static uint32_t batches = 0;
+static uint32_t batched = 0;
+static uint32_t replies = 0;
+
+// The device that most recently sent us something, to which replies are addressed
+static uint32_t reply_device_id = 0;
+
+// Messages being reassembled from their fragments, of which there is only ever one
+// in flight at a time from our single node
+static fragment_reassembly_t reassembly;
+
+// The fields cached under a stamp by a version 1 or 2 client, and those restored
+// when a message to which a stamp has been applied doesn't say otherwise.  Only
+// from version 3 do stamps carry the fields that they cache.
+#define STAMP_V1_FIELDS (STAMP_CAPTURED_AT|STAMP_LOCATION)
+#define STAMP_FIELDS_VERSION 3
+
+static service_stamp_t *service_find_stamp(uint32_t device_id, uint32_t stamp) {
+    int i;
+    for (i=0; i<SERVICE_STAMPS; i++)
+        if (stamps[i].valid && stamps[i].device_id == device_id && stamps[i].stamp == stamp)
+            return &stamps[i];
+    return NULL;
+}
+
+// Restore one cached field, noting if the client sent it anyway
+#define RESTORE(has, field) do {                    \
+        if (message->has)                           \
+            fields_conflicting++;                   \
+        message->has = cached->message.has;         \
+        message->field = cached->message.field;     \
+        fields_restored++;                          \
+    } while (0)
+
+static void service_stamp(ttproto_Telecast *message) {
+    service_stamp_t *cached;
+    uint32_t fields;
+
+    // Create or replace the stamp
+    if (message->has_stamp_version) {
+        cached = service_find_stamp(message->device_id, message->stamp);
+        if (cached == NULL) {
+            cached = &stamps[next_stamp];
+            next_stamp = (next_stamp + 1) % SERVICE_STAMPS;
+        }
+        cached->valid = true;
+        cached->device_id = message->device_id;
+        cached->stamp = message->stamp;
+        cached->version = message->stamp_version;
+        cached->fields = STAMP_V1_FIELDS;
+        if (message->stamp_version >= STAMP_FIELDS_VERSION && message->has_stamp_fields)
+            cached->fields = message->stamp_fields;
+        cached->message = *message;
+        stamps_created++;
+        return;
+    }
+
+    // Apply it
+    stamps_applied++;
+    cached = service_find_stamp(message->device_id, message->stamp);
+    if (cached == NULL) {
+        stamps_unresolved++;
+        return;
+    }
+    fields = cached->fields & STAMP_V1_FIELDS;
+    if (cached->version >= STAMP_FIELDS_VERSION && message->has_stamp_fields)
+        fields = message->stamp_fields;
+    if (fields & STAMP_CAPTURED_AT) {
+        RESTORE(has_captured_at_date, captured_at_date);
+        RESTORE(has_captured_at_time, captured_at_time);
+    }
+    if (fields & STAMP_LOCATION) {
+        RESTORE(has_latitude, latitude);
+        RESTORE(has_longitude, longitude);
+        RESTORE(has_altitude, altitude);
+    }
+    if (fields & STAMP_MOTION_BEGAN)
+        RESTORE(has_motion_began_offset, motion_began_offset);
+    if (fields & STAMP_TEST)
+        RESTORE(has_test, test);
+    if (fields & STAMP_BAT_VOLTAGE)
+        RESTORE(has_bat_voltage, bat_voltage);
+    if (fields & STAMP_BAT_SOC)
+        RESTORE(has_bat_soc, bat_soc);
+    if (fields & STAMP_ENC_TEMP)
+        RESTORE(has_enc_temp, enc_temp);
+    if (fields & STAMP_ENC_HUMID)
+        RESTORE(has_enc_humid, enc_humid);
+
+}
+
+static void service_message(uint8_t *pb, uint16_t length) {
+    ttproto_Telecast message;
+    memset(&message, 0, sizeof(message));
+    pb_istream_t stream = pb_istream_from_buffer(pb, length);
+    if (!pb_decode(&stream, ttproto_Telecast_fields, &message)) {
+        undecodable++;
+        return;
+    }
+    messages++;
+    if (message.has_device_id)
+        reply_device_id = message.device_id;
+    if (message.has_stamp)
+        service_stamp(&message);
+}
+
+// Receive an uplink in any of the buffered formats
+static void service_uplink(uint8_t *bin, uint16_t length) {
+    uint16_t count;
+    uint8_t *message;
+    uint16_t message_length;
+    pbarray_reader_t r;
+
+    // A fragment, which when it completes a message is received as if it were an uplink
+    if (length > 0 && bin[0] == BUFF_FORMAT_FRAGMENT) {
+        fragments++;
+        if (fragment_reassemble(&reassembly, bin, length, &message, &message_length)) {
+            reassembled++;
+            service_uplink(message, message_length);
+        }
+        return;
+    }
+
+    // A batch of mobile measurements, each of which the service would store as if it
+    // had arrived in a message of its own
+    if (length > 0 && bin[0] == BUFF_FORMAT_BATCH) {
+        batch_header_t header;
+        batch_sample_t samples[BATCH_MAX_COUNT];
+        if (!batch_decode(bin, length, &header, samples, BATCH_MAX_COUNT, &count)) {
+            undecodable++;
+            return;
+        }
+        batches++;
+        batched += count;
+        reply_device_id = header.device_id;
+        messages += count;
+        return;
+    }
+
+    // A single protocol buffer
+    if (length > 0 && bin[0] == BUFF_FORMAT_SINGLE_PB) {
+        service_message(bin, length);
+        return;
+    }
+
+    // An array of them, preceded by their lengths as bytes or as varints
+    if (!pbarray_begin(&r, bin, length)) {
+        undecodable++;
+        return;
+    }
+    while (pbarray_next(&r, &message, &message_length))
+        service_message(message, message_length);
+
+}
+
+// Receive a binary uplink
+void service_receive_bytes(uint8_t *bin, uint16_t length) {
+    service_uplink(bin, length);
+}
+
+// Receive a hex-encoded uplink
+void service_receive(char *hex) {
+    uint8_t bin[512];
+    uint16_t length;
+    unsigned int databyte;
+
+    for (length = 0; length < sizeof(bin) && sscanf(&hex[length*2], "%2x", &databyte) == 1; length++)
+        bin[length] = (uint8_t) databyte;
+
+    service_uplink(bin, length);
+
+}
+
+// Build the reply to a request, returning its length.  With no commands pending for
+// the device, this is an empty message from the service addressed back to it.
+uint16_t service_reply(uint8_t *reply, uint16_t size) {
+    ttproto_Telecast message;
+    uint8_t pb[64];
+    uint16_t length;
+
+    memset(&message, 0, sizeof(message));
+    message.has_device_type = true;
+    message.device_type = ttproto_Telecast_deviceType_TTSERVE;
+    message.has_device_id = true;
+    message.device_id = reply_device_id;
+    pb_ostream_t stream = pb_ostream_from_buffer(pb, sizeof(pb));
+    if (!pb_encode(&stream, ttproto_Telecast_fields, &message))
+        return 0;
+    if (pbarray_header_size(1, 0, false) + stream.bytes_written > size)
+        return 0;
+
+    length = pbarray_put_count(reply, 1, false);
+    length += pbarray_put_length(&reply[length], stream.bytes_written, false);
+    memcpy(&reply[length], pb, stream.bytes_written);
+    replies++;
+    return (length + stream.bytes_written);
+
+}
+
+void service_report() {
+    printf("  service: messages %lu, undecodable %lu, stamps created %lu, applied %lu, unresolved %lu\n",
+           (unsigned long) messages, (unsigned long) undecodable, (unsigned long) stamps_created,
+           (unsigned long) stamps_applied, (unsigned long) stamps_unresolved);
+    printf("  service: fields restored %lu, also sent %lu, fragments %lu, reassembled %lu\n",
+           (unsigned long) fields_restored, (unsigned long) fields_conflicting,
+           (unsigned long) fragments, (unsigned long) reassembled);
+    printf("  service: batches %lu, batched measurements %lu\n",
+           (unsigned long) batches, (unsigned long) batched);
+    if (replies != 0)
+        printf("  service: replies %lu\n", (unsigned long) replies);
+}
@@ -0,0 +1,264 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host simulator.  The firmware's main() runs unmodified; when it goes to
+// sleep in sd_app_evt_wait() the virtual clock jumps directly to the next
+// timer expiry, UART delivery or geiger pulse, so that days of operation
+// can be run in seconds and the resulting activity reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "nrf_delay.h"
+#include "nrf_gpio.h"
+#include "custom_board.h"
+#include "stats.h"
+#include "comm.h"
+#include "sim.h"
+
+// The firmware's own main(), renamed at compile time
+int firmware_main(void);
+
+// Run parameters
+static uint64_t sim_end = (uint64_t) 7 * 24 * 60 * 60 * SIM_TICKS_PER_SECOND;
+static uint32_t sim_cpm = 30;
+static uint32_t sim_seed = 1;
+static bool sim_verbose_output = false;
+static int sim_snr_db = 5;
+static bool sim_full_stats = false;
+
+// State
+static uint64_t now = 0;
+static bool in_interrupt = false;
+static struct timespec wall_start;
+static sim_counters_t counters;
+
+uint64_t sim_now() {
+    return now;
+}
+
+bool sim_verbose() {
+    return sim_verbose_output;
+}
+
+// SNR at which the gateway's replies are received
+int sim_snr() {
+    return sim_snr_db;
+}
+
+sim_counters_t *sim_counters() {
+    return &counters;
+}
+
+// xorshift32, so that runs are repeatable for a given seed
+uint32_t sim_random() {
+    sim_seed ^= sim_seed << 13;
+    sim_seed ^= sim_seed >> 17;
+    sim_seed ^= sim_seed << 5;
+    return sim_seed;
+}
+
+// Time of the next event that would raise an interrupt
+static uint64_t next_event() {
+    uint64_t next = sdk_timer_next_expiry();
+    uint64_t t = sdk_uart_next_delivery();
+    if (t < next)
+        next = t;
+    t = sdk_gpiote_next_pulse();
+    if (t < next)
+        next = t;
+    t = cell_next_event();
+    if (t < next)
+        next = t;
+    t = sdk_flash_next_completion();
+    if (t < next)
+        next = t;
+    return next;
+}
+
+// Move the clock forward, delivering interrupts that occur along the way.
+// As on the chip, interrupt handlers don't nest, so time spent within a
+// handler simply passes and its events are delivered once it returns.
+void sim_advance_to(uint64_t when) {
+    uint64_t next;
+    if (in_interrupt) {
+        if (when > now)
+            now = when;
+        return;
+    }
+    while ((next = next_event()) <= when) {
+        if (next > now)
+            now = next;
+        in_interrupt = true;
+        sdk_timer_fire(now);
+        sdk_uart_deliver(now);
+        sdk_gpiote_pulse(now);
+        cell_event(now);
+        sdk_flash_complete(now);
+        in_interrupt = false;
+    }
+    if (when > now)
+        now = when;
+}
+
+void nrf_delay_us(uint32_t number_of_us) {
+    uint64_t ticks = ((uint64_t) number_of_us * SIM_TICKS_PER_SECOND) / 1000000;
+    counters.delay_ticks += ticks;
+    sim_advance_to(now + ticks);
+}
+
+void nrf_delay_ms(uint32_t number_of_ms) {
+    uint64_t ticks = SIM_MS_TO_TICKS(number_of_ms);
+    counters.delay_ticks += ticks;
+    sim_advance_to(now + ticks);
+}
+
+void sim_pin_changed(uint32_t pin, bool level) {
+    if (level)
+        counters.pin_on_since[pin] = now;
+    else
+        counters.pin_on_ticks[pin] += now - counters.pin_on_since[pin];
+}
+
+static double seconds(uint64_t ticks) {
+    return ((double) ticks / SIM_TICKS_PER_SECOND);
+}
+
+// Percentage of the run for which a power pin was on
+static void report_pin(char *name, uint32_t pin) {
+    uint64_t on = counters.pin_on_ticks[pin];
+    if (nrf_gpio_pin_out_read(pin))
+        on += now - counters.pin_on_since[pin];
+    printf("  %-8s on %10.0fs (%5.2f%%)\n", name, seconds(on), now == 0 ? 0.0 : (100.0 * on) / now);
+}
+
+static void report(char *reason) {
+    struct timespec wall_end;
+    clock_gettime(CLOCK_MONOTONIC, &wall_end);
+    double wall = (wall_end.tv_sec - wall_start.tv_sec) + (wall_end.tv_nsec - wall_start.tv_nsec) / 1e9;
+
+    printf("\nsimulation ended: %s\n", reason);
+    printf("  simulated %.0fs (%.2f days) in %.2fs of wall time\n", seconds(now), seconds(now) / 86400, wall);
+    printf("  wakeups %llu, scheduler events %llu, timer expirations %llu\n",
+           (unsigned long long) counters.wakeups,
+           (unsigned long long) counters.sched_events,
+           (unsigned long long) counters.timer_expirations);
+    printf("  busy-wait delays %.0fs\n", seconds(counters.delay_ticks));
+    printf("  flash pages erased %llu, words written %llu\n",
+           (unsigned long long) counters.flash_pages_erased,
+           (unsigned long long) counters.flash_words_written);
+    printf("  uart bytes tx %llu, rx %llu, rx interrupts %llu\n",
+           (unsigned long long) counters.uart_bytes_tx,
+           (unsigned long long) counters.uart_bytes_rx,
+           (unsigned long long) counters.uart_rx_interrupts);
+    printf("  radio transmissions %llu, payload bytes %llu\n",
+           (unsigned long long) counters.radio_transmissions,
+           (unsigned long long) counters.radio_payload_bytes);
+    if (counters.cell_sends != 0)
+        printf("  cell sends %llu, bytes over the air tx %llu, rx %llu\n",
+               (unsigned long long) counters.cell_sends,
+               (unsigned long long) counters.cell_bytes_tx,
+               (unsigned long long) counters.cell_bytes_rx);
+    if (counters.cell_commands != 0)
+        printf("  cell commands %llu, sessions %llu, network round trips %llu\n",
+               (unsigned long long) counters.cell_commands,
+               (unsigned long long) counters.cell_sessions,
+               (unsigned long long) counters.cell_round_trips);
+    printf("  geiger pulses delivered %llu\n", (unsigned long long) counters.geiger_pulses);
+    printf("  app: transmitted %lu bytes, received %lu, messages %lu, resets %lu\n",
+           (unsigned long) stats()->transmitted, (unsigned long) stats()->received,
+           (unsigned long) stats()->messages, (unsigned long) stats()->resets);
+    if (stats()->cell_requests != 0)
+        printf("  app: cell uart tx %lu, rx %lu, requests %lu, replies %lu, reply ms avg %lu, max %lu\n",
+               (unsigned long) stats()->cell_wire_transmitted, (unsigned long) stats()->cell_wire_received,
+               (unsigned long) stats()->cell_requests, (unsigned long) stats()->cell_replies,
+               (unsigned long) (stats()->cell_replies ? stats()->cell_reply_ms_total / stats()->cell_replies : 0),
+               (unsigned long) stats()->cell_reply_ms_max);
+    if (stats()->errors_overrun != 0 || stats()->errors_framing != 0)
+        printf("  app: receive overruns %lu, framing errors %lu\n",
+               (unsigned long) stats()->errors_overrun, (unsigned long) stats()->errors_framing);
+    service_report();
+#ifdef POWER_PIN_LORA
+    report_pin("lora", POWER_PIN_LORA);
+#endif
+#ifdef POWER_PIN_CELL
+    report_pin("cell", POWER_PIN_CELL);
+#endif
+#ifdef POWER_PIN_GEIGER
+    report_pin("geiger", POWER_PIN_GEIGER);
+#endif
+#ifdef POWER_PIN_GPS
+    report_pin("gps", POWER_PIN_GPS);
+#endif
+#ifdef POWER_PIN_TWI
+    report_pin("twi", POWER_PIN_TWI);
+#endif
+}
+
+void sim_exit(char *reason) {
+    report(reason);
+    exit(0);
+}
+
+// Sleep until an interrupt is delivered.  If the scheduler already has work,
+// as it would if an interrupt had fired while running, return immediately.
+uint32_t sd_app_evt_wait() {
+    uint64_t next;
+    uint64_t interrupts = counters.interrupts;
+    if (sdk_sched_pending())
+        return NRF_SUCCESS;
+    while (counters.interrupts == interrupts) {
+        next = next_event();
+        if (next == SIM_NEVER || next > sim_end) {
+            now = sim_end;
+            sim_exit(next == SIM_NEVER ? "nothing left to do" : "end of run");
+        }
+        sim_advance_to(next);
+    }
+    counters.wakeups++;
+    return NRF_SUCCESS;
+}
+
+static void usage(char *name) {
+    fprintf(stderr, "usage: %s [--days N] [--seconds N] [--cpm N] [--snr N] [--seed N] [--full-stats] [--verbose]\n", name);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int i;
+
+    for (i=1; i<argc; i++) {
+        if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0)
+            sim_verbose_output = true;
+        else if (strcmp(argv[i], "--full-stats") == 0)
+            sim_full_stats = true;
+        else if (i+1 >= argc)
+            usage(argv[0]);
+        else if (strcmp(argv[i], "--days") == 0)
+            sim_end = (uint64_t) (atof(argv[++i]) * 86400 * SIM_TICKS_PER_SECOND);
+        else if (strcmp(argv[i], "--seconds") == 0)
+            sim_end = (uint64_t) atoll(argv[++i]) * SIM_TICKS_PER_SECOND;
+        else if (strcmp(argv[i], "--cpm") == 0)
+            sim_cpm = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--snr") == 0)
+            sim_snr_db = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            sim_seed = atoi(argv[++i]) | 1;
+        else
+            usage(argv[0]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+    sim_gpio_init();
+    sdk_gpiote_set_cpm(sim_cpm);
+
+    // Begin as a freshly-configured device would, by sending the full set of stats
+    if (sim_full_stats)
+        comm_initiate_service_update(true);
+
+    return (firmware_main());
+}
@@ -0,0 +1,83 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host simulator: virtual clock, event sources, and run accounting
+
+#ifndef SIM_H__
+#define SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The virtual clock runs at the RTC rate used by app_timer
+#define SIM_TICKS_PER_SECOND    32768
+#define SIM_MS_TO_TICKS(ms)     (((uint64_t)(ms) * SIM_TICKS_PER_SECOND) / 1000)
+#define SIM_NEVER               UINT64_MAX
+
+// Virtual time
+uint64_t sim_now();
+void sim_advance_to(uint64_t when);
+bool sim_verbose();
+int sim_snr();
+uint32_t sim_random();
+
+// Event sources, each of which reports when it next needs attention
+// and is fired by the clock when that time arrives
+uint64_t sdk_timer_next_expiry();
+void sdk_timer_fire(uint64_t now);
+uint64_t sdk_uart_next_delivery();
+void sdk_uart_deliver(uint64_t now);
+void sdk_uart_receive(char *line, uint32_t delay_ms);
+void sdk_uart_receive_bytes(uint8_t *data, uint16_t length, uint32_t delay_ms);
+uint64_t sdk_gpiote_next_pulse();
+void sdk_gpiote_pulse(uint64_t now);
+void sdk_gpiote_set_cpm(uint32_t cpm);
+uint64_t sdk_flash_next_completion();
+void sdk_flash_complete(uint64_t now);
+bool sdk_sched_pending();
+
+// Simulated peripherals
+void modem_tx_byte(uint8_t databyte);
+void modem_reset();
+void cell_tx_byte(uint8_t databyte);
+void cell_reset();
+uint64_t cell_next_event();
+void cell_event(uint64_t now);
+void sim_gpio_init();
+void sim_gpio_set_input(uint32_t pin, bool level);
+void service_receive(char *hex);
+void service_receive_bytes(uint8_t *bin, uint16_t length);
+uint16_t service_reply(uint8_t *reply, uint16_t size);
+void service_report();
+
+// Accounting
+struct sim_counters_s {
+    uint64_t timer_expirations;
+    uint64_t sched_events;
+    uint64_t wakeups;
+    uint64_t interrupts;
+    uint64_t delay_ticks;
+    uint64_t flash_pages_erased;
+    uint64_t flash_words_written;
+    uint64_t uart_bytes_tx;
+    uint64_t uart_bytes_rx;
+    uint64_t uart_rx_interrupts;
+    uint64_t radio_transmissions;
+    uint64_t radio_payload_bytes;
+    uint64_t cell_sends;
+    uint64_t cell_bytes_tx;
+    uint64_t cell_bytes_rx;
+    uint64_t cell_commands;
+    uint64_t cell_sessions;
+    uint64_t cell_round_trips;
+    uint64_t geiger_pulses;
+    uint64_t pin_on_ticks[32];
+    uint64_t pin_on_since[32];
+};
+typedef struct sim_counters_s sim_counters_t;
+sim_counters_t *sim_counters();
+void sim_pin_changed(uint32_t pin, bool level);
+void sim_exit(char *reason);
+
+#endif // SIM_H__
@@ -0,0 +1,58 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host stand-ins for Bluetooth, which isn't simulated.  Debug output that
+// would otherwise go to the phone is written to stdout when verbose.
+
+#include <stdio.h>
+#include "nrf.h"
+#include "bt.h"
+#include "btdebug.h"
+#include "sim.h"
+
+void bluetooth_init() {
+}
+
+void bluetooth_softdevice_init(void) {
+}
+
+void drop_bluetooth(void) {
+}
+
+bool can_send_to_bluetooth(void) {
+    return false;
+}
+
+bool send_byte_to_bluetooth(uint8_t databyte) {
+    return false;
+}
+
+uint32_t bluetooth_session_id() {
+    return 0;
+}
+
+void btdebug_create_timer() {
+}
+
+void btdebug_send_byte(uint8_t databyte) {
+    if (sim_verbose())
+        putchar(databyte);
+}
+
+// Prefix each line with the virtual time, so that traces can be lined up
+void btdebug_send_string(char *str) {
+    static bool at_line_start = true;
+    if (!sim_verbose())
+        return;
+    while (*str != '\0') {
+        if (at_line_start) {
+            uint64_t now = sim_now();
+            printf("[%7lu.%03lu] ", (unsigned long) (now / SIM_TICKS_PER_SECOND),
+                   (unsigned long) (((now % SIM_TICKS_PER_SECOND) * 1000) / SIM_TICKS_PER_SECOND));
+        }
+        putchar(*str);
+        at_line_start = (*str == '\n');
+        str++;
+    }
+}
@@ -0,0 +1,106 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host checks of the firmware's own logic.  These are linked against the same
+// objects as the simulator, whose main() is renamed so that this one runs instead.
+// Given --bench, it instead times the firmware against what it replaced.
+//
+//      make APPNAME=host test
+//      make APPNAME=host bench
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "app_scheduler.h"
+#include "sim.h"
+#include "test.h"
+
+typedef struct {
+    char *name;
+    void (*check)(void);
+} test_t;
+
+static const test_t tests[] = {
+    {"geiger counter wrap",         test_geiger_counter_wrap},
+    {"geiger rate change",          test_geiger_rate_change},
+    {"geiger window sums",          test_geiger_window_sums},
+    {"stamp dedup",                 test_stamp_dedup},
+    {"send pack size",              test_send_pack_size},
+    {"batch round trip",            test_batch_round_trip},
+    {"pbarray round trip",          test_pbarray_round_trip},
+    {"fragment round trip",         test_fragment_round_trip},
+    {"lorafp plans",                test_lorafp_plans},
+    {"lorafp overflow",             test_lorafp_overflow},
+    {"phone commands",              test_phone_commands},
+    {"recv commands",               test_recv_commands},
+    {"modem replies",               test_modem_replies},
+    {"serial ring",                 test_serial_ring},
+    {"db journal",                  test_db_journal},
+};
+#define TESTS (sizeof(tests) / sizeof(tests[0]))
+
+static const test_t benches[] = {
+    {"command lookup",              bench_command_lookup},
+    {"stamp id",                    bench_stamp_id},
+    {"lorafp plan",                 bench_lorafp_plan},
+    {"reply lookup",                bench_reply_lookup_transcripts},
+};
+#define BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static int failures = 0;
+
+bool test_check(bool ok, char *what, char *file, int line) {
+    if (!ok) {
+        failures++;
+        printf("FAIL %s:%d: %s\n", file, line, what);
+    }
+    return ok;
+}
+
+// Time a body that does what's being measured the specified number of times, once to warm
+// the caches and then for real, returning nanoseconds per iteration
+double bench_ns(bench_body_t body, uint32_t iterations) {
+    struct timespec start, end;
+    body(iterations/10 + 1);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    body(iterations);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((double) (end.tv_sec - start.tv_sec) * 1e9 + (double) (end.tv_nsec - start.tv_nsec)) / iterations;
+}
+
+void bench_report(char *what, double before_ns, double after_ns) {
+    printf("  %-36s %10.1f ns %10.1f ns %7.1fx\n", what, before_ns, after_ns, before_ns / after_ns);
+}
+
+int main(int argc, char *argv[]) {
+    int i, failed = 0, before;
+
+    sim_gpio_init();
+    APP_SCHED_INIT(0, 32);
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        printf("  %-36s %13s %13s %8s\n", "", "before", "after", "speedup");
+        for (i=0; i<BENCHES; i++) {
+            if (argc > 2 && strstr(benches[i].name, argv[2]) == NULL)
+                continue;
+            printf("%s\n", benches[i].name);
+            benches[i].check();
+        }
+        return 0;
+    }
+
+    for (i=0; i<TESTS; i++) {
+        if (argc > 1 && strstr(tests[i].name, argv[1]) == NULL)
+            continue;
+        before = failures;
+        tests[i].check();
+        printf("%s %s\n", failures == before ? "ok  " : "FAIL", tests[i].name);
+        if (failures != before)
+            failed++;
+    }
+
+    printf("%d of %d tests failed\n", failed, (int) TESTS);
+    return (failed ? 1 : 0);
+}
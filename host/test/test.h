@@ -0,0 +1,44 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Host checks of the firmware's own logic
+
+#ifndef TEST_H__
+#define TEST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Note a failure, without stopping, if a condition doesn't hold
+#define CHECK(cond)     test_check((cond), #cond, __FILE__, __LINE__)
+bool test_check(bool ok, char *what, char *file, int line);
+
+// The checks, by area
+void test_geiger_counter_wrap();
+void test_geiger_rate_change();
+void test_geiger_window_sums();
+void test_stamp_dedup();
+void test_send_pack_size();
+void test_batch_round_trip();
+void test_pbarray_round_trip();
+void test_fragment_round_trip();
+void test_lorafp_plans();
+void test_lorafp_overflow();
+void test_phone_commands();
+void test_recv_commands();
+void test_modem_replies();
+void test_serial_ring();
+void test_db_journal();
+
+// Benchmarks, which compare the time per operation of what the firmware does with what it
+// did before, printing the two and the speedup.  On the host, only the ratio is meaningful.
+typedef void (*bench_body_t)(uint32_t iterations);
+double bench_ns(bench_body_t body, uint32_t iterations);
+void bench_report(char *what, double before_ns, double after_ns);
+void bench_command_lookup();
+void bench_stamp_id();
+void bench_lorafp_plan();
+void bench_reply_lookup_transcripts();
+
+#endif // TEST_H__
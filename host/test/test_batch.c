@@ -0,0 +1,76 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Batches of mobile measurements
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "send.h"
+#include "batch.h"
+#include "test.h"
+
+// Samples taken while driving, with deltas of either sign and the occasional jump
+static void batch_sample(batch_sample_t *s, int i) {
+    memset(s, 0, sizeof(*s));
+    s->captured_at_offset = i * 5 + (i % 3);
+    s->latitude = batch_degrees(35.681236 + i * 0.00011);
+    s->longitude = batch_degrees(139.767125 - i * 0.00007);
+    s->cpm0 = 30 + (i * 7) % 11 + (i == 20 ? 5000 : 0);
+    s->cpm1 = 30 - (i * 3) % 7;
+}
+
+// What's batched must be decoded exactly, and a damaged batch must be rejected
+void test_batch_round_trip() {
+    static batch_t b;
+    batch_header_t header, decoded;
+    batch_sample_t sample, samples[BATCH_MAX_COUNT];
+    uint16_t count, length, max_length = 200;
+    int i;
+
+    memset(&header, 0, sizeof(header));
+    header.flags = BATCH_LOCATION|BATCH_CPM0|BATCH_CPM1;
+    header.device_id = 1234567890;
+    header.captured_at_date = 171017;
+    header.captured_at_time = 235959;
+    header.motion_began_offset = 3600;
+    batch_begin(&b, &header);
+    CHECK(batch_matches(&b, &header));
+
+    // Fill it until the next sample won't fit
+    for (i=0; ; i++) {
+        batch_sample(&sample, i);
+        if (!batch_add(&b, &sample, max_length))
+            break;
+    }
+    CHECK(i > 20 && b.count == i);
+    CHECK(b.length <= max_length);
+
+    CHECK(batch_decode(b.data, b.length, &decoded, samples, BATCH_MAX_COUNT, &count));
+    CHECK(memcmp(&decoded, &header, sizeof(header)) == 0);
+    CHECK(count == b.count);
+    for (i=0; i<count; i++) {
+        batch_sample(&sample, i);
+        CHECK(memcmp(&samples[i], &sample, sizeof(sample)) == 0);
+    }
+
+    // Only as many samples as were asked for are returned, but all are validated
+    CHECK(batch_decode(b.data, b.length, &decoded, samples, 3, &count) && count == 3);
+
+    // Any truncation or excess is rejected
+    for (length=0; length<b.length; length++)
+        CHECK(!batch_decode(b.data, length, &decoded, samples, BATCH_MAX_COUNT, &count));
+    b.data[b.length] = 0;
+    CHECK(!batch_decode(b.data, b.length+1, &decoded, samples, BATCH_MAX_COUNT, &count));
+
+    // A batch holds no more samples than its count can say
+    header.flags = 0;
+    batch_begin(&b, &header);
+    CHECK(!batch_matches(&b, &(batch_header_t) {BATCH_CPM0}));
+    memset(&sample, 0, sizeof(sample));
+    for (i=0; i<BATCH_MAX_COUNT; i++)
+        CHECK(batch_add(&b, &sample, BATCH_MAX_LENGTH));
+    CHECK(!batch_add(&b, &sample, BATCH_MAX_LENGTH));
+    CHECK(batch_decode(b.data, b.length, &decoded, samples, BATCH_MAX_COUNT, &count) && count == BATCH_MAX_COUNT);
+}
@@ -0,0 +1,432 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Recognition of what arrives on the command buffers
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "ring.h"
+#include "config.h"
+#include "comm.h"
+#include "phone.h"
+#include "recv.h"
+#include "lora.h"
+#include "fona.h"
+#include "sim.h"
+#include "test.h"
+
+#define FUZZ_LINES      20000
+
+// Fill a command buffer with a line, as though it had just been received
+static void cmdbuf_line(cmdbuf_t *cmd, char *line) {
+    comm_cmdbuf_reset(cmd);
+    while (*line != '\0')
+        frame_byte(&cmd->line, (uint8_t) *line++);
+    frame_byte(&cmd->line, '\n');
+}
+
+// A random printable character, more often than not one that can appear in a name
+static char fuzz_char() {
+    static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789ABCZ-_+/ ,;.";
+    return chars[sim_random() % (sizeof(chars)-1)];
+}
+
+// A line that resembles a command: the name given, perhaps altered, perhaps followed by arguments
+static void fuzz_command_line(char *line, char *name) {
+    static char *suffixes[] = {"", " ", " on", " off", ",1", ";x", " 1 2", "  x"};
+    uint16_t i, length;
+
+    strcpy(line, name);
+    length = strlen(line);
+    switch (sim_random() % 6) {
+    case 1:
+        if (length > 0)
+            line[--length] = '\0';
+        break;
+    case 2:
+        line[length++] = fuzz_char();
+        line[length] = '\0';
+        break;
+    case 3:
+        if (length > 0)
+            line[sim_random() % length] = fuzz_char();
+        break;
+    case 4:
+        for (i=0; i<length; i++)
+            if ((sim_random() & 1) && line[i] >= 'a' && line[i] <= 'z')
+                line[i] += 'A' - 'a';
+        break;
+    case 5:
+        length = sim_random() % 20;
+        for (i=0; i<length; i++)
+            line[i] = fuzz_char();
+        line[length] = '\0';
+        break;
+    }
+    strcat(line, suffixes[sim_random() % (sizeof(suffixes)/sizeof(suffixes[0]))]);
+}
+
+// What phone_command_lookup() must find: the command that comm_cmdbuf_this_arg_is() matches,
+// as the console did when it tried each of them in turn
+static const phone_command_t *phone_command_by_scan(cmdbuf_t *cmd) {
+    const phone_command_t *c;
+    uint16_t i;
+    for (i=0; (c = phone_command(i)) != NULL; i++)
+        if (comm_cmdbuf_this_arg_is(cmd, c->name))
+            return c;
+    return NULL;
+}
+
+// What recv_command_lookup() must find: the command whose name is the message's whole first
+// word, as long as an argument is present or absent as it requires
+static const recv_command_t *recv_command_by_scan(char *message, char **arg) {
+    const recv_command_t *c;
+    char *space = strchr(message, ' ');
+    uint16_t i, length = (space == NULL) ? strlen(message) : (space - message);
+
+    *arg = (space == NULL) ? NULL : space+1;
+    for (i=0; (c = recv_command(i)) != NULL; i++)
+        if (strlen(c->name) == length && memcmp(message, c->name, length) == 0)
+            break;
+    if (c == NULL)
+        return NULL;
+    if (*arg == NULL ? c->arg == RECV_ARG_REQUIRED : c->arg == RECV_ARG_NONE)
+        return NULL;
+    return c;
+}
+
+// The console's commands must be sorted, and each found by its name in any case
+void test_phone_commands() {
+    static cmdbuf_t cmd;
+    const phone_command_t *c, *prev = NULL;
+    char line[32];
+    uint16_t i, j;
+
+    for (i=0; (c = phone_command(i)) != NULL; prev = c, i++) {
+        if (prev != NULL)
+            CHECK(strcmp(prev->name, c->name) < 0);
+        CHECK(phone_command_lookup(c->name) == c);
+
+        // In upper case, and followed by arguments
+        for (j=0; c->name[j] != '\0'; j++)
+            line[j] = (c->name[j] >= 'a' && c->name[j] <= 'z') ? c->name[j] - 'a' + 'A' : c->name[j];
+        strcpy(&line[j], " on");
+        CHECK(phone_command_lookup(line) == c);
+
+        // But not when the word is longer
+        strcpy(&line[j], "x");
+        CHECK(phone_command_lookup(line) != c);
+    }
+    CHECK(i > 10);
+    CHECK(phone_command_lookup("") == NULL);
+    CHECK(phone_command_lookup("blin") == NULL);
+    CHECK(phone_command_lookup("averyveryverylongword") == NULL);
+
+    // Text for the service, and commands for the modem, are recognized ahead of the table
+    comm_cmdbuf_init(&cmd, CMDBUF_TYPE_PHONE);
+    cmdbuf_line(&cmd, "/hello world");
+    CHECK(comm_cmdbuf_this_arg_is(&cmd, "/*"));
+    CHECK(phone_command_lookup((char *) &cmd.buffer[cmd.args]) == NULL);
+    cmdbuf_line(&cmd, "AT+CGATT?");
+    CHECK(comm_cmdbuf_this_arg_is(&cmd, "at+*"));
+    CHECK(phone_command_lookup((char *) &cmd.buffer[cmd.args]) == NULL);
+    cmdbuf_line(&cmd, "ver");
+    CHECK(!comm_cmdbuf_this_arg_is(&cmd, "/*"));
+    CHECK(!comm_cmdbuf_this_arg_is(&cmd, "at+*"));
+    CHECK(phone_command_lookup((char *) &cmd.buffer[cmd.args]) != NULL);
+
+    // Lines resembling commands are found just as trying each command in turn would find them
+    for (j=0; j<FUZZ_LINES; j++) {
+        fuzz_command_line(line, phone_command(sim_random() % i)->name);
+        cmdbuf_line(&cmd, line);
+        if (!CHECK(phone_command_lookup((char *) &cmd.buffer[cmd.args]) == phone_command_by_scan(&cmd)))
+            printf("     looking up \"%s\"\n", line);
+    }
+}
+
+// The service's commands must be sorted, and each found by its whole name, with an argument
+// only where it may have one
+void test_recv_commands() {
+    const recv_command_t *c, *prev = NULL;
+    char line[32], *arg, *scan_arg;
+    uint16_t i, j;
+
+    for (i=0; (c = recv_command(i)) != NULL; prev = c, i++) {
+        if (prev != NULL)
+            CHECK(strcmp(prev->name, c->name) < 0);
+
+        strcpy(line, c->name);
+        CHECK(recv_command_lookup(line, &arg) == (c->arg == RECV_ARG_REQUIRED ? NULL : c));
+        CHECK(arg == NULL);
+
+        sprintf(line, "%s 1,2", c->name);
+        CHECK(recv_command_lookup(line, &arg) == (c->arg == RECV_ARG_NONE ? NULL : c));
+        CHECK(arg != NULL && strcmp(arg, "1,2") == 0);
+
+        // Neither a longer word nor a prefix is the command
+        sprintf(line, "%sx 1", c->name);
+        CHECK(recv_command_lookup(line, &arg) != c);
+        strcpy(line, c->name);
+        line[strlen(line)-1] = ' ';
+        CHECK(recv_command_lookup(line, &arg) != c);
+    }
+    CHECK(i > 10);
+    CHECK(recv_command_lookup("", &arg) == NULL);
+    CHECK(recv_command_lookup("Hello", &arg) == NULL);
+
+    // Lines resembling commands are found just as a scan of the table would find them
+    for (j=0; j<FUZZ_LINES; j++) {
+        fuzz_command_line(line, recv_command(sim_random() % i)->name);
+        c = recv_command_by_scan(line, &scan_arg);
+        if (!CHECK(recv_command_lookup(line, &arg) == c) || !CHECK(arg == scan_arg))
+            printf("     looking up \"%s\"\n", line);
+    }
+}
+
+// What comm_cmdbuf_reply() must find: the longest reply matched by comm_cmdbuf_this_arg_is()
+static uint16_t reply_by_scan(cmdbuf_t *cmd, const comm_reply_t *replies, uint16_t count, uint16_t *nextarg) {
+    uint16_t i, reply = COMM_REPLY_NONE;
+    int length, longest = -1;
+
+    *nextarg = cmd->args;
+    for (i=0; i<count; i++) {
+        length = strlen(replies[i].text);
+        if (replies[i].text[length-1] == '*')
+            length--;
+        if (length > longest && comm_cmdbuf_this_arg_is(cmd, replies[i].text)) {
+            longest = length;
+            reply = replies[i].reply;
+            *nextarg = cmd->nextarg;
+        }
+    }
+    return reply;
+}
+
+// What comm_cmdbuf_reply() must split out following a reply: each run of bytes that aren't separators
+static uint16_t reply_args_by_scan(cmdbuf_t *cmd, uint16_t nextarg, uint16_t *argv, uint16_t *argl) {
+    uint16_t pos, argc = 0;
+    for (pos = nextarg; pos < cmd->line.length && argc < COMM_REPLY_ARGS; pos++) {
+        if (strchr(" ,;", cmd->buffer[pos]) != NULL || cmd->buffer[pos] < 0x20 || cmd->buffer[pos] >= 0x7f)
+            continue;
+        argv[argc] = pos;
+        while (pos < cmd->line.length && strchr(" ,;", cmd->buffer[pos]) == NULL && cmd->buffer[pos] >= 0x20 && cmd->buffer[pos] < 0x7f)
+            pos++;
+        argl[argc] = pos - argv[argc];
+        argc++;
+    }
+    return argc;
+}
+
+// Classify variations upon each reply in the table, along with lines that merely resemble them
+static void test_replies(const comm_reply_t *replies, uint16_t count) {
+    static cmdbuf_t cmd;
+    static char *others[] = {"", "+", "+c", "+cipopen: 1,1", "+cipopen: 1,0,2", "+ipd", "+ipd20",
+                             "+cme error: 10", "+cmeerror", "OK", "Ok ", "okay", "ok,1", "+netopen: 01",
+                             "+cpin: ready,", "error;", "rn2483 1.0.1", "mac_tx", "radio_rx  0102"};
+    static char *suffixes[] = {"", " ", "1", ",2", " 1,0", "x", ": 5", ",,3;;4 ", " a,b,c,d,e,f,g,h,i,j"};
+    char line[64];
+    uint16_t i, j, k, n, nextarg, expected, argc, argv[COMM_REPLY_ARGS], argl[COMM_REPLY_ARGS];
+
+    for (i=1; i<count; i++)
+        CHECK(strcmp(replies[i-1].text, replies[i].text) < 0);
+
+    comm_cmdbuf_init(&cmd, CMDBUF_TYPE_FONA);
+    for (i=0; i<count + sizeof(others)/sizeof(others[0]); i++) {
+        for (j=0; j<sizeof(suffixes)/sizeof(suffixes[0]); j++) {
+            for (k=0; k<2; k++) {
+                strcpy(line, i < count ? replies[i].text : others[i-count]);
+                if (i < count && line[strlen(line)-1] == '*')
+                    line[strlen(line)-1] = '\0';
+                // Shortened by a byte, to see that a prefix of a reply isn't the reply
+                if (k == 1 && strlen(line) > 0)
+                    line[strlen(line)-1] = '\0';
+                strcat(line, suffixes[j]);
+                cmdbuf_line(&cmd, line);
+                expected = reply_by_scan(&cmd, replies, count, &nextarg);
+                if (!CHECK(comm_cmdbuf_reply(&cmd, replies, count) == expected) || !CHECK(cmd.nextarg == nextarg))
+                    printf("     classifying \"%s\"\n", line);
+                // Asking again gives the same answer, from what was recognized
+                CHECK(comm_cmdbuf_reply(&cmd, replies, count) == expected && cmd.nextarg == nextarg);
+                // The arguments following it are split out, and each can be had as a string
+                argc = expected == COMM_REPLY_NONE ? 0 : reply_args_by_scan(&cmd, nextarg, argv, argl);
+                if (!CHECK(cmd.reply_argc == argc) || !CHECK(memcmp(cmd.reply_argv, argv, argc*sizeof(argv[0])) == 0))
+                    printf("     splitting \"%s\"\n", line);
+                for (n=0; n<argc; n++)
+                    CHECK(strlen(comm_cmdbuf_reply_arg(&cmd, n)) == argl[n]);
+                CHECK(strcmp(comm_cmdbuf_reply_arg(&cmd, argc), "") == 0);
+            }
+        }
+    }
+}
+
+// The modules' replies must be sorted, and recognized as a linear scan would have
+void test_modem_replies() {
+    const comm_reply_t *replies;
+    uint16_t count;
+
+    replies = fona_replies(&count);
+    test_replies(replies, count);
+    replies = lora_replies(&count);
+    test_replies(replies, count);
+}
+
+// Lines for timing the console and service command lookups: each command, and some that aren't
+#define BENCH_LOOKUPS   200000
+#define BENCH_LINES     128
+static cmdbuf_t bench_cmd[BENCH_LINES];
+static char *bench_message[BENCH_LINES];
+static uint16_t bench_lines;
+static volatile uintptr_t bench_sink;
+
+// The service's commands as they were recognized before, by a chain of comparisons
+static uint16_t recv_command_by_chain(char *message) {
+    if (memcmp(message, "cfgdev ", 7) == 0) return 1;
+    if (memcmp(message, "cfggps ", 7) == 0) return 2;
+    if (memcmp(message, "cfgsvc ", 7) == 0) return 3;
+    if (memcmp(message, "cfgttn ", 7) == 0) return 4;
+    if (memcmp(message, "cfglab ", 7) == 0) return 5;
+    if (memcmp(message, "cfgsen ", 7) == 0) return 6;
+    if (memcmp(message, "cfgdfu ", 7) == 0) return 7;
+    if (memcmp(message, "dfu", 3) == 0) return 8;
+    if (memcmp(message, "burn", 4) == 0) return 9;
+    if (strcmp(message, "restart") == 0) return 10;
+    if (strcmp(message, "reboot") == 0) return 11;
+    if (strcmp(message, "hello") == 0) return 12;
+    if (strcmp(message, "down") == 0) return 13;
+    return 0;
+}
+
+static void bench_phone_by_scan(uint32_t iterations) {
+    while (iterations-- > 0)
+        bench_sink += (uintptr_t) phone_command_by_scan(&bench_cmd[iterations % bench_lines]);
+}
+
+static void bench_phone_lookup(uint32_t iterations) {
+    cmdbuf_t *cmd;
+    while (iterations-- > 0) {
+        cmd = &bench_cmd[iterations % bench_lines];
+        bench_sink += (uintptr_t) phone_command_lookup((char *) &cmd->buffer[cmd->args]);
+    }
+}
+
+static void bench_recv_by_chain(uint32_t iterations) {
+    while (iterations-- > 0)
+        bench_sink += recv_command_by_chain(bench_message[iterations % bench_lines]);
+}
+
+static void bench_recv_lookup(uint32_t iterations) {
+    char *arg;
+    while (iterations-- > 0)
+        bench_sink += (uintptr_t) recv_command_lookup(bench_message[iterations % bench_lines], &arg);
+}
+
+// The console's and the service's commands, tried in turn as they were, and looked up in their tables
+void bench_command_lookup() {
+    static char *others[] = {"/hello world", "at+cgatt?", "x", "sensors please", "version2", "zzz"};
+    static char lines[BENCH_LINES][32];
+    const phone_command_t *p;
+    const recv_command_t *r;
+    uint16_t i;
+
+    for (bench_lines = 0; bench_lines < BENCH_LINES && (p = phone_command(bench_lines)) != NULL; bench_lines++)
+        sprintf(lines[bench_lines], "%s on", p->name);
+    for (i=0; i<sizeof(others)/sizeof(others[0]) && bench_lines < BENCH_LINES; i++)
+        strcpy(lines[bench_lines++], others[i]);
+    for (i=0; i<bench_lines; i++) {
+        comm_cmdbuf_init(&bench_cmd[i], CMDBUF_TYPE_PHONE);
+        cmdbuf_line(&bench_cmd[i], lines[i]);
+    }
+    bench_report("phone, by console line", bench_ns(bench_phone_by_scan, BENCH_LOOKUPS), bench_ns(bench_phone_lookup, BENCH_LOOKUPS));
+
+    for (bench_lines = 0; (r = recv_command(bench_lines)) != NULL; bench_lines++) {
+        sprintf(lines[bench_lines], r->arg == RECV_ARG_NONE ? "%s" : "%s 1,2,3", r->name);
+        bench_message[bench_lines] = lines[bench_lines];
+    }
+    for (i=0; i<sizeof(others)/sizeof(others[0]); i++)
+        bench_message[bench_lines++] = others[i];
+    bench_report("recv, by service message", bench_ns(bench_recv_by_chain, BENCH_LOOKUPS), bench_ns(bench_recv_lookup, BENCH_LOOKUPS));
+}
+
+// Transcripts of what the modules send, with the replies that the firmware acts upon interleaved
+// with echoes, unsolicited reports and replies to queries that it doesn't classify.  The SIM5320
+// lines follow its AT command manual, and the RN2483/RN2903 lines its command reference.
+static char *fona_transcript[] = {
+    "START", "AT", "OK", "+CPIN: READY", "SMS DONE", "PB DONE", "ATE0", "OK",
+    "+ICCID: 89014103211118510720", "OK", "+CSQ: 17,99", "OK",
+    "+CPSI: GSM,Online,310-410,0x1c7b,48231,38 EGSM 900,-71,0,34-34", "OK",
+    "+CPSI: WCDMA,Online,310-410,0x52E3,60227315,WCDMA IMT 2000,170,10762,0,3.5,101,34,32,500", "OK",
+    "+CPSI: NO SERVICE,Online", "+CREG: 0,1", "+CGREG: 0,1", "OK",
+    "+CGPSINFO: 3113.343286,N,12121.234064,E,250311,072809.3,44.1,0.0,0", "OK", "+CGPSINFO: ,,,,,,,,", "OK",
+    "+NETOPEN: 0", "OK", "+CDNSGIP: 1,\"tt.safecast.org\",\"52.9.43.96\"", "OK",
+    "+CIPOPEN: 1,0", "OK", "+CIPSEND: 1,120,120", "OK", "+IPD14", "+CIPRXGET: 1", "+IPCLOSE: 1,2",
+    "+CIPOPEN: 1,4", "+CIPERROR: 4", "ERROR", "+CME ERROR: SIM not inserted", "+NETOPEN: 1",
+    "+CHTTPSSTART: 0", "OK", "+CHTTPS: RECV EVENT", "+CHTTPSRECV: DATA,249", "+CHTTPSRECV: 0",
+    "+CHTTPSNOTIFY: PEER CLOSED", "+CFTRANTX: DATA,256", "+CFTPGETFILE: 0", "RDY", "",
+};
+static char *lora_transcript[] = {
+    "RN2483 1.0.1 Dec 15 2015 09:38:09", "ok", "ok", "ok", "0004A30B001A2B3C", "ok", "invalid_param",
+    "ok", "accepted", "ok", "mac_tx_ok", "ok", "mac_rx 1 48656C6C6F", "ok", "mac_err", "ok", "no_free_ch",
+    "busy", "denied", "4294967245", "ok", "radio_tx_ok", "ok", "radio_rx  48656C6C6F20776F726C64",
+    "radio_err", "-3", "RN2903 1.0.3 Aug 08 2017 15:11:09", "3.3", "",
+};
+static const comm_reply_t *bench_replies;
+static uint16_t bench_reply_count;
+
+// Recognize a reply by trying each in turn, then walk the arguments following it a token at a time
+static void bench_reply_by_scan(uint32_t iterations) {
+    cmdbuf_t *cmd;
+    uint16_t i, nextarg;
+    while (iterations-- > 0) {
+        cmd = &bench_cmd[iterations % bench_lines];
+        cmd->args = 0;
+        if (reply_by_scan(cmd, bench_replies, bench_reply_count, &nextarg) == COMM_REPLY_NONE)
+            continue;
+        cmd->nextarg = nextarg;
+        for (i=0; i<COMM_REPLY_ARGS && cmd->nextarg < cmd->line.length; i++) {
+            comm_cmdbuf_next_arg(cmd);
+            comm_cmdbuf_this_arg_is(cmd, "*");
+            bench_sink += cmd->buffer[cmd->args];
+        }
+    }
+}
+
+static void bench_reply_lookup(uint32_t iterations) {
+    cmdbuf_t *cmd;
+    uint16_t i;
+    while (iterations-- > 0) {
+        cmd = &bench_cmd[iterations % bench_lines];
+        cmd->args = 0;
+        cmd->reply = COMM_REPLY_UNCLASSIFIED;
+        if (comm_cmdbuf_reply(cmd, bench_replies, bench_reply_count) == COMM_REPLY_NONE)
+            continue;
+        for (i=0; i<cmd->reply_argc; i++)
+            bench_sink += comm_cmdbuf_reply_arg(cmd, i)[0];
+    }
+}
+
+// Each line of a transcript, recognized and split into its arguments
+static void bench_transcript(char *what, char **lines, uint16_t count, const comm_reply_t *replies, uint16_t reply_count) {
+    double before, after;
+    bench_replies = replies;
+    bench_reply_count = reply_count;
+    for (bench_lines = 0; bench_lines < count && bench_lines < BENCH_LINES; bench_lines++) {
+        comm_cmdbuf_init(&bench_cmd[bench_lines], CMDBUF_TYPE_FONA);
+        cmdbuf_line(&bench_cmd[bench_lines], lines[bench_lines]);
+    }
+    before = bench_ns(bench_reply_by_scan, BENCH_LOOKUPS);
+    after = bench_ns(bench_reply_lookup, BENCH_LOOKUPS);
+    bench_report(what, before, after);
+}
+
+// The modules' replies, recognized by trying each as they were, and by comm_cmdbuf_reply()
+void bench_reply_lookup_transcripts() {
+    const comm_reply_t *replies;
+    uint16_t count;
+    replies = fona_replies(&count);
+    bench_transcript("fona, by transcript line", fona_transcript, sizeof(fona_transcript)/sizeof(fona_transcript[0]), replies, count);
+    replies = lora_replies(&count);
+    bench_transcript("lora, by transcript line", lora_transcript, sizeof(lora_transcript)/sizeof(lora_transcript[0]), replies, count);
+}
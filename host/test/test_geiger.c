@@ -0,0 +1,172 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Geiger pulse counting.  geiger.c is built for these checks with 16-bit
+// counters, as on the nRF51, so that they wrap within a short run.
+
+#include <stdio.h>
+#include <math.h>
+#include "nrf_timer.h"
+#include "geiger.h"
+#include "config.h"
+#include "nordic_common.h"
+#include "sim.h"
+#include "test.h"
+
+// Called by geiger's own timer every GEIGER_BUCKET_SECONDS, and here instead
+void geiger_bucket_update();
+
+// The ring of buckets as geiger.c keeps it, which holds an invalid count until filled
+#define RING_BUCKETS    (MAX(GEIGER_MOBILE_INTEGRATION_SECONDS,GEIGER_FIXED_INTEGRATION_SECONDS)/GEIGER_BUCKET_SECONDS)
+#define INVALID_COUNT   0xFFFFFFFFL
+#define RANDOM_BUCKETS  20000
+
+// Count a number of pulses on both tubes
+static void pulses(uint32_t count) {
+    while (count--) {
+        nrf_timer_task_trigger(NRF_TIMER1, NRF_TIMER_TASK_COUNT);
+        nrf_timer_task_trigger(NRF_TIMER2, NRF_TIMER_TASK_COUNT);
+    }
+}
+
+// A steady rate must be measured as such even as the counters wrap.  Had the
+// difference between readings not been masked to the counter's width, the
+// bucket in which a counter wrapped would have held nearly 2^32 pulses.
+void test_geiger_counter_wrap() {
+    bool avail0, avail1;
+    uint32_t cpm0, cpm1, wraps = 0, last, reported = 0;
+    int i, buckets = (GEIGER_SETTLING_SECONDS+GEIGER_FIXED_INTEGRATION_SECONDS)/GEIGER_BUCKET_SECONDS;
+
+    geiger_init();
+    CHECK(NRF_TIMER1->BITMODE == NRF_TIMER_BIT_WIDTH_16);
+
+    // Start such that the counters wrap just after the values become reportable
+    pulses(0x10000 - 50 - buckets*100);
+    s_geiger_init(NULL, 0);
+
+    // 100 pulses per bucket is 1200 cpm, which with dead-time compensation is 1202
+    for (i=0; i<buckets+4; i++) {
+        last = NRF_TIMER1->counter;
+        pulses(100);
+        if (NRF_TIMER1->counter < last)
+            wraps++;
+        geiger_bucket_update();
+        if (!s_geiger_get_value(&avail0, &cpm0, &avail1, &cpm1))
+            continue;
+        reported++;
+        CHECK(avail0 && cpm0 == 1202);
+        CHECK(avail1 && cpm1 == 1202);
+    }
+    CHECK(wraps == 1);
+    CHECK(reported == 5);
+}
+
+// A Poisson-distributed number of pulses with the given mean
+static uint32_t poisson(float mean) {
+    float limit = expf(-mean), p = 1.0;
+    uint32_t k = 0;
+    do {
+        k++;
+        p *= ((float) (sim_random() & 0xffffff) + 1.0) / 16777217.0;
+    } while (p > limit);
+    return k-1;
+}
+
+// Count buckets at a rate until the measured value passes a threshold, returning
+// the number of buckets or 0 if it didn't, and how often the window dropped back,
+// which is when the value begins to carry an error of its own
+static uint32_t rate(uint32_t cpm, uint32_t buckets, uint32_t above, uint32_t below, uint32_t *dropped) {
+    uint32_t i, cpm0, error0, lastError0 = 0;
+    for (i=1; i<=buckets; i++) {
+        pulses(poisson((float) cpm * GEIGER_BUCKET_SECONDS / 60));
+        geiger_bucket_update();
+        s_geiger_get_value(NULL, &cpm0, NULL, NULL);
+        s_geiger_get_error(&error0, NULL);
+        if (lastError0 == 0 && error0 != 0)
+            (*dropped)++;
+        lastError0 = error0;
+        if ((above != 0 && cpm0 > above) || (below != 0 && cpm0 < below))
+            return i;
+    }
+    return 0;
+}
+
+// Background counts must not be mistaken for a change in rate, even at the low
+// rates at which a single test most often fails by chance, but a real change
+// must be reflected within half a minute rather than over five.
+void test_geiger_rate_change() {
+    uint32_t dropped = 0, buckets;
+    uint32_t week = 7*24*60*60/GEIGER_BUCKET_SECONDS;
+    uint32_t fill = (GEIGER_SETTLING_SECONDS+GEIGER_FIXED_INTEGRATION_SECONDS)/GEIGER_BUCKET_SECONDS;
+
+    s_geiger_term();
+    s_geiger_init(NULL, 0);
+    rate(10, fill, 0, 0, &dropped);
+    CHECK(s_geiger_get_value(NULL, NULL, NULL, NULL));
+
+    rate(10, week, 0, 0, &dropped);
+    CHECK(dropped == 0);
+
+    buckets = rate(300, 60, 200, 0, &dropped);
+    CHECK(buckets != 0 && buckets <= 6);
+    CHECK(dropped == 1);
+
+    rate(300, 60/GEIGER_BUCKET_SECONDS, 0, 0, &dropped);
+    buckets = rate(10, 60, 0, 100, &dropped);
+    CHECK(buckets != 0 && buckets <= 6);
+}
+
+// See that a tube's window and count of invalid buckets agree with the ring, recomputed in full:
+// the window must be the latest buckets, none of them invalid, and hold their sum
+static bool geiger_window_agrees(uint16_t tube) {
+    uint32_t *bucket, windowSum, sum = 0;
+    uint16_t i, latest, invalid, windowBuckets, counted = 0;
+    bool ok = true;
+
+    bucket = geiger_buckets(tube, &latest, &invalid, &windowSum, &windowBuckets);
+    for (i=0; i<RING_BUCKETS; i++)
+        if (bucket[i] == INVALID_COUNT)
+            counted++;
+    ok &= CHECK(invalid == counted);
+    ok &= CHECK(windowBuckets <= RING_BUCKETS);
+    for (i=0; i<windowBuckets && i<RING_BUCKETS; i++) {
+        ok &= CHECK(bucket[(latest + RING_BUCKETS - i) % RING_BUCKETS] != INVALID_COUNT);
+        sum += bucket[(latest + RING_BUCKETS - i) % RING_BUCKETS];
+    }
+    ok &= CHECK(windowSum == sum);
+    return ok;
+}
+
+// Random counts on each tube, at rates that change often enough that the window drops back,
+// must keep the running total of the window in step with the ring.  Now and then the tubes
+// are powered off and on, so that the ring is refilled from invalid buckets, which must
+// leave the count of them as each is overwritten and never be taken into the window.
+void test_geiger_window_sums() {
+    static const uint32_t cpms[] = {0, 10, 30, 300, 3000};
+    uint32_t i, j, n, cpm0 = 10, cpm1 = 10;
+
+    s_geiger_term();
+    s_geiger_init(NULL, 0);
+    for (i=0; i<RANDOM_BUCKETS; i++) {
+        if ((sim_random() % 40) == 0)
+            cpm0 = cpms[sim_random() % (sizeof(cpms)/sizeof(cpms[0]))];
+        if ((sim_random() % 40) == 0)
+            cpm1 = cpms[sim_random() % (sizeof(cpms)/sizeof(cpms[0]))];
+        if ((sim_random() % 500) == 0) {
+            s_geiger_term();
+            s_geiger_init(NULL, 0);
+        }
+        n = poisson((float) cpm0 * GEIGER_BUCKET_SECONDS / 60);
+        for (j=0; j<n; j++)
+            nrf_timer_task_trigger(NRF_TIMER1, NRF_TIMER_TASK_COUNT);
+        n = poisson((float) cpm1 * GEIGER_BUCKET_SECONDS / 60);
+        for (j=0; j<n; j++)
+            nrf_timer_task_trigger(NRF_TIMER2, NRF_TIMER_TASK_COUNT);
+        geiger_bucket_update();
+        if (!geiger_window_agrees(0) || !geiger_window_agrees(1)) {
+            printf("     after %u buckets\n", i);
+            break;
+        }
+    }
+}
@@ -0,0 +1,152 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// LoRaWAN frequency plans, as generated by TTN's code and then cached
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "lorafp.h"
+#include "test.h"
+
+#define PLAN_COMMANDS   96
+#define COMMAND_LENGTH  64
+#define BENCH_PLANS     2000
+
+// The copies of lorafp.c built with a cache too small for any region, whose plans must be
+// regenerated by running the TTN code for each command, as they were before the cache
+typedef bool (*lorafp_get_t)(char *region, bool loraWAN, uint8_t sf, uint16_t cmdno, char *buffer, uint16_t length);
+bool lorafp_commands_get_command(char *region, bool loraWAN, uint8_t sf, uint16_t cmdno, char *buffer, uint16_t length);
+bool lorafp_bytes_get_command(char *region, bool loraWAN, uint8_t sf, uint16_t cmdno, char *buffer, uint16_t length);
+
+// See whether a plan holds a command
+static bool lorafp_planned(char plan[][COMMAND_LENGTH], uint16_t count, char *command) {
+    uint16_t i;
+    for (i=0; i<count; i++)
+        if (strcmp(plan[i], command) == 0)
+            return true;
+    return false;
+}
+
+// See whether two plans are the same
+static bool lorafp_same(char a[][COMMAND_LENGTH], char b[][COMMAND_LENGTH], uint16_t count) {
+    uint16_t i;
+    for (i=0; i<count; i++)
+        if (strcmp(a[i], b[i]) != 0)
+            return false;
+    return true;
+}
+
+// Fetch each of a region's commands, returning how many there are
+static uint16_t lorafp_plan_from(lorafp_get_t get, char *region, uint8_t sf, char plan[][COMMAND_LENGTH]) {
+    uint16_t i;
+    for (i=0; i<PLAN_COMMANDS; i++)
+        if (!get(region, true, sf, i, plan[i], COMMAND_LENGTH))
+            break;
+    return i;
+}
+static uint16_t lorafp_plan(char *region, uint8_t sf, char plan[][COMMAND_LENGTH]) {
+    return lorafp_plan_from(lorafp_get_command, region, sf, plan);
+}
+
+// Each region's plan must be as TTN would have sent it, regardless of which was last cached
+void test_lorafp_plans() {
+    static char eu[PLAN_COMMANDS][COMMAND_LENGTH], us[PLAN_COMMANDS][COMMAND_LENGTH], again[PLAN_COMMANDS][COMMAND_LENGTH];
+    char command[COMMAND_LENGTH], expected[COMMAND_LENGTH];
+    uint16_t i, count, on = 0;
+
+    // EU868: the second receive window, 8 duty cycles, 5 added channels, power, retries, and data rate
+    count = lorafp_plan("eu", 9, eu);
+    CHECK(count == 2 + 8 + 5*3 + 2 + 1);
+    CHECK(strcmp(eu[0], "mac set rx2 3 869525000") == 0);
+    CHECK(strcmp(eu[1], "mac set ch drrange 1 0 6") == 0);
+    CHECK(strcmp(eu[count-3], "mac set pwridx 1") == 0);
+    CHECK(strcmp(eu[count-2], "mac set retx 7") == 0);
+    CHECK(strcmp(eu[count-1], "mac set dr 3") == 0);
+
+    // US915 sub-band 2: each of the 72 channels on or off, with data rates for those on
+    count = lorafp_plan("US", 10, us);
+    CHECK(count == 72 + 8 + 2 + 1);
+    for (i=0; i<72; i++) {
+        sprintf(expected, "mac set ch status %u %s", i, ((i >= 8 && i <= 15) || i == 65) ? "on" : "off");
+        CHECK(lorafp_planned(us, count, expected));
+    }
+    for (i=0; i<count; i++) {
+        CHECK(strncmp(us[i], "mac set ", 8) == 0);
+        if (strstr(us[i], " on") != NULL)
+            on++;
+    }
+    CHECK(on == 9);
+    CHECK(strcmp(us[count-1], "mac set dr 0") == 0);
+
+    // Going back and forth between regions makes no difference
+    count = lorafp_plan("eu", 9, again);
+    CHECK(count == 2 + 8 + 5*3 + 2 + 1 && lorafp_same(again, eu, count));
+    count = lorafp_plan("us", 10, again);
+    CHECK(count == 72 + 8 + 2 + 1 && lorafp_same(again, us, count));
+
+    // Nor does asking for commands out of order
+    CHECK(lorafp_get_command("eu", true, 9, 5, command, sizeof(command)) && strcmp(command, eu[5]) == 0);
+    CHECK(lorafp_get_command("us", true, 10, 5, command, sizeof(command)) && strcmp(command, us[5]) == 0);
+    CHECK(lorafp_get_command("eu", true, 9, 0, command, sizeof(command)) && strcmp(command, eu[0]) == 0);
+
+    // A short buffer gets as much as fits
+    CHECK(lorafp_get_command("eu", true, 9, 0, command, 8) && strcmp(command, "mac set") == 0);
+    CHECK(!lorafp_get_command("xx", true, 9, 0, command, sizeof(command)));
+}
+
+// A plan that doesn't fit the cache, for want of either commands or bytes, must be
+// regenerated in full rather than truncated, however the regions are interleaved
+void test_lorafp_overflow() {
+    static char plan[PLAN_COMMANDS][COMMAND_LENGTH], copy[PLAN_COMMANDS][COMMAND_LENGTH];
+    static lorafp_get_t copies[] = {lorafp_commands_get_command, lorafp_bytes_get_command};
+    static char *regions[] = {"eu", "us", "as", "us", "eu"};
+    static uint8_t sfs[] = {9, 10, 7, 12, 0};
+    char command[COMMAND_LENGTH];
+    uint16_t i, j, count;
+
+    for (i=0; i<sizeof(copies)/sizeof(copies[0]); i++) {
+        for (j=0; j<sizeof(regions)/sizeof(regions[0]); j++) {
+            count = lorafp_plan(regions[j], sfs[j], plan);
+            CHECK(count > 16);
+            CHECK(lorafp_plan_from(copies[i], regions[j], sfs[j], copy) == count);
+            CHECK(lorafp_same(copy, plan, count));
+        }
+        count = lorafp_plan("us", 10, plan);
+        CHECK(copies[i]("us", true, 10, 70, command, sizeof(command)) && strcmp(command, plan[70]) == 0);
+        CHECK(copies[i]("us", true, 10, 0, command, 8) && strcmp(command, "mac set") == 0);
+        CHECK(!copies[i]("us", true, 10, count, command, sizeof(command)));
+    }
+}
+
+static lorafp_get_t volatile bench_get;
+static char *bench_region;
+static volatile uint32_t bench_sink;
+
+static void bench_plan_body(uint32_t iterations) {
+    char command[COMMAND_LENGTH];
+    uint16_t i;
+    while (iterations-- > 0)
+        for (i=0; bench_get(bench_region, true, 0, i, command, sizeof(command)); i++)
+            bench_sink += command[8];
+}
+
+// Fetch each region's whole plan, as the modem is initialized, by running the TTN code for
+// each command and from the cache
+void bench_lorafp_plan() {
+    static char *regions[] = {"eu", "us", "as"};
+    char what[40];
+    double before, after;
+    uint16_t i;
+    for (i=0; i<sizeof(regions)/sizeof(regions[0]); i++) {
+        bench_region = regions[i];
+        bench_get = lorafp_commands_get_command;
+        before = bench_ns(bench_plan_body, BENCH_PLANS);
+        bench_get = lorafp_get_command;
+        after = bench_ns(bench_plan_body, BENCH_PLANS);
+        sprintf(what, "%s plan", regions[i]);
+        bench_report(what, before, after);
+    }
+}
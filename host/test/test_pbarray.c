@@ -0,0 +1,133 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Arrays of protocol buffers, and the fragments in which a large one is sent
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "send.h"
+#include "pbarray.h"
+#include "fragment.h"
+#include "test.h"
+
+// Messages of assorted lengths, one too long for the byte format, each filled with its index
+static const uint16_t message_lengths[] = {1, 20, 60, 128, 256, 0, 17};
+#define MESSAGES (sizeof(message_lengths)/sizeof(message_lengths[0]))
+
+// Build an array of the messages, returning its length
+static uint16_t pbarray_build(uint8_t *frame, bool fVarint) {
+    uint16_t i, length, varint_bytes = 0;
+
+    for (i=0; i<MESSAGES; i++)
+        varint_bytes += pbarray_varint_size(message_lengths[i]);
+    length = pbarray_put_count(frame, MESSAGES, fVarint);
+    for (i=0; i<MESSAGES; i++)
+        length += pbarray_put_length(&frame[length], message_lengths[i], fVarint);
+    CHECK(length == pbarray_header_size(MESSAGES, varint_bytes, fVarint));
+    for (i=0; i<MESSAGES; i++) {
+        memset(&frame[length], i, message_lengths[i]);
+        length += message_lengths[i];
+    }
+    return length;
+}
+
+// See that an array holds just the messages that were built into it
+static bool pbarray_matches(uint8_t *frame, uint16_t length) {
+    pbarray_reader_t r;
+    uint8_t *message;
+    uint16_t i, j, message_length;
+
+    if (!pbarray_begin(&r, frame, length) || r.count != MESSAGES)
+        return false;
+    for (i=0; i<MESSAGES; i++) {
+        if (!pbarray_next(&r, &message, &message_length) || message_length != message_lengths[i])
+            return false;
+        for (j=0; j<message_length; j++)
+            if (message[j] != i)
+                return false;
+    }
+    return (!pbarray_next(&r, &message, &message_length));
+}
+
+// Both formats must be read back exactly, and a truncated one rejected
+void test_pbarray_round_trip() {
+    uint8_t frame[FRAGMENT_MAX_LENGTH];
+    uint16_t offset, length;
+    uint32_t value, values[] = {0, 1, 127, 128, 16383, 16384, 0xffffffff};
+    uint8_t trimmed[] = {BUFF_FORMAT_PB_ARRAY, 2, 3, 1, 'a', 'b', 'c', 'd', 'e'};
+    int i;
+
+    // Varints of every length
+    for (i=0; i<sizeof(values)/sizeof(values[0]); i++) {
+        length = pbarray_put_varint(frame, values[i]);
+        CHECK(length == pbarray_varint_size(values[i]));
+        offset = 0;
+        CHECK(pbarray_get_varint(frame, length, &offset, &value) && value == values[i] && offset == length);
+        offset = 0;
+        CHECK(!pbarray_get_varint(frame, length-1, &offset, &value));
+    }
+
+    // The byte format only when it can hold what's in the array
+    CHECK(!pbarray_needs_varint(PBARRAY_BYTE_MAX, PBARRAY_BYTE_MAX));
+    CHECK(pbarray_needs_varint(PBARRAY_BYTE_MAX+1, 1));
+    CHECK(pbarray_needs_varint(1, PBARRAY_BYTE_MAX+1));
+
+    // As has always been the case, what follows the last message of the byte format is ignored
+    CHECK(pbarray_begin(&(pbarray_reader_t) {0}, trimmed, sizeof(trimmed)));
+    CHECK(pbarray_begin(&(pbarray_reader_t) {0}, trimmed, sizeof(trimmed)-1));
+    CHECK(!pbarray_begin(&(pbarray_reader_t) {0}, trimmed, sizeof(trimmed)-2));
+
+    length = pbarray_build(frame, true);
+    CHECK(length <= sizeof(frame));
+    CHECK(frame[0] == BUFF_FORMAT_PB_VARINT_ARRAY);
+    CHECK(pbarray_matches(frame, length));
+    for (i=0; i<length; i++)
+        CHECK(!pbarray_matches(frame, i));
+}
+
+// A message sent in fragments must be reassembled as it was, in whatever order they arrive
+void test_fragment_round_trip() {
+    static fragment_reassembly_t r;
+    uint8_t message[FRAGMENT_MAX_LENGTH];
+    uint8_t frames[FRAGMENT_MAX_COUNT][FRAGMENT_MAX_FRAME];
+    uint16_t frame_lengths[FRAGMENT_MAX_COUNT];
+    uint8_t *reassembled;
+    uint16_t length, reassembled_length, mtu = 51;
+    uint8_t count;
+    int i;
+
+    length = pbarray_build(message, true);
+    count = fragment_count(length, mtu);
+    CHECK(count == (length + (mtu-FRAGMENT_HEADER_BYTES) - 1) / (mtu-FRAGMENT_HEADER_BYTES));
+    for (i=0; i<count; i++) {
+        frame_lengths[i] = fragment_build(message, length, 7, i, mtu, frames[i]);
+        CHECK(frame_lengths[i] > FRAGMENT_HEADER_BYTES && frame_lengths[i] <= mtu);
+    }
+    CHECK(fragment_build(message, length, 7, count, mtu, frames[0]) == 0);
+    CHECK(fragment_count(FRAGMENT_MAX_LENGTH+1, mtu) == 0);
+    CHECK(fragment_count(length, FRAGMENT_HEADER_BYTES) == 0);
+
+    // In reverse, so that the last arrives first
+    fragment_reassembly_reset(&r);
+    for (i=count-1; i>0; i--)
+        CHECK(!fragment_reassemble(&r, frames[i], frame_lengths[i], &reassembled, &reassembled_length));
+    CHECK(fragment_reassemble(&r, frames[0], frame_lengths[0], &reassembled, &reassembled_length));
+    CHECK(reassembled_length == length && memcmp(reassembled, message, length) == 0);
+    CHECK(pbarray_matches(reassembled, reassembled_length));
+
+    // A fragment of another message abandons what was partially reassembled
+    for (i=0; i<count-1; i++)
+        CHECK(!fragment_reassemble(&r, frames[i], frame_lengths[i], &reassembled, &reassembled_length));
+    frames[0][1]++;
+    CHECK(!fragment_reassemble(&r, frames[0], frame_lengths[0], &reassembled, &reassembled_length));
+    CHECK(!fragment_reassemble(&r, frames[count-1], frame_lengths[count-1], &reassembled, &reassembled_length));
+    frames[0][1]--;
+
+    // As does a fragment whose length doesn't match the others
+    for (i=1; i<count; i++)
+        CHECK(!fragment_reassemble(&r, frames[i], frame_lengths[i], &reassembled, &reassembled_length));
+    CHECK(!fragment_reassemble(&r, frames[0], frame_lengths[0]-1, &reassembled, &reassembled_length));
+    CHECK(!fragment_reassemble(&r, frames[0], frame_lengths[0], &reassembled, &reassembled_length));
+}
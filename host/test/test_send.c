@@ -0,0 +1,189 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Message stamping, and the packing of measurements within the MTU
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "pb_encode.h"
+#include "tt.pb.h"
+#include "crc32.h"
+#include "config.h"
+#include "sensor.h"
+#include "send.h"
+#include "test.h"
+
+// Used only within send.c
+bool stamp_create(ttproto_Telecast *message);
+bool stamp_apply(ttproto_Telecast *message);
+void stamp_invalidate();
+uint32_t stamp_id(ttproto_Telecast *message);
+
+// A message captured at a fixed place and time
+static void stamp_message(ttproto_Telecast *message, uint32_t time, float latitude) {
+    memset(message, 0, sizeof(*message));
+    message->has_captured_at_date = message->has_captured_at_time = true;
+    message->captured_at_date = 171017;
+    message->captured_at_time = time;
+    message->has_latitude = message->has_longitude = true;
+    message->latitude = latitude;
+    message->longitude = 139.767125;
+}
+
+// Messages must share a stamp only if they share the stamped fields exactly
+void test_stamp_dedup() {
+    ttproto_Telecast created, message;
+
+    // The ID depends upon each of the fields, to the bit
+    stamp_message(&created, 120000, 35.681236);
+    stamp_message(&message, 120000, 35.681236);
+    CHECK(stamp_id(&created) == stamp_id(&message));
+    message.captured_at_time++;
+    CHECK(stamp_id(&created) != stamp_id(&message));
+    stamp_message(&message, 120000, 35.681236);
+    message.latitude = nextafterf(message.latitude, 90.0);
+    CHECK(stamp_id(&created) != stamp_id(&message));
+    message.has_latitude = false;
+    CHECK(stamp_id(&created) != stamp_id(&message));
+
+    // A message with the same fields is stamped, with them removed
+    CHECK(stamp_create(&created));
+    CHECK(created.has_stamp && created.stamp == stamp_id(&created));
+    CHECK(created.has_stamp_version && created.stamp_version == 3);
+    CHECK(created.stamp_fields == (STAMP_CAPTURED_AT|STAMP_LOCATION));
+    stamp_message(&message, 120000, 35.681236);
+    CHECK(stamp_apply(&message));
+    CHECK(message.has_stamp && message.stamp == created.stamp);
+    CHECK(!message.has_captured_at_date && !message.has_captured_at_time);
+    CHECK(!message.has_latitude && !message.has_longitude);
+    CHECK(!message.has_stamp_fields);
+
+    // Those that differ are sent in full
+    stamp_message(&message, 120001, 35.681236);
+    CHECK(!stamp_apply(&message));
+    CHECK(!message.has_stamp && message.has_captured_at_time && message.has_latitude);
+    stamp_message(&message, 120000, 35.681300);
+    CHECK(!stamp_apply(&message));
+
+    // As is everything, once the stamp is invalidated
+    stamp_invalidate();
+    stamp_message(&message, 120000, 35.681236);
+    CHECK(!stamp_apply(&message));
+}
+
+// The stamp ID as it was computed before, from the text of the fields
+uint32_t stamp_id_by_text(ttproto_Telecast *message) {
+    char buffer[64];
+
+    if (message->has_latitude && message->has_longitude && sensor_op_mode() != OPMODE_MOBILE)
+        sprintf(buffer, "%f,%f,%lu,%lu",
+                message->latitude,
+                message->longitude,
+                message->captured_at_date,
+                message->captured_at_time);
+    else
+        sprintf(buffer, "%lu,%lu",
+                message->captured_at_date,
+                message->captured_at_time);
+
+    return(crc32_compute((uint8_t *)buffer, strlen(buffer), NULL));
+}
+
+#define BENCH_STAMPS    1000000
+static ttproto_Telecast bench_stamped;
+static uint32_t (* volatile bench_stamp_function)(ttproto_Telecast *message);
+static volatile uint32_t bench_sink;
+
+static void bench_stamp_body(uint32_t iterations) {
+    while (iterations-- > 0) {
+        bench_stamped.captured_at_time = iterations;
+        bench_sink += bench_stamp_function(&bench_stamped);
+    }
+}
+
+// Stamp IDs of a stationary message, from the text of the fields and from their values.
+// The code size of each is reported by the bench target.
+void bench_stamp_id() {
+    double before, after;
+    stamp_message(&bench_stamped, 0, 35.681236);
+    bench_stamp_function = stamp_id_by_text;
+    before = bench_ns(bench_stamp_body, BENCH_STAMPS);
+    bench_stamp_function = stamp_id;
+    after = bench_ns(bench_stamp_body, BENCH_STAMPS);
+    bench_report("stamp_id, stationary", before, after);
+}
+
+// A message with several classes of measurement
+static void pack_message(ttproto_Telecast *message) {
+    memset(message, 0, sizeof(*message));
+    message->has_device_id = true;
+    message->device_id = 1234567890;
+    message->has_lnd_7318u = true;
+    message->lnd_7318u = 35;
+    message->has_lnd_7318u_error = true;
+    message->lnd_7318u_error = 9;
+    message->has_pms_pm01_0 = message->has_pms_pm02_5 = message->has_pms_pm10_0 = true;
+    message->pms_pm01_0 = 5;
+    message->pms_pm02_5 = 12;
+    message->pms_pm10_0 = 20;
+    message->has_pms_c00_30 = message->has_pms_c00_50 = message->has_pms_c01_00 = true;
+    message->pms_c00_30 = 12345;
+    message->pms_c00_50 = 2345;
+    message->pms_c01_00 = 345;
+    message->has_pms_csecs = true;
+    message->pms_csecs = 300;
+    message->has_env_temp = message->has_env_humid = true;
+    message->env_temp = 21.5;
+    message->env_humid = 45.0;
+    message->has_bat_voltage = message->has_bat_soc = true;
+    message->bat_voltage = 4.1;
+    message->bat_soc = 88.0;
+}
+
+// Whatever fits within the MTU must be kept, and nothing that doesn't, by priority
+void test_send_pack_size() {
+    ttproto_Telecast message;
+    size_t full, size, geiger_only;
+    uint16_t length, max;
+    uint32_t all = PACK_GEIGER|PACK_GEIGER_ERROR|PACK_PMS|PACK_PMS_COUNTS|PACK_ENV|PACK_BATTERY;
+    uint32_t packed;
+
+    // A message that fits is left alone
+    pack_message(&message);
+    CHECK(pb_get_encoded_size(&full, ttproto_Telecast_fields, &message));
+    CHECK(send_pack(&message, full, &length) == all);
+    CHECK(length == full);
+
+    // The smallest message that carries anything at all
+    pack_message(&message);
+    message.has_lnd_7318u_error = false;
+    message.has_pms_pm01_0 = message.has_pms_pm02_5 = message.has_pms_pm10_0 = false;
+    message.has_pms_c00_30 = message.has_pms_c00_50 = message.has_pms_c01_00 = message.has_pms_csecs = false;
+    message.has_env_temp = message.has_env_humid = false;
+    message.has_bat_voltage = message.has_bat_soc = false;
+    CHECK(pb_get_encoded_size(&geiger_only, ttproto_Telecast_fields, &message));
+
+    for (max = geiger_only; max < full; max++) {
+        pack_message(&message);
+        packed = send_pack(&message, max, &length);
+        CHECK(pb_get_encoded_size(&size, ttproto_Telecast_fields, &message) && size == length);
+        if (!CHECK(length <= max))
+            break;
+        // Geiger goes first, and counts and errors never without what they belong to
+        CHECK((packed & PACK_GEIGER) != 0);
+        CHECK((packed & PACK_GEIGER_ERROR) == 0 || (packed & PACK_GEIGER) != 0);
+        CHECK((packed & PACK_PMS_COUNTS) == 0 || (packed & PACK_PMS) != 0);
+        CHECK(packed != all);
+        CHECK(message.has_lnd_7318u == ((packed & PACK_GEIGER) != 0));
+        CHECK(message.has_lnd_7318u_error == ((packed & PACK_GEIGER_ERROR) != 0));
+        CHECK(message.has_pms_c00_30 == ((packed & PACK_PMS_COUNTS) != 0));
+        CHECK(message.has_bat_soc == ((packed & PACK_BATTERY) != 0));
+    }
+
+    // If nothing fits, the message is left to fail as too large
+    pack_message(&message);
+    CHECK(send_pack(&message, geiger_only-1, &length) == all);
+    CHECK(length == full);
+}
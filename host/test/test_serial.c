@@ -0,0 +1,114 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// UART input, received into a ring at interrupt level and drained by the scheduler.  serial.c
+// is built for these checks to hand what it drains for the LoRa module to us instead.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "app_scheduler.h"
+#include "serial.h"
+#include "gpio.h"
+#include "stats.h"
+#include "sim.h"
+#include "test.h"
+
+#define RING_HOLDS      1023
+#define LINES           400
+#define LINE_LENGTH     120
+#define CHUNK_LENGTH    512
+
+// What the modem sends, and what serial.c delivers of it
+static uint8_t sent[LINES * (LINE_LENGTH + 8)];
+static uint32_t sent_length;
+static uint8_t received[sizeof(sent)];
+static uint32_t received_length;
+
+// Called by serial.c in place of lora_received_byte()
+void test_serial_received_byte(uint8_t databyte) {
+    if (received_length < sizeof(received))
+        received[received_length++] = databyte;
+}
+
+// Lines of random length and content, each beginning with its number so that order is evident
+static void serial_transcript() {
+    uint32_t i, j, length;
+    sent_length = 0;
+    for (i=0; i<LINES; i++) {
+        sent_length += sprintf((char *) &sent[sent_length], "%05u ", i);
+        length = sim_random() % LINE_LENGTH;
+        for (j=0; j<length; j++)
+            sent[sent_length++] = ' ' + (sim_random() % 95);
+        sent[sent_length++] = '\r';
+        sent[sent_length++] = '\n';
+    }
+}
+
+// Have the transcript arrive in chunks at an interval, with the scheduler running after every so
+// many of them.  Of each burst that arrives between runs, as much as the ring holds must be
+// delivered in order, and the rest counted as overrun.  Returns how many bytes were dropped.
+static uint32_t serial_replay(uint16_t chunk, uint32_t interval_ms, uint16_t chunks_per_run) {
+    uint32_t sent_offset = 0, burst_offset = 0, expected_length = 0, burst, n, overruns = stats()->errors_overrun;
+    uint16_t chunks = 0;
+    bool intact = true;
+
+    received_length = 0;
+    while (sent_offset < sent_length) {
+        n = (sent_length - sent_offset < chunk) ? sent_length - sent_offset : chunk;
+        sdk_uart_receive_bytes(&sent[sent_offset], n, interval_ms);
+        sim_advance_to(sdk_uart_next_delivery());
+        sent_offset += n;
+        if (++chunks < chunks_per_run && sent_offset < sent_length)
+            continue;
+        app_sched_execute();
+        chunks = 0;
+        burst = sent_offset - burst_offset;
+        if (burst > RING_HOLDS)
+            burst = RING_HOLDS;
+        if (expected_length + burst > received_length || memcmp(&received[expected_length], &sent[burst_offset], burst) != 0)
+            intact = false;
+        expected_length += burst;
+        burst_offset = sent_offset;
+    }
+
+    if (!CHECK(intact && received_length == expected_length))
+        printf("     %u-byte chunks every %ums, %u per run\n", chunk, interval_ms, chunks_per_run);
+    CHECK(stats()->errors_overrun - overruns == sent_length - received_length);
+    return sent_length - received_length;
+}
+
+// Lines arriving in chunks of any size must reach the module on the UART byte-for-byte and in
+// order as the ring wraps, and when more arrives than it holds, what doesn't fit must be counted
+// rather than corrupting what was kept or what follows
+void test_serial_ring() {
+    static const uint16_t chunks[] = {1, 7, 64, 333, CHUNK_LENGTH};
+    uint16_t i;
+
+    gpio_uart_select(UART_LORA);
+    serial_transcript();
+
+    // At the rate the modem sends, drained as it arrives, nothing is lost
+    for (i=0; i<sizeof(chunks)/sizeof(chunks[0]); i++) {
+        CHECK(serial_replay(chunks[i], 10, 1) == 0);
+        CHECK(received_length == sent_length && memcmp(received, sent, sent_length) == 0);
+    }
+
+    // Nor when the scheduler is held off for nearly as much as the ring holds
+    CHECK(serial_replay(7, 1, RING_HOLDS/7) == 0);
+    CHECK(serial_replay(64, 0, RING_HOLDS/64) == 0);
+    CHECK(received_length == sent_length && memcmp(received, sent, sent_length) == 0);
+
+    // Flooded faster than it is drained, what was kept is still exact, and all else counted
+    CHECK(serial_replay(CHUNK_LENGTH, 0, 3) > 0);
+    CHECK(serial_replay(333, 0, 4) > 0);
+
+    // After which lines arrive intact again
+    CHECK(serial_replay(64, 10, 1) == 0);
+    CHECK(received_length == sent_length && memcmp(received, sent, sent_length) == 0);
+
+    gpio_uart_select(UART_NONE);
+    serial_term();
+}
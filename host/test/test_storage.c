@@ -0,0 +1,98 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// The flash journal of entries awaiting upload, whose writes complete asynchronously
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "app_scheduler.h"
+#include "send.h"
+#include "storage.h"
+#include "sim.h"
+#include "test.h"
+
+// Large enough that the journal wraps, erasing pages, every dozen or so entries
+#define ENTRY_LENGTH    1000
+#define ENTRIES         40
+
+// Let whatever flash operations are queued complete, along with any they lead to
+static void flash_settle() {
+    uint64_t when;
+    do {
+        while ((when = sdk_flash_next_completion()) != SIM_NEVER)
+            sdk_flash_complete(when);
+        app_sched_execute();
+    } while (sdk_flash_next_completion() != SIM_NEVER);
+}
+
+// Is this the entry that should be next to upload?
+static bool entry_is(uint8_t id) {
+    uint16_t length, request_type;
+    uint8_t *entry = db_peek(0, &length, &request_type);
+    return (entry != NULL && length == ENTRY_LENGTH && entry[0] == id && entry[ENTRY_LENGTH-1] == id);
+}
+
+// Entries must be counted only once they're in flash, releases made while another is
+// being written must survive a reboot, and nothing may be lost as the journal wraps
+void test_db_journal() {
+    uint8_t entry[ENTRY_LENGTH];
+    uint16_t i;
+
+    storage_init();
+    flash_settle();
+    db_release(db_get(NULL, NULL, NULL));
+    flash_settle();
+    CHECK(db_get(NULL, NULL, NULL) == 0);
+
+    // Not there until its write completes, and the buffer is busy until then
+    memset(entry, 1, sizeof(entry));
+    CHECK(db_put(entry, sizeof(entry), REPLY_NONE));
+    CHECK(db_get(NULL, NULL, NULL) == 0);
+    CHECK(db_peek(0, NULL, NULL) == NULL);
+    CHECK(!db_put(entry, sizeof(entry), REPLY_NONE));
+    flash_settle();
+    CHECK(db_get(NULL, NULL, NULL) == 1);
+    CHECK(entry_is(1));
+
+    // Walking them in order finds each
+    for (i=2; i<=5; i++) {
+        memset(entry, i, sizeof(entry));
+        CHECK(db_put(entry, sizeof(entry), REPLY_NONE));
+        flash_settle();
+    }
+    for (i=0; i<5; i++)
+        CHECK(db_peek(i, NULL, NULL) != NULL && db_peek(i, NULL, NULL)[0] == i+1);
+    CHECK(db_peek(5, NULL, NULL) == NULL);
+
+    // A release made while the previous one is still being written is written after it
+    db_release(1);
+    db_release(2);
+    CHECK(entry_is(4));
+    flash_settle();
+    storage_init();
+    CHECK(db_get(NULL, NULL, NULL) == 2);
+    CHECK(entry_is(4));
+    db_release(2);
+    flash_settle();
+
+    // Release each as the next is queued, so that releases land on pages being erased
+    for (i=6; i<6+ENTRIES; i++) {
+        memset(entry, i, sizeof(entry));
+        CHECK(db_put(entry, sizeof(entry), REPLY_NONE));
+        if (i > 6)
+            db_release(1);
+        flash_settle();
+        CHECK(db_get(NULL, NULL, NULL) == 1);
+        CHECK(entry_is(i));
+        if ((i % 7) == 0) {
+            storage_init();
+            CHECK(db_get(NULL, NULL, NULL) == 1);
+            CHECK(entry_is(i));
+        }
+    }
+    db_release(1);
+    flash_settle();
+
+}
@@ -0,0 +1,139 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Batching of the measurements made while mobile, many of which are taken within a
+// short distance and time of one another, into a single compact message.  This has
+// no dependencies upon the rest of the firmware so that the very same code may be
+// used by a receiver.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include "send.h"
+#include "pbarray.h"
+#include "batch.h"
+
+// Map signed deltas onto unsigned so that small ones of either sign stay short
+static uint32_t zigzag(int32_t value) {
+    return ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+// Convert a latitude or longitude into the units in which it is batched
+int32_t batch_degrees(float degrees) {
+    return ((int32_t) lround(degrees * BATCH_DEGREES_SCALE));
+}
+
+// Start an empty batch
+void batch_begin(batch_t *b, batch_header_t *header) {
+    b->header = *header;
+    memset(&b->last, 0, sizeof(b->last));
+    b->count = 0;
+    b->data[0] = BUFF_FORMAT_BATCH;
+    b->data[1] = header->flags;
+    b->data[2] = 0;
+    b->length = BATCH_HEADER_BYTES;
+    b->length += pbarray_put_varint(&b->data[b->length], header->device_id);
+    b->length += pbarray_put_varint(&b->data[b->length], header->captured_at_date);
+    b->length += pbarray_put_varint(&b->data[b->length], header->captured_at_time);
+    b->length += pbarray_put_varint(&b->data[b->length], header->motion_began_offset);
+}
+
+// See if samples having this header may be added to the batch
+bool batch_matches(batch_t *b, batch_header_t *header) {
+    return (b->header.flags == header->flags
+            && b->header.device_id == header->device_id
+            && b->header.captured_at_date == header->captured_at_date
+            && b->header.captured_at_time == header->captured_at_time
+            && b->header.motion_began_offset == header->motion_began_offset);
+}
+
+// Add a sample to the batch, returning false if it won't fit within the length
+bool batch_add(batch_t *b, batch_sample_t *sample, uint16_t max_length) {
+    uint8_t encoded[5*PBARRAY_VARINT_MAX];
+    uint16_t length = 0;
+    uint8_t flags = b->header.flags;
+
+    if (b->count >= BATCH_MAX_COUNT)
+        return false;
+
+    length += pbarray_put_varint(&encoded[length], zigzag((int32_t) (sample->captured_at_offset - b->last.captured_at_offset)));
+    if (flags & BATCH_LOCATION) {
+        length += pbarray_put_varint(&encoded[length], zigzag(sample->latitude - b->last.latitude));
+        length += pbarray_put_varint(&encoded[length], zigzag(sample->longitude - b->last.longitude));
+    }
+    if (flags & BATCH_CPM0)
+        length += pbarray_put_varint(&encoded[length], zigzag((int32_t) (sample->cpm0 - b->last.cpm0)));
+    if (flags & BATCH_CPM1)
+        length += pbarray_put_varint(&encoded[length], zigzag((int32_t) (sample->cpm1 - b->last.cpm1)));
+
+    if (max_length > sizeof(b->data))
+        max_length = sizeof(b->data);
+    if (b->length + length > max_length)
+        return false;
+
+    memcpy(&b->data[b->length], encoded, length);
+    b->length += length;
+    b->data[2] = ++b->count;
+    b->last = *sample;
+    return true;
+
+}
+
+// Decode a batch into its header and as many of its samples as will fit
+bool batch_decode(uint8_t *frame, uint16_t length, batch_header_t *header, batch_sample_t *samples, uint16_t max_samples, uint16_t *count) {
+    batch_sample_t last;
+    uint16_t offset, i, n;
+    uint32_t value;
+
+    if (length < BATCH_HEADER_BYTES || frame[0] != BUFF_FORMAT_BATCH)
+        return false;
+    header->flags = frame[1];
+    n = frame[2];
+    offset = BATCH_HEADER_BYTES;
+    if (!pbarray_get_varint(frame, length, &offset, &header->device_id)
+        || !pbarray_get_varint(frame, length, &offset, &header->captured_at_date)
+        || !pbarray_get_varint(frame, length, &offset, &header->captured_at_time)
+        || !pbarray_get_varint(frame, length, &offset, &header->motion_began_offset))
+        return false;
+
+    memset(&last, 0, sizeof(last));
+    for (i=0; i<n; i++) {
+        if (!pbarray_get_varint(frame, length, &offset, &value))
+            return false;
+        last.captured_at_offset += unzigzag(value);
+        if (header->flags & BATCH_LOCATION) {
+            if (!pbarray_get_varint(frame, length, &offset, &value))
+                return false;
+            last.latitude += unzigzag(value);
+            if (!pbarray_get_varint(frame, length, &offset, &value))
+                return false;
+            last.longitude += unzigzag(value);
+        }
+        if (header->flags & BATCH_CPM0) {
+            if (!pbarray_get_varint(frame, length, &offset, &value))
+                return false;
+            last.cpm0 += unzigzag(value);
+        }
+        if (header->flags & BATCH_CPM1) {
+            if (!pbarray_get_varint(frame, length, &offset, &value))
+                return false;
+            last.cpm1 += unzigzag(value);
+        }
+        if (i < max_samples)
+            samples[i] = last;
+    }
+
+    // Anything left over means that it wasn't what it claimed to be
+    if (offset != length)
+        return false;
+
+    *count = (n < max_samples) ? n : max_samples;
+    return true;
+
+}
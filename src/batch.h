@@ -0,0 +1,54 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#ifndef BATCH_H__
+#define BATCH_H__
+
+// A batch of mobile measurements begins with BUFF_FORMAT_BATCH, the flags below, and
+// the number of samples, followed by varints of the device ID, captured_at_date,
+// captured_at_time and motion_began_offset shared by every sample.  Each sample is
+// then the zigzag varint delta from the previous sample (or from zero, for the first)
+// of its captured_at_offset, of its latitude and longitude in units of 1e-5 degrees
+// if BATCH_LOCATION, and of its CPM values if BATCH_CPM0 and BATCH_CPM1.
+#define BATCH_LOCATION          0x01
+#define BATCH_CPM0              0x02
+#define BATCH_CPM1              0x04
+#define BATCH_TEST              0x08
+
+#define BATCH_HEADER_BYTES      3
+#define BATCH_MAX_COUNT         255
+#define BATCH_MAX_LENGTH        512
+#define BATCH_DEGREES_SCALE     100000.0
+
+typedef struct {
+    uint8_t flags;
+    uint32_t device_id;
+    uint32_t captured_at_date;
+    uint32_t captured_at_time;
+    uint32_t motion_began_offset;
+} batch_header_t;
+
+typedef struct {
+    uint32_t captured_at_offset;
+    int32_t latitude;
+    int32_t longitude;
+    uint32_t cpm0;
+    uint32_t cpm1;
+} batch_sample_t;
+
+typedef struct {
+    batch_header_t header;
+    batch_sample_t last;
+    uint8_t count;
+    uint16_t length;
+    uint8_t data[BATCH_MAX_LENGTH];
+} batch_t;
+
+void batch_begin(batch_t *b, batch_header_t *header);
+bool batch_matches(batch_t *b, batch_header_t *header);
+bool batch_add(batch_t *b, batch_sample_t *sample, uint16_t max_length);
+int32_t batch_degrees(float degrees);
+bool batch_decode(uint8_t *frame, uint16_t length, batch_header_t *header, batch_sample_t *samples, uint16_t max_samples, uint16_t *count);
+
+#endif // BATCH_H__
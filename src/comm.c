@@ -19,6 +19,7 @@
 #include "phone.h"
 #include "misc.h"
 #include "send.h"
+#include "pbarray.h"
 #include "stats.h"
 #include "timer.h"
 #include "gpio.h"
@@ -48,6 +49,8 @@ static bool fFlushBuffers = false;
 static uint16_t mode_request = COMM_NONE;
 static uint16_t connect_state = CONNECT_STATE_UNKNOWN;
 static char last_select_reason[64] = "";
+// Flash-buffered entries in flight, to be released once their delivery is confirmed
+static uint16_t db_drain_entries = 0;
 
 // Burn & stats stuff
 static bool burn_toggle_mode_request = false;
@@ -110,9 +113,8 @@ char *comm_mode_name(uint16_t mode) {
 // Initialize a command buffer
 void comm_cmdbuf_init(cmdbuf_t *cmd, uint16_t type) {
     cmd->type = type;
-    cmd->busy_length = 0;
-    cmd->busy_nextput = 0;
-    cmd->busy_nextget = 0;
+    frame_init(&cmd->line, FRAME_LINE, cmd->buffer, sizeof(cmd->buffer), &stats()->errors_framing);
+    ring_init(&cmd->busy, cmd->busy_buffer, sizeof(cmd->busy_buffer), &stats()->errors_overrun);
     comm_cmdbuf_reset(cmd);
 }
 
@@ -130,17 +132,13 @@ void comm_cmdbuf_reset(cmdbuf_t *cmd) {
     uint8_t databyte;
 
     // Reset the buffer
-    cmd->length = 0;
-    cmd->buffer[0] = '\0';
+    frame_reset(&cmd->line);
     cmd->args = 0;
     cmd->complete = false;
+    cmd->reply = COMM_REPLY_UNCLASSIFIED;
 
     // If there was anything waiting in the busy buffer, process it.
-    while (cmd->busy_length) {
-        cmd->busy_length--;
-        databyte = cmd->busy_buffer[cmd->busy_nextget++];
-        if (cmd->busy_nextget >= sizeof(cmd->busy_buffer))
-            cmd->busy_nextget = 0;
+    while (ring_get(&cmd->busy, &databyte)) {
         if (comm_cmdbuf_received_byte(cmd, databyte))
             break;
     }
@@ -188,48 +186,19 @@ bool comm_cmdbuf_append(cmdbuf_t *cmd, uint8_t databyte) {
     if (!commInitialized)
         return false;
 
-    // If we're already complete, we need to buffer it.
+    // If we're already complete, we need to hold it until the line has been processed.
+    // If even that overflows, it is dropped and counted.
     if (cmd->complete) {
-        if (cmd->busy_length < sizeof(cmd->busy_buffer)) {
-            cmd->busy_buffer[cmd->busy_nextput++] = databyte;
-            if (cmd->busy_nextput >= sizeof(cmd->busy_buffer))
-                cmd->busy_nextput = 0;
-            cmd->busy_length++;
-            return false;
-        } else {
-            // Busy buffer overflow - just reset it and cause data loss
-            // because there's really nothing else we can do.
-            cmd->busy_length = 0;
-            cmd->busy_nextput = 0;
-            return false;
-        }
-    }
-
-    // If it's a newline AND not a blank line AND within our line length limits, we're done
-    if (databyte == '\n') {
-        if (cmd->length != 0) {
-            cmd->complete = true;
-            return(true);
-        }
-        // Blank line
-        return(false);
+        ring_put(&cmd->busy, databyte);
+        return false;
     }
 
-    // Only append it if it's simple ASCII
-    if (databyte >= 0x20 && databyte < 0x7f) {
-        cmd->buffer[cmd->length++] = databyte;
-
-        // If we've overflowed the buffer, it's an error, so let's take some intentional data loss
-        // rather than enqueueing bad work to be done.  Very specifically, if we get flooded with
-        // data for whatever reason that is both within the ASCII range and isn't terminated
-        // by a newline, there's a possibility that we might either overflow the busy buffer
-        // or enqueue scheduler put's far too fast to handle.  Just shunt this crap to ground.
-        if (cmd->length >= CMD_MAX_LINELENGTH)
-            cmd->length = 0;
-
-        // Always leave the buffer null-terminated, so we can use string operations during parsing
-        cmd->buffer[cmd->length] = '\0';
-
+    // Frame it as a line of simple ASCII, left null-terminated so that we can use string
+    // operations during parsing.  If we get flooded with text that isn't terminated by a
+    // newline, it is shunted to ground rather than enqueueing bad work to be done.
+    if (frame_byte(&cmd->line, databyte)) {
+        cmd->complete = true;
+        return(true);
     }
 
     // Not yet complete
@@ -292,7 +261,7 @@ bool comm_cmdbuf_this_arg_is(cmdbuf_t *cmd, char *testCmd) {
     if (!tokenMode) {
 
         // Not enough room left in the command buffer.
-        if (testLen > (cmd->length - cmd->args)) {
+        if (testLen > (cmd->line.length - cmd->args)) {
             return (false);
         }
 
@@ -312,7 +281,7 @@ bool comm_cmdbuf_this_arg_is(cmdbuf_t *cmd, char *testCmd) {
         cmd->nextarg += testLen;
 
         // If we tested the full string, we're done.
-        if (testLen == (cmd->length - cmd->args)) {
+        if (testLen == (cmd->line.length - cmd->args)) {
             return (true);
         }
 
@@ -320,11 +289,11 @@ bool comm_cmdbuf_this_arg_is(cmdbuf_t *cmd, char *testCmd) {
 
     // In our special token mode, match ANY non-separator up to the next space or end-of-buffer
     if (tokenMode)
-        while (cmd->nextarg < cmd->length && !isArgSeparator(cmd->buffer[cmd->nextarg], embeddedSpaces))
+        while (cmd->nextarg < cmd->line.length && !isArgSeparator(cmd->buffer[cmd->nextarg], embeddedSpaces))
             cmd->nextarg++;
 
     // If we need to test for a word delimiter and there is more left, look at it
-    if (testForWord && (cmd->nextarg < cmd->length)) {
+    if (testForWord && (cmd->nextarg < cmd->line.length)) {
 
         // Ensure there is at least one separator following the command
         if (!isArgSeparator(cmd->buffer[cmd->nextarg], embeddedSpaces)) {
@@ -332,7 +301,7 @@ bool comm_cmdbuf_this_arg_is(cmdbuf_t *cmd, char *testCmd) {
         }
 
         // Skip past contiguous separators
-        for (i = cmd->nextarg; i < cmd->length; i++) {
+        for (i = cmd->nextarg; i < cmd->line.length; i++) {
             if (!isArgSeparator(cmd->buffer[i], embeddedSpaces))
                 break;
             if (tokenMode)
@@ -347,6 +316,124 @@ bool comm_cmdbuf_this_arg_is(cmdbuf_t *cmd, char *testCmd) {
 
 }
 
+// Find the first of a sorted range of replies whose text has at least the specified byte at 'i'
+static uint16_t comm_reply_lower_bound(const comm_reply_t *replies, uint16_t lo, uint16_t hi, uint16_t i, char ch) {
+    uint16_t mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (replies[mid].text[i] < ch)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Recognize which of a table of replies, sorted by text, is at the current argument.  Entries
+// sharing a prefix are adjacent in the table, so the line is scanned just once, narrowing the
+// candidates byte-by-byte as in a trie, and the longest that matches wins.  The result is kept
+// until the buffer changes, and 'nextarg' is left as comm_cmdbuf_this_arg_is() would leave it.
+// The arguments following the reply are split out at the same time, for comm_cmdbuf_reply_arg().
+uint16_t comm_cmdbuf_reply(cmdbuf_t *cmd, const comm_reply_t *replies, uint16_t count) {
+    uint16_t lo, hi, first, last, i, j, pos;
+    bool embeddedSpaces;
+    char ch, *text;
+
+    // If we've already classified what's here, we're done
+    if (cmd->reply != COMM_REPLY_UNCLASSIFIED && cmd->reply_args == cmd->args) {
+        cmd->nextarg = cmd->reply_nextarg;
+        return (cmd->reply);
+    }
+
+    cmd->reply = COMM_REPLY_NONE;
+    cmd->reply_args = cmd->args;
+    cmd->reply_nextarg = cmd->args;
+
+    lo = 0;
+    hi = count;
+    for (i = 0; lo < hi; i++) {
+
+        // Fold case, treating the end of the line as a null
+        pos = cmd->args + i;
+        ch = (pos < cmd->line.length) ? (char) cmd->buffer[pos] : '\0';
+        if (ch >= 'A' && ch <= 'Z')
+            ch += 'a' - 'A';
+
+        // A candidate ending here sorts ahead of all others sharing its prefix
+        text = replies[lo].text;
+        if (text[i] == '\0') {
+            embeddedSpaces = (strchr(text, ' ') != NULL);
+            if (pos >= cmd->line.length || isArgSeparator(cmd->buffer[pos], embeddedSpaces)) {
+                cmd->reply = replies[lo].reply;
+                cmd->reply_nextarg = pos;
+                while (cmd->reply_nextarg < cmd->line.length && isArgSeparator(cmd->buffer[cmd->reply_nextarg], embeddedSpaces))
+                    cmd->reply_nextarg++;
+            }
+            lo++;
+        }
+
+        // With just one candidate left there's nothing to search for
+        if (hi - lo == 1) {
+            text = replies[lo].text;
+            if (text[i] == '*' && text[i+1] == '\0') {
+                cmd->reply = replies[lo].reply;
+                cmd->reply_nextarg = pos;
+                break;
+            }
+            if (ch == '\0' || text[i] != ch)
+                break;
+            continue;
+        }
+
+        // Note a wildcard ending here, and narrow to the candidates continuing with this byte
+        j = comm_reply_lower_bound(replies, lo, hi, i, '*');
+        if (j < hi && replies[j].text[i] == '*' && replies[j].text[i+1] == '\0') {
+            cmd->reply = replies[j].reply;
+            cmd->reply_nextarg = pos;
+        }
+        if (ch == '\0')
+            break;
+        first = comm_reply_lower_bound(replies, lo, hi, i, ch);
+        last = comm_reply_lower_bound(replies, first, hi, i, ch+1);
+        lo = first;
+        hi = last;
+
+    }
+
+    // Note where each argument begins, skipping separators as token mode would
+    cmd->reply_argc = 0;
+    pos = cmd->reply_nextarg;
+    while (cmd->reply != COMM_REPLY_NONE) {
+        while (pos < cmd->line.length && isArgSeparator(cmd->buffer[pos], false))
+            pos++;
+        if (pos >= cmd->line.length || cmd->reply_argc >= COMM_REPLY_ARGS)
+            break;
+        cmd->reply_argv[cmd->reply_argc++] = pos;
+        while (pos < cmd->line.length && !isArgSeparator(cmd->buffer[pos], false))
+            pos++;
+    }
+
+    cmd->nextarg = cmd->reply_nextarg;
+    return (cmd->reply);
+
+}
+
+// Get argument #N following the reply last recognized by comm_cmdbuf_reply(), null-terminating
+// it in the buffer, or an empty string if there are fewer arguments than that
+char *comm_cmdbuf_reply_arg(cmdbuf_t *cmd, uint16_t n) {
+    uint16_t pos;
+
+    if (n >= cmd->reply_argc)
+        return ((char *) &cmd->buffer[cmd->line.length]);
+
+    pos = cmd->reply_argv[n];
+    while (pos < cmd->line.length && !isArgSeparator(cmd->buffer[pos], false))
+        pos++;
+    cmd->buffer[pos] = '\0';
+    return ((char *) &cmd->buffer[cmd->reply_argv[n]]);
+
+}
+
 // Based on having done comm_cmdbuf_this_arg_is(), move to the next argument
 char *comm_cmdbuf_next_arg(cmdbuf_t *cmd) {
     // This method returns the pointer to the current arg,
@@ -377,6 +464,7 @@ void comm_call_now() {
     commCallNow = true;
     lastOneshotTime = 0;
     comm_initiate_service_update(false);
+    timer_request_poll();
 }
 
 // See if we can send stats with limited MTU available
@@ -407,6 +495,20 @@ uint16_t comm_get_mtu() {
     return MTU;
 }
 
+// See if the transport's airtime budget would allow a message of up to the MTU to be sent.
+// Deferrable messages are held to a smaller budget, leaving the rest for measurements.
+bool comm_airtime_available(bool fDeferrable) {
+
+    switch (comm_mode()) {
+#ifdef LORA
+    case COMM_LORA:
+        return lora_airtime_available(lora_get_mtu(), fDeferrable);
+#endif
+    }
+
+    return true;
+}
+
 // Incoming data processing
 void comm_reset(bool fForce) {
     switch (comm_mode()) {
@@ -671,6 +773,10 @@ void comm_show_state() {
         int nextmin = nextsecs/60;
         nextsecs -= nextmin*60;
         DEBUG_PRINTF("Next stats update (%ldm) %s by %dm%ds\n", get_service_update_interval_minutes(), fOverdue ? "is overdue" : "will begin", nextmin, nextsecs);
+#ifdef LORA
+        if (comm_mode() == COMM_LORA)
+            lora_airtime_show();
+#endif
 
     }
 
@@ -877,10 +983,11 @@ void comm_poll() {
                 return;
             }
 
-            // If the transaction completed, try again until there's nothing else to transmit
+            // If the transaction completed, try again until there's nothing else to transmit,
+            // but stay powered up while a reply is awaited because powering down would lose it.
             if (oneshotCompleted && !comm_is_busy()) {
                 oneshotCompleted = false;
-                if (!comm_update_service()) {
+                if (!comm_update_service() && !comm_is_awaiting_reply()) {
                     comm_deselect("no work");
                     if (debug(DBG_COMM_MAX))
                         DEBUG_PRINTF("Deselecting comms (no work)\n");
@@ -913,7 +1020,8 @@ void comm_poll() {
             && (!comm_can_send_to_service() || comm_would_be_buffered(false))
             && !sensor_group_any_exclusive_powered_on()
             && !sensor_group_any_exclusive_busy()
-            && (sensor_any_upload_needed() || commCallNow)) {
+            && (sensor_any_upload_needed() || send_fragment_pending() || send_batch_pending() || commCallNow)
+            && (comm_airtime_available(false) || commCallNow)) {
 
             // Check to see if it's time to reselect
             uint32_t suppressionSeconds = get_oneshot_interval();
@@ -966,6 +1074,41 @@ void comm_poll() {
 
 }
 
+// The time at which comm_poll next has something to do, in seconds since boot.  This is
+// only ever later than now when the comms are idle between oneshots.
+uint32_t comm_next_due() {
+    uint32_t suppressionSeconds;
+
+    if (!commEverInitialized || commWaitingForFirstSelect || !currently_deselected)
+        return 0;
+    if (!comm_oneshot_currently_enabled())
+        return 0;
+    if ((storage()->flags & FLAG_PING) != 0)
+        return 0;
+#if defined(CELLX)
+    if (comm_autowan_mode() == AUTOWAN_FAILOVER)
+        return 0;
+#endif
+
+    // A oneshot only begins once there is something to upload, which happens only
+    // after the sensor scheduler has sampled something or while a message is being
+    // sent in fragments.
+    if (!sensor_any_upload_needed() && !send_fragment_pending() && !commCallNow)
+        return 0xffffffff;
+
+    // Nor does it begin until there's airtime in which to upload it
+#ifdef LORA
+    if (comm_mode() == COMM_LORA && !commCallNow && !comm_airtime_available(false))
+        return lora_airtime_available_at();
+#endif
+
+    suppressionSeconds = get_oneshot_interval();
+    if (suppressionSeconds == 0 || lastOneshotTime == 0)
+        return 0;
+    return (lastOneshotTime + suppressionSeconds);
+
+}
+
 // Force an update with nonbuffered I/O to flush the buffers
 void comm_flush_buffers() {
     fFlushBuffers = true;
@@ -982,6 +1125,73 @@ void comm_initiate_service_update(bool fFull) {
     comm_flush_buffers();
 }
 
+// Coalesce as many flash-buffered entries as will fit within the MTU into a single
+// array of protocol buffers, returning the number of entries that were consumed.
+static uint16_t comm_coalesce_db(uint8_t *buffer, uint16_t buffer_size, uint16_t *length, uint16_t *request_type) {
+    uint16_t i, entries, entry_length, entry_request_type, message_length, header_size;
+    uint16_t messages = 0, data_bytes = 0, varint_bytes = 0, max_length = 0;
+    uint16_t max_bytes = comm_get_mtu();
+    uint8_t *entry, *message, *plength, *pdata;
+    pbarray_reader_t r;
+    bool fVarint;
+
+    if (max_bytes > buffer_size)
+        max_bytes = buffer_size;
+    *request_type = REPLY_NONE;
+
+    // Determine how many entries fit, in order, overriding NONE with whatever reply is desired
+    for (entries = 0; (entry = db_peek(entries, &entry_length, &entry_request_type)) != NULL; entries++) {
+        uint16_t entry_messages = messages, entry_data_bytes = data_bytes;
+        uint16_t entry_varint_bytes = varint_bytes, entry_max_length = max_length;
+        if (!pbarray_begin(&r, entry, entry_length))
+            break;
+        while (pbarray_next(&r, &message, &message_length)) {
+            entry_messages++;
+            entry_data_bytes += message_length;
+            entry_varint_bytes += pbarray_varint_size(message_length);
+            if (message_length > entry_max_length)
+                entry_max_length = message_length;
+        }
+        fVarint = pbarray_needs_varint(entry_messages, entry_max_length);
+        if ((pbarray_header_size(entry_messages, entry_varint_bytes, fVarint) + entry_data_bytes) > max_bytes)
+            break;
+        messages = entry_messages;
+        data_bytes = entry_data_bytes;
+        varint_bytes = entry_varint_bytes;
+        max_length = entry_max_length;
+        if (entry_request_type != REPLY_NONE)
+            *request_type = entry_request_type;
+    }
+    if (entries == 0)
+        return 0;
+
+    // Gather all the message lengths into the header, followed by all the message data
+    fVarint = pbarray_needs_varint(messages, max_length);
+    header_size = pbarray_header_size(messages, varint_bytes, fVarint);
+    plength = buffer + pbarray_put_count(buffer, messages, fVarint);
+    pdata = &buffer[header_size];
+    for (i=0; i<entries; i++) {
+        entry = db_peek(i, &entry_length, NULL);
+        pbarray_begin(&r, entry, entry_length);
+        while (pbarray_next(&r, &message, &message_length)) {
+            plength += pbarray_put_length(plength, message_length, fVarint);
+            memcpy(pdata, message, message_length);
+            pdata += message_length;
+        }
+    }
+    *length = header_size + data_bytes;
+
+    return entries;
+}
+
+// Called by the transport when it knows that what was last sent has been delivered
+void comm_send_delivered() {
+    if (db_drain_entries != 0) {
+        db_release(db_drain_entries);
+        db_drain_entries = 0;
+    }
+}
+
 // If it's time, do a single transaction with the service to keep it up-to-date
 bool comm_update_service() {
 
@@ -989,31 +1199,52 @@ bool comm_update_service() {
     if (comm_is_busy())
         return false;
 
-    // Before doing anything else, flush measurements that are pending in nvram
+    // If a drain of flash-buffered entries went idle without its delivery being
+    // confirmed, they were never released and so will simply be sent again.
+    if (db_drain_entries != 0) {
+        DEBUG_PRINTF("%d flash entries unconfirmed\n", db_drain_entries);
+        db_drain_entries = 0;
+    }
+
+    // Before doing anything else, flush measurements that are pending in nvram,
+    // coalescing as many entries as will fit into a single transmission.
     if (!comm_is_deselected() && db_get(NULL, NULL, NULL) != 0) {
         uint8_t entry[DB_ENTRY_BYTES];
         uint16_t entry_length, entry_request_type;
-        uint16_t messages = db_get(entry, &entry_length, &entry_request_type);
-        if (messages != 0) {
-            // Only attempt to send it if there's some possibility that we CAN.
-            // This happens frequently because we may have buffered data while in
-            // mobile mode, but then later we're on Lora which can't send out
-            // the buffered messages.  They'll just need to wait until a Fona
-            // connection is active.
-            if (entry_length <= comm_get_mtu()) {
-                DEBUG_PRINTF("SEND %db/%dm from flash (%d entries)\n", entry_length, messages, entry[1]);
-                if (comm_send_to_service(entry, entry_length, entry_request_type)) {
-                    db_get_release();
-                    return true;
-                }
-                return false;
+        uint16_t entries = comm_coalesce_db(entry, sizeof(entry), &entry_length, &entry_request_type);
+        // Only attempt to send it if there's some possibility that we CAN.
+        // This happens frequently because we may have buffered data while in
+        // mobile mode, but then later we're on Lora which can't send out
+        // the buffered messages.  They'll just need to wait until a Fona
+        // connection is active.
+        if (entries == 0 && db_get(entry, &entry_length, &entry_request_type) != 0 && entry_length <= comm_get_mtu())
+            entries = 1;
+        if (entries != 0) {
+            pbarray_reader_t r;
+            DEBUG_PRINTF("SEND %db/%dm from flash (%d entries)\n", entry_length, pbarray_begin(&r, entry, entry_length) ? r.count : 0, entries);
+            if (comm_send_to_service(entry, entry_length, entry_request_type)) {
+                db_drain_entries = entries;
+                return true;
             }
+            return false;
         }
     }
 
+    // Continue sending a message that was too large for the MTU, if the duty cycle allows.
+    // If not, other traffic may go out in the meantime.
+    if (!comm_is_deselected() && send_fragment_pending())
+        if (send_fragment_next())
+            return true;
+
+    // Send measurements that were batched while mobile
+    if (!comm_is_deselected() && send_batch_pending())
+        if (send_batch_flush())
+            return true;
+
     // Because it happens so seldomoly, give priority to periodically sending our version # to the service,
-    // and receiving service policy updates back (processed in receive processing)
-    if (!comm_would_be_buffered(false) && !ShouldSuppress(&lastServiceUpdateTime, get_service_update_interval_minutes()*60)) {
+    // and receiving service policy updates back (processed in receive processing), unless
+    // airtime is scarce in which case they're deferred in favor of measurements.
+    if (!comm_would_be_buffered(false) && comm_airtime_available(true) && !ShouldSuppress(&lastServiceUpdateTime, get_service_update_interval_minutes()*60)) {
         static bool fSentConfigDEV = true;
         static bool fSentConfigSVC = true;
         static bool fSentConfigTTN = true;
@@ -1058,36 +1289,47 @@ bool comm_update_service() {
                 DEBUG_PRINTF("Now sending full stats on FONA\n");
             }
         }
-        // Send each one in sequence
-        if (!fSentFullStats)
-            fSentSomething = fSentFullStats = fMobile || send_update_to_service(UPDATE_STATS_VERSION);
-        else if (!fSentConfigLAB)
-            fSentSomething = fSentConfigLAB = fMobile || send_update_to_service(UPDATE_STATS_LABEL);
-        else if (!fSentConfigDEV)
-            fSentSomething = fSentConfigDEV = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_DEV);
-        else if (!fSentConfigGPS)
-            fSentSomething = fSentConfigGPS = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_GPS);
-        else if (!fSentConfigSVC)
-            fSentSomething = fSentConfigSVC = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_SVC);
-        else if (!fSentConfigTTN)
-            fSentSomething = fSentConfigTTN = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_TTN);
-        else if (!fSentConfigSEN)
-            fSentSomething = fSentConfigSEN = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_SEN);
-        else if (!fSentConfigBAT)
-            fSentSomething = fSentConfigBAT = fMobile || send_update_to_service(UPDATE_STATS_BATTERY);
-        else if (!fSentConfigMOD)
-            fSentSomething = fSentConfigMOD = fMobile || send_update_to_service(UPDATE_STATS_MODULES);
-        else if (!fSentConfigERR)
-            fSentSomething = fSentConfigERR = fMobile || send_update_to_service(UPDATE_STATS_ERRORS);
-        else if (!fSentDFU)
-            fSentSomething = fSentDFU = fMobile || send_update_to_service(UPDATE_STATS_DFU);
-        else if (!fSentCell1)
-            fSentSomething = fSentCell1 = fMobile || send_update_to_service(UPDATE_STATS_CELL1);
-        else if (!fSentCell2)
-            fSentSomething = fSentCell2 = fMobile || send_update_to_service(UPDATE_STATS_CELL2);
-        else {
-            fSentSomething = fSentStats = send_update_to_service(UPDATE_STATS);
-        }
+        // Send each one in sequence.  Unless they're to be sent separately, each is held in
+        // the send buffer and we go around again until all are held or one doesn't fit within
+        // the MTU, after which those that were held go out together as a single message.
+        bool fBatch = (storage()->flags & FLAG_STATS_SEPARATE) == 0;
+        bool fHeldSomething = false;
+        send_stats_hold(fBatch);
+        do {
+            if (!fSentFullStats)
+                fSentSomething = fSentFullStats = fMobile || send_update_to_service(UPDATE_STATS_VERSION);
+            else if (!fSentConfigLAB)
+                fSentSomething = fSentConfigLAB = fMobile || send_update_to_service(UPDATE_STATS_LABEL);
+            else if (!fSentConfigDEV)
+                fSentSomething = fSentConfigDEV = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_DEV);
+            else if (!fSentConfigGPS)
+                fSentSomething = fSentConfigGPS = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_GPS);
+            else if (!fSentConfigSVC)
+                fSentSomething = fSentConfigSVC = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_SVC);
+            else if (!fSentConfigTTN)
+                fSentSomething = fSentConfigTTN = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_TTN);
+            else if (!fSentConfigSEN)
+                fSentSomething = fSentConfigSEN = fMobile || send_update_to_service(UPDATE_STATS_CONFIG_SEN);
+            else if (!fSentConfigBAT)
+                fSentSomething = fSentConfigBAT = fMobile || send_update_to_service(UPDATE_STATS_BATTERY);
+            else if (!fSentConfigMOD)
+                fSentSomething = fSentConfigMOD = fMobile || send_update_to_service(UPDATE_STATS_MODULES);
+            else if (!fSentConfigERR)
+                fSentSomething = fSentConfigERR = fMobile || send_update_to_service(UPDATE_STATS_ERRORS);
+            else if (!fSentDFU)
+                fSentSomething = fSentDFU = fMobile || send_update_to_service(UPDATE_STATS_DFU);
+            else if (!fSentCell1)
+                fSentSomething = fSentCell1 = fMobile || send_update_to_service(UPDATE_STATS_CELL1);
+            else if (!fSentCell2)
+                fSentSomething = fSentCell2 = fMobile || send_update_to_service(UPDATE_STATS_CELL2);
+            else {
+                fSentSomething = fSentStats = send_update_to_service(UPDATE_STATS);
+            }
+            fHeldSomething |= fSentSomething;
+        } while (fBatch && fSentSomething && !fSentStats);
+        send_stats_hold(false);
+        if (fBatch)
+            fSentSomething = fHeldSomething && send_stats_flush();
         // Come back here immediately if the message couldn't make it out or we have stuff left to do
         if (!fSentFullStats
             || !fSentConfigDEV
@@ -1254,6 +1496,9 @@ bool comm_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
         fTransmitted = false;
         break;
     }
+    // Whatever is now in flight is no longer a drain of flash-buffered entries
+    if (fTransmitted)
+        db_drain_entries = 0;
     return fTransmitted;
 }
 
@@ -1310,6 +1555,17 @@ bool comm_is_busy() {
     return false;
 }
 
+// See if we've sent a request whose reply has yet to arrive
+bool comm_is_awaiting_reply() {
+    switch (comm_mode()) {
+#ifdef FONA
+    case COMM_FONA:
+        return(fona_is_awaiting_reply());
+#endif
+    }
+    return false;
+}
+
 // See if the GPS is currently active and updating
 bool comm_gps_active() {
 #ifdef UGPS
@@ -1517,15 +1773,53 @@ uint16_t comm_gps_get_value(float *pLat, float *pLon, float *pAlt) {
     return result;
 }
 
-// Decode a hex-encoded received message, then unmarshal and process what's inside
-uint16_t comm_decode_received_message(char *msg, void *ttmessage, uint8_t *buffer, uint16_t buffer_length, uint16_t *bytesDecoded) {
-    uint8_t bin[256], *pbin;
+// Where a decoded string field should be placed
+typedef struct {
+    char *buffer;
+    uint16_t length;
+} decoded_string_t;
+
+// Decode a string field directly into the caller's buffer, truncating if it won't fit
+static bool comm_decode_string(pb_istream_t *stream, const pb_field_t *field, void **arg) {
+    decoded_string_t *str = (decoded_string_t *) *arg;
+    uint16_t length = stream->bytes_left;
+    if (length > str->length-1)
+        length = str->length-1;
+    if (!pb_read(stream, (uint8_t *) str->buffer, length))
+        return false;
+    str->buffer[length] = '\0';
+    return pb_read(stream, NULL, stream->bytes_left);
+}
+
+// Extract the single protocol buffer from a binary received message, returning its length
+// or 0 if it isn't in a format that we understand.
+uint16_t comm_received_pb_binary(uint8_t *bin, uint16_t length, uint8_t *buffer, uint16_t buffer_length) {
+    pbarray_reader_t r;
+    uint8_t *message;
+    uint16_t message_length;
+
+    // Look at the first byte of what's been received, and see if it's in either of the "array"
+    // formats.  It will be this way if we're relaying a message.
+    if (!pbarray_begin(&r, bin, length) || r.count != 1 || !pbarray_next(&r, &message, &message_length)) {
+        DEBUG_PRINTF("Received message of unknown format 0x%02x 0x%02x 0x%02x\n", bin[0], bin[1], bin[2]);
+        return 0;
+    }
+
+    // Extract the message
+    if (message_length > buffer_length)
+        return 0;
+    memcpy(buffer, message, message_length);
+    return message_length;
+
+}
+
+// Extract the single protocol buffer from a hex-encoded received message, returning its length
+// or 0 if it isn't in a format that we understand.
+uint16_t comm_received_pb(char *msg, uint8_t *buffer, uint16_t buffer_length, uint16_t *bytesDecoded) {
+    uint8_t bin[256];
     int length;
     char hiChar, loChar;
     uint8_t databyte;
-    uint16_t status;
-    ttproto_Telecast tmessage;
-    ttproto_Telecast *message = (ttproto_Telecast *) ttmessage;
 
     // Skip leading whitespace and control characters, to get to the hex
     while (*msg != '\0' && *msg <= ' ')
@@ -1544,32 +1838,32 @@ uint16_t comm_decode_received_message(char *msg, void *ttmessage, uint8_t *buffe
     if (bytesDecoded != NULL)
         *bytesDecoded = length;
 
-    // Zero out the structure to receive the decoded data
-    if (message == NULL)
-        message = &tmessage;
-    memset(message, 0, sizeof(ttproto_Telecast));
-
-    // Look at the first byte of what's been received, and see if it's in the new "array" format.
-    // It will be this way if we're relaying a message.
-    // If not, just process it as-is under the assumption that it's a single protocol buffer
-    pbin = bin;
-    if (bin[0] == BUFF_FORMAT_PB_ARRAY && bin[1] == 1) {
+    return comm_received_pb_binary(bin, length, buffer, buffer_length);
 
-        // Process the message
-        length = bin[2];
-        pbin = &bin[3];
-
-        DEBUG_PRINTF("Received %d-byte message\n", length);
+}
 
-    } else {
+// Unmarshal and process the protocol buffer extracted from a received message
+static uint16_t comm_decode_pb(uint8_t *bin, uint16_t length, void *ttmessage, uint8_t *buffer, uint16_t buffer_length) {
+    uint16_t status;
+    ttproto_Telecast tmessage;
+    ttproto_Telecast *message = (ttproto_Telecast *) ttmessage;
+    decoded_string_t text;
 
-        DEBUG_PRINTF("Received message of unknown format 0x%02x 0x%02x 0x%02x\n", bin[0], bin[1], bin[2]);
-        return MSG_NOT_DECODED;
+    DEBUG_PRINTF("Received %d-byte message\n", length);
 
-    }
+    // Zero out the structure to receive the decoded data, arranging for the
+    // text of the message to be placed directly into the output buffer.
+    if (message == NULL)
+        message = &tmessage;
+    memset(message, 0, sizeof(ttproto_Telecast));
+    buffer[0] = '\0';
+    text.buffer = (char *) buffer;
+    text.length = buffer_length;
+    message->message.funcs.decode = comm_decode_string;
+    message->message.arg = &text;
 
     // Create a stream that will write to our buffer.
-    pb_istream_t stream = pb_istream_from_buffer(pbin, length);
+    pb_istream_t stream = pb_istream_from_buffer(bin, length);
 
     // Decode the message
     status = pb_decode(&stream, ttproto_Telecast_fields, message);
@@ -1578,12 +1872,6 @@ uint16_t comm_decode_received_message(char *msg, void *ttmessage, uint8_t *buffe
         return MSG_NOT_DECODED;
     }
 
-    // Copy the message to the output buffer
-    if (message->has_message)
-        strlcpy((char *) buffer, message->message, buffer_length);
-    else
-        buffer[0] = '\0';
-
     // Do various things based on device type
     if (!message->has_device_type) {
 
@@ -1636,6 +1924,33 @@ uint16_t comm_decode_received_message(char *msg, void *ttmessage, uint8_t *buffe
 
 }
 
+// Decode a hex-encoded received message, then unmarshal and process what's inside
+uint16_t comm_decode_received_message(char *msg, void *ttmessage, uint8_t *buffer, uint16_t buffer_length, uint16_t *bytesDecoded) {
+    uint8_t bin[256];
+    uint16_t length;
+
+    // Extract the protocol buffer
+    length = comm_received_pb(msg, bin, sizeof(bin), bytesDecoded);
+    if (length == 0)
+        return MSG_NOT_DECODED;
+
+    return comm_decode_pb(bin, length, ttmessage, buffer, buffer_length);
+
+}
+
+// Decode a received message that arrived as binary rather than hex
+uint16_t comm_decode_received_binary(uint8_t *msg, uint16_t msg_length, void *ttmessage, uint8_t *buffer, uint16_t buffer_length) {
+    uint8_t bin[256];
+    uint16_t length;
+
+    length = comm_received_pb_binary(msg, msg_length, bin, sizeof(bin));
+    if (length == 0)
+        return MSG_NOT_DECODED;
+
+    return comm_decode_pb(bin, length, ttmessage, buffer, buffer_length);
+
+}
+
 // Set the state so that we can understand why connects may have failed
 void comm_set_connect_state(uint16_t state) {
     connect_state = state;
@@ -5,6 +5,8 @@
 #ifndef COMM_H__
 #define COMM_H__
 
+#include "ring.h"
+
 // States.  For device-specific state, start assigning at COMM_STATE_DEVICE_START
 #define COMM_STATE_IDLE                 0
 #define COMM_STATE_COMPLETE             1
@@ -25,6 +27,19 @@
 #define CMDBUF_TYPE_FONA_DEFERRED       4
 #endif
 
+// A reply that a module may send, recognized at the start of a line.  As with
+// comm_cmdbuf_this_arg_is(), a trailing "*" matches anything beginning with the text,
+// and otherwise the text must be followed by a separator or the end of the line.
+typedef struct {
+    char *text;
+    uint16_t reply;
+} comm_reply_t;
+#define COMM_REPLY_NONE                 0
+#define COMM_REPLY_UNCLASSIFIED         0xffff
+
+// How many of the arguments following a reply are split out when it is recognized
+#define COMM_REPLY_ARGS                 8
+
 // Command buffer
 typedef struct cmdbuf_s cmdbuf_t;
 struct cmdbuf_s {
@@ -38,16 +53,21 @@ struct cmdbuf_s {
     bool complete;
     // length is +1 so we can always guarantee null termination of what's inside
     uint8_t buffer[CMD_MAX_LINELENGTH + 1];
-    uint16_t length;
-    // A buffer of stuff held in case we receive while we're busy processing
-    uint8_t busy_buffer[250];
-    uint16_t busy_nextget;
-    uint16_t busy_nextput;
-    uint16_t busy_length;
+    frame_t line;
+    // A ring of stuff held in case we receive while we're busy processing
+    uint8_t busy_buffer[256];
+    ring_t busy;
     // offset into buffer where completed command args begin
     uint16_t args;
     // offset to the next argument, after testing an arg via ThisArg()
     uint16_t nextarg;
+    // the reply recognized at 'reply_args' by comm_cmdbuf_reply(), and what follows it
+    uint16_t reply;
+    uint16_t reply_args;
+    uint16_t reply_nextarg;
+    // where each of the arguments following that reply begins
+    uint8_t reply_argc;
+    uint16_t reply_argv[COMM_REPLY_ARGS];
 };
 
 // Why comm may be failing
@@ -86,21 +106,26 @@ void comm_cmdbuf_set_state(cmdbuf_t *cmd, uint16_t newstate);
 bool comm_cmdbuf_append(cmdbuf_t *cmd, uint8_t databyte);
 bool comm_cmdbuf_received_byte(cmdbuf_t *cmd, uint8_t databyte);
 bool comm_cmdbuf_this_arg_is(cmdbuf_t *cmd, char *testCmd);
+uint16_t comm_cmdbuf_reply(cmdbuf_t *cmd, const comm_reply_t *replies, uint16_t count);
+char *comm_cmdbuf_reply_arg(cmdbuf_t *cmd, uint16_t n);
 char *comm_cmdbuf_next_arg(cmdbuf_t *cmd);
 void comm_enqueue_complete(uint16_t type);
 bool comm_is_initialized();
 bool comm_is_busy();
+bool comm_is_awaiting_reply();
 void comm_disable_oneshot_mode();
 bool comm_uart_switching_allowed();
 bool comm_oneshot_currently_enabled();
 void comm_oneshot_completed();
 bool comm_would_be_buffered(bool);
 void comm_poll();
+uint32_t comm_next_due();
 void comm_reinit();
 void comm_init();
 void comm_request_mode_on_reselect(uint16_t mode);
 void comm_select_completed();
 uint16_t comm_get_mtu();
+bool comm_airtime_available(bool fDeferrable);
 
 #define GPS_NOT_CONFIGURED              0
 #define GPS_NO_DATA                     1
@@ -128,6 +153,7 @@ void comm_show_state();
 void comm_select(uint16_t which, char *reason);
 bool comm_can_send_to_service();
 bool comm_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType);
+void comm_send_delivered();
 
 #define AUTOWAN_NORMAL          0
 #define AUTOWAN_GPS_WAIT        1
@@ -139,6 +165,9 @@ uint16_t comm_autowan_mode();
 #define MSG_SAFECAST            2
 #define MSG_REPLY_TTGATE        3
 #define MSG_REPLY_TTSERVE       4
+uint16_t comm_received_pb(char *msg, uint8_t *buffer, uint16_t buffer_length, uint16_t *bytesDecoded);
+uint16_t comm_received_pb_binary(uint8_t *bin, uint16_t length, uint8_t *buffer, uint16_t buffer_length);
 uint16_t comm_decode_received_message(char *msg, void *message, uint8_t *buffer, uint16_t length, uint16_t *decodedBytes);
+uint16_t comm_decode_received_binary(uint8_t *msg, uint16_t msg_length, void *message, uint8_t *buffer, uint16_t length);
 
 #endif // COMM_H__
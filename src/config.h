@@ -17,6 +17,12 @@
 // Note: on 2017-12-16 changed from 120 to 240 because of slow cell connect observed in Japan
 #define CELL_SERVICE_SECONDS                240
 
+// How long a TCP or HTTP session to the service is kept open after its last use, so that
+// requests that follow can reuse it (0 closes it after each reply), and how long we wait
+// for a reply before giving up on it.  The session is lost, of course, when cell powers down.
+#define CELL_SESSION_IDLE_SECONDS           30
+#define CELL_REPLY_WAIT_SECONDS             30
+
 // Key performance parameters that impact battery life more than anything else (aside from sensor-defs.h)
 #ifdef GEIGERFAST
 #define ONESHOT_MINUTES                     10
@@ -112,12 +118,36 @@
 #define GEIGER_BUCKET_SECONDS               5
 #define GEIGER_MOBILE_INTEGRATION_SECONDS   (60 * 1)
 #define GEIGER_FIXED_INTEGRATION_SECONDS    (60 * 5)
+#define GEIGER_ADAPTIVE_MIN_BUCKETS         3       // Window after a change in count rate
+#define GEIGER_ADAPTIVE_SIGMAS              5       // Deviation that signals a change in count rate
+#define GEIGER_ADAPTIVE_REFERENCE_BUCKETS   12      // Least window against which a change is tested
+
+// Relative priorities of the classes of measurement when packing them into a message
+// that is limited by the MTU.  Classes that are left out are carried over to a later
+// message, gaining a point of priority for every PACK_STALENESS_SECONDS they've waited.
+#define PACK_PRIORITY_GEIGER                100
+#define PACK_PRIORITY_PMS                   80
+#define PACK_PRIORITY_OPC                   70
+#define PACK_PRIORITY_ENV                   60
+#define PACK_PRIORITY_ENC                   50
+#define PACK_PRIORITY_BATTERY               40
+#define PACK_PRIORITY_COUNTS                20
+#define PACK_PRIORITY_ERROR                 20
+#define PACK_STALENESS_SECONDS              60
 
 // This is our primary app clock.  Note that for mobile mode the fast timer MUST be
 // running at the geiger bucket interval.
 #define TT_FAST_TIMER_SECONDS               GEIGER_BUCKET_SECONDS
 #define TT_SLOW_TIMER_SECONDS               15
 
+// When nothing is active, the primary app clock sleeps until the next deadline, but for no
+// longer than this because the 24-bit RTC that keeps our time wraps every 512 seconds.
+#define TT_IDLE_TIMER_SECONDS_MAX           (60*5)
+
+// app_timer stops and clears the RTC whenever no timer is running, which would lose our
+// time while the single-shot primary timer is being rearmed, so this one always runs.
+#define TT_TIMEBASE_TIMER_SECONDS           (60*8)
+
 // Power measurement parameters
 #define PWR_SAMPLE_PERIOD_SECONDS           20
 #define PWR_SAMPLE_SECONDS                  2
@@ -173,6 +203,29 @@
 // Time to wait to flush serial before sleeping
 #define SERIAL_FLUSH_MILLISECONDS           250
 
+// Fraction of the time that we may occupy a LoRa channel, as per EU868 sub-band g1,
+// which is the pace at which we send the fragments of a message that exceeds the MTU.
+// Airtime is also budgeted over a sliding window, as is TTN's fair-use airtime per day.
+// Stats are deferred once the given percentage of either budget has been used, so that
+// the rest is left for measurements.
+#define LORA_DUTY_CYCLE_PERCENT             1
+#define LORA_DUTY_CYCLE_WINDOW_SECONDS      (60*60)
+#define TTN_FAIR_USE_SECONDS_PER_DAY        30
+#define LORA_AIRTIME_DEFERRABLE_PERCENT     50
+
+// LoRaWAN spreading factor adaptation.  Like TTN's ADR, we aim to leave a margin above the
+// demodulation floor of the spreading factor in use, stepping up as soon as the smoothed SNR of
+// acknowledgements falls short of it, or after a number of unacknowledged confirmed uplinks.
+// We only step down once a number of acknowledgements show that the lower spreading factor
+// would still leave the margin plus some hysteresis, so that we don't flap between the two.
+#define LORAWAN_SF_MIN                      7
+#define LORAWAN_SF_MAX                      12
+#define LORAWAN_SF_MAX_US915                9       // DR0/SF10 allows only 11-byte payloads
+#define LORAWAN_SF_MARGIN_DB                10
+#define LORAWAN_SF_HYSTERESIS_DB            3
+#define LORAWAN_SF_SAMPLES                  4
+#define LORAWAN_SF_FAILURES                 2
+
 // Maximum time to wait for a LoRa ping reply
 #define PING_REPLY_SECONDS                  (TT_SLOW_TIMER_SECONDS+1)
 
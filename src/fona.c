@@ -35,6 +35,10 @@
 // Use TCP instead of HTTP for confirmed transactions
 #define USETCP true
 
+// Carry requests and replies as raw binary rather than as hex, which would double
+// both what HTTP sends over the air and what the modem gives us across the UART
+#define USEBINARY true
+
 // Hard-wired file names
 #define DFU_INFO_PACKET "dfu.dat"
 #define DFU_FIRMWARE    "dfu.bin"
@@ -98,16 +102,72 @@
 #define COMM_FONA_CIPSENDRPL            COMM_STATE_DEVICE_START+55
 #define COMM_FONA_CIPCLOSERPL           COMM_STATE_DEVICE_START+56
 
+// Replies recognized at the start of a line from the module
+#define FONA_RPL_OK                      1
+#define FONA_RPL_ERROR                   2
+#define FONA_RPL_START                   3
+#define FONA_RPL_IPD                     4
+#define FONA_RPL_IPCLOSE                 5
+#define FONA_RPL_CHTTPSNOTIFY_CLOSED     6
+#define FONA_RPL_CIPERROR                7
+#define FONA_RPL_CME                     8
+#define FONA_RPL_ICCID                   9
+#define FONA_RPL_CGPSINFO                10
+#define FONA_RPL_CPIN_READY              11
+#define FONA_RPL_PB_DONE                 12
+#define FONA_RPL_CPSI                    13
+#define FONA_RPL_NETOPEN_0               14
+#define FONA_RPL_NETOPEN_1               15
+#define FONA_RPL_CDNSGIP                 16
+#define FONA_RPL_CIPOPEN_1_0             17
+#define FONA_RPL_CIPOPEN                 18
+#define FONA_RPL_CIPRXGET                19
+#define FONA_RPL_CHTTPS_RECV_EVENT       20
+#define FONA_RPL_CHTTPSRECV_0            21
+#define FONA_RPL_CHTTPSRECV_DATA         22
+#define FONA_RPL_CFTPGETFILE             23
+#define FONA_RPL_CFTRANTX                24
+
 // Command buffer
 static cmdbuf_t fromFona;
 
+// Replies, which MUST be kept sorted by text.  Where one begins with another, the longest
+// that matches is the one recognized.
+static const comm_reply_t fonaReplies[] = {
+    {"+cdnsgip: *",                 FONA_RPL_CDNSGIP},
+    {"+cftpgetfile:",               FONA_RPL_CFTPGETFILE},
+    {"+cftrantx:",                  FONA_RPL_CFTRANTX},
+    {"+cgpsinfo:*",                 FONA_RPL_CGPSINFO},
+    {"+chttps: recv event",         FONA_RPL_CHTTPS_RECV_EVENT},
+    {"+chttpsnotify: peer closed",  FONA_RPL_CHTTPSNOTIFY_CLOSED},
+    {"+chttpsrecv: 0",              FONA_RPL_CHTTPSRECV_0},
+    {"+chttpsrecv: data",           FONA_RPL_CHTTPSRECV_DATA},
+    {"+ciperror:",                  FONA_RPL_CIPERROR},
+    {"+cipopen:",                   FONA_RPL_CIPOPEN},
+    {"+cipopen: 1,0",               FONA_RPL_CIPOPEN_1_0},
+    {"+ciprxget:",                  FONA_RPL_CIPRXGET},
+    {"+cme",                        FONA_RPL_CME},
+    {"+cpin: ready",                FONA_RPL_CPIN_READY},
+    {"+cpsi:",                      FONA_RPL_CPSI},
+    {"+iccid:",                     FONA_RPL_ICCID},
+    {"+ipclose:",                   FONA_RPL_IPCLOSE},
+    {"+ipd*",                       FONA_RPL_IPD},
+    {"+netopen: 0",                 FONA_RPL_NETOPEN_0},
+    {"+netopen: 1",                 FONA_RPL_NETOPEN_1},
+    {"error",                       FONA_RPL_ERROR},
+    {"ok",                          FONA_RPL_OK},
+    {"pb done",                     FONA_RPL_PB_DONE},
+    {"start",                       FONA_RPL_START},
+};
+
 // The Fona module cannot, by design, send more than 1500 bytes.  We choose this
 // number to be close but comfortably below that number.
 #define FONA_MTU 1480
 
-// Buffers for sending/receiving
+// Buffers for sending/receiving.  Binary replies are framed into the iobuf by the length
+// announced in the line preceding them.
 static uint8_t deferred_iobuf[FONA_MTU+256];
-static uint16_t deferred_iobuf_length;
+static frame_t deferred;
 static uint16_t deferred_request_type;
 static uint32_t deferred_active = 0;
 static bool deferred_done_after_callback = false;
@@ -122,7 +182,9 @@ static char service_udp_ipv4[32] = "";
 static char service_tcp_ipv4[32] = "";
 
 // IP
+#if USETCP
 static uint16_t ip_open_retries;
+#endif
 
 // GPS context
 #ifdef FONAGPS
@@ -157,8 +219,27 @@ static uint32_t dfu_total_length = 0;
 static uint32_t dfu_last_message_length = 0;
 static uint16_t getfile_retries;
 
-// Request/reply state management
-static bool awaitingTTServeReply = false;
+// Request/reply state management.  Requests may be pipelined over an open session,
+// so more than one reply may be awaited, and those that the modem announces while
+// we're busy are fetched once we're idle.
+static uint16_t awaitingTTServeReplies = 0;
+static uint32_t request_sent_ms = 0;
+static uint32_t reply_wait_began = 0;
+#define MAX_RECEIVED_PENDING 4
+static uint16_t received_pending[MAX_RECEIVED_PENDING];
+static uint16_t received_pending_count = 0;
+
+// The TCP or HTTP session to the service, which is kept open between requests
+static bool session_open = false;
+static uint32_t session_last_used = 0;
+
+// Binary data being received, whose length is announced by the line preceding it
+#if USEBINARY
+#define RAW_PREFIX_TCP  "+ciprxget: 2,"
+#define RAW_PREFIX_HTTP "+chttpsrecv: data,"
+static char raw_line[32];
+static uint16_t raw_line_length = 0;
+#endif
 
 // Get MTU
 uint16_t fona_get_mtu() {
@@ -192,6 +273,22 @@ bool thisargisF(char *what) {
     return (comm_cmdbuf_this_arg_is(&fromFona, what));
 }
 
+// Get the table of replies
+const comm_reply_t *fona_replies(uint16_t *count) {
+    *count = sizeof(fonaReplies) / sizeof(fonaReplies[0]);
+    return fonaReplies;
+}
+
+// Check whether the command buffer begins with a specific reply, recognizing it once per line
+bool replyisF(uint16_t reply) {
+    return (comm_cmdbuf_reply(&fromFona, fonaReplies, sizeof(fonaReplies) / sizeof(fonaReplies[0])) == reply);
+}
+
+// Get an argument following the reply that was recognized
+char *replyargF(uint16_t n) {
+    return (comm_cmdbuf_reply_arg(&fromFona, n));
+}
+
 // Quick wrapper to move to next arg
 char *nextargF() {
     return(comm_cmdbuf_next_arg(&fromFona));
@@ -227,13 +324,41 @@ void processstateF(uint16_t newstate) {
     fona_process();
 }
 
+// Fetch data that the modem told us had arrived, returning true if we've asked for it
+bool fona_fetch_received() {
+    char command[64];
+    uint16_t i, length;
+
+    if (received_pending_count == 0)
+        return false;
+
+    // Replies are fetched one at a time, in the order that they arrived
+    length = received_pending[0];
+    received_pending_count--;
+    for (i=0; i<received_pending_count; i++)
+        received_pending[i] = received_pending[i+1];
+
+    frame_reset(&deferred);
+    sprintf(command, "at+ciprxget=%d,1,%d", USEBINARY ? 2 : 3, length);
+    fona_send(command);
+    setstateF(COMM_FONA_CIPRXGETRPL2);
+    return true;
+
+}
+
+// Note that the session has been used, and return to idle to await whatever is next
+void fona_session_used() {
+    session_last_used = get_seconds_since_boot();
+    setidlestateF();
+}
+
 // Check to see if we received what we regard as a bad reply universally
 bool commonreplyF() {
 
     // Handle an error on any command by resetting the device.  If
     // you need to do special per-state handling of "error", just do so
     // before calling commonreplyF.
-    if (thisargisF("error")) {
+    if (replyisF(FONA_RPL_ERROR)) {
         DEBUG_PRINTF("ERROR(%d)\n", fromFona.state);
         // We need to do a hardware reset to close currently open sessions
         fonaForceFullHardwareReset = true;
@@ -243,7 +368,7 @@ bool commonreplyF() {
 
     // Handle an unexpected reset that may have occurred because of
     // power supply issues, etc.
-    if (thisargisF("start") && fromFona.state != COMM_STATE_IDLE) {
+    if (replyisF(FONA_RPL_START) && fromFona.state != COMM_STATE_IDLE) {
         DEBUG_PRINTF("** SPONTANEOUS RESET in state %d **\n", fromFona.state);
         if (fRecordingStats) {
             if (fromFona.state == COMM_FONA_CPSIRPL)
@@ -256,23 +381,34 @@ bool commonreplyF() {
         return(true);
     }
 
-    // Process incoming TCP/IP data
-    if (thisargisF("+ipd*")) {
-        char command[64];
+    // Process incoming TCP/IP data, fetching it now unless we're in the midst of
+    // something else, such as sending the next of several pipelined requests
+    if (replyisF(FONA_RPL_IPD)) {
         nextargF();
         thisargisF("*");
         int len = atoi(nextargF());
+#if USEBINARY
+        if (len > sizeof(deferred_iobuf))
+            len = sizeof(deferred_iobuf);
+#else
         if (len > CMD_MAX_LINELENGTH)
             len = CMD_MAX_LINELENGTH;;
-        deferred_iobuf_length = 0;
-        sprintf(command, "at+ciprxget=3,1,%d", len);
-        fona_send(command);
-        setstateF(COMM_FONA_CIPRXGETRPL2);
+#endif
+        if (received_pending_count < MAX_RECEIVED_PENDING)
+            received_pending[received_pending_count++] = len;
+        if (fromFona.state == COMM_STATE_IDLE)
+            fona_fetch_received();
+        return(true);
+    }
+
+    // The service closed the session
+    if (replyisF(FONA_RPL_IPCLOSE) || replyisF(FONA_RPL_CHTTPSNOTIFY_CLOSED)) {
+        session_open = false;
         return(true);
     }
 
     // Handle stateless error conditions
-    if (thisargisF("+ciperror:")) {
+    if (replyisF(FONA_RPL_CIPERROR)) {
         nextargF();
         DEBUG_PRINTF("CIPERROR(%d) %s\n", fromFona.state, &fromFona.buffer[fromFona.args]);
         // We need to do a hardware reset to close currently open sessions
@@ -282,7 +418,7 @@ bool commonreplyF() {
     }
 
     // Handle unrecoverable SIM errors
-    if (thisargisF("+cme")) {
+    if (replyisF(FONA_RPL_CME)) {
         nextargF();
         if (thisargisF("error:")) {
             nextargF();
@@ -299,7 +435,7 @@ bool commonreplyF() {
 
     // Map SIM ICCID to APN
     // https://en.wikipedia.org/wiki/Subscriber_identity_module
-    if (thisargisF("+iccid:")) {
+    if (replyisF(FONA_RPL_ICCID)) {
         nextargF();
         // Save it for stats purposes
         char *iccid = (char *)&fromFona.buffer[fromFona.args];
@@ -338,28 +474,20 @@ bool commonreplyF() {
 
     // Process incoming gps info reports
 #ifdef FONAGPS
-    if (thisargisF("+cgpsinfo:*")) {
+    if (replyisF(FONA_RPL_CGPSINFO)) {
 
         // Indicate that we've got some data
         gpio_indicate(INDICATE_GPS_CONNECTING);
 
-        // Parse the arguments
+        // Parse the arguments, as split when the reply was recognized
         gpsDataParsed = true;
-        nextargF();
-        thisargisF("*");
-        char *lat = nextargF();
-        thisargisF("*");
-        char *latNS = nextargF();
-        thisargisF("*");
-        char *lon = nextargF();
-        thisargisF("*");
-        char *lonEW = nextargF();
-        thisargisF("*");
-        char *utcDate = nextargF();
-        thisargisF("*");
-        char *utcTime = nextargF();
-        thisargisF("*");
-        char *alt = nextargF();
+        char *lat = replyargF(0);
+        char *latNS = replyargF(1);
+        char *lon = replyargF(2);
+        char *lonEW = replyargF(3);
+        char *utcDate = replyargF(4);
+        char *utcTime = replyargF(5);
+        char *alt = replyargF(6);
         if (utcDate[0] != '\0' && utcTime[0] != '\0')
             set_timestamp(atol(utcDate), atol(utcTime));
         if (lat[0] != '\0' && lon[0] != '\0' && alt[0] != '\0') {
@@ -479,6 +607,88 @@ bool fona_is_busy() {
     return false;
 }
 
+// Initiate the TCP send now that the session is open, after which the "cipsend" will
+// process the deferred iobuf.
+#if USETCP
+void fona_tcp_start_send() {
+    char command[64];
+    deferred_callback_requested = true;
+    deferred_done_after_callback = true;
+    watchdog_extend = true;
+    sprintf(command, "at+cipsend=1,%u", deferred.length);
+    fona_send(command);
+    setstateF(COMM_FONA_CIPSENDRPL);
+}
+#endif // USETCP
+
+// Initiate the HTTP send now that the session is open.
+// Note that this REPLACES the contents of deferred_iobuf with the request, header and all.
+#if !USETCP
+void fona_http_start_send() {
+    char command[64];
+#if USEBINARY
+    char header[192];
+    uint16_t header_length;
+
+    // The iobuf has room beyond the MTU for the header
+    if (deferred.length > FONA_MTU)
+        deferred.length = FONA_MTU;
+
+    // Put together a minimalist HTTP header for the binary body
+    sprintf(header, "POST %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: TTNODE\r\nContent-Type: application/octet-stream\r\nContent-Length: %d\r\n\r\n",
+            SERVICE_HTTP_TOPIC, SERVICE_HTTP_ADDRESS, SERVICE_HTTP_PORT, deferred.length);
+    header_length = strlen(header);
+
+    // Slide the body up and put the header in front of it
+    memmove(&deferred_iobuf[header_length], deferred_iobuf, deferred.length);
+    memcpy(deferred_iobuf, header, header_length);
+    deferred.length += header_length;
+
+    // Bump stats about what we've transmitted
+    stats_io(deferred.length, 0);
+
+#else
+    char hiChar, loChar, body[sizeof(deferred_iobuf)*2+50+1];
+    uint16_t i, header_length, hexified_length, total_length;
+
+    // The hexified data length will be the original data * 2 (because of hexification)
+    hexified_length = deferred.length * 2;
+
+    // Put together a minimalist HTTP header and command to transmit it
+    sprintf(body, "POST %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: TTNODE\r\nContent-Length: %d\r\n\r\n",
+            SERVICE_HTTP_TOPIC, SERVICE_HTTP_ADDRESS, SERVICE_HTTP_PORT, hexified_length);
+
+    // Compute the remaining lengths
+    header_length = strlen(body);
+
+    // Hexify into the body, and add trailing \r\n, and a null term which is useful for %s printing when debugging
+    total_length = header_length;
+    for (i=0; i<deferred.length; i++) {
+        if ( (i + header_length) >= (sizeof(deferred_iobuf) - sizeof("00\r\n")) )
+            break;
+        HexChars(deferred_iobuf[i], &hiChar, &loChar);
+        body[total_length++] = hiChar;
+        body[total_length++] = loChar;
+    }
+    body[total_length] = '\0';
+
+    // Bump stats about what we've transmitted
+    stats_io(total_length, 0);
+
+    // Move it back into the iobuf
+    deferred.length = total_length;
+    memcpy(deferred_iobuf, body, deferred.length);
+
+#endif // USEBINARY
+
+    // Generate a command
+    deferred_callback_requested = true;
+    sprintf(command, "at+chttpssend=%u", deferred.length);
+    fona_send(command);
+
+}
+#endif // !USETCP
+
 // Transmit a well-formed protocol buffer to the LPWAN as a message
 bool fona_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType) {
     char command[64];
@@ -500,11 +710,17 @@ bool fona_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
         return false;
 
     // Now that we're committed, if this is a request that requires a reply, remember that we're doing so.
-    awaitingTTServeReply = (RequestType != REPLY_NONE);
+    if (RequestType != REPLY_NONE) {
+        if (awaitingTTServeReplies++ == 0) {
+            request_sent_ms = get_milliseconds_since_boot();
+            reply_wait_began = get_seconds_since_boot();
+        }
+        stats()->cell_requests++;
+    }
 
     // Set up the deferred data
     deferred_active = get_seconds_since_boot();
-    deferred_iobuf_length = length;
+    deferred.length = length;
     memcpy(deferred_iobuf, buffer, length);
     deferred_request_type = RequestType;
 
@@ -521,7 +737,7 @@ bool fona_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
         // Transmit it, expecting the deferred handler to finish this.
         deferred_callback_requested = true;
         deferred_done_after_callback = true;
-        sprintf(command, "at+cipsend=0,%u,\"%s\",%u", deferred_iobuf_length, service_udp_ipv4, SERVICE_UDP_PORT);
+        sprintf(command, "at+cipsend=0,%u,\"%s\",%u", deferred.length, service_udp_ipv4, SERVICE_UDP_PORT);
         fona_send(command);
         setstateF(COMM_FONA_MISCRPL);
 
@@ -536,12 +752,16 @@ bool fona_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
         // Bump stats about what we've transmitted
         stats_io(length, 0);
 
-        // Transmit it, after which the "cipsend" will process the deferred iobuf
-        ip_open_retries = 8;
-        comm_set_connect_state(CONNECT_STATE_APP_SERVICE);
-        sprintf(command, "at+cipopen=1,\"TCP\",\"%s\",%u", service_tcp_ipv4, SERVICE_TCP_PORT);
-        fona_send(command);
-        setstateF(COMM_FONA_CIPOPENRPL2);
+        // If the session is still open, send it right away, else open one first
+        if (session_open) {
+            fona_tcp_start_send();
+        } else {
+            ip_open_retries = 8;
+            comm_set_connect_state(CONNECT_STATE_APP_SERVICE);
+            sprintf(command, "at+cipopen=1,\"TCP\",\"%s\",%u", service_tcp_ipv4, SERVICE_TCP_PORT);
+            fona_send(command);
+            setstateF(COMM_FONA_CIPOPENRPL2);
+        }
 
 #else
 
@@ -551,9 +771,14 @@ bool fona_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
 
         // Transmit it, expecting to receive a callback at fona_http_start_send() after
         // the session is open.
-        sprintf(command, "at+chttpsopse=\"%s\",%u,1", SERVICE_HTTP_ADDRESS, SERVICE_HTTP_PORT);
-        fona_send(command);
-        setstateF(COMM_FONA_CHTTPSOPSERPL);
+        if (session_open) {
+            fona_http_start_send();
+            setstateF(COMM_FONA_CHTTPSSENDRPL);
+        } else {
+            sprintf(command, "at+chttpsopse=\"%s\",%u,1", SERVICE_HTTP_ADDRESS, SERVICE_HTTP_PORT);
+            fona_send(command);
+            setstateF(COMM_FONA_CHTTPSOPSERPL);
+        }
 
 #endif // USETCP
 
@@ -563,55 +788,11 @@ bool fona_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
     return true;
 }
 
-// Initiate the HTTP send now that the session is open.
-// Note that this REPLACES the contents of deferred_iobuf with a hexified version of same.
-#if !USETCP
-void fona_http_start_send() {
-    char command[64];
-    char hiChar, loChar, body[sizeof(deferred_iobuf)*2+50+1];
-    uint16_t i, header_length, hexified_length, total_length;
-
-    // The hexified data length will be the original data * 2 (because of hexification)
-    hexified_length = deferred_iobuf_length * 2;
-
-    // Put together a minimalist HTTP header and command to transmit it
-    sprintf(body, "POST %s HTTP/1.1\r\nHost: %s:%d\r\nUser-Agent: TTNODE\r\nContent-Length: %d\r\n\r\n",
-            SERVICE_HTTP_TOPIC, SERVICE_HTTP_ADDRESS, SERVICE_HTTP_PORT, hexified_length);
-
-    // Compute the remaining lengths
-    header_length = strlen(body);
-
-    // Hexify into the body, and add trailing \r\n, and a null term which is useful for %s printing when debugging
-    total_length = header_length;
-    for (i=0; i<deferred_iobuf_length; i++) {
-        if ( (i + header_length) >= (sizeof(deferred_iobuf) - sizeof("00\r\n")) )
-            break;
-        HexChars(deferred_iobuf[i], &hiChar, &loChar);
-        body[total_length++] = hiChar;
-        body[total_length++] = loChar;
-    }
-    body[total_length] = '\0';
-
-    // Bump stats about what we've transmitted
-    stats_io(total_length, 0);
-
-    // Move it back into the iobuf
-    deferred_iobuf_length = total_length;
-    memcpy(deferred_iobuf, body, deferred_iobuf_length);
-
-    // Generate a command
-    deferred_callback_requested = true;
-    sprintf(command, "at+chttpssend=%u", deferred_iobuf_length);
-    fona_send(command);
-
-}
-#endif // !USETCP
-
 // Initiate the HTTP receive into the deferred iobuf
 #if !USETCP
 void fona_http_start_receive() {
     char command[64];
-    deferred_iobuf_length = 0;
+    frame_reset(&deferred);
     sprintf(command, "at+chttpsrecv=%u", sizeof(deferred_iobuf));
     fona_send(command);
 }
@@ -640,41 +821,77 @@ void fona_append_received_hex_data(char *buffer, uint16_t buffer_length) {
     for (i=0; i<buffer_length; i++) {
         databyte = buffer[i];
         if (databyte > ' ') {
-            if (deferred_iobuf_length >= sizeof(deferred_iobuf))
+            if (deferred.length >= sizeof(deferred_iobuf))
                 return;
-            deferred_iobuf[deferred_iobuf_length++] = databyte;
+            deferred_iobuf[deferred.length++] = databyte;
         }
     }
 
 }
 
+// Locate the body of an HTTP response, or return NULL if there's no header
+#if USEBINARY && !USETCP
+uint8_t *fona_http_body(uint8_t *response, uint16_t length, uint16_t *body_length) {
+    uint16_t i;
+    for (i=0; i+4<=length; i++)
+        if (memcmp(&response[i], "\r\n\r\n", 4) == 0) {
+            *body_length = length - (i+4);
+            return &response[i+4];
+        }
+    return NULL;
+}
+#endif
+
 // Process the stuff in the deferred iobuf
 void fona_process_received() {
     uint8_t buffer[CMD_MAX_LINELENGTH];
     uint16_t msgtype;
+#if USEBINARY
+    uint8_t *body = deferred_iobuf;
+    uint16_t body_length = deferred.length;
+#endif
 
     // Regardless of what we received, indicate that we're no longer waiting for
-    // a TTServe reply, because we only want to listen for a single receive
+    // this TTServe reply, because we only want to listen for a single receive
     // window, for power reasons  If we don't pick it up now, we'll pick it up
     // eventually on the next message to the service.
-    awaitingTTServeReply = false;
+    if (awaitingTTServeReplies != 0)
+        awaitingTTServeReplies--;
 
     // Null-terminate the io buffer
-    if (deferred_iobuf_length == sizeof(deferred_iobuf))
-        deferred_iobuf_length--;
-    deferred_iobuf[deferred_iobuf_length] = '\0';
+    if (deferred.length == sizeof(deferred_iobuf))
+        deferred.length--;
+    deferred_iobuf[deferred.length] = '\0';
 
     // Only do this if we got something back
-    if (deferred_iobuf_length != 0) {
+    if (deferred.length != 0) {
+
+        // A reply means that what we sent was delivered
+        comm_send_delivered();
 
         // Bump stats about what we've received on the wire
-        stats_io(0, deferred_iobuf_length);
+        stats_io(0, deferred.length);
+        stats_cell_io(0, deferred.length);
+        stats_cell_reply(get_milliseconds_since_boot() - request_sent_ms);
+        request_sent_ms = get_milliseconds_since_boot();
+        reply_wait_began = get_seconds_since_boot();
 
         // Decode the message
+#if USEBINARY
+#if !USETCP
+        body = fona_http_body(deferred_iobuf, deferred.length, &body_length);
+        if (body == NULL) {
+            body = deferred_iobuf;
+            body_length = 0;
+        }
+#endif
+        msgtype = comm_decode_received_binary(body, body_length, NULL, buffer, sizeof(buffer) - 1);
+#else
         msgtype = comm_decode_received_message((char *)deferred_iobuf, NULL, buffer, sizeof(buffer) - 1, NULL);
+#endif
         if (msgtype != MSG_REPLY_TTSERVE) {
             // This can happen if we get an HTTP error in the body
-            deferred_iobuf[deferred_iobuf_length] = '\0';
+            deferred_iobuf[deferred.length] = '\0';
             DEBUG_PRINTF("?: %s\n", deferred_iobuf);
         } else {
 
@@ -700,12 +917,16 @@ void fona_process_deferred() {
         return;
 
     // Transmit deferred stuff
-    for (i=0; i<deferred_iobuf_length; i++)
+    for (i=0; i<deferred.length; i++)
         serial_send_byte(deferred_iobuf[i]);
+    stats_cell_io(deferred.length, 0);
 
     // Now inactive, and we're done with the callback
     deferred_callback_requested = false;
     if (deferred_done_after_callback) {
+        // UDP gives us no acknowledgement, so once it's out the door it is as delivered as it will be
+        if (deferred_request_type == REPLY_NONE)
+            comm_send_delivered();
         deferred_active = 0;
         comm_oneshot_completed();
     }
@@ -784,7 +1005,7 @@ bool fona_needed_to_be_reset() {
         // If we've gone over the watchdog time, reset the world
         if ((secondsSinceBoot - watchdog_set_time) > watchdog_seconds)
             if (fromFona.state != COMM_STATE_IDLE) {
-                DEBUG_PRINTF("WATCHDOG: Fona stuck st=%d cc=%d b=%d,%d,%d '%s'\n", fromFona.state, fromFona.complete, fromFona.busy_length, fromFona.busy_nextput, fromFona.busy_nextget, fromFona.buffer);
+                DEBUG_PRINTF("WATCHDOG: Fona stuck st=%d cc=%d b=%d,%d '%s'\n", fromFona.state, fromFona.complete, fromFona.busy.put, fromFona.busy.get, fromFona.buffer);
                 // If we're in oneshot mode, use a much bigger stick to reset it, just for good measure
                 // This ensures that the uart switch is set appropriately.
                 // We need to do a hardware reset to close currently open sessions
@@ -801,11 +1022,45 @@ bool fona_needed_to_be_reset() {
             }
     }
 
+    // Manage the session to the service while we're otherwise idle
+    if (fonaInitCompleted && fromFona.state == COMM_STATE_IDLE && deferred_active == 0) {
+
+        // Fetch a reply that arrived while we were busy
+        if (fona_fetch_received())
+            return true;
+
+        // Stop waiting for replies that aren't coming
+        if (awaitingTTServeReplies != 0 && (secondsSinceBoot - reply_wait_began) > CELL_REPLY_WAIT_SECONDS) {
+            DEBUG_PRINTF("CELL: %d replies not received\n", awaitingTTServeReplies);
+            awaitingTTServeReplies = 0;
+            comm_oneshot_completed();
+        }
+
+        // Close the session once it has gone unused for a while
+        if (session_open && awaitingTTServeReplies == 0 && (secondsSinceBoot - session_last_used) >= CELL_SESSION_IDLE_SECONDS) {
+            session_open = false;
+#if USETCP
+            fona_send("at+cipclose=1");
+            setstateF(COMM_FONA_CIPCLOSERPL);
+#else
+            fona_send("at+chttpsclse");
+            setstateF(COMM_FONA_CHTTPSCLSERPL);
+#endif
+            return true;
+        }
+
+    }
+
     // Not reset
     return false;
 
 }
 
+// Whether or not we are still awaiting a reply from the service
+bool fona_is_awaiting_reply() {
+    return (awaitingTTServeReplies != 0);
+}
+
 // End DFU mode cleanly
 void dfu_terminate(uint16_t error) {
     if (fonaDFUInProgress) {
@@ -851,7 +1106,7 @@ void fona_reset(bool force) {
 
 // Request state for debugging
 void fona_request_state() {
-    DEBUG_PRINTF("Fona %s: st=%d cc=%d b=%d,%d,%d '%s'\n", comm_is_deselected() ? "disconnected" : "connected", fromFona.state, fromFona.complete, fromFona.busy_length, fromFona.busy_nextput, fromFona.busy_nextget, fromFona.buffer);
+    DEBUG_PRINTF("Fona %s: st=%d cc=%d b=%d,%d '%s'\n", comm_is_deselected() ? "disconnected" : "connected", fromFona.state, fromFona.complete, fromFona.busy.put, fromFona.busy.get, fromFona.buffer);
 }
 
 // Request a full hardware reset if there are init issues
@@ -862,10 +1117,13 @@ void fona_request_full_reset() {
 // One-time init
 void fona_init() {
     comm_cmdbuf_init(&fromFona, CMDBUF_TYPE_FONA);
+    frame_init(&deferred, FRAME_COUNTED, deferred_iobuf, sizeof(deferred_iobuf), &stats()->errors_framing);
     comm_cmdbuf_set_state(&fromFona, COMM_FONA_RESETREQ);
     fonaNoNetwork = false;
     deferred_active = 0;
-    awaitingTTServeReply = false;
+    awaitingTTServeReplies = 0;
+    received_pending_count = 0;
+    session_open = false;
     fonaInitInProgress = false;
     fonaInitCompleted = false;
     fonaFirstResetAfterInit = true;
@@ -895,7 +1153,9 @@ void fona_term(bool fPowerdown) {
     deferred_active = 0;
     deferred_callback_requested = false;
     deferred_done_after_callback = false;
-    awaitingTTServeReply = false;
+    awaitingTTServeReplies = 0;
+    received_pending_count = 0;
+    session_open = false;
     fona_watchdog_reset();
 #ifdef FONAGPS
     gpsSendShutdownCommandWhenIdle = false;
@@ -914,10 +1174,42 @@ void fona_gps_update() {
 // Process byte received from modem
 void fona_received_byte(uint8_t databyte) {
     fona_received_since_powerup++;
+
+#if USEBINARY
+    // Binary data goes straight into the iobuf, bypassing the line-oriented command buffer
+    if (deferred.expected) {
+        frame_byte(&deferred, databyte);
+        return;
+    }
+#endif
+
     if (deferred_callback_requested && databyte == '>')
         comm_enqueue_complete(CMDBUF_TYPE_FONA_DEFERRED);
     else
         comm_cmdbuf_received_byte(&fromFona, databyte);
+
+#if USEBINARY
+    // Watch for the line that announces binary data.  This must be done here rather than
+    // in the state machine, because the data follows before the line can be processed.
+    if (databyte == '\n') {
+        raw_line[raw_line_length] = '\0';
+        if (memcmp(raw_line, RAW_PREFIX_TCP, strlen(RAW_PREFIX_TCP)) == 0) {
+            // +CIPRXGET: 2,<link>,<length>,<remaining>
+            char *p = strchr(&raw_line[strlen(RAW_PREFIX_TCP)], ',');
+            if (p != NULL)
+                frame_expect(&deferred, atoi(p+1));
+        } else if (memcmp(raw_line, RAW_PREFIX_HTTP, strlen(RAW_PREFIX_HTTP)) == 0) {
+            // +CHTTPSRECV: DATA,<length>
+            frame_expect(&deferred, atoi(&raw_line[strlen(RAW_PREFIX_HTTP)]));
+        }
+        raw_line_length = 0;
+    } else if (databyte >= 0x20 && databyte < 0x7f && raw_line_length < sizeof(raw_line)-1) {
+        if (databyte >= 'A' && databyte <= 'Z')
+            databyte += 'a' - 'A';
+        raw_line[raw_line_length++] = databyte;
+    }
+#endif
+
 }
 
 // Request that the GPS be shut down
@@ -1017,7 +1309,9 @@ void fona_process() {
         deferred_active = 0;
         deferred_callback_requested = false;
         deferred_done_after_callback = false;
-        awaitingTTServeReply = false;
+        awaitingTTServeReplies = 0;
+        received_pending_count = 0;
+        session_open = false;
         serial_transmit_enable(true);
         if (apn[0] == '\0')
             strcpy(apn, storage()->carrier_apn);
@@ -1069,12 +1363,12 @@ void fona_process() {
 
     case COMM_FONA_CRESETRPL: {
         // Process start up-front, else we'd go recursive because of commonreplyF()
-        if (thisargisF("start")) {
+        if (replyisF(FONA_RPL_START)) {
             seenF(0x01);
             fRecordingStats = true;
-        } else if (thisargisF("+cpin: ready"))
+        } else if (replyisF(FONA_RPL_CPIN_READY))
             seenF(0x02);
-        else if (thisargisF("pb done")) {
+        else if (replyisF(FONA_RPL_PB_DONE)) {
             // Wait until 1 second after when we think we're done
             // This seems to be necessary else we get a +CME ERROR: SIM busy
             nrf_delay_ms(1000);
@@ -1097,7 +1391,7 @@ void fona_process() {
     case COMM_FONA_ECHORPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok")) {
+        if (replyisF(FONA_RPL_OK)) {
             if (serial_hwfc_enabled()){
                 // Enable hardware flow control & reconfigure GPIO
                 fona_send("at+cgfunc=11,1");
@@ -1114,7 +1408,7 @@ void fona_process() {
         if (serial_hwfc_enabled()){
             if (commonreplyF())
                 break;
-            if (thisargisF("ok")) {
+            if (replyisF(FONA_RPL_OK)) {
                 // Enable hardware flow control & reconfigure GPIO
                 fona_send("at+ifc=2,2");
                 setstateF(COMM_FONA_IFCRPL2);
@@ -1166,7 +1460,7 @@ void fona_process() {
 #ifdef FONAGPS
     case COMM_FONA_CGPSRPL: {
         // ignore error reply because it may have been user-enabled via at+cgpsauto=1
-        if (thisargisF("error") || thisargisF("ok"))
+        if (replyisF(FONA_RPL_ERROR) || replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (commonreplyF())
             break;
@@ -1182,7 +1476,7 @@ void fona_process() {
     case COMM_FONA_CGPSINFORPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             // Settle down from reset.  This appears to be necessary, else
@@ -1241,7 +1535,7 @@ void fona_process() {
     case COMM_FONA_CGPSINFO2RPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+cgpsinfocfg=0");
@@ -1255,7 +1549,7 @@ void fona_process() {
     case COMM_FONA_CGPSINFO3RPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+cgps=0");
@@ -1272,7 +1566,7 @@ void fona_process() {
                 processstateF(COMM_FONA_INITCOMPLETED);
             break;
         }
-        if (thisargisF("ok")) {
+        if (replyisF(FONA_RPL_OK)) {
             comm_set_connect_state(CONNECT_STATE_WIRELESS_SERVICE);
             fona_send("at+cpsi=5");
             setstateF(COMM_FONA_CPSIRPL);
@@ -1300,9 +1594,9 @@ void fona_process() {
             processstateF(COMM_FONA_INITCOMPLETED);
             break;
         }
-        if (thisargisF("ok")) {
+        if (replyisF(FONA_RPL_OK)) {
             seenF(0x01);
-        } else if (thisargisF("+cpsi:")) {
+        } else if (replyisF(FONA_RPL_CPSI)) {
             nextargF();
             // See if it's something we recognize
             if (thisargisF("no service")) {
@@ -1356,7 +1650,7 @@ void fona_process() {
     case COMM_FONA_CPSI0RPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok")) {
+        if (replyisF(FONA_RPL_OK)) {
             if (apn[0] != '\0')
                 processstateF(COMM_FONA_CICCIDRPL);
             else {
@@ -1369,7 +1663,7 @@ void fona_process() {
     }
 
     case COMM_FONA_ATIRPL: {
-        if (thisargisF("ok")) {
+        if (replyisF(FONA_RPL_OK)) {
             atiMode = false;
             fona_send("at+ciccid");
             setstateF(COMM_FONA_CICCIDRPL);
@@ -1395,7 +1689,7 @@ void fona_process() {
     case COMM_FONA_CGSOCKCONTRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+csocksetpn=1");
@@ -1407,7 +1701,7 @@ void fona_process() {
     case COMM_FONA_CSOCKSETPNRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+cipmode=0");
@@ -1419,7 +1713,7 @@ void fona_process() {
     case COMM_FONA_CIPMODERPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+ciptimeout=120000,30000,120000");
@@ -1431,7 +1725,7 @@ void fona_process() {
     case COMM_FONA_CIPTIMEOUTRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             comm_set_connect_state(CONNECT_STATE_DATA_SERVICE);
@@ -1445,13 +1739,13 @@ void fona_process() {
     case COMM_FONA_NETOPENRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         // Valid traversal of APN?
-        if (thisargisF("+netopen: 0"))
+        if (replyisF(FONA_RPL_NETOPEN_0))
             seenF(0x02);
         // Invalid traversal of APN?
-        if (thisargisF("+netopen: 1")) {
+        if (replyisF(FONA_RPL_NETOPEN_1)) {
             watchdog_extend = false;
             gpio_indicate(INDICATE_CELL_NO_SERVICE);
             DEBUG_PRINTF("Waiting for network...\n");
@@ -1512,9 +1806,9 @@ void fona_process() {
     case COMM_FONA_CDNSGIPRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
-        else if (thisargisF("+cdnsgip: *")) {
+        else if (replyisF(FONA_RPL_CDNSGIP)) {
             nextargF();
             thisargisF("*");
             char *err = nextargF();
@@ -1550,9 +1844,9 @@ void fona_process() {
     case COMM_FONA_CDNSGIPRPL2: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
-        else if (thisargisF("+cdnsgip: *")) {
+        else if (replyisF(FONA_RPL_CDNSGIP)) {
             nextargF();
             thisargisF("*");
             char *err = nextargF();
@@ -1586,7 +1880,7 @@ void fona_process() {
     case COMM_FONA_CIPHEADRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+cipsrip=0");
@@ -1598,7 +1892,7 @@ void fona_process() {
     case COMM_FONA_CIPSRIPRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+ciprxget=1");
@@ -1609,7 +1903,7 @@ void fona_process() {
     case COMM_FONA_CIPRXGETRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+cipopen=0,\"UDP\",,,9000");
@@ -1620,7 +1914,7 @@ void fona_process() {
     case COMM_FONA_CIPOPENRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
 #if USETCP
@@ -1637,7 +1931,7 @@ void fona_process() {
     case COMM_FONA_CHTTPSSTARTRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             processstateF(COMM_FONA_INITCOMPLETED);
@@ -1699,11 +1993,13 @@ void fona_process() {
         if (commonreplyF())
             break;
         // Initial open
-        if (thisargisF("ok")) {
+        if (replyisF(FONA_RPL_OK)) {
             fona_watchdog_reset();
-        } else if (thisargisF("+cipopen: 1,0")) {
+        } else if (replyisF(FONA_RPL_CIPOPEN_1_0)) {
+            session_open = true;
+            stats()->cell_sessions++;
             seenF(0x01);
-        } else if (thisargisF("+cipopen:")) {
+        } else if (replyisF(FONA_RPL_CIPOPEN)) {
             // Retry
             if (ip_open_retries != 0) {
                 ip_open_retries--;
@@ -1724,40 +2020,40 @@ void fona_process() {
             }
         }
         if (allwereseenF(0x01)) {
-            char command[64];
             comm_set_connect_state(CONNECT_STATE_UNKNOWN);
             // Our deferred handler will finish this command
-            deferred_callback_requested = true;
-            deferred_done_after_callback = true;
-            watchdog_extend = true;
-            sprintf(command, "at+cipsend=1,%u", deferred_iobuf_length);
-            fona_send(command);
-            setstateF(COMM_FONA_CIPSENDRPL);
+            fona_tcp_start_send();
         }
         break;
     }
 
     case COMM_FONA_CIPSENDRPL: {
-        if (thisargisF("error"))
-            seenF(0x01);
-        else if (thisargisF("ok"))
-            seenF(0x01);
-        else if (commonreplyF())
-            break;
-        else if (thisargisF("+ipclose:"))
-            seenF(0x02);
-        if (allwereseenF(0x03)) {
+        // Rather than waiting here for the reply, we go idle so that another request
+        // may be sent over the same session while the service is processing this one.
+        if (replyisF(FONA_RPL_ERROR)) {
+            // The session was lost, so give up on this request and open a new one next time
             watchdog_extend = false;
-            fona_send("at+cipclose=1");
-            setstateF(COMM_FONA_CIPCLOSERPL);
-        }
+            session_open = false;
+            deferred_callback_requested = false;
+            deferred_active = 0;
+            if (deferred_request_type != REPLY_NONE && awaitingTTServeReplies != 0)
+                awaitingTTServeReplies--;
+            setidlestateF();
+            comm_oneshot_completed();
+        } else if (replyisF(FONA_RPL_OK)) {
+            watchdog_extend = false;
+            comm_send_delivered();
+            if (!fona_fetch_received())
+                fona_session_used();
+        } else if (commonreplyF())
+            break;
         break;
     }
 
     case COMM_FONA_CIPCLOSERPL: {
-        if (thisargisF("error"))
+        if (replyisF(FONA_RPL_ERROR))
             seenF(0x01);
-        else if (thisargisF("ok"))
+        else if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         else if (commonreplyF())
             break;
@@ -1770,17 +2066,23 @@ void fona_process() {
     case COMM_FONA_CIPRXGETRPL2: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
-            break;
-        else if (thisargisF("+ciprxget:"))
+#if USEBINARY
+        // The data itself was captured as it arrived, ahead of the "ok"
+        if (replyisF(FONA_RPL_OK)) {
+            fona_process_received();
+            fona_session_used();
+        }
+#else
+        if (replyisF(FONA_RPL_OK))
             break;
-        else if (thisargisF("+ipclose:"))
+        else if (replyisF(FONA_RPL_CIPRXGET))
             break;
         else {
-            fona_append_received_hex_data((char *)fromFona.buffer, fromFona.length);
+            fona_append_received_hex_data((char *)fromFona.buffer, fromFona.line.length);
             fona_process_received();
-            setidlestateF();
+            fona_session_used();
         }
+#endif
         break;
     }
 
@@ -1794,8 +2096,11 @@ void fona_process() {
     case COMM_FONA_CHTTPSOPSERPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK)) {
+            session_open = true;
+            stats()->cell_sessions++;
             seenF(0x01);
+        }
         if (allwereseenF(0x01)) {
             fona_http_start_send();
             setstateF(COMM_FONA_CHTTPSSENDRPL);
@@ -1806,7 +2111,7 @@ void fona_process() {
     case COMM_FONA_CHTTPSSENDRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+chttpssend");
@@ -1818,9 +2123,9 @@ void fona_process() {
     case COMM_FONA_CHTTPSSEND2RPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
-        else if (thisargisF("+chttps: recv event"))
+        else if (replyisF(FONA_RPL_CHTTPS_RECV_EVENT))
             seenF(0x02);
         if (allwereseenF(0x03)) {
             fona_http_start_receive();
@@ -1832,16 +2137,17 @@ void fona_process() {
     case COMM_FONA_CHTTPSRECVRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             break;
-        if (thisargisF("+chttpsrecv: 0")) {
+        if (replyisF(FONA_RPL_CHTTPSRECV_0)) {
             fona_process_received();
-            fona_send("at+chttpsclse");
-            setstateF(COMM_FONA_CHTTPSCLSERPL);
-        } else if (thisargisF("+chttpsrecv: data")) {
+            fona_session_used();
+        } else if (replyisF(FONA_RPL_CHTTPSRECV_DATA)) {
             break;
         } else {
-            fona_append_received_hex_data((char *)fromFona.buffer, fromFona.length);
+#if !USEBINARY
+            fona_append_received_hex_data((char *)fromFona.buffer, fromFona.line.length);
+#endif
         }
         break;
     }
@@ -1849,7 +2155,7 @@ void fona_process() {
     case COMM_FONA_CHTTPSCLSERPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             setidlestateF();
@@ -1886,7 +2192,7 @@ void fona_process() {
             dfu_terminate(DFU_ERR_BASIC);
             break;
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             char buffer[64];
@@ -1902,7 +2208,7 @@ void fona_process() {
             dfu_terminate(DFU_ERR_BASIC);
             break;
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             char command[64];
@@ -1918,7 +2224,7 @@ void fona_process() {
             dfu_terminate(DFU_ERR_BASIC);
             break;
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             fona_send("at+cftppw=\"safecast-password\"");
@@ -1932,7 +2238,7 @@ void fona_process() {
             dfu_terminate(DFU_ERR_BASIC);
             break;
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
 #ifdef DFU_TEST_WITHOUT_DOWNLOAD
@@ -1976,7 +2282,7 @@ void fona_process() {
             watchdog_extend = false;
             break;
         }
-        if (thisargisF("+cftpgetfile:")) {
+        if (replyisF(FONA_RPL_CFTPGETFILE)) {
             if (thisargisF("+cftpgetfile: 0")) {
                 seenF(0x02);
                 DEBUG_PRINTF("DFU downloaded successfully.\n");
@@ -1996,7 +2302,7 @@ void fona_process() {
                 break;
             }
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x03)) {
             DEBUG_PRINTF("DFU downloading %s/%s\n", storage()->dfu_filename, DFU_INFO_PACKET);
@@ -2019,7 +2325,7 @@ void fona_process() {
             watchdog_extend = false;
             break;
         }
-        if (thisargisF("+cftpgetfile:")) {
+        if (replyisF(FONA_RPL_CFTPGETFILE)) {
             if (thisargisF("+cftpgetfile: 0")) {
                 seenF(0x02);
                 DEBUG_PRINTF("DFU downloaded successfully.\n");
@@ -2029,7 +2335,7 @@ void fona_process() {
                 break;
             }
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x03)) {
             // Done with the download
@@ -2062,7 +2368,7 @@ void fona_process() {
             dfu_terminate(DFU_ERR_BASIC);
             break;
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             // So that we can validate what has been downloaded, initiate a transfer to the host
@@ -2082,7 +2388,7 @@ void fona_process() {
             watchdog_extend = false;
             break;
         }
-        if (thisargisF("+cftrantx:")) {
+        if (replyisF(FONA_RPL_CFTRANTX)) {
             if (thisargisF("+cftrantx: 0")) {
                 seenF(0x02);
             } else if (thisargisF("+cftrantx: data")) {
@@ -2108,7 +2414,7 @@ void fona_process() {
                 break;
             }
         }
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x03)) {
             DEBUG_PRINTF("DFU download is valid\n");
@@ -2138,7 +2444,7 @@ void fona_process() {
     case COMM_FONA_MISCRPL: {
         if (commonreplyF())
             break;
-        if (thisargisF("ok"))
+        if (replyisF(FONA_RPL_OK))
             seenF(0x01);
         if (allwereseenF(0x01)) {
             setidlestateF();
@@ -13,6 +13,7 @@ void fona_gps_update();
 void fona_gps_shutdown();
 uint16_t fona_gps_get_value(float *lat, float *lon, float *alt);
 bool fona_needed_to_be_reset();
+bool fona_is_awaiting_reply();
 bool fona_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType);
 void fona_request_full_reset();
 void fona_init();
@@ -23,7 +24,10 @@ void fona_request_state();
 void fona_reset(bool Force);
 void fona_send(char *msg);
 void fona_received_byte(uint8_t databyte);
+bool fona_fetch_received();
+void fona_session_used();
 uint16_t fona_get_mtu();
+const comm_reply_t *fona_replies(uint16_t *count);
 
 #endif // FONA
 #endif // COMM_FONA_H__
@@ -0,0 +1,138 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Splitting of messages that exceed the transport's MTU into fragments, and their
+// reassembly.  This has no dependencies upon the rest of the firmware so that the
+// very same code may be used by a receiver.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "send.h"
+#include "fragment.h"
+
+// Bytes of message carried by all but the last fragment
+static uint16_t fragment_chunk(uint16_t mtu) {
+    if (mtu > FRAGMENT_MAX_FRAME)
+        mtu = FRAGMENT_MAX_FRAME;
+    if (mtu <= FRAGMENT_HEADER_BYTES)
+        return 0;
+    return (mtu - FRAGMENT_HEADER_BYTES);
+}
+
+// Number of fragments needed to send a message, or 0 if it can't be fragmented
+uint8_t fragment_count(uint16_t length, uint16_t mtu) {
+    uint16_t chunk = fragment_chunk(mtu);
+    uint16_t count;
+
+    if (chunk == 0 || length == 0 || length > FRAGMENT_MAX_LENGTH)
+        return 0;
+    count = (length + chunk - 1) / chunk;
+    if (count > FRAGMENT_MAX_COUNT)
+        return 0;
+    return ((uint8_t) count);
+
+}
+
+// Build the specified fragment of a message into a frame of no more than the MTU,
+// returning the length of the frame.
+uint16_t fragment_build(uint8_t *message, uint16_t length, uint8_t id, uint8_t index, uint16_t mtu, uint8_t *frame) {
+    uint16_t chunk = fragment_chunk(mtu);
+    uint8_t count = fragment_count(length, mtu);
+    uint16_t offset, chunk_length;
+
+    if (count == 0 || index >= count)
+        return 0;
+
+    offset = index * chunk;
+    chunk_length = length - offset;
+    if (chunk_length > chunk)
+        chunk_length = chunk;
+
+    frame[0] = BUFF_FORMAT_FRAGMENT;
+    frame[1] = id;
+    frame[2] = index;
+    frame[3] = count;
+    memcpy(&frame[FRAGMENT_HEADER_BYTES], &message[offset], chunk_length);
+
+    return (FRAGMENT_HEADER_BYTES + chunk_length);
+
+}
+
+// Discard any partially-reassembled message
+void fragment_reassembly_reset(fragment_reassembly_t *r) {
+    r->id = 0;
+    r->count = 0;
+    r->chunk = 0;
+    r->received = 0;
+    r->length = 0;
+    r->tail_length = 0;
+}
+
+// Accumulate a received fragment, returning true with the reassembled message once
+// all of its fragments have arrived.  Fragments may arrive in any order, and a
+// fragment of a different message discards whatever was partially reassembled.
+bool fragment_reassemble(fragment_reassembly_t *r, uint8_t *frame, uint16_t frame_length, uint8_t **message, uint16_t *message_length) {
+    uint8_t id, index, count;
+    uint8_t *data;
+    uint16_t data_length;
+
+    if (frame_length <= FRAGMENT_HEADER_BYTES || frame[0] != BUFF_FORMAT_FRAGMENT)
+        return false;
+    id = frame[1];
+    index = frame[2];
+    count = frame[3];
+    if (count == 0 || count > FRAGMENT_MAX_COUNT || index >= count)
+        return false;
+    data = &frame[FRAGMENT_HEADER_BYTES];
+    data_length = frame_length - FRAGMENT_HEADER_BYTES;
+
+    // Start over if this is a different message
+    if (r->count != count || r->id != id) {
+        fragment_reassembly_reset(r);
+        r->id = id;
+        r->count = count;
+    }
+
+    // All but the last fragment are the same length, which is how we learn where each
+    // one goes.  The last is held aside because it may arrive before any of the others.
+    if (index < count-1) {
+        if (r->chunk == 0)
+            r->chunk = data_length;
+        if (data_length != r->chunk || (index+1) * r->chunk > FRAGMENT_MAX_LENGTH) {
+            fragment_reassembly_reset(r);
+            return false;
+        }
+        memcpy(&r->data[index * r->chunk], data, data_length);
+    } else {
+        if (data_length > sizeof(r->tail)) {
+            fragment_reassembly_reset(r);
+            return false;
+        }
+        memcpy(r->tail, data, data_length);
+        r->tail_length = data_length;
+    }
+    r->received |= (1UL << index);
+
+    // Done if we're still waiting for something
+    if (r->received != ((1UL << count) - 1))
+        return false;
+
+    // Append the last fragment and deliver the message
+    r->length = (count-1) * r->chunk + r->tail_length;
+    if (r->length > FRAGMENT_MAX_LENGTH) {
+        fragment_reassembly_reset(r);
+        return false;
+    }
+    memcpy(&r->data[(count-1) * r->chunk], r->tail, r->tail_length);
+    *message = r->data;
+    *message_length = r->length;
+
+    // A duplicate of any fragment will begin the message anew
+    r->count = 0;
+    r->received = 0;
+
+    return true;
+
+}
@@ -0,0 +1,33 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#ifndef FRAGMENT_H__
+#define FRAGMENT_H__
+
+// Each fragment of a message that is too large for the transport's MTU begins with
+// BUFF_FORMAT_FRAGMENT, followed by the message ID, the fragment index, and the
+// number of fragments.  The remainder is the next chunk of the buffered-format
+// message, with all but the last chunk being of the same length.
+#define FRAGMENT_HEADER_BYTES   4
+#define FRAGMENT_MAX_COUNT      16
+#define FRAGMENT_MAX_LENGTH     512
+#define FRAGMENT_MAX_FRAME      128
+
+typedef struct {
+    uint8_t id;
+    uint8_t count;
+    uint16_t chunk;
+    uint32_t received;
+    uint16_t length;
+    uint16_t tail_length;
+    uint8_t data[FRAGMENT_MAX_LENGTH];
+    uint8_t tail[FRAGMENT_MAX_FRAME];
+} fragment_reassembly_t;
+
+uint8_t fragment_count(uint16_t length, uint16_t mtu);
+uint16_t fragment_build(uint8_t *message, uint16_t length, uint8_t id, uint8_t index, uint16_t mtu, uint8_t *frame);
+void fragment_reassembly_reset(fragment_reassembly_t *r);
+bool fragment_reassemble(fragment_reassembly_t *r, uint8_t *frame, uint16_t frame_length, uint8_t **message, uint16_t *message_length);
+
+#endif // FRAGMENT_H__
@@ -6,12 +6,15 @@
 
 #include <stdint.h>
 #include <string.h>
+#include <math.h>
 #include "debug.h"
 #include "nrf.h"
 #include "nrf_gpio.h"
 #include "nrf_delay.h"
 #include "nrf_gpiote.h"
 #include "nrf_drv_gpiote.h"
+#include "nrf_timer.h"
+#include "nrf_soc.h"
 #include "app_gpiote.h"
 #include "boards.h"
 #include "softdevice_handler.h"
@@ -30,24 +33,53 @@
 
 #ifdef GEIGERX
 
-// These counters are maintained by the lowest level, which is
-// the GPIOTE interrupt counter.  These are the only things
-// maintained at that lowest level.
+// Tube pulses are counted in hardware, without waking the CPU: each
+// tube's GPIOTE IN event is wired through PPI to the COUNT task of a
+// TIMER in counter mode, which we read once per bucket.  The SoftDevice
+// reserves TIMER0 and the upper PPI channels, but leaves these to us.
+#define GEIGER0_TIMER NRF_TIMER1
+#define GEIGER0_PPI_CHANNEL 0
+#define GEIGER1_TIMER NRF_TIMER2
+#define GEIGER1_PPI_CHANNEL 1
+
+// TIMER1 and TIMER2 are only 16 bits wide on the nRF51, so the counters wrap sooner there
+#ifndef GEIGER_COUNTER_BITS
+#ifdef NRF51
+#define GEIGER_COUNTER_BITS 16
+#else
+#define GEIGER_COUNTER_BITS 32
+#endif
+#endif
+#if GEIGER_COUNTER_BITS == 16
+#define GEIGER_COUNTER_WIDTH NRF_TIMER_BIT_WIDTH_16
+#define GEIGER_COUNTER_MASK 0xFFFFL
+#else
+#define GEIGER_COUNTER_WIDTH NRF_TIMER_BIT_WIDTH_32
+#define GEIGER_COUNTER_MASK 0xFFFFFFFFL
+#endif
+static uint32_t geiger0CounterLastRead = 0;
+static uint32_t geiger1CounterLastRead = 0;
+
+// Values derived from the hardware counters
 static bool valuesHaveBeenUpdated = false;
 static bool value0IsReportable = false;
 static bool value0EverReportable = false;
 static uint32_t reportableValue0;
+static uint32_t reportableError0;
+static bool reportableWindowed0;
 static uint32_t lastValue0;
+static uint32_t lastError0;
 static bool value1IsReportable = false;
 static bool value1EverReportable = false;
 static uint32_t reportableValue1;
+static uint32_t reportableError1;
+static bool reportableWindowed1;
 static uint32_t lastValue1;
+static uint32_t lastError1;
 static bool geiger0IsAvailable = false;
-static uint32_t geiger0InterruptCount = 0;
-static uint32_t geiger0InterruptCount_total = 0;
+static uint32_t geiger0PulseCount_total = 0;
 static bool geiger1IsAvailable = false;
-static uint32_t geiger1InterruptCount = 0;
-static uint32_t geiger1InterruptCount_total = 0;
+static uint32_t geiger1PulseCount_total = 0;
 static bool geigerPowerOn = false;
 static int bucketsLeftDuringSettling = 0;
 static int bucketsLeftToFillAfterPowerOn = 0;
@@ -65,15 +97,161 @@ static uint16_t currentBucket = 0;
 static uint32_t bucket0[GEIGER_INTEGRATION_BUCKETS];
 static uint32_t bucket1[GEIGER_INTEGRATION_BUCKETS];
 
+// The number of buckets not yet filled since power-on
+static uint16_t bucket0Invalid = GEIGER_INTEGRATION_BUCKETS;
+static uint16_t bucket1Invalid = GEIGER_INTEGRATION_BUCKETS;
+
+// The adaptive integration window, which is the most recent buckets within the ring,
+// with a running total so that a bucket update needn't re-sum them.  It grows a bucket
+// at a time up to the whole ring, but drops back to just the latest buckets when the
+// count rate changes significantly, so that a hot spot is reflected right away rather
+// than being averaged in over minutes.
+typedef struct {
+    uint32_t sum;
+    uint16_t buckets;
+    // Buckets yet to be counted before a suspected change of rate can be confirmed
+    uint16_t confirming;
+    bool rising;
+} geiger_window_t;
+static geiger_window_t window0;
+static geiger_window_t window1;
+
 // Forwards
 void geiger_power_on();
+uint16_t geiger_integration_seconds();
+
+// Wire a tube's pin to its counter
+static void geiger_counter_init(uint32_t pin, NRF_TIMER_Type *timer, uint8_t ppi_channel) {
+    uint32_t err_code;
+    nrf_drv_gpiote_in_config_t config = GPIOTE_CONFIG_IN_SENSE_LOTOHI(true);
+
+    nrf_timer_mode_set(timer, NRF_TIMER_MODE_COUNTER);
+    nrf_timer_bit_width_set(timer, GEIGER_COUNTER_WIDTH);
+    nrf_timer_task_trigger(timer, NRF_TIMER_TASK_CLEAR);
+    nrf_timer_task_trigger(timer, NRF_TIMER_TASK_START);
+
+    err_code = nrf_drv_gpiote_in_init(pin, &config, NULL);
+    DEBUG_CHECK(err_code);
+
+    err_code = sd_ppi_channel_assign(ppi_channel,
+                                     (const volatile void *) nrf_drv_gpiote_in_event_addr_get(pin),
+                                     nrf_timer_task_address_get(timer, NRF_TIMER_TASK_COUNT));
+    DEBUG_CHECK(err_code);
+    err_code = sd_ppi_channel_enable_set(1L << ppi_channel);
+    DEBUG_CHECK(err_code);
+
+    nrf_drv_gpiote_in_event_enable(pin, false);
+
+}
+
+// Get the number of pulses counted since the counter was last read.  The
+// counter runs freely, so that no pulses are lost between reading and clearing,
+// and the difference is taken modulo the counter's width so that it may wrap.
+static uint32_t geiger_counter_read(NRF_TIMER_Type *timer, uint32_t *lastRead) {
+    uint32_t count, pulses;
+    nrf_timer_task_trigger(timer, NRF_TIMER_TASK_CAPTURE0);
+    count = nrf_timer_cc_read(timer, NRF_TIMER_CC_CHANNEL0);
+    pulses = (count - *lastRead) & GEIGER_COUNTER_MASK;
+    *lastRead = count;
+    return pulses;
+}
+
+// Set up pulse counting, after the GPIOTE driver has been initialized
+void geiger_init() {
+    geiger_counter_init(PIN_GEIGER0, GEIGER0_TIMER, GEIGER0_PPI_CHANNEL);
+    geiger_counter_init(PIN_GEIGER1, GEIGER1_TIMER, GEIGER1_PPI_CHANNEL);
+}
+
+// Sum the most recent buckets
+static uint32_t geiger_recent_sum(uint32_t *bucket, uint16_t buckets) {
+    uint32_t sum = 0;
+    uint16_t i;
+    for (i = 0; i < buckets; i++)
+        sum += bucket[(currentBucket + GEIGER_INTEGRATION_BUCKETS - i) % GEIGER_INTEGRATION_BUCKETS];
+    return sum;
+}
+
+// See if the count in the latest buckets differs from what a reference count predicts.  Counts
+// are Poisson, so the variance of each equals its expected count, and we test the square
+// of the difference against the sum of their variances to avoid a square root.
+static bool geiger_rate_changed(uint32_t recent, uint32_t reference, uint16_t referenceBuckets, bool *rising) {
+    float expected = ((float) reference * GEIGER_ADAPTIVE_MIN_BUCKETS) / referenceBuckets;
+    float deviation = (float) recent - expected;
+    *rising = (deviation > 0);
+    return ((deviation * deviation) > (GEIGER_ADAPTIVE_SIGMAS * GEIGER_ADAPTIVE_SIGMAS * MAX(expected, 1.0) * (1.0 + ((float) GEIGER_ADAPTIVE_MIN_BUCKETS / referenceBuckets))));
+}
+
+// Replace the oldest bucket with a new count, maintaining the adaptive window
+static void geiger_bucket_insert(uint32_t *bucket, uint16_t *invalid, geiger_window_t *window, uint32_t count) {
+    uint32_t evicted = bucket[currentBucket];
+    uint32_t recent, since;
+    uint16_t sinceBuckets;
+    bool confirming, rising;
+
+    if (evicted == INVALID_COUNT)
+        (*invalid)--;
+    bucket[currentBucket] = count;
+
+    // Grow the window by the new bucket, dropping the one that we just overwrote if it was within it
+    window->sum += count;
+    window->buckets++;
+    if (window->buckets > GEIGER_INTEGRATION_BUCKETS) {
+        window->sum -= evicted;
+        window->buckets--;
+    }
 
-// Geiger events
-void geiger0_event() {
-    geiger0InterruptCount++;
+    // A single test at low count rates fails by chance several times a week, so a change of rate is only
+    // suspected when the latest buckets deviate from the rest of the window.  It is confirmed once the
+    // buckets that follow, taken alone, deviate from that same reference in the same direction, at
+    // which point the window drops back to just those buckets.
+    confirming = (window->confirming > 0);
+    if (confirming && --window->confirming > 0)
+        return;
+    sinceBuckets = confirming ? GEIGER_ADAPTIVE_MIN_BUCKETS*2 : GEIGER_ADAPTIVE_MIN_BUCKETS;
+    if (window->buckets < (sinceBuckets + GEIGER_ADAPTIVE_REFERENCE_BUCKETS))
+        return;
+    recent = geiger_recent_sum(bucket, GEIGER_ADAPTIVE_MIN_BUCKETS);
+    since = confirming ? geiger_recent_sum(bucket, sinceBuckets) : recent;
+    if (!geiger_rate_changed(recent, window->sum - since, window->buckets - sinceBuckets, &rising))
+        return;
+    if (!confirming) {
+        window->confirming = GEIGER_ADAPTIVE_MIN_BUCKETS;
+        window->rising = rising;
+        return;
+    }
+    if (rising != window->rising)
+        return;
+    if (debug(DBG_SENSOR))
+        DEBUG_PRINTF("CPM rate change (%lu in %ds, was %lu in %ds)\n", recent, GEIGER_ADAPTIVE_MIN_BUCKETS*GEIGER_BUCKET_SECONDS, window->sum - since, (window->buckets - sinceBuckets)*GEIGER_BUCKET_SECONDS);
+    window->sum = recent;
+    window->buckets = GEIGER_ADAPTIVE_MIN_BUCKETS;
+
+}
+
+// Get a tube's ring of buckets, the latest of them, how many are invalid, and its window
+uint32_t *geiger_buckets(uint16_t tube, uint16_t *latest, uint16_t *invalid, uint32_t *windowSum, uint16_t *windowBuckets) {
+    geiger_window_t *window = (tube == 0) ? &window0 : &window1;
+    *latest = currentBucket;
+    *invalid = (tube == 0) ? bucket0Invalid : bucket1Invalid;
+    *windowSum = window->sum;
+    *windowBuckets = window->buckets;
+    return (tube == 0) ? bucket0 : bucket1;
+}
+
+// Convert a count over a number of buckets to CPM, compensating for the tube's dead time
+static float geiger_compensated_cpm(float count, uint16_t buckets) {
+    float bucketsPerMinute = (float) 60 / GEIGER_BUCKET_SECONDS;
+    float mean = count / ((float) buckets / bucketsPerMinute);
+    float divisor = 1 - (mean * 1.8833e-6);
+    if (!divisor)
+        return 0.0;
+    return (mean / divisor);
 }
-void geiger1_event() {
-    geiger1InterruptCount++;
+
+// The half-width of the 95% confidence interval of a CPM measured from a count
+static uint32_t geiger_cpm_error(uint32_t count, uint16_t buckets) {
+    float interval = 1.96 * sqrtf((float) MAX(count, 1));
+    return (uint32_t) (geiger_compensated_cpm((float) count + interval, buckets) - geiger_compensated_cpm((float) count, buckets) + 0.5);
 }
 
 // Get the number of integration seconds based on current mode
@@ -97,11 +275,11 @@ bool s_geiger_show_value(uint32_t when, char *buffer, uint16_t length) {
         return false;
     last = when;
     if (value0EverReportable && value1EverReportable) {
-        sprintf(msg, "CPM %ldcpm %ldcpm", reportableValue0, reportableValue1);
+        sprintf(msg, "CPM %ld+/-%ldcpm %ld+/-%ldcpm", reportableValue0, reportableError0, reportableValue1, reportableError1);
     } else if (value0EverReportable) {
-        sprintf(msg, "CPM0 %ldcpm", reportableValue0);
+        sprintf(msg, "CPM0 %ld+/-%ldcpm", reportableValue0, reportableError0);
     } else if (value1EverReportable) {
-        sprintf(msg, "CPM1 %ld cpm", reportableValue1);
+        sprintf(msg, "CPM1 %ld+/-%ld cpm", reportableValue1, reportableError1);
     } else
         sprintf(msg, "CPM not yet measured");
     strlcpy(buffer, msg, length);
@@ -121,6 +299,16 @@ bool s_geiger_get_value(bool *pAvail0, uint32_t *pCPM0, bool *pAvail1, uint32_t
     return(value0IsReportable || value1IsReportable);
 }
 
+// Report on the uncertainty of the geiger values, as the half-width of their 95% confidence intervals.
+// A value measured over the whole ring has an uncertainty that follows from the value itself, and
+// so is reported as 0 to keep it out of the message; only a shortened window's needs to be sent.
+void s_geiger_get_error(uint32_t *pError0, uint32_t *pError1) {
+    if (pError0 != NULL)
+        *pError0 = reportableWindowed0 ? reportableError0 : 0;
+    if (pError1 != NULL)
+        *pError1 = reportableWindowed1 ? reportableError1 : 0;
+}
+
 // Skip this sensor if we're in a mode in which we need to get something sent out
 // Note that we call this with NULL elsewhere in this file, so do not use the argument
 bool g_geiger_skip(void *g_do_not_use_or_you_will_segfault) {
@@ -195,11 +383,11 @@ void s_geiger_measure(void *s) {
 
     // Debugging
     if (value0IsReportable && value1IsReportable) {
-        DEBUG_PRINTF("GEIGER reported %ld %ld\n", reportableValue0, reportableValue1);
+        DEBUG_PRINTF("GEIGER reported %ld+/-%ld %ld+/-%ld\n", reportableValue0, reportableError0, reportableValue1, reportableError1);
     } else if (value0IsReportable) {
-        DEBUG_PRINTF("GEIGER reported %ld -\n", reportableValue0);
+        DEBUG_PRINTF("GEIGER reported %ld+/-%ld -\n", reportableValue0, reportableError0);
     } else if (value1IsReportable) {
-        DEBUG_PRINTF("GEIGER reported - %ld\n", reportableValue1);
+        DEBUG_PRINTF("GEIGER reported - %ld+/-%ld\n", reportableValue1, reportableError1);
     }
 
     // Done
@@ -210,25 +398,22 @@ void s_geiger_measure(void *s) {
 // Update the buckets where we accumulate the data from the counts.
 // This *must* be called every GEIGER_BUCKET_SECONDS.
 void geiger_bucket_update() {
-    int i;
-    uint32_t interruptCount0, interruptCount1;
+    uint32_t pulseCount0, pulseCount1;
 
-    // Grab the values from the interrupt counters, and clear them out
-    interruptCount0 = geiger0InterruptCount;
-    geiger0InterruptCount = 0;
-    interruptCount1 = geiger1InterruptCount;
-    geiger1InterruptCount = 0;
+    // Grab the pulses counted since the last bucket
+    pulseCount0 = geiger_counter_read(GEIGER0_TIMER, &geiger0CounterLastRead);
+    pulseCount1 = geiger_counter_read(GEIGER1_TIMER, &geiger1CounterLastRead);
 
     // Take note of when the geigers become available
 #define PULSE_DEBOUNCE 5
-    geiger0InterruptCount_total += interruptCount0;
-    if (!geiger0IsAvailable && geiger0InterruptCount_total > PULSE_DEBOUNCE) {
+    geiger0PulseCount_total += pulseCount0;
+    if (!geiger0IsAvailable && geiger0PulseCount_total > PULSE_DEBOUNCE) {
         geiger0IsAvailable = true;
         if (debug(DBG_SENSOR))
             DEBUG_PRINTF("Geiger #0 detected\n");
     }
-    geiger1InterruptCount_total += interruptCount1;
-    if (!geiger1IsAvailable && geiger1InterruptCount_total > PULSE_DEBOUNCE) {
+    geiger1PulseCount_total += pulseCount1;
+    if (!geiger1IsAvailable && geiger1PulseCount_total > PULSE_DEBOUNCE) {
         geiger1IsAvailable = true;
         if (debug(DBG_SENSOR))
             DEBUG_PRINTF("Geiger #1 detected\n");
@@ -241,7 +426,7 @@ void geiger_bucket_update() {
         if (bucketsLeftDuringSettling > 0) {
             --bucketsLeftDuringSettling;
             if (debug(DBG_SENSOR))
-                DEBUG_PRINTF("CPM settling (+%d +%d)\n", interruptCount0, interruptCount1);
+                DEBUG_PRINTF("CPM settling (+%d +%d)\n", pulseCount0, pulseCount1);
             return;
         }
 
@@ -257,71 +442,42 @@ void geiger_bucket_update() {
     // Insert the up-to-date interrupt counters into the bucket
     if (++currentBucket >= GEIGER_INTEGRATION_BUCKETS)
         currentBucket = 0;
-    bucket0[currentBucket] = interruptCount0;
-    bucket1[currentBucket] = interruptCount1;
+    geiger_bucket_insert(bucket0, &bucket0Invalid, &window0, pulseCount0);
+    geiger_bucket_insert(bucket1, &bucket1Invalid, &window1, pulseCount1);
 
-    // Sum up the bucket contents
-    uint32_t cpm0 = 0;
-    uint32_t cpm0buckets = 0;
+    // Values are reportable once the whole ring has been filled, after which
+    // they are measured over the adaptive window
     if (geiger0IsAvailable) {
-        value0IsReportable = true;
-        for (i = 0; i < GEIGER_INTEGRATION_BUCKETS; i++) {
-            if (bucket0[i] == INVALID_COUNT)
-                value0IsReportable = false;
-            else {
-                cpm0 += bucket0[i];
-                cpm0buckets++;
-            }
-        }
+        value0IsReportable = (bucket0Invalid == 0);
         if (value0IsReportable)
             value0EverReportable = true;
     }
-    uint32_t cpm1 = 0;
-    uint32_t cpm1buckets = 0;
     if (geiger1IsAvailable) {
-        value1IsReportable = true;
-        for (i = 0; i < GEIGER_INTEGRATION_BUCKETS; i++) {
-            if (bucket1[i] == INVALID_COUNT)
-                value1IsReportable = false;
-            else {
-                cpm1 += bucket1[i];
-                cpm1buckets++;
-            }
-        }
+        value1IsReportable = (bucket1Invalid == 0);
         if (value1IsReportable)
             value1EverReportable = true;
     }
 
     // Compute compensated means
-    float bucketsPerMinute = (float) 60 / GEIGER_BUCKET_SECONDS;
-    float mean, compensated, divisor, secondsPerBucketPerMinute;
-    lastValue0 = 0;
-    if (cpm0buckets) {
-        secondsPerBucketPerMinute  = ((float) cpm0buckets) / bucketsPerMinute;
-        mean = (float) cpm0 / secondsPerBucketPerMinute;
-        divisor = 1 - (mean * 1.8833e-6);
-        if (divisor)
-            compensated = mean / divisor;
-        else
-            compensated = 0.0;
-        lastValue0 = (uint32_t) compensated;
+    lastValue0 = lastError0 = 0;
+    if (geiger0IsAvailable && window0.buckets) {
+        lastValue0 = (uint32_t) geiger_compensated_cpm((float) window0.sum, window0.buckets);
+        lastError0 = geiger_cpm_error(window0.sum, window0.buckets);
         if (value0IsReportable) {
             reportableValue0 = lastValue0;
+            reportableError0 = lastError0;
+            reportableWindowed0 = (window0.buckets < GEIGER_INTEGRATION_BUCKETS);
             valuesHaveBeenUpdated = true;
         }
     }
-    lastValue1 = 0;
-    if (cpm1buckets) {
-        secondsPerBucketPerMinute  = ((float) cpm1buckets) / bucketsPerMinute;
-        mean = (float) cpm1 / secondsPerBucketPerMinute;
-        divisor = 1 - (mean * 1.8833e-6);
-        if (divisor)
-            compensated = mean / divisor;
-        else
-            compensated = 0.0;
-        lastValue1 = (uint32_t) compensated;
+    lastValue1 = lastError1 = 0;
+    if (geiger1IsAvailable && window1.buckets) {
+        lastValue1 = (uint32_t) geiger_compensated_cpm((float) window1.sum, window1.buckets);
+        lastError1 = geiger_cpm_error(window1.sum, window1.buckets);
         if (value1IsReportable) {
             reportableValue1 = lastValue1;
+            reportableError1 = lastError1;
+            reportableWindowed1 = (window1.buckets < GEIGER_INTEGRATION_BUCKETS);
             valuesHaveBeenUpdated = true;
         }
     }
@@ -331,11 +487,11 @@ void geiger_bucket_update() {
     int percentComplete = (int) (((float) (totalIterations - bucketsLeftToFillAfterPowerOn) / totalIterations) * 100);
     if (percentComplete < 0) percentComplete = 0;
     if (geiger0IsAvailable && geiger1IsAvailable)
-        DEBUG_PRINTF("CPM %d %d (%d %d) %d%%\n", lastValue0, lastValue1, interruptCount0, interruptCount1, percentComplete);
+        DEBUG_PRINTF("CPM %d+/-%d %d+/-%d (%d %d) %d%%\n", lastValue0, lastError0, lastValue1, lastError1, pulseCount0, pulseCount1, percentComplete);
     else if (geiger0IsAvailable)
-        DEBUG_PRINTF("CPM %d - (%d %d) %d%%\n", lastValue0, interruptCount0, interruptCount1, percentComplete);
+        DEBUG_PRINTF("CPM %d+/-%d - (%d %d) %d%%\n", lastValue0, lastError0, pulseCount0, pulseCount1, percentComplete);
     else if (geiger1IsAvailable)
-        DEBUG_PRINTF("CPM - %d (%d %d) %d%%\n", lastValue1, interruptCount0, interruptCount1, percentComplete);
+        DEBUG_PRINTF("CPM - %d+/-%d (%d %d) %d%%\n", lastValue1, lastError1, pulseCount0, pulseCount1, percentComplete);
 
 }
 
@@ -398,15 +554,18 @@ void geiger_power_on() {
             bucket0[i] = INVALID_COUNT;
             bucket1[i] = INVALID_COUNT;
         }
+        bucket0Invalid = bucket1Invalid = GEIGER_INTEGRATION_BUCKETS;
+        memset(&window0, 0, sizeof(window0));
+        memset(&window1, 0, sizeof(window1));
 
         // After powering on, allow settling for stabilization.  When we're in mobile mode,
         // power-on only happens up-front and the geiger stays running continuously.
         bucketsLeftDuringSettling = GEIGER_SETTLING_SECONDS/GEIGER_BUCKET_SECONDS;
         bucketsLeftToFillAfterPowerOn = geiger_integration_seconds()/GEIGER_BUCKET_SECONDS + bucketsLeftDuringSettling;
 
-        // Init the current values
-        geiger0InterruptCount = 0;
-        geiger1InterruptCount = 0;
+        // Discard anything counted while we weren't sampling
+        geiger_counter_read(GEIGER0_TIMER, &geiger0CounterLastRead);
+        geiger_counter_read(GEIGER1_TIMER, &geiger1CounterLastRead);
 
         // Clear whether or not the values are reportable
         s_geiger_clear_measurement();
@@ -12,10 +12,10 @@
 #define LND7128EC   3
 
 bool s_geiger_get_value(bool *pAvail0, uint32_t *pCPM0, bool *pAvail1, uint32_t *pCPM1);
+void s_geiger_get_error(uint32_t *pError0, uint32_t *pError1);
 bool s_geiger_show_value(uint32_t when, char *buffer, uint16_t length);
 void s_geiger_clear_measurement();
-void geiger0_event();
-void geiger1_event();
+void geiger_init();
 void geiger_poll();
 bool g_geiger_skip(void *g);
 void s_geiger_poll(void *s);
@@ -23,6 +23,7 @@ bool s_geiger_init(void *s, uint16_t param);
 bool s_geiger_term();
 void s_geiger_measure(void *s);
 bool s_geiger_upload_needed(void *s);
+uint32_t *geiger_buckets(uint16_t tube, uint16_t *latest, uint16_t *invalid, uint32_t *windowSum, uint16_t *windowBuckets);
 
 #endif // GEIGERX
 #endif // GEIGER_H__
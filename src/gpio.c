@@ -57,20 +57,12 @@ static bool fSensorPowerForceOff = false;
 // GPIO initialization info
 #ifdef ENABLE_GPIOTE
 #if defined(NSDKV10) || defined(NSDKV11) || defined(NSDKV121)
-#ifdef GEIGERX
-static uint32_t m_geiger0_low_to_high_mask = 0;
-static uint32_t m_geiger1_low_to_high_mask = 0;
-#endif
 #ifdef MOTIONX
 static uint32_t m_motion_low_to_high_mask = 0;
 #endif
 static uint32_t m_gpiote_low_to_high_mask = 0;
 static uint32_t m_gpiote_high_to_low_mask = 0;
 #else
-#ifdef GEIGERX
-static uint32_t m_geiger0_low_to_high_mask[GPIO_COUNT] = {0};
-static uint32_t m_geiger1_low_to_high_mask[GPIO_COUNT] = {0};
-#endif
 #ifdef MOTIONX
 static uint32_t m_motion_low_to_high_mask[GPIO_COUNT] = {0};
 #endif
@@ -357,12 +349,6 @@ void motion_event() {
 #if defined(NSDKV10) || defined(NSDKV11) || defined(NSDKV121)
 
 void gpiote_event_handler (uint32_t event_pins_low_to_high, uint32_t event_pins_high_to_low) {
-#ifdef GEIGERX
-    if ((event_pins_low_to_high & m_geiger0_low_to_high_mask) != 0)
-        geiger0_event();
-    if ((event_pins_low_to_high & m_geiger1_low_to_high_mask) != 0)
-        geiger1_event();
-#endif
 #ifdef MOTIONX
     if ((event_pins_low_to_high & m_motion_low_to_high_mask) != 0)
         motion_event();
@@ -372,12 +358,6 @@ void gpiote_event_handler (uint32_t event_pins_low_to_high, uint32_t event_pins_
 #else
 
 void gpiote_event_handler (uint32_t const *event_pins_low_to_high, uint32_t const *event_pins_high_to_low) {
-#ifdef GEIGERX
-    if ((event_pins_low_to_high[0] & m_geiger0_low_to_high_mask[0]) != 0)
-        geiger0_event();
-    if ((event_pins_low_to_high[0] & m_geiger1_low_to_high_mask[0]) != 0)
-        geiger1_event();
-#endif
 #ifdef MOTIONX
     if ((event_pins_low_to_high[0] & m_motion_low_to_high_mask[0]) != 0)
         motion_event();
@@ -676,38 +656,23 @@ void gpio_init() {
 
     APP_GPIOTE_INIT(APP_GPIOTE_MAX_USERS);
 
-#if defined(NSDKV10) || defined(NSDKV11) || defined(NSDKV121)
+    // Geiger pulses are counted in hardware rather than by our handler
 #ifdef GEIGERX
-    m_geiger0_low_to_high_mask |= (1L << PIN_GEIGER0);
-    m_geiger1_low_to_high_mask |= (1L << PIN_GEIGER1);
-    m_gpiote_low_to_high_mask |= m_geiger0_low_to_high_mask | m_geiger1_low_to_high_mask;
+    geiger_init();
 #endif
+
+#if defined(NSDKV10) || defined(NSDKV11) || defined(NSDKV121)
 #ifdef MOTIONX
     m_motion_low_to_high_mask |= (1L << SENSE_PIN_MOTION);
     m_gpiote_low_to_high_mask |= m_motion_low_to_high_mask;
 #endif
 #else
-#ifdef GEIGERX
-    m_geiger0_low_to_high_mask[0] |= (1L << PIN_GEIGER0);
-    m_geiger1_low_to_high_mask[0] |= (1L << PIN_GEIGER1);
-    m_gpiote_low_to_high_mask[0] |= m_geiger0_low_to_high_mask[0] | m_geiger1_low_to_high_mask[0];
-#endif
 #ifdef MOTIONX
     m_motion_low_to_high_mask[0] |= (1L << SENSE_PIN_MOTION);
     m_gpiote_low_to_high_mask[0] |= m_motion_low_to_high_mask[0];
 #endif
 #endif
 
-#ifdef GEIGERX
-    nrf_gpio_cfg_input(PIN_GEIGER0,  NRF_GPIO_PIN_NOPULL);
-    nrf_gpio_cfg_input(PIN_GEIGER1,  NRF_GPIO_PIN_NOPULL);
-    nrf_gpio_cfg_sense_input(PIN_GEIGER0,
-                             NRF_GPIO_PIN_NOPULL,
-                             NRF_GPIO_PIN_SENSE_HIGH);
-    nrf_gpio_cfg_sense_input(PIN_GEIGER1,
-                             NRF_GPIO_PIN_NOPULL,
-                             NRF_GPIO_PIN_SENSE_HIGH);
-#endif
 #ifdef MOTIONX
     nrf_gpio_cfg_input(SENSE_PIN_MOTION,  NRF_GPIO_PIN_NOPULL);
     nrf_gpio_cfg_sense_input(SENSE_PIN_MOTION,
@@ -10,6 +10,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "debug.h"
 #include "config.h"
 #include "comm.h"
@@ -63,6 +64,24 @@
 #define COMM_LORA_SAVESTATERPL          COMM_STATE_DEVICE_START+27
 #define COMM_LORA_RESTORESTATERPL       COMM_STATE_DEVICE_START+28
 #define COMM_LORA_HWEUIDONE             COMM_STATE_DEVICE_START+29
+#define COMM_LORA_SETDRRPL              COMM_STATE_DEVICE_START+30
+#define COMM_LORA_TXSNRRPL              COMM_STATE_DEVICE_START+31
+
+// Replies recognized at the start of a line from the module
+#define LORA_RPL_OK                      1
+#define LORA_RPL_ACCEPTED                2
+#define LORA_RPL_BUSY                    3
+#define LORA_RPL_NO_FREE_CH              4
+#define LORA_RPL_DENIED                  5
+#define LORA_RPL_RN2483                  6
+#define LORA_RPL_RN2903                  7
+#define LORA_RPL_INVALID_PARAM           8
+#define LORA_RPL_RADIO_TX_OK             9
+#define LORA_RPL_MAC_TX_OK               10
+#define LORA_RPL_MAC_RX                  11
+#define LORA_RPL_MAC_ERR                 12
+#define LORA_RPL_RADIO_ERR               13
+#define LORA_RPL_RADIO_RX                14
 
 // Delay that Microchip appears to need in many reset-related circumstances
 #define MICROCHIP_LONG_DELAY_MS 1500
@@ -70,6 +89,24 @@
 // Command buffer
 static cmdbuf_t fromLora;
 
+// Replies, which MUST be kept sorted by text
+static const comm_reply_t loraReplies[] = {
+    {"accepted",        LORA_RPL_ACCEPTED},
+    {"busy",            LORA_RPL_BUSY},
+    {"denied",          LORA_RPL_DENIED},
+    {"invalid_param",   LORA_RPL_INVALID_PARAM},
+    {"mac_err",         LORA_RPL_MAC_ERR},
+    {"mac_rx",          LORA_RPL_MAC_RX},
+    {"mac_tx_ok",       LORA_RPL_MAC_TX_OK},
+    {"no_free_ch",      LORA_RPL_NO_FREE_CH},
+    {"ok",              LORA_RPL_OK},
+    {"radio_err",       LORA_RPL_RADIO_ERR},
+    {"radio_rx",        LORA_RPL_RADIO_RX},
+    {"radio_tx_ok",     LORA_RPL_RADIO_TX_OK},
+    {"rn2483",          LORA_RPL_RN2483},
+    {"rn2903",          LORA_RPL_RN2903},
+};
+
 // LoRa vs LoRaWAN state and primary modes
 static bool LoRaWAN_mode = false;
 static bool LoRaWAN_mode_desired_after_reset = false;
@@ -112,6 +149,29 @@ static uint16_t toRelayBufferLength;
 static uint32_t toRelayDevice;
 static int toRelaySNR;
 
+// Airtime that we've used, summed into bins so that it can be totalled over a sliding window
+#define AIRTIME_BINS 24
+typedef struct {
+    uint32_t bin_seconds;
+    uint32_t bin_began;
+    uint16_t bin;
+    uint32_t ms[AIRTIME_BINS];
+} airtime_window_t;
+static airtime_window_t airtime_hour = { LORA_DUTY_CYCLE_WINDOW_SECONDS/AIRTIME_BINS };
+static airtime_window_t airtime_day = { (24*60*60)/AIRTIME_BINS };
+static uint32_t airtime_deferred = 0;
+
+// LoRaWAN spreading factor adaptation
+static uint8_t lorawanSF = 0;
+static bool lorawanSFChangePending = false;
+static bool lorawanSNRValid = false;
+static uint16_t lorawanSFSamples = 0;
+static uint16_t lorawanSFFailures = 0;
+static bool lorawanConfirmed = false;
+// A downlink held while the SNR at which it was received is fetched
+static bool downlinkPending = false;
+static char downlink_buffer[CMD_MAX_LINELENGTH + 1];
+
 // Get MTU
 uint16_t lora_get_mtu() {
 
@@ -123,6 +183,224 @@ uint16_t lora_get_mtu() {
     return(125);
 }
 
+// Index of the configured region in storage's per-region LoRaWAN history, or -1 if unknown
+static int lorawan_region() {
+    char *region = storage()->lpwan_region;
+    if (region[0] == 'e' && region[1] == 'u')
+        return LPWAN_REGION_EU;
+    if (region[0] == 'u' && region[1] == 's')
+        return LPWAN_REGION_US;
+    if (region[0] == 'a' && region[1] == 's')
+        return LPWAN_REGION_AS;
+    return -1;
+}
+
+static uint8_t lorawan_sf_max() {
+    if (lorawan_region() == LPWAN_REGION_US)
+        return LORAWAN_SF_MAX_US915;
+    return LORAWAN_SF_MAX;
+}
+
+// The LoRaWAN spreading factor in use, which starts out as whatever we last chose in this region
+static uint8_t lorawan_sf() {
+    int region;
+    if (lorawanSF == 0) {
+        lorawanSF = LORAWAN_SF_MIN;
+        region = lorawan_region();
+        if (region >= 0) {
+            uint8_t sf = storage()->lorawan_sf[region];
+            if (sf >= LORAWAN_SF_MIN && sf <= lorawan_sf_max()) {
+                lorawanSF = sf;
+                lorawanSNRValid = true;
+            }
+        }
+    }
+    return lorawanSF;
+}
+
+// Switch spreading factor, which is done by the module just before our next uplink
+static void lorawan_sf_set(uint8_t sf) {
+    int region = lorawan_region();
+    DEBUG_PRINTF("LoRaWAN SF%d -> SF%d\n", lorawan_sf(), sf);
+    lorawanSF = sf;
+    lorawanSFChangePending = true;
+    lorawanSFSamples = 0;
+    lorawanSFFailures = 0;
+    if (region >= 0) {
+        storage()->lorawan_sf[region] = sf;
+        storage_save(false);
+    }
+}
+
+// Margin, in quarters of a dB, by which a smoothed SNR (also in quarter dB) exceeds the
+// demodulation floor of a spreading factor, which is -7.5dB at SF7 and 2.5dB lower for
+// each step above it, plus the margin that we want to leave for fading.
+static int16_t lorawan_sf_margin(uint8_t sf, int8_t snr) {
+    int16_t floor = -30 - (10 * (sf - LORAWAN_SF_MIN));
+    return (snr - floor - (LORAWAN_SF_MARGIN_DB * 4));
+}
+
+// A confirmed uplink was acknowledged, with the SNR at which the gateway's reply was received
+static void lorawan_sf_acknowledged(bool fHaveSNR, int16_t snr) {
+    int region = lorawan_region();
+    uint8_t sf = lorawan_sf();
+    int8_t smoothed;
+    int16_t margin;
+
+    lorawanSFFailures = 0;
+    if (!fHaveSNR || region < 0)
+        return;
+
+    // Smooth it in quarter dB, which also fits the range of SNRs that we see into a byte
+    if (snr < -32)
+        snr = -32;
+    if (snr > 31)
+        snr = 31;
+    smoothed = snr * 4;
+    if (lorawanSNRValid) {
+        int16_t sum = (3 * storage()->lorawan_snr[region]) + (snr * 4);
+        smoothed = (sum >= 0) ? ((sum + 2) / 4) : -((2 - sum) / 4);
+    }
+    storage()->lorawan_snr[region] = smoothed;
+    lorawanSNRValid = true;
+    lorawanSFSamples++;
+
+    margin = lorawan_sf_margin(sf, smoothed);
+    if (margin < 0 && sf < lorawan_sf_max())
+        lorawan_sf_set(sf+1);
+    else if (lorawanSFSamples >= LORAWAN_SF_SAMPLES && sf > LORAWAN_SF_MIN
+             && margin >= (10 + (LORAWAN_SF_HYSTERESIS_DB * 4)))
+        lorawan_sf_set(sf-1);
+
+}
+
+// A confirmed uplink went unacknowledged
+static void lorawan_sf_unacknowledged() {
+    uint8_t sf = lorawan_sf();
+    if (++lorawanSFFailures >= LORAWAN_SF_FAILURES && sf < lorawan_sf_max())
+        lorawan_sf_set(sf+1);
+}
+
+// Time-on-air of an uplink, as computed by trackAirtime() in ttn.cpp for explicit header,
+// CR 4/5, CRC on, and an 8-symbol preamble.  In point-to-point mode we use the module's
+// default SF12 because we never change it, and in LoRaWAN mode the SF that we've chosen,
+// adding the 13 bytes of LoRaWAN MAC header and MIC that surround our payload.
+uint32_t lora_airtime_ms(uint16_t length) {
+    int32_t sf = 12;
+    int32_t bw = 125;
+    int32_t de, bits, symbols;
+    uint32_t tsym_us;
+
+    if (LoRaWAN_mode) {
+        sf = lorawan_sf();
+        length += 13;
+    }
+    de = (sf >= 11 && bw == 125) ? 1 : 0;
+    tsym_us = ((uint32_t) 1000 << sf) / bw;
+
+    bits = 8 * length - 4 * sf + 28 + 16;
+    symbols = 0;
+    if (bits > 0)
+        symbols = (bits + 4 * (sf - 2 * de) - 1) / (4 * (sf - 2 * de));
+    symbols = 8 + symbols * 5;
+
+    // Add the preamble of 8 + 4.25 symbols, computing in quarter-symbols
+    return (((49 + (uint32_t) symbols * 4) * tsym_us) / 4000);
+
+}
+
+// Discard airtime that has aged out of the window
+static void airtime_advance(airtime_window_t *w) {
+    uint32_t now = get_seconds_since_boot();
+    if ((now - w->bin_began) >= (AIRTIME_BINS * w->bin_seconds)) {
+        memset(w->ms, 0, sizeof(w->ms));
+        w->bin_began = now;
+        return;
+    }
+    while ((now - w->bin_began) >= w->bin_seconds) {
+        w->bin = (w->bin + 1) % AIRTIME_BINS;
+        w->ms[w->bin] = 0;
+        w->bin_began += w->bin_seconds;
+    }
+}
+
+static uint32_t airtime_used(airtime_window_t *w) {
+    uint32_t i, total = 0;
+    airtime_advance(w);
+    for (i=0; i<AIRTIME_BINS; i++)
+        total += w->ms[i];
+    return total;
+}
+
+// The airtime allowed within an hour by the duty cycle, or 0 if it isn't limited.  The RN2903
+// in the US915 band is limited by dwell time rather than duty cycle.  In LoRaWAN mode the module
+// chooses among channels in more than one sub-band, and so we budget as though they were one.
+static uint32_t airtime_hour_budget() {
+    if (isRN2903 || storage()->lpwan_region[0] == 'u')
+        return 0;
+    return (LORA_DUTY_CYCLE_WINDOW_SECONDS * 10 * LORA_DUTY_CYCLE_PERCENT);
+}
+
+// The airtime allowed per day by TTN's fair use policy, which doesn't apply to our own gateways
+static uint32_t airtime_day_budget() {
+    if (!LoRaWAN_mode)
+        return 0;
+    return (TTN_FAIR_USE_SECONDS_PER_DAY * 1000);
+}
+
+static bool airtime_within(airtime_window_t *w, uint32_t budget, uint32_t ms, bool fDeferrable) {
+    if (budget == 0)
+        return true;
+    if (fDeferrable)
+        budget = (budget * LORA_AIRTIME_DEFERRABLE_PERCENT) / 100;
+    return ((airtime_used(w) + ms) <= budget);
+}
+
+// See if a message of the given length may be sent without exceeding our airtime budgets
+bool lora_airtime_available(uint16_t length, bool fDeferrable) {
+    uint32_t ms = lora_airtime_ms(length);
+    return (airtime_within(&airtime_hour, airtime_hour_budget(), ms, fDeferrable)
+            && airtime_within(&airtime_day, airtime_day_budget(), ms, fDeferrable));
+}
+
+// The time at which more airtime next becomes available, when a window's oldest bin ages out
+uint32_t lora_airtime_available_at() {
+    if (!airtime_within(&airtime_day, airtime_day_budget(), 0, false))
+        return (airtime_day.bin_began + airtime_day.bin_seconds);
+    return (airtime_hour.bin_began + airtime_hour.bin_seconds);
+}
+
+static void airtime_record(uint16_t length) {
+    uint32_t ms = lora_airtime_ms(length);
+    airtime_advance(&airtime_hour);
+    airtime_hour.ms[airtime_hour.bin] += ms;
+    airtime_advance(&airtime_day);
+    airtime_day.ms[airtime_day.bin] += ms;
+}
+
+// Display airtime used against the budgets that apply
+void lora_airtime_show() {
+    uint32_t hour = airtime_used(&airtime_hour);
+    uint32_t day = airtime_used(&airtime_day);
+    char budget[32];
+    char buff[96];
+    if (airtime_hour_budget() == 0)
+        strcpy(budget, "unlimited");
+    else
+        sprintf(budget, "%lums", airtime_hour_budget());
+    if (LoRaWAN_mode)
+        sprintf(buff, "  LoRaWAN SF%d snr %d, airtime %lums/hr of %s", lorawan_sf(),
+                lorawan_region() < 0 ? 0 : storage()->lorawan_snr[lorawan_region()] / 4, hour, budget);
+    else
+        sprintf(buff, "  Lora airtime %lums/hr of %s", hour, budget);
+    if (airtime_day_budget() == 0)
+        sprintf(budget, ", %lums/day", day);
+    else
+        sprintf(budget, ", %lums/day of %lums", day, airtime_day_budget());
+    strlcat(buff, budget, sizeof(buff));
+    DEBUG_PRINTF("%s, %lu deferred\n", buff, airtime_deferred);
+}
+
 // Transmit the command to the LPWAN
 void lora_send(char *msg) {
 
@@ -195,6 +473,17 @@ bool thisargisL(char *what) {
     return (comm_cmdbuf_this_arg_is(&fromLora, what));
 }
 
+// Get the table of replies
+const comm_reply_t *lora_replies(uint16_t *count) {
+    *count = sizeof(loraReplies) / sizeof(loraReplies[0]);
+    return loraReplies;
+}
+
+// Check whether the command buffer begins with a specific reply, recognizing it once per line
+bool replyisL(uint16_t reply) {
+    return (comm_cmdbuf_reply(&fromLora, loraReplies, sizeof(loraReplies) / sizeof(loraReplies[0])) == reply);
+}
+
 // Set lorawan to the specified state
 void setstateL(uint16_t newstate) {
     comm_cmdbuf_set_state(&fromLora, newstate);
@@ -221,6 +510,21 @@ void processstateL(uint16_t newstate) {
     lora_process();
 }
 
+// If we've chosen a new spreading factor, switch to it before transmitting what's in
+// the deferred transmit buffer, which will be sent once the module has done so.
+static bool lorawan_sf_switch() {
+    char command[32];
+    if (!LoRaWAN_mode || !lorawanSFChangePending)
+        return false;
+    lorawanSFChangePending = false;
+    if (!lorafp_get_sf_command(storage()->lpwan_region, lorawan_sf(), command, sizeof(command)))
+        return false;
+    deferred_transmit = true;
+    lora_send(command);
+    setstateL(COMM_LORA_SETDRRPL);
+    return true;
+}
+
 // Process a transmit that was deferred because of a receive-in-progress
 bool sent_pending_outbound() {
     if (!deferred_transmit)
@@ -229,6 +533,8 @@ bool sent_pending_outbound() {
         DEBUG_PRINTF("Sleeping!\n");
         return(false);
     }
+    if (lorawan_sf_switch())
+        return true;
 #ifdef FLOWTRACE
     DEBUG_PRINTF("(I'm sending now.)\n");
 #endif
@@ -343,22 +649,18 @@ void process_rx(char *in) {
     }
 
     // Assign it a routing slot
-    if (!message.has_relay_device1) {
-        message.has_relay_device1 = true;
-        message.relay_device1 = thisDeviceID;
-    } else if (!message.has_relay_device2) {
-        message.has_relay_device2 = true;
-        message.relay_device2 = thisDeviceID;
-    } else if (!message.has_relay_device3) {
-        message.has_relay_device3 = true;
-        message.relay_device3 = thisDeviceID;
-    } else if (!message.has_relay_device4) {
-        message.has_relay_device4 = true;
-        message.relay_device4 = thisDeviceID;
-    } else if (!message.has_relay_device5) {
-        message.has_relay_device5 = true;
-        message.relay_device5 = thisDeviceID;
-    } else {
+    uint32_t relayTag;
+    if (!message.has_relay_device1)
+        relayTag = ttproto_Telecast_relay_device1_tag;
+    else if (!message.has_relay_device2)
+        relayTag = ttproto_Telecast_relay_device2_tag;
+    else if (!message.has_relay_device3)
+        relayTag = ttproto_Telecast_relay_device3_tag;
+    else if (!message.has_relay_device4)
+        relayTag = ttproto_Telecast_relay_device4_tag;
+    else if (!message.has_relay_device5)
+        relayTag = ttproto_Telecast_relay_device5_tag;
+    else {
         // If no slots left, relay no further.
         DEBUG_PRINTF("RELAY: too many hops\n");
         comm_cmdbuf_reset(&fromLora);
@@ -366,16 +668,20 @@ void process_rx(char *in) {
         return;
     }
 
-    // Encode the PB to be transmitted
-    pb_ostream_t stream = pb_ostream_from_buffer(toRelayBuffer, sizeof(toRelayBuffer));
-    uint16_t status = pb_encode(&stream, ttproto_Telecast_fields, &message);
-    if (!status) {
+    // Relay the PB exactly as it was received, with our routing slot appended.  Appending
+    // a field is equivalent to having encoded it along with the others, and it retains
+    // the string fields that weren't kept when the message was decoded.
+    toRelayBufferLength = comm_received_pb(in, toRelayBuffer, sizeof(toRelayBuffer), NULL);
+    pb_ostream_t stream = pb_ostream_from_buffer(&toRelayBuffer[toRelayBufferLength], sizeof(toRelayBuffer) - toRelayBufferLength);
+    if (toRelayBufferLength == 0
+        || !pb_encode_tag(&stream, PB_WT_VARINT, relayTag)
+        || !pb_encode_varint(&stream, thisDeviceID)) {
         DEBUG_PRINTF("Relay pb_encode: %s\n", PB_GET_ERROR(&stream));
         comm_cmdbuf_reset(&fromLora);
         setidlestateL();
         return;
     }
-    toRelayBufferLength = stream.bytes_written;
+    toRelayBufferLength += stream.bytes_written;
     toRelayDevice = message.device_id;
 
     // Get the SNR of the received message, which will then relay it.
@@ -384,6 +690,26 @@ void process_rx(char *in) {
 
 }
 
+// Process a LoRaWAN downlink's payload, which is empty if there was nothing for us
+static void process_downlink(char *rxdata) {
+    if (rxdata[0] != '\0') {
+        process_rx(rxdata);
+        return;
+    }
+    // If we get an empty reply, try up to one more time
+    // to see if it happens to come back to us on that xmit
+    if (xmitReplyRetriesLeft > 0) {
+        int saveRetriesLeft = xmitReplyRetriesLeft;
+        setstateL(COMM_STATE_IDLE);
+        send_ping_to_service(REPLY_NONE);
+        // send_ping_to_service resets xmitReplyRetriesLeft, so
+        // here we restore and decrement it.
+        xmitReplyRetriesLeft = saveRetriesLeft - 1;
+    } else {
+        setidlestateL();
+    }
+}
+
 // Reset our watchdog timer
 void lora_watchdog_reset() {
     watchdog_set_time = get_seconds_since_boot();
@@ -465,6 +791,15 @@ bool lora_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
         return false;
     }
 
+    // Defer it if it would exceed our airtime budget, which would otherwise be enforced by
+    // the module with "no_free_ch" or by the network with a ban.
+    if (!lora_airtime_available(length, false)) {
+        airtime_deferred++;
+        if (debug(DBG_TX))
+            DEBUG_PRINTF("Lora airtime exhausted.\n");
+        return false;
+    }
+
     // Once every [N] minutes, even if this wasn't a request asking for a reply, force a RequestType so
     // that we give TTGATE an opportunity to send us a "down" message in case it can't reach the service.
     if (RequestType == REPLY_NONE)
@@ -488,6 +823,7 @@ bool lora_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
 
     // Do different types of transmit, based on mode.  Start by assuming no retries.
     xmitReplyRetriesLeft = 0;
+    lorawanConfirmed = LoRaWAN_mode && RequestType != REPLY_NONE;
     if (LoRaWAN_mode) {
         if (RequestType == REPLY_NONE) {
             command = "mac tx uncnf 1 ";
@@ -513,6 +849,7 @@ bool lora_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
 
     // Bump stats about what we've transmitted
     stats_io(length, 0);
+    airtime_record(length);
 
     // If we are sleeping/receiving, defer the xmit until it completes
     if (fromLora.state == COMM_LORA_RXRPL || fromLora.state == COMM_LORA_SLEEPRPL) {
@@ -520,7 +857,7 @@ bool lora_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType
 #ifdef FLOWTRACE
         DEBUG_PRINTF("(I'll send in a moment.)\n");
 #endif
-    } else {
+    } else if (!lorawan_sf_switch()) {
         deferred_transmit = false;
         lora_send(deferred_transmit_buffer);
         setstateL(COMM_LORA_TXRPL1);
@@ -603,7 +940,7 @@ void lora_reset(bool force) {
 
 // Request state for debugging
 void lora_request_state() {
-    DEBUG_PRINTF("Lora %s: st=%d cc=%d b=%d,%d,%d '%s'\n", comm_is_deselected() ? "disconnected" : "connected", fromLora.state, fromLora.complete, fromLora.busy_length, fromLora.busy_nextput, fromLora.busy_nextget, fromLora.buffer);
+    DEBUG_PRINTF("Lora %s: st=%d cc=%d b=%d,%d '%s'\n", comm_is_deselected() ? "disconnected" : "connected", fromLora.state, fromLora.complete, fromLora.busy.put, fromLora.busy.get, fromLora.buffer);
 }
 
 // One-time or per-oneshot init
@@ -712,17 +1049,17 @@ void lora_process() {
         // There may be garbage, so retry until we get in sync
         if (!loraInitEverCompleted)
             DEBUG_PRINTF("%s\n", &fromLora.buffer[fromLora.args]);
-        if (thisargisL("rn2483")) {
+        if (replyisL(LORA_RPL_RN2483)) {
             isRN2483 = true;
             strlcpy(stats()->module_lora, "RN2493", sizeof(stats()->module_lora)-1);
             if (s->lpwan_region[0] == '\0')
                 strlcpy(s->lpwan_region, "eu", sizeof(s->lpwan_region)-1);
-        } else if (thisargisL("rn2903")) {
+        } else if (replyisL(LORA_RPL_RN2903)) {
             isRN2903 = true;
             strlcpy(stats()->module_lora, "RN2903", sizeof(stats()->module_lora)-1);
             if (s->lpwan_region[0] == '\0')
                 strlcpy(s->lpwan_region, "us", sizeof(s->lpwan_region)-1);
-        } else if (thisargisL("invalid_param")) {
+        } else if (replyisL(LORA_RPL_INVALID_PARAM)) {
             // This is totally expected, as we are trying to re-sync
             lora_send("sys get ver");
             setstateL(COMM_LORA_GETVERRPL);
@@ -855,7 +1192,7 @@ void lora_process() {
     case COMM_LORA_SETWDTRPL: {
         STORAGE *s = storage();
         // Stay in the same state, sending frequency plan commands until there are none left for the region
-        if (lorafp_get_command(s->lpwan_region, false, lorafpRegionCommandNumber, buffer, sizeof(buffer))) {
+        if (lorafp_get_command(s->lpwan_region, false, 0, lorafpRegionCommandNumber, buffer, sizeof(buffer))) {
             lorafpRegionCommandNumber++;
             lora_send(buffer);
             setstateL(COMM_LORA_SETWDTRPL);
@@ -924,7 +1261,7 @@ void lora_process() {
         // Re-enabled 2017-05-05 after upgrading lorafp
         STORAGE *s = storage();
         // Stay in the same state, sending frequency plan commands until there are none left for the region
-        if (lorafp_get_command(s->lpwan_region, true, lorafpRegionCommandNumber, buffer, sizeof(buffer))) {
+        if (lorafp_get_command(s->lpwan_region, true, lorawan_sf(), lorafpRegionCommandNumber, buffer, sizeof(buffer))) {
             lorafpRegionCommandNumber++;
             lora_send(buffer);
             setstateL(COMM_LORA_SETAPPKEYRPL);
@@ -935,6 +1272,8 @@ void lora_process() {
         // fallthrough when no more commands to send
         // See https://www.microchip.com/forums/m945840.aspx#951895
     case COMM_LORA_SENDFPRPL: {
+        // The frequency plan included our spreading factor
+        lorawanSFChangePending = false;
         lora_send("mac set devaddr 00000000");
         setstateL(COMM_LORA_REJOIN1);
         break;
@@ -967,9 +1306,9 @@ void lora_process() {
     }
 
     case COMM_LORA_RESTORESTATERPL: {
-        if (thisargisL("ok")) {
+        if (replyisL(LORA_RPL_OK)) {
             setstateL(COMM_LORA_RESTORESTATERPL);
-        } else if (thisargisL("accepted")) {
+        } else if (replyisL(LORA_RPL_ACCEPTED)) {
             processstateL(COMM_LORA_INITCOMPLETED);
         } else {
             processstateL(COMM_LORA_RESETREQ);
@@ -988,23 +1327,23 @@ void lora_process() {
 
     case COMM_LORA_JOINRPL: {
         bool fRetry = false;
-        if (thisargisL("ok")) {
+        if (replyisL(LORA_RPL_OK)) {
             // this is expected response from initiating the rcv,
             // so just reset the buffer and keep waiting for a message to come in
             setstateL(COMM_LORA_JOINRPL);
-        } else if (thisargisL("accepted")) {
+        } else if (replyisL(LORA_RPL_ACCEPTED)) {
             stats()->joins++;
             stats()->joins_today++;
             processstateL(COMM_LORA_INITCOMPLETED);
-        } else if (thisargisL("busy")) {
+        } else if (replyisL(LORA_RPL_BUSY)) {
             DEBUG_PRINTF("Join busy, retrying.\n");
             // This is not at all expected, but it means that we're
             // moving too quickly and we should try again.
             fRetry = true;
-        } else if (thisargisL("no_free_ch")) {
+        } else if (replyisL(LORA_RPL_NO_FREE_CH)) {
             DEBUG_PRINTF("No free channel on join, retrying.\n");
             fRetry = true;
-        } else if (thisargisL("denied")) {
+        } else if (replyisL(LORA_RPL_DENIED)) {
             DEBUG_PRINTF("Join denied, retrying.\n");
             stats()->denies++;
             stats()->denies_today++;
@@ -1097,41 +1436,64 @@ void lora_process() {
     }
 
     case  COMM_LORA_TXRPL1: {
-        if (thisargisL("ok"))
+        if (replyisL(LORA_RPL_OK))
             setstateL(COMM_LORA_TXRPL2);
         else
             setidlestateL();
         break;
     }
 
-    case  COMM_LORA_TXRPL2: {
-        if (thisargisL("radio_tx_ok") || thisargisL("mac_tx_ok")) {
+    case COMM_LORA_SETDRRPL: {
+        if (!replyisL(LORA_RPL_OK))
+            DEBUG_PRINTF("Set SF: %s\n", &fromLora.buffer[fromLora.args]);
+        setstateL(COMM_STATE_IDLE);
+        if (!sent_pending_outbound())
             setidlestateL();
-        } else if (thisargisL("mac_rx")) {
-            comm_cmdbuf_next_arg(&fromLora);
-            // skip mac_rx
-            thisargisL("*");
-            comm_cmdbuf_next_arg(&fromLora);
-            // skip port#
-            thisargisL("*");
-            char *rxdata = comm_cmdbuf_next_arg(&fromLora);
-            if (rxdata[0] != '\0') {
-                process_rx(rxdata);
-            } else {
-                // If we get an empty reply, try up to one more time
-                // to see if it happens to come back to us on that xmit
-                if (xmitReplyRetriesLeft > 0) {
-                    int saveRetriesLeft = xmitReplyRetriesLeft;
-                    setstateL(COMM_STATE_IDLE);
-                    send_ping_to_service(REPLY_NONE);
-                    // send_ping_to_service resets xmitReplyRetriesLeft, so
-                    // here we restore and decrement it.
-                    xmitReplyRetriesLeft = saveRetriesLeft - 1;
-                } else {
-                    setidlestateL();
-                }
-            }
+        break;
+    }
+
+    case COMM_LORA_TXSNRRPL: {
+        char *snr = (char *) &fromLora.buffer[fromLora.args];
+        lorawan_sf_acknowledged(snr[0] == '-' || (snr[0] >= '0' && snr[0] <= '9'), atoi(snr));
+        if (downlinkPending) {
+            downlinkPending = false;
+            process_downlink(downlink_buffer);
+            if (loraInitEverCompleted && !awaitingTTServeReply)
+                comm_oneshot_completed();
+        } else
+            setidlestateL();
+        break;
+    }
+
+    case  COMM_LORA_TXRPL2: {
+        if (replyisL(LORA_RPL_RADIO_TX_OK) || replyisL(LORA_RPL_MAC_TX_OK)) {
+            comm_send_delivered();
+            // The acknowledgement of a confirmed uplink tells us how well the gateway hears us
+            if (lorawanConfirmed) {
+                lorawanConfirmed = false;
+                lora_send("radio get snr");
+                setstateL(COMM_LORA_TXSNRRPL);
+            } else
+                setidlestateL();
+        } else if (replyisL(LORA_RPL_MAC_RX)) {
+            // A downlink in the receive window means that the uplink arrived
+            comm_send_delivered();
+            // the data follows the port#
+            char *rxdata = comm_cmdbuf_reply_arg(&fromLora, 1);
+            // The downlink is the acknowledgement of a confirmed uplink, so find out how well it
+            // was heard before the radio receives anything else, and process it afterward
+            if (lorawanConfirmed) {
+                lorawanConfirmed = false;
+                strlcpy(downlink_buffer, rxdata, sizeof(downlink_buffer));
+                downlinkPending = true;
+                lora_send("radio get snr");
+                setstateL(COMM_LORA_TXSNRRPL);
+            } else
+                process_downlink(rxdata);
         } else {
+            if (lorawanConfirmed && replyisL(LORA_RPL_MAC_ERR))
+                lorawan_sf_unacknowledged();
+            lorawanConfirmed = false;
             DEBUG_PRINTF("tx2 reply ?? %s\n", &fromLora.buffer[fromLora.args]);
             // Record this as an error because it means that something the caller
             // thought was transmitted silently got dropped.
@@ -1144,11 +1506,11 @@ void lora_process() {
     }
 
     case COMM_LORA_RXRPL: {
-        if (thisargisL("ok")) {
+        if (replyisL(LORA_RPL_OK)) {
             // this is expected response from initiating the rcv,
             // so just reset the buffer and keep waiting for a message to come in
             setstateL(COMM_LORA_RXRPL);
-        } else if (thisargisL("radio_err")) {
+        } else if (replyisL(LORA_RPL_RADIO_ERR)) {
             // Re-enable serial output now that it's safe to do so
             serial_transmit_enable(true);
             // We're done waiting for reply
@@ -1183,14 +1545,14 @@ void lora_process() {
                 if (!sent_pending_outbound())
                     restart_receive();
             }
-        } else if (thisargisL("busy")) {
+        } else if (replyisL(LORA_RPL_BUSY)) {
             // Re-enable serial output now that it's safe to do so
             serial_transmit_enable(true);
             // This is not at all expected, but it means that we're
             // moving too quickly and we should try again.
             nrf_delay_ms(MICROCHIP_LONG_DELAY_MS);
             restart_receive();
-        } else if (thisargisL("radio_rx")) {
+        } else if (replyisL(LORA_RPL_RADIO_RX)) {
             // Re-enable serial output now that it's safe to do so
             serial_transmit_enable(true);
             comm_cmdbuf_next_arg(&fromLora);
@@ -1217,7 +1579,7 @@ void lora_process() {
         // Ignore spurious OK that may come in after sleep reply;
         // see cmd_clear_lpwan_sleep_state for more info.
         // Also ignore the reply from a sys get ver
-        if (!thisargisL("ok"))
+        if (!replyisL(LORA_RPL_OK))
             if (fromLora.buffer[0] != 'R' && fromLora.buffer[0] != 'N')
                 DEBUG_PRINTF("lpwan ?? %s\n", &fromLora.buffer[fromLora.args]);
         setidlestateL();
@@ -20,6 +20,11 @@ bool lora_can_send_to_service();
 bool lora_send_to_service(uint8_t *buffer, uint16_t length, uint16_t RequestType);
 void lora_received_byte(uint8_t databyte);
 uint16_t lora_get_mtu();
+const comm_reply_t *lora_replies(uint16_t *count);
+uint32_t lora_airtime_ms(uint16_t length);
+bool lora_airtime_available(uint16_t length, bool fDeferrable);
+uint32_t lora_airtime_available_at();
+void lora_airtime_show();
 
 #endif // LORA
 #endif // COMM_LORA_H__
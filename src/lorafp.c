@@ -56,6 +56,25 @@ static char *pBuffer;
 static uint16_t BufferLeft;
 static uint16_t BufferNeeded;
 
+// The LoRaWAN frequency plan commands for the most recently requested region, generated
+// once and then indexed directly, rather than re-running the TTN code for every command.
+// The "mac set " that begins every one of them isn't stored.  US915 is the largest plan.
+#define CACHE_PREFIX "mac set "
+#ifndef CACHE_COMMANDS
+#define CACHE_COMMANDS 96
+#endif
+#ifndef CACHE_BYTES
+#define CACHE_BYTES 1536
+#endif
+static bool cacheValid = false;
+static bool cacheOverflow;
+static uint8_t cacheFP;
+static uint16_t cacheCommands;
+static uint16_t cacheUsed;
+static uint16_t cacheStart;
+static uint16_t cacheOffset[CACHE_COMMANDS];
+static char cacheText[CACHE_BYTES];
+
 // Forwards
 void sendCommand(uint8_t table, uint8_t index, bool appendSpace);
 bool sendMacSet(uint8_t index, const char *value);
@@ -694,29 +713,126 @@ void modem_stream_print(uint8_t databyte, uint8_t format) {
     out[0] = 
     out[2] = '\0';
     HexChars(databyte, &out[0], &out[1]);
-    modem_stream_write(out);
+    modemStream->write(out);
 }
 
-// This is the only function exposed by this method.  The semantic is such that
-// the caller requests "command #N" that needs to be sent to the device.
-bool lorafp_get_command(char *region, bool loraWAN, uint16_t cmdno, char *buffer, uint16_t length) {
-    uint8_t sf = TTN_DEFAULT_SF;
-    uint8_t fsb = TTN_DEFAULT_FSB;
-    enum ttn_fp_t fp;
+// Emulation that appends every command to the cache, rather than capturing just one
+void modem_stream_record(const char *str) {
+    uint16_t len, prefix;
+    if (cacheOverflow)
+        return;
+    // Terminate the command, dropping the prefix that they all share
+    if (str[0] == SEND_MSG[0] && str[1] == SEND_MSG[1] && str[2] == SEND_MSG[2]) {
+        prefix = strlen(CACHE_PREFIX);
+        len = cacheUsed - cacheStart;
+        if (cacheCommands >= CACHE_COMMANDS || cacheUsed >= CACHE_BYTES) {
+            cacheOverflow = true;
+            return;
+        }
+        if (len >= prefix && memcmp(&cacheText[cacheStart], CACHE_PREFIX, prefix) == 0) {
+            memmove(&cacheText[cacheStart], &cacheText[cacheStart+prefix], len-prefix);
+            cacheUsed -= prefix;
+        }
+        cacheText[cacheUsed++] = '\0';
+        cacheOffset[cacheCommands++] = cacheStart;
+        cacheStart = cacheUsed;
+        return;
+    }
+    len = strlen(str);
+    if (cacheUsed + len >= CACHE_BYTES) {
+        cacheOverflow = true;
+        return;
+    }
+    memcpy(&cacheText[cacheUsed], str, len);
+    cacheUsed += len;
+}
 
-    // Convert from textual to internal TTN region codes
+// Convert from textual to internal TTN region codes
+static bool lorafp_region(char *region, enum ttn_fp_t *fp) {
     if (region[2] != '\0')
         return false;
     char ch0 = tolower((int)region[0]);
     char ch1 = tolower((int)region[1]);
     if (ch0 == 'e' && ch1 == 'u')
-        fp = TTN_FP_EU868;
+        *fp = TTN_FP_EU868;
     else if (ch0 == 'u' && ch1 == 's')
-        fp = TTN_FP_US915;
+        *fp = TTN_FP_US915;
     else if (ch0 == 'a' && ch1 == 's')
-        fp = TTN_FP_AS920_923;
+        *fp = TTN_FP_AS920_923;
     else
         return false;
+    return true;
+}
+
+// Set up the emulated modem stream so that it captures command #N
+static void lorafp_capture(uint16_t cmdno, char *buffer, uint16_t length) {
+    thiscmdno = 0;
+    targetcmdno = cmdno;
+    targetcmdfound = false;
+    pBuffer = buffer;
+    BufferLeft = length - 1;
+    BufferNeeded = 0;
+    *pBuffer = '\0';
+    modem.available = modem_stream_available;
+    modem.read = modem_stream_read;
+    modem.write = modem_stream_write;
+    modem.print = modem_stream_print;
+    modemStream = &modem;
+}
+
+// Generate the region's frequency plan into the cache, if it isn't already there, and
+// remember if it didn't fit so that it isn't generated again just to find that out
+static bool lorafp_cache(enum ttn_fp_t fp) {
+
+    if (cacheFP == fp && (cacheValid || cacheOverflow))
+        return cacheValid;
+
+    cacheFP = fp;
+    cacheValid = false;
+    cacheOverflow = false;
+    cacheCommands = 0;
+    cacheUsed = 0;
+    cacheStart = 0;
+    modem.available = modem_stream_available;
+    modem.read = modem_stream_read;
+    modem.write = modem_stream_record;
+    modem.print = modem_stream_print;
+    modemStream = &modem;
+    configureChannels(fp, TTN_DEFAULT_FSB);
+
+    if (cacheOverflow) {
+        DEBUG_PRINTF("WARNING: LORAFP cache too small for region %d\n", fp);
+        return false;
+    }
+
+    cacheValid = true;
+    return true;
+
+}
+
+// The command that sets the LoRaWAN data rate for a spreading factor in the region
+bool lorafp_get_sf_command(char *region, uint8_t sf, char *buffer, uint16_t length) {
+    enum ttn_fp_t fp;
+
+    if (!lorafp_region(region, &fp))
+        return false;
+
+    lorafp_capture(0, buffer, length);
+    setSF(fp, sf);
+
+    return targetcmdfound;
+}
+
+// This is the only function exposed by this method.  The semantic is such that
+// the caller requests "command #N" that needs to be sent to the device.  An sf
+// of 0 requests TTN's default spreading factor.
+bool lorafp_get_command(char *region, bool loraWAN, uint8_t sf, uint16_t cmdno, char *buffer, uint16_t length) {
+    enum ttn_fp_t fp;
+
+    if (!lorafp_region(region, &fp))
+        return false;
+    if (sf == 0)
+        sf = TTN_DEFAULT_SF;
 
     // Process Lora mode
     if (!loraWAN) {
@@ -766,22 +882,23 @@ bool lorafp_get_command(char *region, bool loraWAN, uint16_t cmdno, char *buffer
         return false;;
     }
 
-    // Set up for parsing
-    thiscmdno = 0;
-    targetcmdno = cmdno;
-    targetcmdfound = false;
-    pBuffer = buffer;
-    BufferLeft = length - 1;
-    BufferNeeded = 0;
-    *pBuffer = '\0';
-    modem.available = modem_stream_available;
-    modem.read = modem_stream_read;
-    modem.write = modem_stream_write;
-    modem.print = modem_stream_print;
-    modemStream = &modem;
+    // Fetch the command from the region's cached plan, the last being the data rate
+    if (lorafp_cache(fp)) {
+        if (cmdno > cacheCommands)
+            return false;
+        if (cmdno == cacheCommands)
+            return lorafp_get_sf_command(region, sf, buffer, length);
+        if (strlcpy(buffer, CACHE_PREFIX, length) >= length
+            || strlcat(buffer, &cacheText[cacheOffset[cmdno]], length) >= length)
+            DEBUG_PRINTF("WARNING: LORAFP buffer length==%d\n", length);
+        return true;
+    }
+
+    // If the plan didn't fit, generate the whole thing just to capture command #N
+    lorafp_capture(cmdno, buffer, length);
 
     // Call the TTN method to configure channels
-    configureChannels(fp, fsb);
+    configureChannels(fp, TTN_DEFAULT_FSB);
     setSF(fp, sf);
 
     if (BufferLeft == 0)
@@ -6,7 +6,8 @@
 #define LORAFP_H__
 #ifdef LORA
 
-bool lorafp_get_command(char *region, bool loraWAN, uint16_t cmdno, char *buffer, uint16_t length);
+bool lorafp_get_command(char *region, bool loraWAN, uint8_t sf, uint16_t cmdno, char *buffer, uint16_t length);
+bool lorafp_get_sf_command(char *region, uint8_t sf, char *buffer, uint16_t length);
 
 #endif // LORA
 #endif // LORAFP_H__
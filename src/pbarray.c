@@ -0,0 +1,135 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Encoding and decoding of the headers of buffered arrays of protocol buffers.  This has
+// no dependencies upon the rest of the firmware so that the very same code may be used
+// by a receiver.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "send.h"
+#include "pbarray.h"
+
+// Bytes needed for a varint, which are those of protocol buffers
+uint16_t pbarray_varint_size(uint32_t value) {
+    uint16_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+uint16_t pbarray_put_varint(uint8_t *p, uint32_t value) {
+    uint16_t length = 0;
+    while (value >= 0x80) {
+        p[length++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    p[length++] = (uint8_t) value;
+    return length;
+}
+
+bool pbarray_get_varint(uint8_t *frame, uint16_t length, uint16_t *offset, uint32_t *value) {
+    uint8_t shift;
+    *value = 0;
+    for (shift = 0; shift < 7*PBARRAY_VARINT_MAX; shift += 7) {
+        if (*offset >= length)
+            return false;
+        *value |= (uint32_t) (frame[*offset] & 0x7f) << shift;
+        if ((frame[(*offset)++] & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// See whether an array must be sent in the varint format
+bool pbarray_needs_varint(uint32_t count, uint32_t max_length) {
+    return (count > PBARRAY_BYTE_MAX || max_length > PBARRAY_BYTE_MAX);
+}
+
+// The size of the header of an array, given the total size of its lengths as varints
+uint16_t pbarray_header_size(uint16_t count, uint16_t varint_length_bytes, bool fVarint) {
+    if (fVarint)
+        return (1 + pbarray_varint_size(count) + varint_length_bytes);
+    return (2 + count);
+}
+
+// Begin a header with its format and count, returning the bytes written
+uint16_t pbarray_put_count(uint8_t *p, uint16_t count, bool fVarint) {
+    if (fVarint) {
+        p[0] = BUFF_FORMAT_PB_VARINT_ARRAY;
+        return (1 + pbarray_put_varint(&p[1], count));
+    }
+    p[0] = BUFF_FORMAT_PB_ARRAY;
+    p[1] = (uint8_t) count;
+    return 2;
+}
+
+// Append the length of the next message to a header, returning the bytes written
+uint16_t pbarray_put_length(uint8_t *p, uint16_t length, bool fVarint) {
+    if (fVarint)
+        return (pbarray_put_varint(p, length));
+    p[0] = (uint8_t) length;
+    return 1;
+}
+
+// Begin reading the messages from an array in either format, validating its header.
+// As has always been the case, anything following the last message is ignored.
+bool pbarray_begin(pbarray_reader_t *r, uint8_t *frame, uint16_t length) {
+    uint16_t i, offset;
+    uint32_t value, data = 0;
+
+    r->frame = frame;
+    r->length = length;
+    r->index = 0;
+
+    if (length < 2)
+        return false;
+
+    if (frame[0] == BUFF_FORMAT_PB_ARRAY) {
+        r->count = frame[1];
+        r->header = 2;
+        offset = r->header + r->count;
+        if (offset > length)
+            return false;
+        for (i=0; i<r->count; i++)
+            data += frame[r->header + i];
+    } else if (frame[0] == BUFF_FORMAT_PB_VARINT_ARRAY) {
+        offset = 1;
+        if (!pbarray_get_varint(frame, length, &offset, &value) || value > length)
+            return false;
+        r->count = (uint16_t) value;
+        r->header = offset;
+        for (i=0; i<r->count; i++) {
+            if (!pbarray_get_varint(frame, length, &offset, &value) || value > length)
+                return false;
+            data += value;
+        }
+    } else
+        return false;
+
+    // The messages begin after the last length
+    if (offset + data > length)
+        return false;
+    r->data = offset;
+    return true;
+}
+
+// Fetch the next message of the array, returning false when there are no more
+bool pbarray_next(pbarray_reader_t *r, uint8_t **message, uint16_t *message_length) {
+    uint32_t value;
+
+    if (r->index >= r->count)
+        return false;
+    if (r->frame[0] == BUFF_FORMAT_PB_ARRAY)
+        value = r->frame[r->header++];
+    else if (!pbarray_get_varint(r->frame, r->length, &r->header, &value))
+        return false;
+    *message = &r->frame[r->data];
+    *message_length = (uint16_t) value;
+    r->data += value;
+    r->index++;
+    return true;
+}
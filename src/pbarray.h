@@ -0,0 +1,36 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#ifndef PBARRAY_H__
+#define PBARRAY_H__
+
+// An array of protocol buffers begins with its format, the number of messages, and the
+// length of each message, followed by the concatenated messages.  BUFF_FORMAT_PB_ARRAY
+// has a byte for the count and for each length, limiting it to 255 messages of no more
+// than 255 bytes.  BUFF_FORMAT_PB_VARINT_ARRAY has varints instead, and so it is only
+// used when those limits would be exceeded, so that older services can still decode
+// everything else.
+#define PBARRAY_BYTE_MAX        255
+#define PBARRAY_VARINT_MAX      5
+
+typedef struct {
+    uint8_t *frame;
+    uint16_t length;
+    uint16_t count;
+    uint16_t index;
+    uint16_t header;
+    uint16_t data;
+} pbarray_reader_t;
+
+uint16_t pbarray_varint_size(uint32_t value);
+uint16_t pbarray_put_varint(uint8_t *p, uint32_t value);
+bool pbarray_get_varint(uint8_t *frame, uint16_t length, uint16_t *offset, uint32_t *value);
+bool pbarray_needs_varint(uint32_t count, uint32_t max_length);
+uint16_t pbarray_header_size(uint16_t count, uint16_t varint_length_bytes, bool fVarint);
+uint16_t pbarray_put_count(uint8_t *p, uint16_t count, bool fVarint);
+uint16_t pbarray_put_length(uint8_t *p, uint16_t length, bool fVarint);
+bool pbarray_begin(pbarray_reader_t *r, uint8_t *frame, uint16_t length);
+bool pbarray_next(pbarray_reader_t *r, uint8_t **message, uint16_t *message_length);
+
+#endif // PBARRAY_H__
@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "debug.h"
 #include "bt.h"
 #include "config.h"
@@ -16,6 +17,7 @@
 #include "send.h"
 #include "stats.h"
 #include "recv.h"
+#include "phone.h"
 #include "misc.h"
 #include "timer.h"
 #include "sensor.h"
@@ -41,789 +43,827 @@
 // Command buffer
 static cmdbuf_t fromPhone;
 
-// Process a "complete" command buffer, and if idle parse it to determine its first state
-void phone_complete() {
-
-    // If we're not in an idle state, let's not process commands for it
-    if (fromPhone.state != COMM_STATE_IDLE)
-        return;
-
-    for (;;) {
+// Pass the entire line, including its command, through to TTSERVE
+static void phone_pass_to_service() {
+    fromPhone.args = 0;
+    fromPhone.state = CMD_STATE_XMIT_PHONE_TEXT;
+}
 
-        // If it begins with a slash, transmit this oon the wire as a pb-formatted "text message"
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "/*")) {
-            // Skip to the actual text to be transmitted
-            comm_cmdbuf_next_arg(&fromPhone);
-            fromPhone.state = CMD_STATE_XMIT_PHONE_TEXT;
-            break;
-        }
+// Toggle a debug flag, displaying its new state
+static void phone_debug_toggle(uint32_t flag, char *what) {
+    DEBUG_PRINTF("%s toggled to %s\n", what, debug_flag_toggle(flag) ? "ON" : "OFF");
+}
 
-        // Process our hard-wired commands
+// Toggle a persistent configuration flag, displaying its new state
+static void phone_flag_toggle(uint32_t flag, char *what) {
+    STORAGE *f = storage();
+    f->flags ^= flag;
+    storage_save(true);
+    DEBUG_PRINTF("%s toggled to %s\n", what, (f->flags & flag) != 0 ? "ON" : "OFF");
+}
 
 #ifdef LORA
-        // Commands to be passed-through to the LPWAN chip - used for testing
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "sys") || comm_cmdbuf_this_arg_is(&fromPhone, "mac") || comm_cmdbuf_this_arg_is(&fromPhone, "radio")) {
-            // Convert to lowercase because the LPWAN chip requires this
-            int i;
-            for (i = 0; i < fromPhone.length; i++)
-                if (fromPhone.buffer[i] >= 'A' && fromPhone.buffer[i] <= 'Z')
-                    fromPhone.buffer[i] += 'a' - 'A';
-            // Enter command mode.  This may fail the first time because it's busy,
-            // but then after the next timeout we will be  in that state.
-            lora_enter_command_mode();
-            // Send to the LPWAN chip, even if it may fail because of the state we're in
-            lora_send((char *)&fromPhone.buffer[0]);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Commands to be passed-through to the LPWAN chip - used for testing
+static void phone_cmd_lpwan() {
+    // Convert to lowercase because the LPWAN chip requires this
+    int i;
+    for (i = 0; i < fromPhone.line.length; i++)
+        if (fromPhone.buffer[i] >= 'A' && fromPhone.buffer[i] <= 'Z')
+            fromPhone.buffer[i] += 'a' - 'A';
+    // Enter command mode.  This may fail the first time because it's busy,
+    // but then after the next timeout we will be  in that state.
+    lora_enter_command_mode();
+    // Send to the LPWAN chip, even if it may fail because of the state we're in
+    lora_send((char *)&fromPhone.buffer[0]);
+}
 #endif // LORA
 
-#ifdef FONA
-        // Commands to be passed-through to the chip - used for testing
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "at+*")) {
-            // Send to the chip, even if it may fail because of the state we're in
-            fona_send((char *)&fromPhone.buffer[0]);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-#endif
-
-        // Turn the display on or off
+// Turn the display on or off
 #ifdef SSD
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "ssd")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
-                ssd1306_init();
-            } else if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
-                ssd1306_term();
-            } else {
-                if (!ssd1306_active())
-                    DEBUG_PRINTF("ssd <on/off>\n");
-                else 
-                    ssd1306_reset_display();
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+static void phone_cmd_ssd() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
+        ssd1306_init();
+    } else if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
+        ssd1306_term();
+    } else {
+        if (!ssd1306_active())
+            DEBUG_PRINTF("ssd <on/off>\n");
+        else
+            ssd1306_reset_display();
+    }
+}
 #endif
 
-        // Battery level request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "bat")) {
-            if (sensor_group_schedule_now("g-basics")) {
-                DEBUG_PRINTF("Starting g-basics with max debugging enabled.\n");
-                debug_flags_set(DBG_SENSOR|DBG_SENSOR_MAX);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Battery level request
+static void phone_cmd_bat() {
+    if (sensor_group_schedule_now("g-basics")) {
+        DEBUG_PRINTF("Starting g-basics with max debugging enabled.\n");
+        debug_flags_set(DBG_SENSOR|DBG_SENSOR_MAX);
+    }
+}
 
-        // CPM measurement request
+// CPM measurement request
 #ifdef GEIGERX
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "rad") || comm_cmdbuf_this_arg_is(&fromPhone, "cpm") || comm_cmdbuf_this_arg_is(&fromPhone, "geiger")) {
-            if (sensor_group_schedule_now("g-geiger"))
-                DEBUG_PRINTF("Starting g-geiger\n");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+static void phone_cmd_geiger() {
+    if (sensor_group_schedule_now("g-geiger"))
+        DEBUG_PRINTF("Starting g-geiger\n");
+}
 #endif
 
-        // Toggle a mode that makes it appear that no sensors are enabled
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "dead")) {
-            uint16_t op_mode = sensor_op_mode();
-            if (op_mode != OPMODE_TEST_DEAD)
-                op_mode = OPMODE_TEST_DEAD;
-            else
-                op_mode = OPMODE_NORMAL;
-            sensor_set_op_mode(op_mode);
-            DEBUG_PRINTF("Sensor scheduling now %s\n", op_mode == OPMODE_NORMAL ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Toggle a mode that makes it appear that no sensors are enabled
+static void phone_cmd_dead() {
+    uint16_t op_mode = sensor_op_mode();
+    if (op_mode != OPMODE_TEST_DEAD)
+        op_mode = OPMODE_TEST_DEAD;
+    else
+        op_mode = OPMODE_NORMAL;
+    sensor_set_op_mode(op_mode);
+    DEBUG_PRINTF("Sensor scheduling now %s\n", op_mode == OPMODE_NORMAL ? "ON" : "OFF");
+}
 
-        // Force sensor scheduling now
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "q") || comm_cmdbuf_this_arg_is(&fromPhone, "sample") || comm_cmdbuf_this_arg_is(&fromPhone, "measure")) {
-            sensor_schedule_now();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Force sensor scheduling now
+static void phone_cmd_sample() {
+    sensor_schedule_now();
+}
 
-        // Flip the display
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "flip")) {
-            storage()->flags ^= FLAG_FLIP;
-            storage_save(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
+// Flip the display
+static void phone_cmd_flip() {
+    storage()->flags ^= FLAG_FLIP;
+    storage_save(true);
 #ifdef SSD
-            ssd1306_term();
-            ssd1306_init();
+    ssd1306_term();
+    ssd1306_init();
 #endif
-            DEBUG_PRINTF("Display flipped.\n");
-            break;
-        }
-        
-        // Force cellular to test failover behavior
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "fail")) {
-            comm_force_cell();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+    DEBUG_PRINTF("Display flipped.\n");
+}
+
+// Force cellular to test failover behavior
+static void phone_cmd_fail() {
+    comm_force_cell();
+}
 
-        // Force cellular
+// Force cellular
 #if defined(FONA)
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "fona")) {
-            comm_request_mode_on_reselect(COMM_FONA);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+static void phone_cmd_fona() {
+    comm_request_mode_on_reselect(COMM_FONA);
+}
 #endif
 
-        // Force lora
+// Force lora
 #if defined(LORA)
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "lora")) {
-            comm_request_mode_on_reselect(COMM_LORA);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+static void phone_cmd_lora() {
+    comm_request_mode_on_reselect(COMM_LORA);
+}
 #endif
 
-        // Cancel a pending WAN request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "none")) {
-            comm_request_mode_on_reselect(COMM_NONE);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Cancel a pending WAN request
+static void phone_cmd_none() {
+    comm_request_mode_on_reselect(COMM_NONE);
+}
 
-        // Comms Sensor State request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "ccc")) {
-            comm_show_state();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Comms Sensor State request
+static void phone_cmd_ccc() {
+    comm_show_state();
+}
 
-        // Show Sensor State request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "sss")) {
-            sensor_show_state(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Show Sensor State request
+static void phone_cmd_sss() {
+    sensor_show_state(true);
+}
 
-        // Cause GPS to have a forced update, simulating motion
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "gupdate") || comm_cmdbuf_this_arg_is(&fromPhone, "grefresh")) {
-            storage()->gps_latitude = storage()->gps_longitude = 0.0;
-            comm_gps_update();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Cause GPS to have a forced update, simulating motion
+static void phone_cmd_gupdate() {
+    storage()->gps_latitude = storage()->gps_longitude = 0.0;
+    comm_gps_update();
+}
 
-        // GPS "set to fake data" request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "gfake")) {
-            char buffer[256];
-            storage_set_gps_params_as_string("1/1/1");
-            storage_save(true);
-            storage_get_gps_params_as_string(buffer, sizeof(buffer));
-            DEBUG_PRINTF("Now %s\n", buffer);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// GPS "set to fake data" request
+static void phone_cmd_gfake() {
+    char buffer[256];
+    storage_set_gps_params_as_string("1/1/1");
+    storage_save(true);
+    storage_get_gps_params_as_string(buffer, sizeof(buffer));
+    DEBUG_PRINTF("Now %s\n", buffer);
+}
 
-        // GPS abort and go to "last known Good GPS"
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "glkg") || comm_cmdbuf_this_arg_is(&fromPhone, "gabort")) {
-            comm_gps_abort();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// GPS abort and go to "last known Good GPS"
+static void phone_cmd_gabort() {
+    comm_gps_abort();
+}
 
-        // GPS request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "gps")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            switch (fromPhone.buffer[fromPhone.args]) {
-            case '\0': {
-                float lat, lon, alt;
-                uint16_t status = comm_gps_get_value(&lat, &lon, &alt);
-                if (status == GPS_LOCATION_FULL)
-                    DEBUG_PRINTF("%.3f/%.3f/%.3f\n", lat, lon, alt);
-                else if (status == GPS_LOCATION_PARTIAL)
-                    DEBUG_PRINTF("%.3f/%.3f\n", lat, lon);
-                else if (status == GPS_NO_LOCATION)
-                    DEBUG_PRINTF("No location.\n");
-                else if (status == GPS_LOCATION_ABORTED)
-                    DEBUG_PRINTF("Location aborted.\n");
-                else
-                    DEBUG_PRINTF("No data.\n");
-                break;
-            }
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// GPS request
+static void phone_cmd_gps() {
+    float lat, lon, alt;
+    uint16_t status;
+    comm_cmdbuf_next_arg(&fromPhone);
+    if (fromPhone.buffer[fromPhone.args] != '\0')
+        return;
+    status = comm_gps_get_value(&lat, &lon, &alt);
+    if (status == GPS_LOCATION_FULL)
+        DEBUG_PRINTF("%.3f/%.3f/%.3f\n", lat, lon, alt);
+    else if (status == GPS_LOCATION_PARTIAL)
+        DEBUG_PRINTF("%.3f/%.3f\n", lat, lon);
+    else if (status == GPS_NO_LOCATION)
+        DEBUG_PRINTF("No location.\n");
+    else if (status == GPS_LOCATION_ABORTED)
+        DEBUG_PRINTF("Location aborted.\n");
+    else
+        DEBUG_PRINTF("No data.\n");
+}
 
-        // GPIO test request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "gpio")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            if (fromPhone.buffer[fromPhone.args] != '\0') {
-                uint16_t num = atoi((char *)&fromPhone.buffer[fromPhone.args]);
-                uint16_t pin = num/10;
-                bool fOn = ((num & 0x01) != 0);
-                gpio_power_set(pin, fOn);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// GPIO test request
+static void phone_cmd_gpio() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    if (fromPhone.buffer[fromPhone.args] != '\0') {
+        uint16_t num = atoi((char *)&fromPhone.buffer[fromPhone.args]);
+        uint16_t pin = num/10;
+        bool fOn = ((num & 0x01) != 0);
+        gpio_power_set(pin, fOn);
+    }
+}
 
-        // MTU test request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "mtu")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            if (fromPhone.buffer[fromPhone.args] != '\0') {
-                send_mtu_test(atoi((char *)&fromPhone.buffer[fromPhone.args]));
-                debug_flags_set(DBG_RX|DBG_TX);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// MTU test request, or MTU status if no length is given
+static void phone_cmd_mtu() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    if (fromPhone.buffer[fromPhone.args] != '\0') {
+        send_mtu_test(atoi((char *)&fromPhone.buffer[fromPhone.args]));
+        debug_flags_set(DBG_RX|DBG_TX);
+    } else {
+        mtu_status_check(true);
+    }
+}
 
-        // Temperature/Humidity request
+// Temperature/Humidity request
 #if defined(TWIHIH6130) || defined(TWIBME0)
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "temp") || comm_cmdbuf_this_arg_is(&fromPhone, "env")) {
-            float envTempC, envHumRH;
-            float envPress = 0.0;
+static void phone_cmd_env() {
+    float envTempC, envHumRH;
+    float envPress = 0.0;
 #ifdef TWIHIH6130
-            s_hih6130_get_value(&envTempC, &envHumRH);
+    s_hih6130_get_value(&envTempC, &envHumRH);
 #endif
 #ifdef TWIBME0
-            s_bme280_0_get_value(&envTempC, &envHumRH, &envPress);
+    s_bme280_0_get_value(&envTempC, &envHumRH, &envPress);
 #endif
-            DEBUG_PRINTF("%f degC, %f pctRH, %f Pa\n", envTempC, envHumRH, envPress);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+    DEBUG_PRINTF("%f degC, %f pctRH, %f Pa\n", envTempC, envHumRH, envPress);
+}
 #endif
 
-        // Request state
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "state")) {
-            comm_request_state();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Request state
+static void phone_cmd_state() {
+    comm_request_state();
+}
 
-        // Request statistics
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "comms") || comm_cmdbuf_this_arg_is(&fromPhone, "comm")) {
-            stats_status_check(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Request statistics
+static void phone_cmd_comms() {
+    stats_status_check(true);
+}
 
-        // Request statistics
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "stats")) {
-            comm_initiate_service_update(false);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Request statistics
+static void phone_cmd_stats() {
+    comm_initiate_service_update(false);
+}
 
-        // Request statistics
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "buff")) {
-            comm_would_be_buffered(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Request statistics
+static void phone_cmd_buff() {
+    comm_would_be_buffered(true);
+}
 
-        // Request full statistics
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "hello")) {
-            comm_initiate_service_update(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Request full statistics
+static void phone_cmd_hello() {
+    comm_initiate_service_update(true);
+}
 
-        // Soft reset request
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "reset")) {
-            comm_reset(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Soft reset request
+static void phone_cmd_reset() {
+    comm_reset(true);
+}
 
-        // Force us to drop everything power hungry and optimize power
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "drop")) {
-            io_force_optimize_power();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Force us to drop everything power hungry and optimize power
+static void phone_cmd_drop() {
+    io_force_optimize_power();
+}
 
-        // Turn off indicators, usually when measuring power
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "ind")) {
-            gpio_indicators_off();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Turn off indicators, usually when measuring power
+static void phone_cmd_ind() {
+    gpio_indicators_off();
+}
 
-        // Force us to drop gps
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "nogps")) {
+// Force us to drop gps
+static void phone_cmd_nogps() {
 #ifdef TWIUBLOXM8
-            s_gps_shutdown();
+    s_gps_shutdown();
 #endif
 #ifdef FONAGPS
-            fona_gps_shutdown();
+    fona_gps_shutdown();
 #endif
 #ifdef UGPS
-            s_ugps_shutdown();
+    s_ugps_shutdown();
 #endif
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+}
 
-        // Request to enable verbose LPWAN rx/tx logging
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "d")) {
-            char flags[40];
-            strcpy(flags, "");
-            if (debug(DBG_RX) && debug(DBG_TX))
-                strcat(flags, "C ");
-            else if (!debug(DBG_RX) && !debug(DBG_TX))
-                strcat(flags, "c ");
-            else {
-                strcat(flags, debug(DBG_RX) ? "RX " : "rx ");
-                strcat(flags, debug(DBG_TX) ? "TX " : "tx ");
-            }
-            strcat(flags, debug(DBG_COMM_MAX) ? "CX " : "cx ");
-            strcat(flags, debug(DBG_SENSOR) ? "S " : "s ");
-            strcat(flags, debug(DBG_SENSOR_MAX) ? "SX " : "sx ");
-            strcat(flags, debug(DBG_SENSOR_SUPERMAX) ? "SXX " : "sxx ");
-            strcat(flags, debug(DBG_SENSOR_SUPERDUPERMAX) ? "SXXX " : "sxxx ");
-            strcat(flags, debug(DBG_SENSOR_POLL) ? "SP " : "sp ");
-            strcat(flags, debug(DBG_GPS_MAX) ? "GX " : "gx ");
-            strcat(flags, debug(DBG_AIR) ? "A " : "a ");
-            strcat(flags, debug(DBG_BT) ? "B " : "b ");
-            DEBUG_PRINTF("DEBUG: %s\n", flags);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "0")) {
-            debug_flags_set(DBG_NONE);
-            DEBUG_PRINTF("ALL debug OFF\n");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "1")) {
-            debug_flags_set(DBG_COMMON);
-            DEBUG_PRINTF("Common debug ON\n");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "x")) {
-            debug_flags_set(DBG_COMMON|DBG_GPS_MAX|DBG_SENSOR_MAX|DBG_COMM_MAX);
-            DEBUG_PRINTF("ALL debug ON\n");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "rx")) {
-            DEBUG_PRINTF("RX toggled to %s\n", debug_flag_toggle(DBG_RX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "tx")) {
-            DEBUG_PRINTF("TX toggled to %s\n", debug_flag_toggle(DBG_TX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "c")) {
-            if (debug(DBG_RX) != debug(DBG_TX))
-                debug_flags_set(DBG_RX|DBG_TX);
-            DEBUG_PRINTF("COMM toggled to %s\n", debug_flag_toggle(DBG_RX|DBG_TX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cx")) {
-            DEBUG_PRINTF("COMMMAX toggled to %s\n", debug_flag_toggle(DBG_COMM_MAX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "a")) {
-            DEBUG_PRINTF("AIR toggled to %s\n", debug_flag_toggle(DBG_AIR) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "b")) {
-            DEBUG_PRINTF("BT debug toggled to %s\n", debug_flag_toggle(DBG_BT) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "s")) {
-            DEBUG_PRINTF("SENSOR toggled to %s\n", debug_flag_toggle(DBG_SENSOR) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "sx")) {
-            DEBUG_PRINTF("SENSORMAX toggled to %s\n", debug_flag_toggle(DBG_SENSOR_MAX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "sxx")) {
-            DEBUG_PRINTF("SENSORSUPERMAX toggled to %s\n", debug_flag_toggle(DBG_SENSOR_SUPERMAX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "sxxx")) {
-            DEBUG_PRINTF("SENSORSUPERDUPERMAX toggled to %s\n", debug_flag_toggle(DBG_SENSOR_SUPERDUPERMAX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "sp")) {
-            DEBUG_PRINTF("SENSORPOLL toggled to %s\n", debug_flag_toggle(DBG_SENSOR_POLL) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "g")) {
-            DEBUG_PRINTF("GPSMAX toggled to %s\n", debug_flag_toggle(DBG_GPS_MAX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "gx")) {
-            DEBUG_PRINTF("GPSMAX toggled to %s\n", debug_flag_toggle(DBG_GPS_MAX) ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Display debug flags
+static void phone_cmd_d() {
+    char flags[40];
+    strcpy(flags, "");
+    if (debug(DBG_RX) && debug(DBG_TX))
+        strcat(flags, "C ");
+    else if (!debug(DBG_RX) && !debug(DBG_TX))
+        strcat(flags, "c ");
+    else {
+        strcat(flags, debug(DBG_RX) ? "RX " : "rx ");
+        strcat(flags, debug(DBG_TX) ? "TX " : "tx ");
+    }
+    strcat(flags, debug(DBG_COMM_MAX) ? "CX " : "cx ");
+    strcat(flags, debug(DBG_SENSOR) ? "S " : "s ");
+    strcat(flags, debug(DBG_SENSOR_MAX) ? "SX " : "sx ");
+    strcat(flags, debug(DBG_SENSOR_SUPERMAX) ? "SXX " : "sxx ");
+    strcat(flags, debug(DBG_SENSOR_SUPERDUPERMAX) ? "SXXX " : "sxxx ");
+    strcat(flags, debug(DBG_SENSOR_POLL) ? "SP " : "sp ");
+    strcat(flags, debug(DBG_GPS_MAX) ? "GX " : "gx ");
+    strcat(flags, debug(DBG_AIR) ? "A " : "a ");
+    strcat(flags, debug(DBG_BT) ? "B " : "b ");
+    DEBUG_PRINTF("DEBUG: %s\n", flags);
+}
 
-        // Get version
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "ver")) {
-            DEBUG_PRINTF("%s\n", app_version());
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Debug flag settings
+static void phone_cmd_debug_off() {
+    debug_flags_set(DBG_NONE);
+    DEBUG_PRINTF("ALL debug OFF\n");
+}
+static void phone_cmd_debug_common() {
+    debug_flags_set(DBG_COMMON);
+    DEBUG_PRINTF("Common debug ON\n");
+}
+static void phone_cmd_debug_all() {
+    debug_flags_set(DBG_COMMON|DBG_GPS_MAX|DBG_SENSOR_MAX|DBG_COMM_MAX);
+    DEBUG_PRINTF("ALL debug ON\n");
+}
+static void phone_cmd_rx() {
+    phone_debug_toggle(DBG_RX, "RX");
+}
+static void phone_cmd_tx() {
+    phone_debug_toggle(DBG_TX, "TX");
+}
+static void phone_cmd_c() {
+    if (debug(DBG_RX) != debug(DBG_TX))
+        debug_flags_set(DBG_RX|DBG_TX);
+    phone_debug_toggle(DBG_RX|DBG_TX, "COMM");
+}
+static void phone_cmd_cx() {
+    phone_debug_toggle(DBG_COMM_MAX, "COMMMAX");
+}
+static void phone_cmd_a() {
+    phone_debug_toggle(DBG_AIR, "AIR");
+}
+static void phone_cmd_b() {
+    phone_debug_toggle(DBG_BT, "BT debug");
+}
+static void phone_cmd_s() {
+    phone_debug_toggle(DBG_SENSOR, "SENSOR");
+}
+static void phone_cmd_sx() {
+    phone_debug_toggle(DBG_SENSOR_MAX, "SENSORMAX");
+}
+static void phone_cmd_sxx() {
+    phone_debug_toggle(DBG_SENSOR_SUPERMAX, "SENSORSUPERMAX");
+}
+static void phone_cmd_sxxx() {
+    phone_debug_toggle(DBG_SENSOR_SUPERDUPERMAX, "SENSORSUPERDUPERMAX");
+}
+static void phone_cmd_sp() {
+    phone_debug_toggle(DBG_SENSOR_POLL, "SENSORPOLL");
+}
+static void phone_cmd_gx() {
+    phone_debug_toggle(DBG_GPS_MAX, "GPSMAX");
+}
 
-        // Set test mode
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "test") || comm_cmdbuf_this_arg_is(&fromPhone, "t")) {
-            // Abort GPS if we're still waiting, as a convenience
-            if (!comm_gps_completed())
-                storage_set_gps_params_as_string("1/1/1");
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                DEBUG_PRINTF("test <on/off> (now %s), or test <sensor-name>\n", sensor_op_mode() == OPMODE_TEST_FAST ? "ON" : "OFF");
-            } else {
-                if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
-                    sensor_test("");
-                    debug_flags_set(DBG_SENSOR|DBG_SENSOR_MAX);
-                    sensor_set_op_mode(OPMODE_TEST_FAST);
-                    DEBUG_PRINTF("Rapid-cycling test mode ON\n");
-                } else if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
-                    debug_flags_set(DBG_SENSOR_MAX|DBG_GPS_MAX);
-                    debug_flag_toggle(DBG_SENSOR_MAX);
-                    debug_flag_toggle(DBG_GPS_MAX);
-                    sensor_test("");
-                    DEBUG_PRINTF("Sensor test mode now disabled\n");
-                } else {
-                    debug_flags_set(DBG_SENSOR|DBG_SENSOR_MAX|DBG_GPS_MAX);
-                    sensor_test((char *)&fromPhone.buffer[fromPhone.args]);
-                }
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get version
+static void phone_cmd_ver() {
+    DEBUG_PRINTF("%s\n", app_version());
+}
 
-        // Set power debug mode
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "pwr")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                gpio_power_debug_mode(false, false);
-                DEBUG_PRINTF("Power debug mode turned OFF\n");
-            } else {
-                if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
-                    gpio_power_debug_mode(false, true);
-                    DEBUG_PRINTF("Power debug mode turned OFF - power will never be enabled\n");
-                } else if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
-                    gpio_power_debug_mode(true, false);
-                    DEBUG_PRINTF("Power debug mode turned on - power will never be disabled\n");
-                }
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
+// Set test mode
+static void phone_cmd_test() {
+    // Abort GPS if we're still waiting, as a convenience
+    if (!comm_gps_completed())
+        storage_set_gps_params_as_string("1/1/1");
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        DEBUG_PRINTF("test <on/off> (now %s), or test <sensor-name>\n", sensor_op_mode() == OPMODE_TEST_FAST ? "ON" : "OFF");
+    } else {
+        if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
+            sensor_test("");
+            debug_flags_set(DBG_SENSOR|DBG_SENSOR_MAX);
+            sensor_set_op_mode(OPMODE_TEST_FAST);
+            DEBUG_PRINTF("Rapid-cycling test mode ON\n");
+        } else if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
+            debug_flags_set(DBG_SENSOR_MAX|DBG_GPS_MAX);
+            debug_flag_toggle(DBG_SENSOR_MAX);
+            debug_flag_toggle(DBG_GPS_MAX);
+            sensor_test("");
+            DEBUG_PRINTF("Sensor test mode now disabled\n");
+        } else {
+            debug_flags_set(DBG_SENSOR|DBG_SENSOR_MAX|DBG_GPS_MAX);
+            sensor_test((char *)&fromPhone.buffer[fromPhone.args]);
         }
+    }
+}
 
-        // Set mobile mode
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "mobile")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                DEBUG_PRINTF("mobile <on/off> (now %s), or mobile <sample-period-secs>\n", sensor_op_mode() == OPMODE_MOBILE ? "ON" : "OFF");
-            } else {
-                if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
-                    sensor_set_op_mode(OPMODE_MOBILE);
-                    DEBUG_PRINTF("mobile now ON\n");
-                } else if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
-                    sensor_set_op_mode(OPMODE_NORMAL);
-                    DEBUG_PRINTF("mobile now OFF\n");
-                } else {
-                    uint16_t num = atoi((char *)&fromPhone.buffer[fromPhone.args]);
-                    sensor_set_mobile_upload_period(num);
-                }
-
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
+// Set power debug mode
+static void phone_cmd_pwr() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        gpio_power_debug_mode(false, false);
+        DEBUG_PRINTF("Power debug mode turned OFF\n");
+    } else {
+        if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
+            gpio_power_debug_mode(false, true);
+            DEBUG_PRINTF("Power debug mode turned OFF - power will never be enabled\n");
+        } else if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
+            gpio_power_debug_mode(true, false);
+            DEBUG_PRINTF("Power debug mode turned on - power will never be disabled\n");
         }
+    }
+}
 
-        // Set burn mode
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "burn")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                DEBUG_PRINTF("burn <on/off> (currently %s)\n", sensor_op_mode() == OPMODE_TEST_BURN ? "ON" : "OFF");
-            } else {
-                if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
-                    sensor_set_op_mode(OPMODE_TEST_BURN);
-                    DEBUG_PRINTF("burn now ON\n");
-                }
-                if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
-                    sensor_set_op_mode(OPMODE_NORMAL);
-                    DEBUG_PRINTF("burn now OFF\n");
-                }
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
+// Set mobile mode
+static void phone_cmd_mobile() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        DEBUG_PRINTF("mobile <on/off> (now %s), or mobile <sample-period-secs>\n", sensor_op_mode() == OPMODE_MOBILE ? "ON" : "OFF");
+    } else {
+        if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
+            sensor_set_op_mode(OPMODE_MOBILE);
+            DEBUG_PRINTF("mobile now ON\n");
+        } else if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
+            sensor_set_op_mode(OPMODE_NORMAL);
+            DEBUG_PRINTF("mobile now OFF\n");
+        } else {
+            uint16_t num = atoi((char *)&fromPhone.buffer[fromPhone.args]);
+            sensor_set_mobile_upload_period(num);
         }
 
-        // Set blink mode, so we can identify a specific device
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "blink") || comm_cmdbuf_this_arg_is(&fromPhone, "id")) {
-            gpio_indicate(INDICATE_BLINKY);
-            DEBUG_PRINTF("%lu LEDs are now flashing quickly.\n", io_get_device_address());
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+    }
+}
 
-        // Emulate what would happen if we got a service message directed at us
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "recv")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            recv_message_from_service((char *)&fromPhone.buffer[fromPhone.args]);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
+// Set burn mode
+static void phone_cmd_burn() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        DEBUG_PRINTF("burn <on/off> (currently %s)\n", sensor_op_mode() == OPMODE_TEST_BURN ? "ON" : "OFF");
+    } else {
+        if (comm_cmdbuf_this_arg_is(&fromPhone,"on")) {
+            sensor_set_op_mode(OPMODE_TEST_BURN);
+            DEBUG_PRINTF("burn now ON\n");
+        }
+        if (comm_cmdbuf_this_arg_is(&fromPhone,"off")) {
+            sensor_set_op_mode(OPMODE_NORMAL);
+            DEBUG_PRINTF("burn now OFF\n");
         }
+    }
+}
 
-        // Force an upload now, for debugging
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "upload")) {
-            comm_call_now();
-            DEBUG_PRINTF("Upload will be initiated ASAP\n");
-        }
+// Set blink mode, so we can identify a specific device
+static void phone_cmd_blink() {
+    gpio_indicate(INDICATE_BLINKY);
+    DEBUG_PRINTF("%lu LEDs are now flashing quickly.\n", io_get_device_address());
+}
 
-        // Shortcut to set to cell-only for testing
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "ct")) {
-            char buffer[256];
-            storage_set_device_params_as_string("cell");
-            storage_save(true);
-            storage_get_device_params_as_string(buffer, sizeof(buffer));
-            DEBUG_PRINTF("Now %s\n", buffer);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Emulate what would happen if we got a service message directed at us
+static void phone_cmd_recv() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    recv_message_from_service((char *)&fromPhone.buffer[fromPhone.args]);
+}
 
-        // Shortcut to set device to be a test device
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "dt")) {
-            STORAGE *f = storage();
-            f->flags ^= FLAG_TEST;
-            storage_save(true);
-            DEBUG_PRINTF("Test Device flag toggled to %s\n", (f->flags & FLAG_TEST) != 0 ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Force an upload now, for debugging.  As it always has, the line also goes to TTSERVE.
+static void phone_cmd_upload() {
+    comm_call_now();
+    DEBUG_PRINTF("Upload will be initiated ASAP\n");
+    phone_pass_to_service();
+}
 
-        // Get/Set Device Parameters
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cfgdev") || comm_cmdbuf_this_arg_is(&fromPhone, "o") || comm_cmdbuf_this_arg_is(&fromPhone, "op")) {
-            char buffer[256];
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                storage_get_device_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("%s %s\n", buffer, storage_get_device_params_as_string_help());
-                DEBUG_PRINTF("wan: AUTO=%d LORA=%d TTN=%d FONA=%d F+M=%d\n", WAN_AUTO, WAN_LORA, WAN_LORAWAN, WAN_FONA, WAN_FONA_PLUS_MOBILE);
-            } else {
-                storage_set_device_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
-                storage_save(true);
-                storage_get_device_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Now %s\n", buffer);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Shortcut to set to cell-only for testing
+static void phone_cmd_ct() {
+    char buffer[256];
+    storage_set_device_params_as_string("cell");
+    storage_save(true);
+    storage_get_device_params_as_string(buffer, sizeof(buffer));
+    DEBUG_PRINTF("Now %s\n", buffer);
+}
 
-        // Toggle BT configuration flag
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "bt")) {
-            STORAGE *f = storage();
-            f->flags ^= FLAG_BTKEEPALIVE;
-            storage_save(true);
-            DEBUG_PRINTF("BT Keepalive toggled to %s\n", (f->flags & FLAG_BTKEEPALIVE) != 0 ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Configuration flag toggles
+static void phone_cmd_dt() {
+    phone_flag_toggle(FLAG_TEST, "Test Device flag");
+}
+static void phone_cmd_bt() {
+    phone_flag_toggle(FLAG_BTKEEPALIVE, "BT Keepalive");
+}
+static void phone_cmd_cnf() {
+    phone_flag_toggle(FLAG_CONFIRM_ALL, "CONFIRM ALL");
+}
+static void phone_cmd_sts() {
+    phone_flag_toggle(FLAG_STATS_SEPARATE, "STATS SEPARATE");
+}
 
-        // Toggle CONFIRM ALL configuration flag (generally used as a "stats test")
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cnf") || comm_cmdbuf_this_arg_is(&fromPhone, "st")) {
-            STORAGE *f = storage();
-            f->flags ^= FLAG_CONFIRM_ALL;
-            storage_save(true);
-            DEBUG_PRINTF("CONFIRM ALL toggled to %s\n", (f->flags & FLAG_CONFIRM_ALL) != 0 ? "ON" : "OFF");
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get/Set Device Parameters
+static void phone_cmd_cfgdev() {
+    char buffer[256];
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        storage_get_device_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("%s %s\n", buffer, storage_get_device_params_as_string_help());
+        DEBUG_PRINTF("wan: AUTO=%d LORA=%d TTN=%d FONA=%d F+M=%d\n", WAN_AUTO, WAN_LORA, WAN_LORAWAN, WAN_FONA, WAN_FONA_PLUS_MOBILE);
+    } else {
+        storage_set_device_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
+        storage_save(true);
+        storage_get_device_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Now %s\n", buffer);
+    }
+}
 
-        // Get/Set Service Parameters
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cfgsvc")) {
-            char buffer[256];
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                storage_get_service_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("%s %s\n", buffer, storage_get_service_params_as_string_help());
-            } else {
-                storage_set_service_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
-                storage_save(true);
-                storage_get_service_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Now %s\n", buffer);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get/Set Service Parameters
+static void phone_cmd_cfgsvc() {
+    char buffer[256];
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        storage_get_service_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("%s %s\n", buffer, storage_get_service_params_as_string_help());
+    } else {
+        storage_set_service_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
+        storage_save(true);
+        storage_get_service_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Now %s\n", buffer);
+    }
+}
 
-        // Get/Set DFU Parameters
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cfgdfu")) {
-            char buffer[256];
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                storage_get_dfu_state_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("%s %s\n", buffer, storage_get_dfu_state_as_string_help());
-            } else {
-                storage_set_dfu_state_as_string((char *)&fromPhone.buffer[fromPhone.args]);
-                storage_save(true);
-                storage_get_dfu_state_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Now %s\n", buffer);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get/Set DFU Parameters
+static void phone_cmd_cfgdfu() {
+    char buffer[256];
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        storage_get_dfu_state_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("%s %s\n", buffer, storage_get_dfu_state_as_string_help());
+    } else {
+        storage_set_dfu_state_as_string((char *)&fromPhone.buffer[fromPhone.args]);
+        storage_save(true);
+        storage_get_dfu_state_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Now %s\n", buffer);
+    }
+}
 
-        // Get/Set TTN Parameters
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cfgttn")) {
-            char buffer[256];
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                storage_get_ttn_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("%s %s\n", buffer, storage_get_ttn_params_as_string_help());
-            } else {
-                storage_set_ttn_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
-                storage_save(true);
-                storage_get_ttn_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Now %s\n", buffer);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get/Set TTN Parameters
+static void phone_cmd_cfgttn() {
+    char buffer[256];
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        storage_get_ttn_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("%s %s\n", buffer, storage_get_ttn_params_as_string_help());
+    } else {
+        storage_set_ttn_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
+        storage_save(true);
+        storage_get_ttn_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Now %s\n", buffer);
+    }
+}
 
-        // Get/Set device label
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cfglab") || comm_cmdbuf_this_arg_is(&fromPhone, "l")) {
-            char buffer[256];
-            comm_cmdbuf_next_arg(&fromPhone);
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                storage_get_device_label_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("%s %s\n", buffer, storage_get_device_label_as_string_help());
-            } else {
-                storage_set_device_label_as_string((char *)&fromPhone.buffer[fromPhone.args]);
-                storage_save(true);
-                storage_get_device_label_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Now %s\n", buffer);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get/Set device label
+static void phone_cmd_cfglab() {
+    char buffer[256];
+    comm_cmdbuf_next_arg(&fromPhone);
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        storage_get_device_label_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("%s %s\n", buffer, storage_get_device_label_as_string_help());
+    } else {
+        storage_set_device_label_as_string((char *)&fromPhone.buffer[fromPhone.args]);
+        storage_save(true);
+        storage_get_device_label_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Now %s\n", buffer);
+    }
+}
 
-        // Get/Set Sensor Parameters
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cfgsen")) {
-            char buffer[256];
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                storage_get_sensor_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Current: '%s' Help: '%s'\n", buffer, storage_get_sensor_params_as_string_help());
-            } else {
-                storage_set_sensor_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
-                storage_save(true);
-                storage_get_sensor_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Now %s\n", buffer);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get/Set Sensor Parameters
+static void phone_cmd_cfgsen() {
+    char buffer[256];
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        storage_get_sensor_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Current: '%s' Help: '%s'\n", buffer, storage_get_sensor_params_as_string_help());
+    } else {
+        storage_set_sensor_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
+        storage_save(true);
+        storage_get_sensor_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Now %s\n", buffer);
+    }
+}
 
-        // Get/Set GPS Parameters
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "cfggps")) {
-            char buffer[256];
-            comm_cmdbuf_next_arg(&fromPhone);
-            comm_cmdbuf_this_arg_is(&fromPhone, "*");
-            if (fromPhone.buffer[fromPhone.args] == '\0') {
-                storage_get_gps_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("%s %s\n", buffer, storage_get_gps_params_as_string_help());
-            } else {
-                storage_set_gps_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
-                storage_save(true);
-                storage_get_gps_params_as_string(buffer, sizeof(buffer));
-                DEBUG_PRINTF("Now %s\n", buffer);
-            }
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get/Set GPS Parameters
+static void phone_cmd_cfggps() {
+    char buffer[256];
+    comm_cmdbuf_next_arg(&fromPhone);
+    comm_cmdbuf_this_arg_is(&fromPhone, "*");
+    if (fromPhone.buffer[fromPhone.args] == '\0') {
+        storage_get_gps_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("%s %s\n", buffer, storage_get_gps_params_as_string_help());
+    } else {
+        storage_set_gps_params_as_string((char *)&fromPhone.buffer[fromPhone.args]);
+        storage_save(true);
+        storage_get_gps_params_as_string(buffer, sizeof(buffer));
+        DEBUG_PRINTF("Now %s\n", buffer);
+    }
+}
 
-        // TWI status
+// TWI status
 #ifdef TWIX
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "twi")) {
-            twi_status_check(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+static void phone_cmd_twi() {
+    twi_status_check(true);
+}
 #endif
 
-        // TWI status
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "mtu")) {
-            mtu_status_check(true);
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Get time of day
+static void phone_cmd_time() {
+    DEBUG_PRINTF("%s\n", time_since_boot());
+}
 
-        // Get time of day
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "time")) {
-            DEBUG_PRINTF("%s\n", time_since_boot());
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Restart
+static void phone_cmd_restart() {
+    io_request_restart();
+}
 
-        // Restart
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "reboot") || comm_cmdbuf_this_arg_is(&fromPhone, "restart")) {
-            io_request_restart();
-            comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
-            break;
-        }
+// Echo locally and on server, just for connectivity testing
+static void phone_cmd_echo() {
+    comm_cmdbuf_next_arg(&fromPhone);
+    if (fromPhone.buffer[fromPhone.args] == '\0')
+        DEBUG_PRINTF("@device: Hello.\n");
+    else
+        DEBUG_PRINTF("@device: %s\n", &fromPhone.buffer[fromPhone.args]);
+    // Transmit command, including slash, to the server, to continue echoing
+    phone_pass_to_service();
+}
+
+static void phone_cmd_help();
+
+// Commands, which MUST be kept sorted by name because they're found by binary search.
+// Those that aren't built into this configuration can simply be left out.
+static const phone_command_t phone_commands[] = {
+    {"0",       phone_cmd_debug_off,    "",                 "all debug off"},
+    {"1",       phone_cmd_debug_common, "",                 "common debug on"},
+    {"a",       phone_cmd_a,            "",                 "toggle airtime debug"},
+    {"b",       phone_cmd_b,            "",                 "toggle bluetooth debug"},
+    {"bat",     phone_cmd_bat,          "",                 "measure battery"},
+    {"blink",   phone_cmd_blink,        "",                 "flash LEDs to identify the device"},
+    {"bt",      phone_cmd_bt,           "",                 "toggle bluetooth keepalive"},
+    {"buff",    phone_cmd_buff,         "",                 "show whether comms would be buffered"},
+    {"burn",    phone_cmd_burn,         "<on/off>",         "burn-in mode"},
+    {"c",       phone_cmd_c,            "",                 "toggle comms rx/tx debug"},
+    {"ccc",     phone_cmd_ccc,          "",                 "show comms state"},
+    {"cfgdev",  phone_cmd_cfgdev,       "[params]",         "get/set device params"},
+    {"cfgdfu",  phone_cmd_cfgdfu,       "[params]",         "get/set DFU state"},
+    {"cfggps",  phone_cmd_cfggps,       "[params]",         "get/set GPS params"},
+    {"cfglab",  phone_cmd_cfglab,       "[label]",          "get/set device label"},
+    {"cfgsen",  phone_cmd_cfgsen,       "[params]",         "get/set sensor params"},
+    {"cfgsvc",  phone_cmd_cfgsvc,       "[params]",         "get/set service params"},
+    {"cfgttn",  phone_cmd_cfgttn,       "[params]",         "get/set TTN params"},
+    {"cnf",     phone_cmd_cnf,          "",                 "toggle confirming all messages"},
+    {"comm",    phone_cmd_comms,        "",                 "show comms stats"},
+    {"comms",   phone_cmd_comms,        "",                 "show comms stats"},
+#ifdef GEIGERX
+    {"cpm",     phone_cmd_geiger,       "",                 "measure radiation"},
+#endif
+    {"ct",      phone_cmd_ct,           "",                 "set device to cell-only"},
+    {"cx",      phone_cmd_cx,           "",                 "toggle max comms debug"},
+    {"d",       phone_cmd_d,            "",                 "show debug flags"},
+    {"dead",    phone_cmd_dead,         "",                 "toggle sensor scheduling"},
+    {"drop",    phone_cmd_drop,         "",                 "drop to lowest power"},
+    {"dt",      phone_cmd_dt,           "",                 "toggle test device flag"},
+    {"echo",    phone_cmd_echo,         "[text]",           "echo locally and via the service"},
+#if defined(TWIHIH6130) || defined(TWIBME0)
+    {"env",     phone_cmd_env,          "",                 "show temperature and humidity"},
+#endif
+    {"fail",    phone_cmd_fail,         "",                 "force cellular to test failover"},
+    {"flip",    phone_cmd_flip,         "",                 "flip the display"},
+#if defined(FONA)
+    {"fona",    phone_cmd_fona,         "",                 "use cellular"},
+#endif
+    {"g",       phone_cmd_gx,           "",                 "toggle max GPS debug"},
+    {"gabort",  phone_cmd_gabort,       "",                 "abort GPS, using last known good"},
+#ifdef GEIGERX
+    {"geiger",  phone_cmd_geiger,       "",                 "measure radiation"},
+#endif
+    {"gfake",   phone_cmd_gfake,        "",                 "set a fake GPS location"},
+    {"glkg",    phone_cmd_gabort,       "",                 "abort GPS, using last known good"},
+    {"gpio",    phone_cmd_gpio,         "<pin*10+on>",      "set a power pin"},
+    {"gps",     phone_cmd_gps,          "",                 "show GPS location"},
+    {"grefresh",phone_cmd_gupdate,      "",                 "force a GPS update"},
+    {"gupdate", phone_cmd_gupdate,      "",                 "force a GPS update"},
+    {"gx",      phone_cmd_gx,           "",                 "toggle max GPS debug"},
+    {"hello",   phone_cmd_hello,        "",                 "send full stats"},
+    {"help",    phone_cmd_help,         "",                 "list commands"},
+    {"hi",      phone_cmd_echo,         "[text]",           "echo locally and via the service"},
+    {"id",      phone_cmd_blink,        "",                 "flash LEDs to identify the device"},
+    {"ind",     phone_cmd_ind,          "",                 "turn off indicators"},
+    {"l",       phone_cmd_cfglab,       "[label]",          "get/set device label"},
+#if defined(LORA)
+    {"lora",    phone_cmd_lora,         "",                 "use lora"},
+    {"mac",     phone_cmd_lpwan,        "<command>",        "pass through to the LPWAN chip"},
+#endif
+    {"measure", phone_cmd_sample,       "",                 "schedule sensors now"},
+    {"mobile",  phone_cmd_mobile,       "<on/off/secs>",    "mobile mode"},
+    {"mtu",     phone_cmd_mtu,          "[length]",         "MTU test, or status"},
+    {"nogps",   phone_cmd_nogps,        "",                 "shut down GPS"},
+    {"none",    phone_cmd_none,         "",                 "cancel a pending WAN request"},
+    {"o",       phone_cmd_cfgdev,       "[params]",         "get/set device params"},
+    {"op",      phone_cmd_cfgdev,       "[params]",         "get/set device params"},
+    {"pwr",     phone_cmd_pwr,          "[on/off]",         "power debug mode"},
+    {"q",       phone_cmd_sample,       "",                 "schedule sensors now"},
+#ifdef GEIGERX
+    {"rad",     phone_cmd_geiger,       "",                 "measure radiation"},
+#endif
+#ifdef LORA
+    {"radio",   phone_cmd_lpwan,        "<command>",        "pass through to the LPWAN chip"},
+#endif
+    {"reboot",  phone_cmd_restart,      "",                 "restart"},
+    {"recv",    phone_cmd_recv,         "<message>",        "act on a message as if from the service"},
+    {"reset",   phone_cmd_reset,        "",                 "reset comms"},
+    {"restart", phone_cmd_restart,      "",                 "restart"},
+    {"rx",      phone_cmd_rx,           "",                 "toggle rx debug"},
+    {"s",       phone_cmd_s,            "",                 "toggle sensor debug"},
+    {"sample",  phone_cmd_sample,       "",                 "schedule sensors now"},
+    {"sp",      phone_cmd_sp,           "",                 "toggle sensor poll debug"},
+#ifdef SSD
+    {"ssd",     phone_cmd_ssd,          "<on/off>",         "display"},
+#endif
+    {"sss",     phone_cmd_sss,          "",                 "show sensor state"},
+    {"st",      phone_cmd_cnf,          "",                 "toggle confirming all messages"},
+    {"state",   phone_cmd_state,        "",                 "show comms device state"},
+    {"stats",   phone_cmd_stats,        "",                 "send stats"},
+    {"sts",     phone_cmd_sts,          "",                 "toggle sending stats separately"},
+    {"sx",      phone_cmd_sx,           "",                 "toggle max sensor debug"},
+    {"sxx",     phone_cmd_sxx,          "",                 "toggle super max sensor debug"},
+    {"sxxx",    phone_cmd_sxxx,         "",                 "toggle super duper max sensor debug"},
+#ifdef LORA
+    {"sys",     phone_cmd_lpwan,        "<command>",        "pass through to the LPWAN chip"},
+#endif
+    {"t",       phone_cmd_test,         "<on/off/sensor>",  "sensor test mode"},
+#if defined(TWIHIH6130) || defined(TWIBME0)
+    {"temp",    phone_cmd_env,          "",                 "show temperature and humidity"},
+#endif
+    {"test",    phone_cmd_test,         "<on/off/sensor>",  "sensor test mode"},
+    {"time",    phone_cmd_time,         "",                 "show time since boot"},
+#ifdef TWIX
+    {"twi",     phone_cmd_twi,          "",                 "show TWI status"},
+#endif
+    {"tx",      phone_cmd_tx,           "",                 "toggle tx debug"},
+    {"upload",  phone_cmd_upload,       "",                 "upload now"},
+    {"ver",     phone_cmd_ver,          "",                 "show version"},
+    {"x",       phone_cmd_debug_all,    "",                 "all debug on"},
+};
+#define PHONE_COMMANDS (sizeof(phone_commands) / sizeof(phone_commands[0]))
+
+// List the commands
+static void phone_cmd_help() {
+    int i;
+    for (i=0; i<PHONE_COMMANDS; i++)
+        DEBUG_PRINTF("%s %s - %s\n", phone_commands[i].name, phone_commands[i].args, phone_commands[i].help);
+}
+
+// Get a command by its position in the table, or NULL past the end
+const phone_command_t *phone_command(uint16_t index) {
+    if (index >= PHONE_COMMANDS)
+        return NULL;
+    return &phone_commands[index];
+}
 
-        // Echo locally and on server, just for connectivity testing
-        if (comm_cmdbuf_this_arg_is(&fromPhone, "echo") || comm_cmdbuf_this_arg_is(&fromPhone, "hi") || comm_cmdbuf_this_arg_is(&fromPhone, "hello")) {
-            comm_cmdbuf_next_arg(&fromPhone);
-            if (fromPhone.buffer[fromPhone.args] == '\0')
-                DEBUG_PRINTF("@device: Hello.\n");
-            else
-                DEBUG_PRINTF("@device: %s\n", &fromPhone.buffer[fromPhone.args]);
-            // Transmit command, including slash, to the server, to continue echoing
-            fromPhone.args = 0;
-            fromPhone.state = CMD_STATE_XMIT_PHONE_TEXT;
+// Find the command named by the first word of a line, or NULL if there's none.  As with
+// comm_cmdbuf_this_arg_is(), the word is compared without regard to case.
+const phone_command_t *phone_command_lookup(char *line) {
+    char word[16];
+    int i, lo, hi, mid, cmp;
+
+    for (i=0; i<sizeof(word)-1; i++) {
+        char ch = line[i];
+        if (ch == '\0' || ch == ' ' || ch == ',' || ch == ';' || ch < 0x20 || ch >= 0x7f)
             break;
-        }
+        if (ch >= 'A' && ch <= 'Z')
+            ch += 'a' - 'A';
+        word[i] = ch;
+    }
+    word[i] = '\0';
+
+    lo = 0;
+    hi = PHONE_COMMANDS-1;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        cmp = strcmp(word, phone_commands[mid].name);
+        if (cmp == 0)
+            return &phone_commands[mid];
+        if (cmp < 0)
+            hi = mid-1;
+        else
+            lo = mid+1;
+    }
+    return NULL;
+}
+
+// Process a "complete" command buffer, and if idle parse it to determine its first state
+void phone_complete() {
+    const phone_command_t *command;
 
-        // Unknown commands, including slash, are passed through to TTSERVE
-        fromPhone.args = 0;
+    // If we're not in an idle state, let's not process commands for it
+    if (fromPhone.state != COMM_STATE_IDLE)
+        return;
+
+    // If it begins with a slash, transmit this oon the wire as a pb-formatted "text message"
+    if (comm_cmdbuf_this_arg_is(&fromPhone, "/*")) {
+        // Skip to the actual text to be transmitted
+        comm_cmdbuf_next_arg(&fromPhone);
         fromPhone.state = CMD_STATE_XMIT_PHONE_TEXT;
-        break;
+        return;
+    }
+
+#ifdef FONA
+    // Commands to be passed-through to the chip - used for testing
+    if (comm_cmdbuf_this_arg_is(&fromPhone, "at+*")) {
+        // Send to the chip, even if it may fail because of the state we're in
+        fona_send((char *)&fromPhone.buffer[0]);
+        comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
+        return;
+    }
+#endif
 
+    // Unknown commands, including slash, are passed through to TTSERVE
+    command = phone_command_lookup((char *) &fromPhone.buffer[fromPhone.args]);
+    if (command == NULL || !comm_cmdbuf_this_arg_is(&fromPhone, command->name)) {
+        phone_pass_to_service();
+        return;
     }
 
+    // Process our hard-wired commands, which return to idle unless they've said otherwise
+    command->handler();
+    if (fromPhone.state == COMM_STATE_IDLE)
+        comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
+
 }
 
 // One-time init
 void phone_init() {
     comm_cmdbuf_init(&fromPhone, CMDBUF_TYPE_PHONE);
     comm_cmdbuf_set_state(&fromPhone, COMM_STATE_IDLE);
+#ifdef DEBUG
+    int i;
+    for (i=1; i<PHONE_COMMANDS; i++)
+        if (strcmp(phone_commands[i-1].name, phone_commands[i].name) >= 0)
+            DEBUG_PRINTF("Phone command '%s' out of order\n", phone_commands[i].name);
+#endif
 }
 
 // Process byte received from phone
@@ -858,8 +898,9 @@ void phone_process() {
         message.has_device_type = true;
         message.device_type = ttproto_Telecast_deviceType_TTAPP;
 
-        message.has_message = true;
-        strlcpy(message.message, (char *) &fromPhone.buffer[0], fromPhone.length);
+        if (fromPhone.line.length > 0)
+            fromPhone.buffer[fromPhone.line.length-1] = '\0';
+        send_set_string(&message.message, (char *) &fromPhone.buffer[0]);
 
         message.has_device_id = true;
         message.device_id = io_get_device_address();
@@ -5,9 +5,19 @@
 #ifndef COMM_PHONE_H__
 #define COMM_PHONE_H__
 
+// A console command, dispatched by its first word
+typedef struct {
+    char *name;
+    void (*handler)(void);
+    char *args;
+    char *help;
+} phone_command_t;
+
 void phone_init();
 void phone_send(char *msg);
 void phone_received_byte(uint8_t databyte);
 void phone_process();
+const phone_command_t *phone_command(uint16_t index);
+const phone_command_t *phone_command_lookup(char *line);
 
 #endif // COMM_PHONE_H__
@@ -68,12 +68,6 @@
 #include "io.h"
 #include "stats.h"
 
-// Define states
-#define STATE_WAITING_FOR_HEADER0       0
-#define STATE_WAITING_FOR_HEADER1       1
-#define STATE_BUFFERING                 2
-static uint16_t state = STATE_WAITING_FOR_HEADER0;
-
 // Header length
 #if defined(PMS2003) || defined(PMS3003)
 #define SAMPLE_LENGTH 24
@@ -85,10 +79,13 @@ static uint16_t state = STATE_WAITING_FOR_HEADER0;
 Error - unknown PMS sensor type
 #endif
 
-static uint8_t sample_to_process[SAMPLE_LENGTH];
-static uint8_t sample_to_process_length;
+// Samples are framed by the two bytes with which each begins.  Once complete, a sample is
+// held for processing by the scheduler, and any that arrives before then is counted as lost.
+static const uint8_t sample_sync[] = {0x42, 0x4D};
 static uint8_t sample[SAMPLE_LENGTH];
-static uint8_t sample_received_length;
+static frame_t sample_frame;
+static uint8_t sample_to_process[SAMPLE_LENGTH];
+static volatile bool sample_to_process_pending = false;
 static float samples_PM1[PMS_SAMPLE_MAX_BINS];
 static float samples_PM2_5[PMS_SAMPLE_MAX_BINS];
 static float samples_PM10[PMS_SAMPLE_MAX_BINS];
@@ -149,11 +146,11 @@ bool s_pms_term() {
 // One-time initialization of sensor
 bool s_pms_init(void *s, uint16_t param) {
     s_pms_clear_measurement();
-    state = STATE_WAITING_FOR_HEADER0;
+    frame_init_sync(&sample_frame, sample_sync, sizeof(sample_sync), sample, sizeof(sample), &stats()->errors_framing);
+    sample_to_process_pending = false;
     num_samples = 0;
     num_valid_samples = 0;
     num_nonzero_samples = 0;
-    sample_received_length = 0;
     num_valid_reports = 0;
     pms_polling_ok = true;
     previous_sample_checksum = 0xDEAD;
@@ -173,9 +170,15 @@ void sample_event_handler(void *unused1, uint16_t unused2) {
     uint16_t pms_c02_50 = 0;
     uint16_t pms_c05_00 = 0;
     uint16_t pms_c10_00 = 0;
+    uint8_t sample_copy[SAMPLE_LENGTH];
+
+    // Take the sample before allowing the next one to be held, because the TWI
+    // callback may frame another while this one is being parsed
+    memcpy(sample_copy, sample_to_process, SAMPLE_LENGTH);
+    sample_to_process_pending = false;
 
     // The macro we'll use to extract bytes from the sample
-#define extract(msb,lsb) ( (sample_to_process[msb] << 8) | sample_to_process[lsb] )
+#define extract(msb,lsb) ( (sample_copy[msb] << 8) | sample_copy[lsb] )
 
     // Exit if we're not initialized.  This happens because data comes in immediately after power,
     // but BEFORE we've actually initialized the sensor.
@@ -297,40 +300,25 @@ void sample_event_handler(void *unused1, uint16_t unused2) {
 // Process byte received from the device
 void pms_received_byte(uint8_t databyte) {
 
-    switch (state) {
+    // Data comes in immediately after power, before the framing has been initialized
+    if (!pms_polling_ok)
+        return;
 
-    case STATE_WAITING_FOR_HEADER0:
-        if (databyte != 0x42)
-            break;
-        sample_received_length = 0;
-        sample[sample_received_length++] = databyte;
-        state = STATE_WAITING_FOR_HEADER1;
-        break;
+    if (!frame_byte(&sample_frame, databyte))
+        return;
 
-    case STATE_WAITING_FOR_HEADER1:
-        if (databyte != 0x4D) {
-            state = STATE_WAITING_FOR_HEADER0;
-            break;
-        }
-        if (sample_received_length < SAMPLE_LENGTH)
-            sample[sample_received_length++] = databyte;
-        state = STATE_BUFFERING;
-        break;
-
-    case STATE_BUFFERING:
-        if (sample_received_length < SAMPLE_LENGTH)
-            sample[sample_received_length++] = databyte;
-        if (sample_received_length >= SAMPLE_LENGTH) {
-            state = STATE_WAITING_FOR_HEADER0;
-            sample_to_process_length = sample_received_length;
-            memcpy(sample_to_process, sample, SAMPLE_LENGTH);
-            // Don't even bother to enqueue event if we know that it won't be recorded
-            if (pms_polling_ok && !reported && num_samples_recorded < PMS_SAMPLE_MAX_BINS)
-                app_sched_event_put(NULL, 0, sample_event_handler);
-        }
-        break;
+    // Don't even bother to enqueue event if we know that it won't be recorded
+    if (reported || num_samples_recorded >= PMS_SAMPLE_MAX_BINS)
+        return;
 
+    if (sample_to_process_pending) {
+        stats()->errors_framing++;
+        return;
     }
+    memcpy(sample_to_process, sample, SAMPLE_LENGTH);
+    sample_to_process_pending = true;
+    if (app_sched_event_put(NULL, 0, sample_event_handler) != NRF_SUCCESS)
+        sample_to_process_pending = false;
 
 }
 
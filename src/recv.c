@@ -16,74 +16,153 @@
 #include "phone.h"
 #include "misc.h"
 #include "io.h"
+#include "recv.h"
 
-// Commands
-#define CMD_RESTART "restart"
-#define CMD_REBOOT "reboot"
-#define CMD_HELLO "hello"
-#define CMD_BURN "burn"
-#define CMD_BURNWITHMINS "burn "
-#define CMD_CFGDEV "cfgdev "
-#define CMD_CFGNET "cfgsvc "
-#define CMD_CFGTTN "cfgttn "
-#define CMD_CFGLAB "cfglab "
-#define CMD_CFGGPS "cfggps "
-#define CMD_CFGSEN "cfgsen "
-#define CMD_CFGDFU "cfgdfu "
-#define CMD_DFU "dfu"
-#define CMD_DFUWITHCFG "dfu "
-#define CMD_DOWN "down"
+static bool recv_cfgdev(char *arg) {
+    storage_set_device_params_as_string(arg);
+    return true;
+}
 
-// Process a received message from the service
-void recv_message_from_service(char *message) {
-    DEBUG_PRINTF("RECEIVED: %s\n", message);
-    if (memcmp(message, CMD_CFGDEV, strlen(CMD_CFGDEV)) == 0) {
-        storage_set_device_params_as_string(&message[strlen(CMD_CFGDEV)]);
-    } else if (memcmp(message, CMD_CFGGPS, strlen(CMD_CFGGPS)) == 0) {
-        storage_set_gps_params_as_string(&message[strlen(CMD_CFGGPS)]);
-    } else if (memcmp(message, CMD_CFGNET, strlen(CMD_CFGNET)) == 0) {
-        storage_set_service_params_as_string(&message[strlen(CMD_CFGNET)]);
-    } else if (memcmp(message, CMD_CFGTTN, strlen(CMD_CFGTTN)) == 0) {
-        storage_set_ttn_params_as_string(&message[strlen(CMD_CFGTTN)]);
-    } else if (memcmp(message, CMD_CFGLAB, strlen(CMD_CFGLAB)) == 0) {
-        storage_set_device_label_as_string(&message[strlen(CMD_CFGLAB)]);
-    } else if (memcmp(message, CMD_CFGSEN, strlen(CMD_CFGSEN)) == 0) {
-        storage_set_sensor_params_as_string(&message[strlen(CMD_CFGSEN)]);
-    } else if (memcmp(message, CMD_CFGDFU, strlen(CMD_CFGDFU)) == 0) {
-        storage_set_dfu_state_as_string(&message[strlen(CMD_CFGDFU)]);
-    } else if (memcmp(message, CMD_DFU, strlen(CMD_DFU)) == 0) {
+static bool recv_cfgdfu(char *arg) {
+    storage_set_dfu_state_as_string(arg);
+    return true;
+}
+
+static bool recv_cfggps(char *arg) {
+    storage_set_gps_params_as_string(arg);
+    return true;
+}
+
+static bool recv_cfglab(char *arg) {
+    storage_set_device_label_as_string(arg);
+    return true;
+}
+
+static bool recv_cfgsen(char *arg) {
+    storage_set_sensor_params_as_string(arg);
+    return true;
+}
+
+static bool recv_cfgsvc(char *arg) {
+    storage_set_service_params_as_string(arg);
+    return true;
+}
+
+static bool recv_cfgttn(char *arg) {
+    storage_set_ttn_params_as_string(arg);
+    return true;
+}
+
+static bool recv_dfu(char *arg) {
 #if !defined(DFU) || !defined(FONA)
-        DEBUG_PRINTF("DFU Requested, but firmware is not configured for DFU\n");
-        return;
+    DEBUG_PRINTF("DFU Requested, but firmware is not configured for DFU\n");
+    return false;
 #else
-        if (memcmp(message, CMD_DFUWITHCFG, strlen(CMD_DFUWITHCFG)) == 0)
-            storage_set_dfu_state_as_string(&message[strlen(CMD_DFUWITHCFG)]);
-        DEBUG_PRINTF("Initiating DFU of '%s'.\n", storage()->dfu_filename);
-        storage()->dfu_status = DFU_PENDING;
+    if (arg != NULL)
+        storage_set_dfu_state_as_string(arg);
+    DEBUG_PRINTF("Initiating DFU of '%s'.\n", storage()->dfu_filename);
+    storage()->dfu_status = DFU_PENDING;
+    return true;
 #endif
-    } else if (memcmp(message, CMD_BURN, strlen(CMD_BURN)) == 0) {
-        uint32_t duration = 60L;  // Default to 1 hour
-        if (memcmp(message, CMD_BURNWITHMINS, strlen(CMD_BURNWITHMINS)) == 0)
-            duration = atol(&message[strlen(CMD_BURNWITHMINS)]);
-        DEBUG_PRINTF("Initiating temporary BURN mode for %ld minutes.\n", duration);
-        sensor_set_temporary_op_mode(OPMODE_TEST_BURN, duration * 60L);
-        return;
-    } else if (strcmp(message, CMD_RESTART) == 0) {
-        io_request_restart();
-        return;
-    } else if (strcmp(message, CMD_REBOOT) == 0) {
-        io_request_restart();
-        return;
-    } else if (strcmp(message, CMD_HELLO) == 0) {
-        comm_initiate_service_update(true);
-        return;
-    } else if (strcmp(message, CMD_DOWN) == 0) {
-        comm_force_cell();
-        return;
-    } else {
+}
+
+static bool recv_burn(char *arg) {
+    uint32_t duration = 60L;  // Default to 1 hour
+    if (arg != NULL)
+        duration = atol(arg);
+    DEBUG_PRINTF("Initiating temporary BURN mode for %ld minutes.\n", duration);
+    sensor_set_temporary_op_mode(OPMODE_TEST_BURN, duration * 60L);
+    return false;
+}
+
+static bool recv_restart(char *arg) {
+    io_request_restart();
+    return false;
+}
+
+static bool recv_hello(char *arg) {
+    comm_initiate_service_update(true);
+    return false;
+}
+
+static bool recv_down(char *arg) {
+    comm_force_cell();
+    return false;
+}
+
+// Commands, which MUST be kept sorted by name because they're found by binary search
+static const recv_command_t recv_commands[] = {
+    {"burn",    RECV_ARG_OPTIONAL,  recv_burn},
+    {"cfgdev",  RECV_ARG_REQUIRED,  recv_cfgdev},
+    {"cfgdfu",  RECV_ARG_REQUIRED,  recv_cfgdfu},
+    {"cfggps",  RECV_ARG_REQUIRED,  recv_cfggps},
+    {"cfglab",  RECV_ARG_REQUIRED,  recv_cfglab},
+    {"cfgsen",  RECV_ARG_REQUIRED,  recv_cfgsen},
+    {"cfgsvc",  RECV_ARG_REQUIRED,  recv_cfgsvc},
+    {"cfgttn",  RECV_ARG_REQUIRED,  recv_cfgttn},
+    {"dfu",     RECV_ARG_OPTIONAL,  recv_dfu},
+    {"down",    RECV_ARG_NONE,      recv_down},
+    {"hello",   RECV_ARG_NONE,      recv_hello},
+    {"reboot",  RECV_ARG_NONE,      recv_restart},
+    {"restart", RECV_ARG_NONE,      recv_restart},
+};
+#define RECV_COMMANDS (sizeof(recv_commands) / sizeof(recv_commands[0]))
+
+// Get a command by its position in the table, or NULL past the end
+const recv_command_t *recv_command(uint16_t index) {
+    if (index >= RECV_COMMANDS)
+        return NULL;
+    return &recv_commands[index];
+}
+
+// Find the command that a message begins with, returning its argument (or NULL)
+const recv_command_t *recv_command_lookup(char *message, char **arg) {
+    char *space = strchr(message, ' ');
+    uint16_t length = (space == NULL) ? strlen(message) : (space - message);
+    int lo, hi, mid, cmp;
+
+    *arg = (space == NULL) ? NULL : space+1;
+
+    lo = 0;
+    hi = RECV_COMMANDS-1;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        cmp = strncmp(message, recv_commands[mid].name, length);
+        if (cmp == 0 && recv_commands[mid].name[length] != '\0')
+            cmp = -1;
+        if (cmp == 0)
+            break;
+        if (cmp < 0)
+            hi = mid-1;
+        else
+            lo = mid+1;
+    }
+    if (lo > hi)
+        return NULL;
+
+    // The argument must be present, or absent, as the command expects
+    if (*arg == NULL ? recv_commands[mid].arg == RECV_ARG_REQUIRED : recv_commands[mid].arg == RECV_ARG_NONE)
+        return NULL;
+
+    return &recv_commands[mid];
+}
+
+// Process a received message from the service
+void recv_message_from_service(char *message) {
+    const recv_command_t *command;
+    char *arg;
+
+    DEBUG_PRINTF("RECEIVED: %s\n", message);
+
+    command = recv_command_lookup(message, &arg);
+    if (command == NULL) {
         DEBUG_PRINTF("TTSERVE: %s\n", (char *) message);
         return;
     }
+
+    if (!command->handler(arg))
+        return;
+
     storage_save(true);
     io_request_restart();
 }
@@ -5,7 +5,22 @@
 #ifndef RECV_H__
 #define RECV_H__
 
+// Whether a command takes an argument following a space
+#define RECV_ARG_NONE       0
+#define RECV_ARG_OPTIONAL   1
+#define RECV_ARG_REQUIRED   2
+
+// A command from the service, whose handler returns true if the configuration it
+// changed must be saved and the device restarted.  arg is NULL if none was given.
+typedef struct {
+    char *name;
+    uint8_t arg;
+    bool (*handler)(char *arg);
+} recv_command_t;
+
 void recv_message_from_service(char *message);
+const recv_command_t *recv_command(uint16_t index);
+const recv_command_t *recv_command_lookup(char *message, char **arg);
 
 #endif // RECV_H__
 
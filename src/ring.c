@@ -0,0 +1,167 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+// Byte rings between a producer and a consumer, and the framing of what is taken
+// from them, shared by everything that receives from the UART or TWI.  This has no
+// dependencies upon the rest of the firmware; counters are supplied by the caller.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "ring.h"
+
+// The consumer must not see an index move before the byte that it covers, and on a
+// single core it's enough to keep the compiler from reordering the two.
+#define RING_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+// Initialize a ring over the supplied buffer
+void ring_init(ring_t *r, uint8_t *buffer, uint16_t size, uint32_t *overruns) {
+    r->buffer = buffer;
+    r->size = size;
+    r->put = r->get = 0;
+    r->overruns = overruns;
+}
+
+// Add a byte, as the producer, returning false if it was dropped because the ring is full
+bool ring_put(ring_t *r, uint8_t databyte) {
+    uint16_t next = r->put + 1;
+    if (next >= r->size)
+        next = 0;
+    if (next == r->get) {
+        if (r->overruns != NULL)
+            (*r->overruns)++;
+        return false;
+    }
+    r->buffer[r->put] = databyte;
+    RING_BARRIER();
+    r->put = next;
+    return true;
+}
+
+// Take a byte, as the consumer, returning false if there is none
+bool ring_get(ring_t *r, uint8_t *databyte) {
+    uint16_t get = r->get;
+    if (get == r->put)
+        return false;
+    *databyte = r->buffer[get];
+    RING_BARRIER();
+    if (++get >= r->size)
+        get = 0;
+    r->get = get;
+    return true;
+}
+
+// See if there is anything to take
+bool ring_empty(ring_t *r) {
+    return (r->get == r->put);
+}
+
+// Discard what hasn't yet been taken, as the consumer
+void ring_flush(ring_t *r) {
+    r->get = r->put;
+}
+
+// Initialize a frame of the specified type, assembled within the supplied buffer
+void frame_init(frame_t *f, uint8_t type, uint8_t *buffer, uint16_t size, uint32_t *errors) {
+    f->type = type;
+    f->buffer = buffer;
+    f->size = size;
+    f->sync = NULL;
+    f->sync_length = 0;
+    f->errors = errors;
+    frame_reset(f);
+}
+
+// Initialize a frame that fills the supplied buffer, beginning with the sync bytes
+void frame_init_sync(frame_t *f, const uint8_t *sync, uint8_t sync_length, uint8_t *buffer, uint16_t size, uint32_t *errors) {
+    frame_init(f, FRAME_SYNC, buffer, size, errors);
+    f->sync = sync;
+    f->sync_length = sync_length;
+}
+
+// Discard what has been framed, and begin again
+void frame_reset(frame_t *f) {
+    f->length = 0;
+    f->expected = (f->type == FRAME_SYNC) ? f->size : 0;
+    f->complete = false;
+    f->damaged = false;
+    if (f->type == FRAME_LINE)
+        f->buffer[0] = '\0';
+}
+
+// Announce the number of bytes about to be received into a counted frame
+void frame_expect(frame_t *f, uint16_t length) {
+    f->expected += length;
+    f->complete = (f->expected == 0);
+}
+
+// Note that the frame has been lost or damaged, counting it just once
+static void frame_damaged(frame_t *f) {
+    if (!f->damaged && f->errors != NULL)
+        (*f->errors)++;
+    f->damaged = true;
+}
+
+// Frame a byte, returning true if it completes the frame.  A completed line or sync frame
+// remains in the buffer until the next byte is framed.
+bool frame_byte(frame_t *f, uint8_t databyte) {
+
+    switch (f->type) {
+
+    case FRAME_LINE:
+        if (f->complete)
+            frame_reset(f);
+        if (databyte == '\n') {
+            if (f->damaged) {
+                frame_reset(f);
+                return false;
+            }
+            if (f->length == 0)
+                return false;
+            f->complete = true;
+            return true;
+        }
+        if (f->damaged || databyte < 0x20 || databyte >= 0x7f)
+            return false;
+        if (f->length >= f->size-1) {
+            frame_damaged(f);
+            f->length = 0;
+            f->buffer[0] = '\0';
+            return false;
+        }
+        f->buffer[f->length++] = databyte;
+        f->buffer[f->length] = '\0';
+        return false;
+
+    case FRAME_SYNC:
+        if (f->complete)
+            frame_reset(f);
+        if (f->length < f->sync_length && databyte != f->sync[f->length]) {
+            f->length = 0;
+            if (databyte != f->sync[0])
+                return false;
+        }
+        f->buffer[f->length++] = databyte;
+        if (f->length < f->expected)
+            return false;
+        f->complete = true;
+        return true;
+
+    case FRAME_COUNTED:
+        if (f->expected == 0)
+            return false;
+        if (f->length < f->size)
+            f->buffer[f->length++] = databyte;
+        else
+            frame_damaged(f);
+        if (--f->expected != 0)
+            return false;
+        f->complete = true;
+        return true;
+
+    }
+
+    return false;
+
+}
@@ -0,0 +1,62 @@
+// Copyright 2017 Inca Roads LLC.  All rights reserved.
+// Use of this source code is governed by licenses granted by the
+// copyright holder including that found in the LICENSE file.
+
+#ifndef RING_H__
+#define RING_H__
+
+// A ring of bytes passed from a single producer to a single consumer, typically from
+// interrupt level to the scheduler.  The producer only ever writes 'put', and the
+// consumer only ever writes 'get', so neither needs to disable interrupts.  One slot
+// is left unused so that a full ring can be told from an empty one.  When the ring is
+// full the newest byte is dropped, and counted in 'overruns' if one was supplied.
+typedef struct {
+    uint8_t *buffer;
+    uint16_t size;
+    volatile uint16_t put;
+    volatile uint16_t get;
+    uint32_t *overruns;
+} ring_t;
+
+void ring_init(ring_t *r, uint8_t *buffer, uint16_t size, uint32_t *overruns);
+bool ring_put(ring_t *r, uint8_t databyte);
+bool ring_get(ring_t *r, uint8_t *databyte);
+bool ring_empty(ring_t *r);
+void ring_flush(ring_t *r);
+
+// Framing of the bytes taken from a ring into what the consumer processes:
+//  FRAME_LINE      Printable text ending in '\n', null-terminated, with other control
+//                  characters dropped and blank lines skipped.  A line that won't fit
+//                  is discarded through to its newline.
+//  FRAME_SYNC      A fixed number of bytes beginning with the given sync bytes, with
+//                  anything received while hunting for the sync bytes skipped.
+//  FRAME_COUNTED   The number of bytes announced by frame_expect(), appended to what
+//                  was already framed so that a reply may arrive in several pieces.
+//                  Whatever won't fit is dropped.
+// A frame that is lost or damaged is counted in 'errors', if one was supplied.
+#define FRAME_LINE      0
+#define FRAME_SYNC      1
+#define FRAME_COUNTED   2
+
+typedef struct {
+    uint8_t type;
+    uint8_t *buffer;
+    uint16_t size;
+    uint16_t length;
+    // FRAME_SYNC: length of the frame.  FRAME_COUNTED: bytes yet to come.
+    uint16_t expected;
+    const uint8_t *sync;
+    uint8_t sync_length;
+    // Set once the frame is complete, or once it has been found to be damaged
+    bool complete;
+    bool damaged;
+    uint32_t *errors;
+} frame_t;
+
+void frame_init(frame_t *f, uint8_t type, uint8_t *buffer, uint16_t size, uint32_t *errors);
+void frame_init_sync(frame_t *f, const uint8_t *sync, uint8_t sync_length, uint8_t *buffer, uint16_t size, uint32_t *errors);
+void frame_reset(frame_t *f);
+void frame_expect(frame_t *f, uint16_t length);
+bool frame_byte(frame_t *f, uint8_t databyte);
+
+#endif // RING_H__
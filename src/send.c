@@ -6,6 +6,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
 #include "debug.h"
 #include "config.h"
 #include "comm.h"
@@ -29,6 +31,9 @@
 #include "ina.h"
 #include "twi.h"
 #include "storage.h"
+#include "fragment.h"
+#include "batch.h"
+#include "pbarray.h"
 #include "crc32.h"
 #include "nrf_delay.h"
 #include "tt.pb.h"
@@ -52,21 +57,30 @@
 // - One byte of count (N) of protocol buffer messages
 // - A byte array of length N with one byte of length of that message, in bytes
 // - The concatenated protocol buffer messages
+// unless there are more than 255 messages or one longer than 255 bytes, in which case
+// the count and lengths are varints (see pbarray.h).  The lengths are kept as varints
+// in buff_hdr, and converted to the header that is needed when it's time to transmit.
 #ifdef TINYBUFFERS
 static uint8_t buff_hdr[25];
 static uint8_t buff_data[250];
 #else
-static uint8_t buff_hdr[250];
+static uint8_t buff_hdr[400];
 static uint8_t buff_data[2500];
 #endif
+// Room ahead of the data for the header, which is never larger than the format byte,
+// the count as a varint, and the lengths as varints.
+#define BUFF_HDR_RESERVE (sizeof(buff_hdr) + 1 + PBARRAY_VARINT_MAX)
 static bool buff_initialized = false;
 static uint8_t *buff_pdata;
+static uint16_t buff_count;
+static uint16_t buff_max_length;
 static uint16_t buff_hdr_used;
 static uint16_t buff_data_left;
 static uint16_t buff_data_used;
 static uint8_t *buff_data_base;
 static uint16_t buff_response_type;
-static uint8_t buff_pop_hdr;
+static uint16_t buff_pop_count;
+static uint16_t buff_pop_max_length;
 static uint8_t *buff_pop_pdata;
 static uint16_t buff_pop_data_left;
 static uint16_t buff_pop_data_used;
@@ -78,13 +92,40 @@ static uint16_t mtu_test = 0;
 static uint32_t mtu_count = 0;
 static uint16_t mtu_max = 0;
 static char mtu_failure[128] = "";
+#define MTU_TEST_MAX_LENGTH 249
+
+// Stats requests held in the send buffer so that they go out together
+static bool stats_hold = false;
 
 // Stamp-related fields
 static bool stamp_message_valid = false;
 static uint32_t stamp_message_id;
-static ttproto_Telecast stamp_message;
 static uint32_t mobile_session_time_offset;     // uses the same base date/time as captured_date
 
+// Slowly-changing measurements that may be left to the service to restore, for as long
+// as they stay within a threshold of the value that was cached when the stamp was created
+typedef struct {
+    uint32_t field;
+    uint16_t has_offset;
+    uint16_t value_offset;
+    float threshold;
+} stamp_threshold_t;
+static const stamp_threshold_t stamp_thresholds[] = {
+    {STAMP_BAT_VOLTAGE, offsetof(ttproto_Telecast, has_bat_voltage), offsetof(ttproto_Telecast, bat_voltage), 0.05},
+    {STAMP_BAT_SOC, offsetof(ttproto_Telecast, has_bat_soc), offsetof(ttproto_Telecast, bat_soc), 1.0},
+    {STAMP_ENC_TEMP, offsetof(ttproto_Telecast, has_enc_temp), offsetof(ttproto_Telecast, enc_temp), 0.5},
+    {STAMP_ENC_HUMID, offsetof(ttproto_Telecast, has_enc_humid), offsetof(ttproto_Telecast, enc_humid), 2.0},
+};
+#define STAMP_THRESHOLDS (sizeof(stamp_thresholds)/sizeof(stamp_thresholds[0]))
+
+// What was cached by the service when the stamp was created
+static struct {
+    uint32_t fields;
+    uint32_t motion_began_offset;
+    bool test;
+    float values[STAMP_THRESHOLDS];
+} stamp_cache;
+
 // Stamp version number.  The service needs to provide
 // backward compatibility forever with these versions because of
 // downlevel clients that expect caching, but this client code
@@ -93,7 +134,14 @@ static uint32_t mobile_session_time_offset;     // uses the same base date/time
 // STAMP_VERSION == 1
 //  Required Fields that are always cached: latitude, longitude, captured_at_date, captured_at_time
 //  Optional Fields that are cached if present: altitude
-#define STAMP_VERSION   1
+// STAMP_VERSION == 2
+//  As version 1, but the stamp ID is computed from the binary field values rather than
+//  from their text, and is opaque to the service.
+// STAMP_VERSION == 3
+//  As version 2, but the stamp_fields bitmap (STAMP_* in send.h) says which fields are
+//  cached when creating the stamp, and which are to be restored when applying it.  When
+//  applying it the bitmap is omitted if it would be the cached subset of the version 1 fields.
+#define STAMP_VERSION   3
 
 // Is this capable of being stamped?
 bool stampable(ttproto_Telecast *message) {
@@ -110,27 +158,30 @@ bool stampable(ttproto_Telecast *message) {
 
 // Get the stamp ID of a message.  Don't call this unless it's stampable.
 uint32_t stamp_id(ttproto_Telecast *message) {
-    char buffer[64];
+    uint8_t buffer[sizeof(uint32_t)*2 + sizeof(float)*2];
+    uint16_t length = 0;
+
+    memcpy(&buffer[length], &message->captured_at_date, sizeof(uint32_t));
+    length += sizeof(uint32_t);
+    memcpy(&buffer[length], &message->captured_at_time, sizeof(uint32_t));
+    length += sizeof(uint32_t);
 
     // Only include lat/lon when present and NOT in mobile mode
-    if (message->has_latitude && message->has_longitude && sensor_op_mode() != OPMODE_MOBILE)
-        sprintf(buffer, "%f,%f,%lu,%lu",
-                message->latitude,
-                message->longitude,
-                message->captured_at_date,
-                message->captured_at_time);
-    else
-        sprintf(buffer, "%lu,%lu",
-                message->captured_at_date,
-                message->captured_at_time);
+    if (message->has_latitude && message->has_longitude && sensor_op_mode() != OPMODE_MOBILE) {
+        memcpy(&buffer[length], &message->latitude, sizeof(float));
+        length += sizeof(float);
+        memcpy(&buffer[length], &message->longitude, sizeof(float));
+        length += sizeof(float);
+    }
 
-    return(crc32_compute((uint8_t *)buffer, strlen(buffer), NULL));
+    return(crc32_compute(buffer, length, NULL));
 
 }
 
 // Create a stamp from the stamp fields
 bool stamp_create(ttproto_Telecast *message) {
     static uint32_t mobile_session_id = 12345;          // init to something unlikely
+    int i;
 
     if (stampable(message)) {
 
@@ -157,7 +208,24 @@ bool stamp_create(ttproto_Telecast *message) {
 
         // Save the stamp info locally
         stamp_message_id = message_id;
-        stamp_message = *message;
+        stamp_cache.fields = STAMP_CAPTURED_AT;
+        if (message->has_latitude || message->has_longitude)
+            stamp_cache.fields |= STAMP_LOCATION;
+        if (message->has_motion_began_offset) {
+            stamp_cache.fields |= STAMP_MOTION_BEGAN;
+            stamp_cache.motion_began_offset = message->motion_began_offset;
+        }
+        if (message->has_test) {
+            stamp_cache.fields |= STAMP_TEST;
+            stamp_cache.test = message->test;
+        }
+        for (i=0; i<STAMP_THRESHOLDS; i++) {
+            const stamp_threshold_t *t = &stamp_thresholds[i];
+            if (*(bool *)((uint8_t *)message + t->has_offset)) {
+                stamp_cache.fields |= t->field;
+                stamp_cache.values[i] = *(float *)((uint8_t *)message + t->value_offset);
+            }
+        }
         stamp_message_valid = true;
 
         // Apply the stamp metadata so that the service stores it
@@ -165,6 +233,8 @@ bool stamp_create(ttproto_Telecast *message) {
         message->has_stamp = true;
         message->stamp_version = STAMP_VERSION;
         message->has_stamp_version = true;
+        message->stamp_fields = stamp_cache.fields;
+        message->has_stamp_fields = true;
         return true;
 
     }
@@ -178,26 +248,56 @@ void stamp_invalidate() {
 
 // Apply a stamp to the current message if its fields matche the last transmitted stamp,
 bool stamp_apply(ttproto_Telecast *message) {
+    uint32_t restore;
+    int i;
 
     if (stamp_message_valid && stampable(message)) {
         if (stamp_id(message) == stamp_message_id) {
 
-            // Apply the stamp
-            message->stamp = stamp_message_id;
-            message->has_stamp = true;
-
             // Remove the fields that are cached on the service
             message->has_captured_at_date = false;
             message->has_captured_at_time = false;
-            if (stamp_message.has_latitude || stamp_message.has_longitude) {
+            restore = STAMP_CAPTURED_AT;
+            if ((stamp_cache.fields & STAMP_LOCATION) != 0
+                && (message->has_latitude || message->has_longitude)) {
                 message->has_latitude = false;
                 message->has_longitude = false;
                 message->has_altitude = false;
+                restore |= STAMP_LOCATION;
             }
-            if (stamp_message.has_motion_began_offset)
+            if ((stamp_cache.fields & STAMP_MOTION_BEGAN) != 0
+                && message->has_motion_began_offset
+                && message->motion_began_offset == stamp_cache.motion_began_offset) {
                 message->has_motion_began_offset = false;
-            if (stamp_message.has_test)
+                restore |= STAMP_MOTION_BEGAN;
+            }
+            if ((stamp_cache.fields & STAMP_TEST) != 0
+                && message->has_test
+                && message->test == stamp_cache.test) {
                 message->has_test = false;
+                restore |= STAMP_TEST;
+            }
+
+            // Remove measurements that haven't moved far from what was cached
+            for (i=0; i<STAMP_THRESHOLDS; i++) {
+                const stamp_threshold_t *t = &stamp_thresholds[i];
+                bool *has = (bool *)((uint8_t *)message + t->has_offset);
+                float value = *(float *)((uint8_t *)message + t->value_offset);
+                if ((stamp_cache.fields & t->field) != 0 && *has
+                    && fabsf(value - stamp_cache.values[i]) <= t->threshold) {
+                    *has = false;
+                    restore |= t->field;
+                }
+            }
+
+            // Apply the stamp.  The bitmap is only needed when restoring something other than
+            // what a version 1 stamp would restore, which keeps it out of most messages.
+            message->stamp = stamp_message_id;
+            message->has_stamp = true;
+            if (restore != (stamp_cache.fields & (STAMP_CAPTURED_AT|STAMP_LOCATION))) {
+                message->stamp_fields = restore;
+                message->has_stamp_fields = true;
+            }
 
             return true;
 
@@ -208,20 +308,331 @@ bool stamp_apply(ttproto_Telecast *message) {
 
 }
 
+// The fields belonging to each class of measurement that is packed into a limited MTU
+#define PACK_FIELD(f) offsetof(ttproto_Telecast, has_##f)
+static const uint16_t pack_geiger[] = {
+    PACK_FIELD(lnd_7318u), PACK_FIELD(lnd_7318c), PACK_FIELD(lnd_7128ec), PACK_FIELD(lnd_712u), PACK_FIELD(lnd_78017w)
+};
+static const uint16_t pack_geiger_error[] = {
+    PACK_FIELD(lnd_7318u_error), PACK_FIELD(lnd_7318c_error), PACK_FIELD(lnd_7128ec_error), PACK_FIELD(lnd_712u_error), PACK_FIELD(lnd_78017w_error)
+};
+static const uint16_t pack_pms[] = {
+    PACK_FIELD(pms_pm01_0), PACK_FIELD(pms_pm02_5), PACK_FIELD(pms_pm10_0),
+    PACK_FIELD(pms_std01_0), PACK_FIELD(pms_std02_5), PACK_FIELD(pms_std10_0)
+};
+static const uint16_t pack_pms_counts[] = {
+    PACK_FIELD(pms_c00_30), PACK_FIELD(pms_c00_50), PACK_FIELD(pms_c01_00), PACK_FIELD(pms_c02_50),
+    PACK_FIELD(pms_c05_00), PACK_FIELD(pms_c10_00), PACK_FIELD(pms_csecs)
+};
+static const uint16_t pack_opc[] = {
+    PACK_FIELD(opc_pm01_0), PACK_FIELD(opc_pm02_5), PACK_FIELD(opc_pm10_0),
+    PACK_FIELD(opc_std01_0), PACK_FIELD(opc_std02_5), PACK_FIELD(opc_std10_0)
+};
+static const uint16_t pack_opc_counts[] = {
+    PACK_FIELD(opc_c00_38), PACK_FIELD(opc_c00_54), PACK_FIELD(opc_c01_00), PACK_FIELD(opc_c02_10),
+    PACK_FIELD(opc_c05_00), PACK_FIELD(opc_c10_00), PACK_FIELD(opc_csecs)
+};
+static const uint16_t pack_env[] = {
+    PACK_FIELD(env_temp), PACK_FIELD(env_humid), PACK_FIELD(env_pressure)
+};
+static const uint16_t pack_enc[] = {
+    PACK_FIELD(enc_temp), PACK_FIELD(enc_humid), PACK_FIELD(enc_pressure)
+};
+static const uint16_t pack_battery[] = {
+    PACK_FIELD(bat_voltage), PACK_FIELD(bat_soc), PACK_FIELD(bat_current)
+};
+typedef struct {
+    uint32_t class;
+    uint32_t requires;          // a class that must also be included
+    uint16_t priority;
+    uint16_t fields;
+    const uint16_t *has_offsets;
+} pack_class_t;
+#define PACK_CLASS(c, r, p, f) {c, r, p, sizeof(f)/sizeof(f[0]), f}
+static const pack_class_t pack_classes[] = {
+    PACK_CLASS(PACK_GEIGER, 0, PACK_PRIORITY_GEIGER, pack_geiger),
+    PACK_CLASS(PACK_GEIGER_ERROR, PACK_GEIGER, PACK_PRIORITY_ERROR, pack_geiger_error),
+    PACK_CLASS(PACK_PMS, 0, PACK_PRIORITY_PMS, pack_pms),
+    PACK_CLASS(PACK_PMS_COUNTS, PACK_PMS, PACK_PRIORITY_COUNTS, pack_pms_counts),
+    PACK_CLASS(PACK_OPC, 0, PACK_PRIORITY_OPC, pack_opc),
+    PACK_CLASS(PACK_OPC_COUNTS, PACK_OPC, PACK_PRIORITY_COUNTS, pack_opc_counts),
+    PACK_CLASS(PACK_ENV, 0, PACK_PRIORITY_ENV, pack_env),
+    PACK_CLASS(PACK_ENC, 0, PACK_PRIORITY_ENC, pack_enc),
+    PACK_CLASS(PACK_BATTERY, 0, PACK_PRIORITY_BATTERY, pack_battery),
+};
+#define PACK_CLASSES (sizeof(pack_classes)/sizeof(pack_classes[0]))
+
+// When each class was last sent
+static uint32_t pack_last_sent[PACK_CLASSES];
+
+// Set or clear the fields of a class of measurement that were present in the message
+static void pack_set(ttproto_Telecast *message, const pack_class_t *c, uint32_t present, bool include) {
+    int i;
+    for (i=0; i<c->fields; i++)
+        if (present & (1 << i))
+            *((bool *)((uint8_t *)message + c->has_offsets[i])) = include;
+}
+
+// Trim the measurements in a message so that its encoding fits within max_length, choosing
+// greedily by priority and staleness those classes of measurement that fit.  The message is
+// left with only the classes that are returned, and its encoded length.  Note that because
+// only the has_ flags are changed, the sizing is done without making a copy of the message.
+uint32_t send_pack(void *msg, uint16_t max_length, uint16_t *length) {
+    ttproto_Telecast *message = (ttproto_Telecast *) msg;
+    uint32_t present[PACK_CLASSES];
+    uint32_t score[PACK_CLASSES];
+    uint32_t included = 0, considered = 0;
+    uint32_t now = get_seconds_since_boot();
+    size_t size;
+    int i, j;
+
+    // Find what's present, and see if we're done
+    for (i=0; i<PACK_CLASSES; i++) {
+        const pack_class_t *c = &pack_classes[i];
+        present[i] = 0;
+        for (j=0; j<c->fields; j++)
+            if (*((bool *)((uint8_t *)message + c->has_offsets[j])))
+                present[i] |= (1 << j);
+        if (present[i] != 0)
+            included |= c->class;
+        score[i] = c->priority + (now - pack_last_sent[i]) / PACK_STALENESS_SECONDS;
+    }
+    if (!pb_get_encoded_size(&size, ttproto_Telecast_fields, message))
+        size = 0xffff;
+    if (size <= max_length) {
+        *length = size;
+        return included;
+    }
+
+    // Start with none of the measurements, then add what fits in order of score
+    for (i=0; i<PACK_CLASSES; i++)
+        pack_set(message, &pack_classes[i], present[i], false);
+    included = 0;
+    for (;;) {
+        int best = -1;
+        for (i=0; i<PACK_CLASSES; i++)
+            if (present[i] != 0 && (considered & pack_classes[i].class) == 0)
+                if (best < 0 || score[i] > score[best])
+                    best = i;
+        if (best < 0)
+            break;
+        considered |= pack_classes[best].class;
+        if (pack_classes[best].requires != 0 && (included & pack_classes[best].requires) == 0)
+            continue;
+        pack_set(message, &pack_classes[best], present[best], true);
+        if (pb_get_encoded_size(&size, ttproto_Telecast_fields, message) && size <= max_length)
+            included |= pack_classes[best].class;
+        else
+            pack_set(message, &pack_classes[best], present[best], false);
+    }
+
+    // If not even one of them fits, leave the message as it was so that it fails as too large
+    if (included == 0)
+        for (i=0; i<PACK_CLASSES; i++)
+            if (present[i] != 0) {
+                pack_set(message, &pack_classes[i], present[i], true);
+                included |= pack_classes[i].class;
+            }
+
+    if (!pb_get_encoded_size(&size, ttproto_Telecast_fields, message))
+        size = 0xffff;
+    *length = size;
+    return included;
+
+}
+
+// Note which classes of measurement have been sent
+void send_pack_sent(uint32_t classes) {
+    int i;
+    uint32_t now = get_seconds_since_boot();
+    for (i=0; i<PACK_CLASSES; i++)
+        if (classes & pack_classes[i].class)
+            pack_last_sent[i] = now;
+}
+
+// A message too large for the MTU, which is sent a fragment at a time
+static struct {
+    bool pending;
+    uint8_t id;
+    uint8_t next;
+    uint8_t count;
+    uint16_t length;
+    uint16_t response_type;
+    uint32_t last_sent;
+    uint32_t spacing;
+    uint8_t message[FRAGMENT_MAX_LENGTH];
+} fragment;
+
+// Begin sending a buffered-format message in fragments, if it's not too large to do so
+static bool send_fragment_start(uint8_t *message, uint16_t length, uint16_t response_type) {
+    uint8_t count = fragment_count(length, comm_get_mtu());
+    if (count == 0)
+        return false;
+    memcpy(fragment.message, message, length);
+    fragment.pending = true;
+    fragment.id++;
+    fragment.next = 0;
+    fragment.count = count;
+    fragment.length = length;
+    fragment.response_type = response_type;
+    fragment.last_sent = 0;
+    fragment.spacing = 0;
+    DEBUG_PRINTF("Fragmenting %db into %d\n", length, count);
+    return true;
+}
+
+// See if there are fragments remaining to be sent
+bool send_fragment_pending() {
+    return fragment.pending;
+}
+
+// Send the next fragment if we've waited long enough since the last one that we
+// stay within the duty cycle.  Only the last fragment asks for a reply, because
+// until then the service has nothing to reply to.
+bool send_fragment_next() {
+    uint8_t frame[FRAGMENT_MAX_FRAME];
+    uint16_t frame_length;
+    bool fLast;
+
+    if (!fragment.pending)
+        return false;
+    if (WouldSuppress(&fragment.last_sent, fragment.spacing))
+        return false;
+
+    frame_length = fragment_build(fragment.message, fragment.length, fragment.id, fragment.next, comm_get_mtu(), frame);
+    if (frame_length == 0) {
+        // The MTU has shrunk since we began, because the transport has changed
+        DEBUG_PRINTF("Fragment %d/%d abandoned\n", fragment.next+1, fragment.count);
+        fragment.pending = false;
+        return false;
+    }
+
+    fLast = (fragment.next+1 == fragment.count);
+    if (!send_to_service(frame, frame_length, fLast ? fragment.response_type : REPLY_NONE, SEND_N))
+        return false;
+    DEBUG_PRINTF("SENT fragment %d/%d %db\n", fragment.next+1, fragment.count, frame_length);
+
+    fragment.next++;
+    fragment.last_sent = get_seconds_since_boot();
+    fragment.spacing = 0;
+#ifdef LORA
+    if (comm_mode() == COMM_LORA)
+        fragment.spacing = 1 + (lora_airtime_ms(frame_length) * (100 - LORA_DUTY_CYCLE_PERCENT)) / (LORA_DUTY_CYCLE_PERCENT * 1000);
+#endif
+    if (fLast)
+        fragment.pending = false;
+
+    return true;
+}
+
+// Measurements made while mobile, held in a batch until it is full or can be sent
+static batch_t batch;
+
+// See if there are batched measurements waiting to be sent
+bool send_batch_pending() {
+    return (batch.count != 0);
+}
+
+// Send the batch as a message of its own, which when the flash database is active will
+// place it there.  Like other buffered messages, it is by default sent reliably.
+bool send_batch_flush() {
+    uint16_t response_type = REPLY_TTSERVE;
+
+    if (batch.count == 0)
+        return true;
+    // While deselected, the batch can only go to the flash database
+    if (comm_is_deselected() && !comm_db_is_active())
+        return false;
+    if ((storage()->flags & FLAG_BUFFERED_EFFICIENT) != 0)
+        response_type = REPLY_NONE;
+    if (!send_to_service(batch.data, batch.length, response_type, SEND_N))
+        return false;
+    DEBUG_PRINTF("SENT batch of %d %db\n", batch.count, batch.length);
+    batch.count = 0;
+    return true;
+}
+
+// Add a measurement to the batch, sending the batch first if the measurement can't join it
+static bool send_batch_add(uint32_t device_id, float lat, float lon, bool fCPM0, uint32_t cpm0, bool fCPM1, uint32_t cpm1) {
+    batch_header_t header;
+    batch_sample_t sample;
+    uint16_t max_length = comm_get_mtu();
+
+    if (!get_current_timestamp(&header.captured_at_date, &header.captured_at_time, &sample.captured_at_offset))
+        return false;
+
+    // Mobile measurements are always flagged as test, as they are when sent individually
+    header.flags = BATCH_LOCATION | BATCH_TEST;
+    if (fCPM0)
+        header.flags |= BATCH_CPM0;
+    if (fCPM1)
+        header.flags |= BATCH_CPM1;
+    header.device_id = device_id;
+    header.motion_began_offset = mobile_session_time_offset;
+    sample.latitude = batch_degrees(lat);
+    sample.longitude = batch_degrees(lon);
+    sample.cpm0 = fCPM0 ? cpm0 : 0;
+    sample.cpm1 = fCPM1 ? cpm1 : 0;
+
+    // The batch must also fit within an entry of the flash database
+    if (comm_db_is_active() && max_length > DB_ENTRY_BYTES)
+        max_length = DB_ENTRY_BYTES;
+
+    if (batch.count != 0 && batch_matches(&batch, &header) && batch_add(&batch, &sample, max_length))
+        return true;
+    if (!send_batch_flush())
+        return false;
+    batch_begin(&batch, &header);
+    return batch_add(&batch, &sample, max_length);
+
+}
+
+// Encode a string field whose value is a null-terminated string
+static bool send_encode_string(pb_ostream_t *stream, const pb_field_t *field, void * const *arg) {
+    char *str = (char *) *arg;
+    if (!pb_encode_tag_for_field(stream, field))
+        return false;
+    return pb_encode_string(stream, (uint8_t *) str, strlen(str));
+}
+
+// Encode the MTU test pattern of the requested length directly into the stream
+static bool send_encode_mtu_test(pb_ostream_t *stream, const pb_field_t *field, void * const *arg) {
+    uint16_t i, length = (uint16_t) (uintptr_t) *arg;
+    uint8_t digit;
+    if (!pb_encode_tag_for_field(stream, field))
+        return false;
+    if (!pb_encode_varint(stream, length))
+        return false;
+    for (i=0; i<length; i++) {
+        digit = '0' + (i % 10);
+        if (!pb_write(stream, &digit, 1))
+            return false;
+    }
+    return true;
+}
+
+// Set a string field of a message being built.  The string isn't copied, and
+// so it must remain valid until the message has been encoded.
+void send_set_string(void *field, char *str) {
+    pb_callback_t *callback = (pb_callback_t *) field;
+    callback->funcs.encode = send_encode_string;
+    callback->arg = str;
+}
+
 // Reset the buffer
 void send_buff_reset() {
 
     // No messages
-    buff_hdr[0] = BUFF_FORMAT_PB_ARRAY;
-    buff_hdr[1] = 0;
-    buff_hdr_used = sizeof(buff_hdr[0]) + sizeof(buff_hdr[1]);
+    buff_count = 0;
+    buff_max_length = 0;
+    buff_hdr_used = 0;
 
     // Always start filling the buffer leaving room for the header
     // which we will ultimately copy into the buffer before doing
     // the UDP I/O.
     buff_data_used = 0;
-    buff_data_left = sizeof(buff_data) - sizeof(buff_hdr);
-    buff_data_base = buff_data + sizeof(buff_hdr);
+    buff_data_left = sizeof(buff_data) - BUFF_HDR_RESERVE;
+    buff_data_base = buff_data + BUFF_HDR_RESERVE;
     buff_pdata = buff_data_base;
     buff_response_type = REPLY_NONE;
 
@@ -230,6 +641,20 @@ void send_buff_reset() {
 
 }
 
+// Size of the header for what's buffered, plus another message of the anticipated length
+static uint16_t send_buff_header_size(uint16_t anticipated) {
+    uint16_t count = buff_count;
+    uint16_t max_length = buff_max_length;
+    uint16_t hdr_used = buff_hdr_used;
+    if (anticipated) {
+        count++;
+        hdr_used += pbarray_varint_size(anticipated);
+        if (anticipated > max_length)
+            max_length = anticipated;
+    }
+    return (pbarray_header_size(count, hdr_used, pbarray_needs_varint(count, max_length)));
+}
+
 // Determine if we should avoid filling any more, out of caution
 bool send_buff_is_full(uint16_t anticipated) {
 
@@ -242,7 +667,7 @@ bool send_buff_is_full(uint16_t anticipated) {
     uint16_t max_buffer_size = sizeof(buff_data) - 250;
 
     // If we've already overflowed, indicate so
-    uint16_t hdr_anticipated = buff_hdr_used + (anticipated ? 1 : 0);
+    uint16_t hdr_anticipated = send_buff_header_size(anticipated);
     if ((hdr_anticipated + buff_data_used + anticipated) > max_buffer_size)
         return true;
 
@@ -259,19 +684,26 @@ bool send_buff_is_empty() {
         send_buff_reset();
 
     // Return whether or not there's anything yet appended into the buffer
-    return (buff_hdr[1] == 0);
+    return (buff_count == 0);
 
 }
 
 
 // Prepare the buff for writing
 uint8_t *send_buff_prepare_for_transmit(uint16_t *lenptr, uint16_t *response_type_ptr) {
+    uint16_t i, offset, length;
+    uint32_t value;
 
-    // Copy the header to be contiguous with the data
-    uint8_t count = buff_hdr[1];
-    uint8_t header_size = sizeof(buff_hdr[0]) + sizeof(buff_hdr[1]) + count;
+    // Build the header so that it is contiguous with the data
+    bool fVarint = pbarray_needs_varint(buff_count, buff_max_length);
+    uint16_t header_size = send_buff_header_size(0);
     uint8_t *header = buff_data_base - header_size;
-    memcpy(header, buff_hdr, header_size);
+    length = pbarray_put_count(header, buff_count, fVarint);
+    offset = 0;
+    for (i=0; i<buff_count; i++) {
+        pbarray_get_varint(buff_hdr, buff_hdr_used, &offset, &value);
+        length += pbarray_put_length(&header[length], (uint16_t) value, fVarint);
+    }
 
     // Return the pointer to the buffer and length to be transmitted
     if (lenptr != NULL)
@@ -282,8 +714,21 @@ uint8_t *send_buff_prepare_for_transmit(uint16_t *lenptr, uint16_t *response_typ
 
 }
 
-// Append a protocol buffer to the send buffer
-bool send_buff_append(uint8_t *ptr, uint8_t len, uint16_t response_type) {
+// Open a stream onto the free space at the end of the send buffer, so that a message can
+// be encoded in place.  It isn't part of the buffer until committed, and so nothing need be
+// done to roll it back.
+void send_buff_stream(pb_ostream_t *stream) {
+
+    // Initialize if we've never yet done so
+    if (!buff_initialized)
+        send_buff_reset();
+
+    *stream = pb_ostream_from_buffer(buff_pdata, buff_data_left);
+
+}
+
+// Commit a message of the given length, already placed at the end of the send buffer
+bool send_buff_commit(uint16_t len, uint16_t response_type) {
 
     // Initialize if we've never yet done so
     if (!buff_initialized)
@@ -294,31 +739,32 @@ bool send_buff_append(uint8_t *ptr, uint8_t len, uint16_t response_type) {
         return false;
 
     // Exit if we've appended too many
-    if (buff_hdr[1] >= (sizeof(buff_hdr) - (sizeof(buff_hdr[0]) + sizeof(buff_hdr[1])) ))
+    if (buff_hdr_used + pbarray_varint_size(len) > sizeof(buff_hdr))
         return false;
 
     // Exit if the body of the buffer is full
     if (buff_data_left < len)
         return false;
 
-    // Remember these in case we need to pop this append
-    buff_pop_hdr = buff_hdr[1];
+    // Remember these in case we need to roll back this commit
+    buff_pop_count = buff_count;
+    buff_pop_max_length = buff_max_length;
     buff_pop_pdata = buff_pdata;
     buff_pop_hdr_used = buff_hdr_used;
     buff_pop_data_used = buff_data_used;
     buff_pop_data_left = buff_data_left;
     buff_pop_response_type = buff_response_type;
 
-    // Append to the buffer
-    memcpy(buff_pdata, ptr, len);
+    // Take the data into the buffer
     buff_pdata += len;
     buff_data_used += len;
     buff_data_left -= len;
 
     // Append to the header
-    buff_hdr[1]++;
-    buff_hdr[sizeof(buff_hdr[0])+buff_hdr[1]] = len;
-    buff_hdr_used++;
+    buff_count++;
+    buff_hdr_used += pbarray_put_varint(&buff_hdr[buff_hdr_used], len);
+    if (len > buff_max_length)
+        buff_max_length = len;
 
     // Set response type, overriding NONE with what is desired
     if (response_type != REPLY_NONE)
@@ -327,7 +773,7 @@ bool send_buff_append(uint8_t *ptr, uint8_t len, uint16_t response_type) {
     // If we've buffered at least 3 items, force a reply response type simply because
     // this means that we've been offline for quite a while and it would be good to give
     // the service a chance to send us a command.
-    if (buff_hdr[1] > 3)
+    if (buff_count > 3)
         buff_response_type = REPLY_TTSERVE;
 
     // Done
@@ -335,23 +781,73 @@ bool send_buff_append(uint8_t *ptr, uint8_t len, uint16_t response_type) {
 
 }
 
+// Append a protocol buffer to the send buffer
+bool send_buff_append(uint8_t *ptr, uint16_t len, uint16_t response_type) {
+
+    // Initialize if we've never yet done so
+    if (!buff_initialized)
+        send_buff_reset();
+
+    // Place it at the end of the buffer, and commit it
+    if (buff_data_left < len)
+        return false;
+    memcpy(buff_pdata, ptr, len);
+    return(send_buff_commit(len, response_type));
+
+}
+
+// Bytes added to a message of the given length when it's sent alone in array format
+static uint16_t send_single_overhead(uint16_t length) {
+    if (!pbarray_needs_varint(1, length))
+        return BUFF_SINGLE_PB_OVERHEAD;
+    return (pbarray_header_size(1, pbarray_varint_size(length), true));
+}
+
 uint16_t send_length_buffered() {
-    if (buff_hdr[1] == 0)
+    if (buff_count == 0)
         return 0;
-    return(sizeof(buff_hdr[0]) + sizeof(buff_hdr[1]) + buff_hdr[1] + buff_data_used);
+    return(send_buff_header_size(0) + buff_data_used);
 }
 
-// Revert the most recent successful append
-void send_buff_append_revert() {
+// Roll back the most recent successful commit
+void send_buff_rollback() {
 
-    buff_hdr[1] = buff_pop_hdr;
+    buff_count = buff_pop_count;
+    buff_max_length = buff_pop_max_length;
     buff_pdata = buff_pop_pdata;
     buff_hdr_used = buff_pop_hdr_used;
     buff_data_used = buff_pop_data_used;
     buff_data_left = buff_pop_data_left;
     buff_response_type = buff_pop_response_type;
-    DEBUG_PRINTF("Revert: %sb buffered.\n", send_length_buffered());
+    DEBUG_PRINTF("Rollback: %db buffered.\n", send_length_buffered());
+
+}
+
+// Hold stats requests in the send buffer, rather than sending each as it is made, for as
+// long as they fit within the MTU.  They go out together with send_stats_flush().
+void send_stats_hold(bool fHold) {
+    stats_hold = fHold;
+}
+
+// See if what's buffered, plus another message of the anticipated length, fits within the MTU
+static bool send_buff_fits_mtu(uint16_t anticipated) {
+    return (!send_buff_is_full(anticipated)
+            && (send_buff_header_size(anticipated) + buff_data_used + anticipated) <= comm_get_mtu());
+}
+
+// Transmit the stats requests that were held, as a single message
+bool send_stats_flush() {
+    uint16_t length, response_type, count = buff_count;
+    uint8_t *xmit_buff;
 
+    if (send_buff_is_empty())
+        return true;
+    xmit_buff = send_buff_prepare_for_transmit(&length, &response_type);
+    if (!send_to_service(xmit_buff, length, response_type, SEND_N))
+        return false;
+    DEBUG_PRINTF("SENT %db (%d stats)\n", length, count);
+    send_buff_reset();
+    return true;
 }
 
 // MTU test in progress?
@@ -406,10 +902,6 @@ bool send_update_to_service(uint16_t UpdateType) {
     if (sensor_op_mode() == OPMODE_TEST_BURN)
         fUploadParticleCounts = true;
 
-    // If we're in a super low MTU mode, don't upload particle counts
-    if (fBadlyLimitedMTU)
-        fUploadParticleCounts = false;
-
     // We keep all these outside of conditional compilation purely for code readability
     bool isGPSDataAvailable = false;
     bool isGeiger0DataAvailable = false;
@@ -421,6 +913,7 @@ bool send_update_to_service(uint16_t UpdateType) {
     bool isEncDataAvailable = false;
     bool isPMSDataAvailable = false;
     bool isOPCDataAvailable = false;
+    bool isBatched = false;
 
 #if defined(TWIMAX17043) || defined(TWIMAX17201) || defined(TWIINA219)
     float batteryVoltage, batterySOC, batteryCurrent;
@@ -524,9 +1017,10 @@ bool send_update_to_service(uint16_t UpdateType) {
 
     // Get Geiger info
 #ifdef GEIGERX
-    uint32_t cpm0, cpm1;
+    uint32_t cpm0, cpm1, cpm0error, cpm1error;
     // Get the geiger values
     s_geiger_get_value(&isGeiger0DataAvailable, &cpm0, &isGeiger1DataAvailable, &cpm1);
+    s_geiger_get_error(&cpm0error, &cpm1error);
 #endif
 
     // Show the POTENTIAL things we might transmit
@@ -554,80 +1048,21 @@ bool send_update_to_service(uint16_t UpdateType) {
         isOPCDataAvailable = false;
     }
 
-    // If we're limited at all, don't send both environmental measurements together
-    if (fLimitedMTU && fUploadParticleCounts) {
-
-        // Only send one sensor or the other
-        if (isPMSDataAvailable) {
-            isOPCDataAvailable = false;
-        }
-
-        // Don't package other things with it.  We've encountered MTU issues
-        // when motion happens (and thus we don't have the benefit of stamp
-        // optimization).
-        if (isOPCDataAvailable || isPMSDataAvailable) {
-            isGeiger0DataAvailable = false;
-            isGeiger1DataAvailable = false;
-            isBatteryVoltageDataAvailable = false;
-            isBatterySOCDataAvailable = false;
-            isBatteryCurrentDataAvailable = false;
-            isEncDataAvailable = false;
-            isEnvDataAvailable = false;
-        }
-
-    }
-
-    // If we're severly limited, strictly send things one class at a time
-    while (fBadlyLimitedMTU && !isStatsRequest) {
-
-        if (isGeiger0DataAvailable || isGeiger1DataAvailable) {
-            isPMSDataAvailable = false;
-            isOPCDataAvailable = false;
-            isEnvDataAvailable = false;
-            isEncDataAvailable = false;
-            isBatteryVoltageDataAvailable = false;
-            isBatterySOCDataAvailable = false;
-            isBatteryCurrentDataAvailable = false;
-            break;
-        }
-
-        if (isPMSDataAvailable) {
-            isOPCDataAvailable = false;
-            isEnvDataAvailable = false;
-            isEncDataAvailable = false;
-            isBatteryVoltageDataAvailable = false;
-            isBatterySOCDataAvailable = false;
-            isBatteryCurrentDataAvailable = false;
-            break;
-        }
-
-        if (isOPCDataAvailable) {
-            isEnvDataAvailable = false;
-            isEncDataAvailable = false;
-            isBatteryVoltageDataAvailable = false;
-            isBatterySOCDataAvailable = false;
-            isBatteryCurrentDataAvailable = false;
-            break;
-        }
-
-        if (isEnvDataAvailable) {
-            isEncDataAvailable = false;
-            isBatteryVoltageDataAvailable = false;
-            isBatterySOCDataAvailable = false;
-            isBatteryCurrentDataAvailable = false;
-            break;
-        }
-
-        if (isEncDataAvailable) {
-            isBatteryVoltageDataAvailable = false;
-            isBatterySOCDataAvailable = false;
-            isBatteryCurrentDataAvailable = false;
-            break;
+#ifdef GEIGERX
+    // When mobile, measurements that would otherwise be buffered or placed into flash
+    // one message at a time are instead added to a compact batch of them.  A batch has
+    // no room for the error of a CPM measured over a shortened window, so those are sent alone.
+    if (!isStatsRequest && isGPSDataAvailable && (isGeiger0DataAvailable || isGeiger1DataAvailable)
+        && cpm0error == 0 && cpm1error == 0
+        && sensor_op_mode() == OPMODE_MOBILE && (fBuffered || comm_db_is_active())) {
+        isBatched = send_batch_add(deviceID, lat, lon, isGeiger0DataAvailable, cpm0, isGeiger1DataAvailable, cpm1);
+        if (isBatched) {
+            s_geiger_clear_measurement();
+            isGeiger0DataAvailable = isGeiger1DataAvailable = false;
+            DEBUG_PRINTF("BATCH %d %db\n", batch.count, batch.length);
         }
-
-        break;
-
     }
+#endif
 
     // Exit if there's truly nothing to send
     if (!isStatsRequest &&
@@ -643,15 +1078,15 @@ bool send_update_to_service(uint16_t UpdateType) {
         if (debug(DBG_COMM_MAX))
             DEBUG_PRINTF("SEND: (nothing to send)\n");
         comm_oneshot_completed();
-        return false;
+        return isBatched;
     }
 
     // Format for transmission
     uint16_t responseType;
     uint16_t status;
-    uint8_t buffer[350];
     ttproto_Telecast message = ttproto_Telecast_init_zero;
-    pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+    char stats_string[128];
+    pb_ostream_t stream;
 
     // As of 2017-03-24, now that we send everything through buffered message
     // format, this field is optional because TTSERVE defaults to SOLARCAST if not present.
@@ -686,63 +1121,64 @@ bool send_update_to_service(uint16_t UpdateType) {
         switch (UpdateType) {
 
         case UPDATE_STATS_VERSION:
-            strlcpy(message.stats_app_version, app_version(), sizeof(message.stats_app_version));
-            message.has_stats_app_version = true;
+            send_set_string(&message.stats_app_version, app_version());
             StatType = "version";
             break;
 
         case UPDATE_STATS_CONFIG_DEV:
-            message.has_stats_device_params = storage_get_device_params_as_string(message.stats_device_params, sizeof(message.stats_device_params));
+            if (storage_get_device_params_as_string(stats_string, sizeof(stats_string)))
+                send_set_string(&message.stats_device_params, stats_string);
             StatType = "device";
             break;
 
         case UPDATE_STATS_CONFIG_GPS:
-            message.has_stats_gps_params = storage_get_gps_params_as_string(message.stats_gps_params, sizeof(message.stats_gps_params));
+            if (storage_get_gps_params_as_string(stats_string, sizeof(stats_string)))
+                send_set_string(&message.stats_gps_params, stats_string);
             StatType = "gps";
             break;
 
         case UPDATE_STATS_CONFIG_SVC:
-            message.has_stats_service_params = storage_get_service_params_as_string(message.stats_service_params, sizeof(message.stats_service_params));
+            if (storage_get_service_params_as_string(stats_string, sizeof(stats_string)))
+                send_set_string(&message.stats_service_params, stats_string);
             StatType = "service";
             break;
 
         case UPDATE_STATS_CONFIG_TTN:
-            strlcpy(message.stats_ttn_params, storage()->ttn_dev_eui, sizeof(message.stats_ttn_params));
-            message.has_stats_ttn_params = true;
+            send_set_string(&message.stats_ttn_params, storage()->ttn_dev_eui);
             StatType = "ttn";
             break;
 
         case UPDATE_STATS_CONFIG_SEN:
-            message.has_stats_sensor_params = storage_get_sensor_params_as_string(message.stats_sensor_params, sizeof(message.stats_sensor_params));
+            if (storage_get_sensor_params_as_string(stats_string, sizeof(stats_string)))
+                send_set_string(&message.stats_sensor_params, stats_string);
             StatType = "sensor";
             break;
 
         case UPDATE_STATS_LABEL:
-            message.has_stats_device_label = storage_get_device_label_as_string(message.stats_device_label, sizeof(message.stats_device_label));
+            if (storage_get_device_label_as_string(stats_string, sizeof(stats_string)))
+                send_set_string(&message.stats_device_label, stats_string);
             StatType = "label";
             break;
 
         case UPDATE_STATS_BATTERY:
             if (!fLimitedMTU && stp->battery[0] != '\0') {
-                strlcpy(message.stats_battery, stp->battery, sizeof(message.stats_battery));
-                message.has_stats_battery = true;
+                send_set_string(&message.stats_battery, stp->battery);
             }
             StatType = "battery";
             break;
 
         case UPDATE_STATS_DFU:
-            message.has_stats_dfu = storage_get_dfu_state_as_string(message.stats_dfu, sizeof(message.stats_dfu));
+            if (storage_get_dfu_state_as_string(stats_string, sizeof(stats_string)))
+                send_set_string(&message.stats_dfu, stats_string);
             StatType = "dfu";
             break;
 
         case UPDATE_STATS_MODULES:
             if (stp->module_lora[0] != '\0') {
-                strlcpy(message.stats_module_lora, stp->module_lora, sizeof(message.stats_module_lora));
-                message.has_stats_module_lora = true;
+                send_set_string(&message.stats_module_lora, stp->module_lora);
             }
             if (stp->module_fona[0] != '\0') {
-                strlcpy(message.stats_module_fona, stp->module_fona, sizeof(message.stats_module_fona));
-                message.has_stats_module_fona = true;
+                send_set_string(&message.stats_module_fona, stp->module_fona);
             }
             StatType = "module";
             break;
@@ -750,8 +1186,7 @@ bool send_update_to_service(uint16_t UpdateType) {
         case UPDATE_STATS_CELL1:
 #ifdef FONA
             if (stp->cell_iccid[0] != '\0') {
-                strlcpy(message.stats_iccid, stp->cell_iccid, sizeof(message.stats_iccid));
-                message.has_stats_iccid = true;
+                send_set_string(&message.stats_iccid, stp->cell_iccid);
             }
 #endif
             StatType = "iccid";
@@ -760,8 +1195,7 @@ bool send_update_to_service(uint16_t UpdateType) {
         case UPDATE_STATS_CELL2:
 #ifdef FONA
             if (stp->cell_cpsi[0] != '\0') {
-                strlcpy(message.stats_cpsi, stp->cell_cpsi, sizeof(message.stats_cpsi));
-                message.has_stats_cpsi = true;
+                send_set_string(&message.stats_cpsi, stp->cell_cpsi);
             }
 #endif
             StatType = "cell";
@@ -769,14 +1203,11 @@ bool send_update_to_service(uint16_t UpdateType) {
 
         case UPDATE_STATS_MTU_TEST:
             if (mtu_test != 0) {
-                if (mtu_test >= sizeof(message.stats_cpsi)-1)
+                if (mtu_test >= MTU_TEST_MAX_LENGTH)
                     mtu_test = 0;
                 else {
-                    int i;
-                    for (i=0; i<mtu_test; i++)
-                        message.stats_cpsi[i] = '0' + (i % 10);
-                    message.stats_cpsi[i] = '\0';
-                    message.has_stats_cpsi = true;
+                    message.stats_cpsi.funcs.encode = send_encode_mtu_test;
+                    message.stats_cpsi.arg = (void *) (uintptr_t) mtu_test;
                     mtu_test++;
                 }
             }
@@ -829,8 +1260,7 @@ bool send_update_to_service(uint16_t UpdateType) {
             }
             // fails on Lora during burn mode with bad twi, where errors accumulate
             if (!fLimitedMTU || strlen(stp->errors_twi_info) < 48) {
-                strlcpy(message.errors_twi_info, stp->errors_twi_info, sizeof(message.errors_twi_info));
-                message.has_errors_twi_info = true;
+                send_set_string(&message.errors_twi_info, stp->errors_twi_info);
             }
             if (stp->errors_spi != 0) {
                 message.errors_spi = stp->errors_spi;
@@ -921,36 +1351,56 @@ bool send_update_to_service(uint16_t UpdateType) {
 #if G0==LND7318U
         message.has_lnd_7318u = true;
         message.lnd_7318u = cpm0;
+        message.has_lnd_7318u_error = (cpm0error != 0);
+        message.lnd_7318u_error = cpm0error;
 #elif G0==LND7318C
         message.has_lnd_7318c = true;
         message.lnd_7318c = cpm0;
+        message.has_lnd_7318c_error = (cpm0error != 0);
+        message.lnd_7318c_error = cpm0error;
 #elif G0==LND7128EC
         message.has_lnd_7128ec = true;
         message.lnd_7128ec = cpm0;
+        message.has_lnd_7128ec_error = (cpm0error != 0);
+        message.lnd_7128ec_error = cpm0error;
 #elif G0==LND712U
         message.has_lnd_712u = true;
         message.lnd_712u = cpm0;
+        message.has_lnd_712u_error = (cpm0error != 0);
+        message.lnd_712u_error = cpm0error;
 #elif G0==LND78017W
         message.has_lnd_78017w = true;
         message.lnd_78017w = cpm0;
+        message.has_lnd_78017w_error = (cpm0error != 0);
+        message.lnd_78017w_error = cpm0error;
 #endif
     }
     if (isGeiger1DataAvailable) {
 #if G1==LND7318U
         message.has_lnd_7318u = true;
         message.lnd_7318u = cpm1;
+        message.has_lnd_7318u_error = (cpm1error != 0);
+        message.lnd_7318u_error = cpm1error;
 #elif G1==LND7318C
         message.has_lnd_7318c = true;
         message.lnd_7318c = cpm1;
+        message.has_lnd_7318c_error = (cpm1error != 0);
+        message.lnd_7318c_error = cpm1error;
 #elif G1==LND7128EC
         message.has_lnd_7128ec = true;
         message.lnd_7128ec = cpm1;
+        message.has_lnd_7128ec_error = (cpm1error != 0);
+        message.lnd_7128ec_error = cpm1error;
 #elif G1==LND712U
         message.has_lnd_712u = true;
         message.lnd_712u = cpm1;
+        message.has_lnd_712u_error = (cpm1error != 0);
+        message.lnd_712u_error = cpm1error;
 #elif G1==LND78017W
         message.has_lnd_78017w = true;
         message.lnd_78017w = cpm1;
+        message.has_lnd_78017w_error = (cpm1error != 0);
+        message.lnd_78017w_error = cpm1error;
 #endif
     }
 #endif
@@ -1172,9 +1622,31 @@ bool send_update_to_service(uint16_t UpdateType) {
             DEBUG_PRINTF("*** Not stamped!\n");
     }
 
-    // Encode the message
+    // Fit as many of the measurements as we can within the MTU, along with whatever the
+    // message must carry regardless.  Those left out remain available, and will be sent later.
+    uint32_t packed = 0;
+    if (!isStatsRequest && !send_mtu_test_in_progress()) {
+        uint16_t packed_length;
+        packed = send_pack(&message, comm_get_mtu() - send_single_overhead(comm_get_mtu()), &packed_length);
+        if ((packed & PACK_GEIGER) == 0)
+            isGeiger0DataAvailable = isGeiger1DataAvailable = false;
+        if ((packed & PACK_PMS) == 0)
+            isPMSDataAvailable = false;
+        if ((packed & PACK_OPC) == 0)
+            isOPCDataAvailable = false;
+        if ((packed & PACK_ENV) == 0)
+            isEnvDataAvailable = false;
+        if ((packed & PACK_ENC) == 0)
+            isEncDataAvailable = false;
+        if ((packed & PACK_BATTERY) == 0)
+            isBatteryVoltageDataAvailable = isBatterySOCDataAvailable = isBatteryCurrentDataAvailable = false;
+    }
+
+    // Encode the message directly into the end of the send buffer.  If there isn't room for it
+    // there behind messages already buffered, it's handled just as a failure to append it.
+    send_buff_stream(&stream);
     status = pb_encode(&stream, ttproto_Telecast_fields, &message);
-    if (!status) {
+    if (!status && send_buff_is_empty()) {
         DEBUG_PRINTF("Send pb_encode: %s\n", PB_GET_ERROR(&stream));
         if (stamp_created)
             stamp_invalidate();
@@ -1185,32 +1657,60 @@ bool send_update_to_service(uint16_t UpdateType) {
     uint16_t bytes_written = stream.bytes_written;
     bool fSent = true;
     bool fMTUFailure = false;
+    bool fHeld = false;
+
+    if (stats_hold && isStatsRequest && status && send_buff_fits_mtu(bytes_written)) {
+
+        // Hold it until the rest of the stats have been added
+        fSent = fHeld = send_buff_commit(bytes_written, responseType);
 
-    if (fBuffered && !send_buff_is_full(bytes_written)) {
+    } else if (stats_hold && isStatsRequest && !send_buff_is_empty()) {
+
+        // It won't fit with those already held, so it must wait for the next message
+        fSent = false;
+
+    } else if (fBuffered && status && !send_buff_is_full(bytes_written)) {
 
         // Buffer it
-        fSent = send_buff_append(buffer, bytes_written, responseType);
+        fSent = send_buff_commit(bytes_written, responseType);
 
     } else {
 
         if (send_buff_is_empty()) {
 
-            // If this is larger than allowable MTU, don't bother
-            if (bytes_written > comm_get_mtu() && !send_mtu_test_in_progress()) {
+            // If this is larger than allowable MTU, send it in fragments if we can.  Only
+            // one message is fragmented at a time, and so any other must wait its turn.
+            if ((bytes_written + send_single_overhead(bytes_written)) > comm_get_mtu() && !send_mtu_test_in_progress()) {
 
-                fMTUFailure = true;
+                if (send_fragment_pending()) {
+                    fSent = false;
+                } else {
+                    uint16_t send_length, send_response_type;
+                    send_buff_commit(bytes_written, responseType);
+                    uint8_t *xmit_buff = send_buff_prepare_for_transmit(&send_length, &send_response_type);
+                    if (!send_fragment_start(xmit_buff, send_length, send_response_type))
+                        fMTUFailure = true;
+                    else if (!(fSent = send_fragment_next()))
+                        fragment.pending = false;
+                    send_buff_reset();
+                }
 
             } else {
 
-                // If the buffer is empty, just send a single PB to the service
-                fSent = send_to_service(buffer, bytes_written, responseType, SEND_1);
+                // If the buffer is empty, just send a single PB to the service, in the
+                // buffer where it lies because that's the only format that we support.
+                uint16_t send_length, send_response_type;
+                send_buff_commit(bytes_written, responseType);
+                uint8_t *xmit_buff = send_buff_prepare_for_transmit(&send_length, &send_response_type);
+                fSent = send_to_service(xmit_buff, send_length, send_response_type, SEND_N);
+                send_buff_reset();
 
             }
 
         } else {
             // Append this to the existing buffer, remembering whether or not it succeeded.
             // Ultimately, if it isn't sent, we'll come back here to retry sending it.
-            fSent = send_buff_append(buffer, bytes_written, responseType);
+            fSent = status && send_buff_commit(bytes_written, responseType);
 
             // Regardless of whether or not it succeeded, we must transmit what's in the buffer
             // so that we don't get stuck forever with a full buffer.  Prepare for transmission
@@ -1242,9 +1742,9 @@ bool send_update_to_service(uint16_t UpdateType) {
                 if (send_to_service(xmit_buff, bytes_written, send_response_type, SEND_N)) {
                     send_buff_reset();
                 } else {
-                    // If error AND if the append had succeeded, revert it
+                    // If error AND if the commit had succeeded, roll it back
                     if (fSent)
-                        send_buff_append_revert();
+                        send_buff_rollback();
                 }
             }
 
@@ -1321,7 +1821,7 @@ bool send_update_to_service(uint16_t UpdateType) {
     }
 
     if (fMTUFailure || fSent || debug(DBG_COMM_MAX))
-        DEBUG_PRINTF("%s %s\n", fMTUFailure ? "FAIL" : (fSent ? (fBuffered ? "BUFF" : "SENT") : "WAIT"), sent_msg);
+        DEBUG_PRINTF("%s %s\n", fMTUFailure ? "FAIL" : (fSent ? ((fBuffered || fHeld) ? "BUFF" : "SENT") : "WAIT"), sent_msg);
 
     // If we exceeded MTU with this message, DISCARD the data because otherwise we will be stuck
     // in an infinite retry loop trying to send the same data over and over.
@@ -1336,6 +1836,7 @@ bool send_update_to_service(uint16_t UpdateType) {
     }
 
     // Clear them once transmitted successfully
+    send_pack_sent(packed);
 #ifdef GEIGERX
     if (isGeiger0DataAvailable || isGeiger1DataAvailable)
         s_geiger_clear_measurement();
@@ -9,8 +9,38 @@
 // special case version number 8 because of the old style "single protocl buffer" message format that
 // always begins with 0x08. (see ttserve/main.go)
 #define BUFF_FORMAT_PB_ARRAY        0
+#define BUFF_FORMAT_FRAGMENT        1
+#define BUFF_FORMAT_BATCH           2
+#define BUFF_FORMAT_PB_VARINT_ARRAY 3
 #define BUFF_FORMAT_SINGLE_PB       8
 
+// Bytes added to a message when it's sent alone in array format: format, count, and length.
+// A message longer than 255 bytes needs the varint format, and a byte more for its length.
+#define BUFF_SINGLE_PB_OVERHEAD     3
+
+// Fields that may be cached by the service under a stamp.  A message that creates
+// a stamp says which of them the service should cache, and a message to which the
+// stamp has been applied says which of them the service should restore.
+#define STAMP_CAPTURED_AT       0x0001      // captured_at_date, captured_at_time
+#define STAMP_LOCATION          0x0002      // latitude, longitude, altitude
+#define STAMP_MOTION_BEGAN      0x0004      // motion_began_offset
+#define STAMP_TEST              0x0008      // test
+#define STAMP_BAT_VOLTAGE       0x0010      // bat_voltage
+#define STAMP_BAT_SOC           0x0020      // bat_soc
+#define STAMP_ENC_TEMP          0x0040      // enc_temp
+#define STAMP_ENC_HUMID         0x0080      // enc_humid
+
+// Classes of measurement that are packed into a message limited by MTU
+#define PACK_GEIGER             0x0001
+#define PACK_PMS                0x0002
+#define PACK_PMS_COUNTS         0x0004
+#define PACK_OPC                0x0008
+#define PACK_OPC_COUNTS         0x0010
+#define PACK_ENV                0x0020
+#define PACK_ENC                0x0040
+#define PACK_BATTERY            0x0080
+#define PACK_GEIGER_ERROR       0x0100
+
 // Statistic upload modes
 #define UPDATE_NORMAL           0
 #define UPDATE_STATS            1
@@ -46,5 +76,14 @@ void send_mtu_test(uint16_t start_length);
 void mtu_status_check(bool fForce);
 bool send_buff_is_full(uint16_t anticipated);
 bool send_buff_is_empty();
+void send_set_string(void *field, char *str);
+uint32_t send_pack(void *message, uint16_t max_length, uint16_t *length);
+void send_pack_sent(uint32_t classes);
+bool send_fragment_pending();
+bool send_fragment_next();
+bool send_batch_pending();
+bool send_batch_flush();
+void send_stats_hold(bool fHold);
+bool send_stats_flush();
 
 #endif // SEND_H__
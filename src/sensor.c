@@ -61,6 +61,16 @@ static bool fTestModeRequested = false;
 static bool fInit = false;
 void sensor_init();
 
+// Set when something outside the poller may have changed what is due.  This may
+// be set at interrupt level, and so the queue itself is only touched by the poller.
+static volatile bool sensor_reschedule_requested = true;
+
+// Request that all groups be re-examined on the next poll
+static void sensor_reschedule() {
+    sensor_reschedule_requested = true;
+    timer_request_poll();
+}
+
 // Get the time suppression
 uint16_t sensor_get_mobile_upload_period() {
     return mobile_period;
@@ -175,6 +185,7 @@ void sensor_measurement_completed(sensor_t *s) {
         return;
     s->state.is_completed = true;
     s->state.is_polling_valid = false;
+    sensor_reschedule();
     if (debug(DBG_SENSOR))
         DEBUG_PRINTF("%s measured\n", s->name);
 }
@@ -188,6 +199,7 @@ void sensor_unconfigure(sensor_t *s) {
         return;
     s->state.is_completed = true;
     s->state.is_polling_valid = false;
+    sensor_reschedule();
     if (sensor_op_mode() == OPMODE_TEST_BURN) {
         DEBUG_PRINTF("Would have deconfigured if not in burn-in test mode: %s\n", s->name);
     } else {
@@ -248,6 +260,7 @@ void sensor_test(char *name) {
             }
         }
     }
+    sensor_reschedule();
     if (!fTestModeRequested) {
         if (name[0] != '\0')
             DEBUG_PRINTF("Sensor not found\n");
@@ -268,6 +281,7 @@ bool sensor_schedule_now() {
             g->state.last_repeated = 0;
         }
     }
+    sensor_reschedule();
     DEBUG_PRINTF("Sensor timings have been accelerated.\n");
     return true;
 }
@@ -278,6 +292,7 @@ bool sensor_group_schedule_now(char *gname) {
     if (g == NULL)
         return false;
     g->state.last_repeated = 0;
+    sensor_reschedule();
     return true;
 }
 
@@ -299,6 +314,8 @@ bool sensor_group_completed(group_t *g) {
             s->state.is_polling_valid = false;
             somethingCompleted = true;
         }
+    if (somethingCompleted)
+        sensor_reschedule();
     if (somethingCompleted && debug(DBG_SENSOR_MAX))
         DEBUG_PRINTF("%s is completed.\n", g->name);
     return (somethingCompleted);
@@ -587,11 +604,133 @@ void sensor_set_pin_state(uint16_t pin, bool enable) {
         gpio_power_set(pin, enable);
 }
 
+// Number of groups in the table, and the queue of those that are configured, ordered
+// by the time at which each next needs attention from the poller
+#define SENSOR_GROUPS ((sizeof(sensor_groups)/sizeof(sensor_groups[0]))-1)
+#define SENSOR_NEVER 0xffffffffL
+static group_t *sensor_queue[SENSOR_GROUPS];
+static uint16_t sensor_queue_length = 0;
+
+// Insert a group into the queue, ordered by when it is next due
+static void sensor_queue_push(group_t *g, uint32_t due) {
+    uint16_t i, parent;
+    g->state.next_due = due;
+    for (i = sensor_queue_length++; i > 0; i = parent) {
+        parent = (i-1)/2;
+        if (sensor_queue[parent]->state.next_due <= due)
+            break;
+        sensor_queue[i] = sensor_queue[parent];
+    }
+    sensor_queue[i] = g;
+}
+
+// Remove the group that is due soonest
+static group_t *sensor_queue_pop() {
+    group_t *first = sensor_queue[0];
+    group_t *last = sensor_queue[--sensor_queue_length];
+    uint16_t i, child;
+    for (i = 0; (child = (2*i)+1) < sensor_queue_length; i = child) {
+        if (child+1 < sensor_queue_length && sensor_queue[child+1]->state.next_due < sensor_queue[child]->state.next_due)
+            child++;
+        if (last->state.next_due <= sensor_queue[child]->state.next_due)
+            break;
+        sensor_queue[i] = sensor_queue[child];
+    }
+    sensor_queue[i] = last;
+    return first;
+}
+
+// Make every configured group due if anything that the poller's decisions depend upon has changed
+static void sensor_reschedule_if_changed() {
+    static uint16_t last_battery_status, last_op_mode, last_comm_mode, last_uart;
+    static bool last_deselected, last_test_mode_requested;
+    group_t **gp, *g;
+    uint16_t bat_status = battery_status();
+    uint16_t op_mode = sensor_op_mode();
+    uint16_t active_comm_mode = comm_mode();
+    uint16_t uart = gpio_current_uart();
+    bool deselected = comm_is_deselected();
+
+    if (bat_status != last_battery_status || op_mode != last_op_mode || active_comm_mode != last_comm_mode
+        || uart != last_uart || deselected != last_deselected || fTestModeRequested != last_test_mode_requested) {
+        last_battery_status = bat_status;
+        last_op_mode = op_mode;
+        last_comm_mode = active_comm_mode;
+        last_uart = uart;
+        last_deselected = deselected;
+        last_test_mode_requested = fTestModeRequested;
+        sensor_reschedule_requested = true;
+    }
+
+    if (!sensor_reschedule_requested)
+        return;
+    sensor_reschedule_requested = false;
+
+    sensor_queue_length = 0;
+    for (gp = &sensor_groups[0]; (g = *gp) != END_OF_LIST; gp++)
+        if (g->state.is_configured)
+            sensor_queue_push(g, 0);
+
+}
+
+// When a suppression interval ends, mirroring the test made by ShouldSuppress()
+static uint32_t sensor_expiry(uint32_t lastTime, uint32_t suppressionSeconds) {
+    if (lastTime == 0)
+        return 0;
+    return (lastTime + suppressionSeconds);
+}
+
+// Determine when a group next needs to be polled, given the state that the last poll left it in.
+// Anything that is waiting for a condition other than time is due again on the next poll.
+static uint32_t sensor_group_next_due(group_t *g) {
+    sensor_t **sp, *s;
+
+    if (sensor_op_mode() == OPMODE_TEST_SENSOR && !g->state.is_being_tested)
+        return SENSOR_NEVER;
+
+    // Idle, waiting for its repeat period
+    if (!g->state.is_processing) {
+        if (fTestModeRequested)
+            return SENSOR_NEVER;
+        if (sensor_op_mode() == OPMODE_TEST_SENSOR)
+            return 0;
+        return sensor_expiry(g->state.last_repeated, group_repeat_seconds(g));
+    }
+
+    // Settling as a group
+    if (g->state.is_settling) {
+        if (g->settling_seconds == 0)
+            return 0;
+        return sensor_expiry(g->state.last_settled, g->settling_seconds);
+    }
+
+    // Sampling, which needs polling until done except while a sensor is settling
+    for (sp = &g->sensors[0]; (s = *sp) != END_OF_LIST; sp++) {
+        if (!s->state.is_configured || s->state.is_completed)
+            continue;
+        if (sensor_op_mode() == OPMODE_TEST_SENSOR && !s->state.is_being_tested)
+            continue;
+        if (s->state.is_processing && s->state.is_settling && s->settling_seconds != 0)
+            return sensor_expiry(s->state.last_settled, s->settling_seconds);
+        break;
+    }
+    return 0;
+
+}
+
+// The time at which the poller next has something to do, in seconds since boot
+uint32_t sensor_next_due() {
+    if (!fInit || sensor_reschedule_requested || sensor_queue_length == 0)
+        return 0;
+    return sensor_queue[0]->state.next_due;
+}
+
 // Poll, advancing the state machine
 void sensor_poll() {
     static int inside_poll = 0;
     bool groups_currently_active;
     int pending;
+    uint32_t now;
     group_t **gp, *g;
     sensor_t **sp, *s;
 
@@ -631,11 +770,23 @@ void sensor_poll() {
     if (debug(DBG_SENSOR_SUPERDUPERMAX))
         DEBUG_PRINTF("sensor_poll enter\n");
 
-    // Loop over all configured sensors in all configured groups
+    // Only the groups that are due need to be looked at, because polling any other
+    // group would find that it is still waiting for a timer to expire.
+    sensor_reschedule_if_changed();
+    now = get_seconds_since_boot();
+    while (sensor_queue_length != 0 && sensor_queue[0]->state.next_due <= now)
+        sensor_queue_pop()->state.is_due = true;
+
+    // Loop over the due groups in table order, so that earlier groups keep their
+    // precedence for exclusive resources
     groups_currently_active = 0;
 
     for (gp = &sensor_groups[0]; (g = *gp) != END_OF_LIST; gp++) {
 
+        // If not due, skip this group
+        if (!g->state.is_due)
+            continue;
+
         // If not configured, skip this group
         if (!g->state.is_configured)
             continue;
@@ -654,6 +805,12 @@ void sensor_poll() {
             if (fTestModeRequested)
                 continue;
 
+            // If we're in the repeat idle period for this group there is nothing else to check.
+            // This is the same test that is made (with side-effects) just before starting.
+            if (sensor_op_mode() != OPMODE_TEST_SENSOR)
+                if (WouldSuppress(&g->state.last_repeated, group_repeat_seconds(g)))
+                    continue;
+
             // Skip if this group doesn't need to be processed right now
             if (g->skip_handler != NO_HANDLER && sensor_op_mode() != OPMODE_TEST_SENSOR)
                 if (g->skip_handler(g)) {
@@ -1068,6 +1225,15 @@ void sensor_poll() {
 
     } // Looping across groups
 
+    // Requeue the groups that were polled, based upon the state that they were left in
+    for (gp = &sensor_groups[0]; (g = *gp) != END_OF_LIST; gp++) {
+        if (g->state.is_due) {
+            g->state.is_due = false;
+            if (g->state.is_configured)
+                sensor_queue_push(g, sensor_group_next_due(g));
+        }
+    }
+
     // If no groups are currently active and test mode was requested, we
     // can now enter it.
     if (fTestModeRequested) {
@@ -87,6 +87,8 @@ struct group_state_s {
     uint32_t last_settled;
     uint32_t last_repeated;
     uint32_t repeat_seconds_override;
+    uint32_t next_due;
+    bool is_due;
     struct _group_app_timer {
         // see APP_TIMER_DEF in app_timer.h
         app_timer_t timer_data;
@@ -178,6 +180,7 @@ bool sensor_test_mode();
 void *sensor_group_name(char *name);
 bool sensor_schedule_now();
 bool sensor_group_schedule_now(char *gname);
+uint32_t sensor_next_due();
 void sensor_freeze(bool fFreeze);
 bool sensor_is_being_tested(sensor_t *s);
 void sensor_test(char *name);
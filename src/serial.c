@@ -12,8 +12,13 @@
 #include "nrf_delay.h"
 #include "custom_board.h"
 #include "app_uart.h"
+#include "app_scheduler.h"
 #include "serial.h"
 #include "gpio.h"
+#include "ring.h"
+#include "stats.h"
+#include "config.h"
+#include "comm.h"
 
 #ifdef LORA
 #include "lora.h"
@@ -44,9 +49,17 @@
 #define UART_RX_BUF_SIZE 1024
 #else
 #define UART_TX_BUF_SIZE 256
-#define UART_RX_BUF_SIZE 256
+#define UART_RX_BUF_SIZE 64
 #endif
 
+// Received bytes are moved at interrupt level into this ring, which is drained in bulk by the
+// scheduler.  It is sized to hold what the modem might send during the longest of the delays
+// taken by the state machines.
+#define UART_RING_SIZE 1024
+static uint8_t uart_ring_buffer[UART_RING_SIZE];
+static ring_t uart_ring;
+static volatile bool uart_drain_scheduled = false;
+
 static bool fSerialInit = false;
 static bool fTransmitDisabled = false;
 static bool fHWFC = false;
@@ -190,59 +203,82 @@ void add_to_debug_log(uint16_t databyte) {
 }
 #endif
 
-// Handle serial input events
 #ifndef DISABLE_UART
-void uart_event_handler(app_uart_evt_t *p_event) {
-    uint8_t databyte;
 
-    // Exit if we're in the middle of switching uarts
-    if (!fSerialInit)
-        return;
+// Have the scheduler drain the receive ring
+static void serial_drain(void *p_event_data, uint16_t event_size);
+static void serial_schedule_drain() {
+    uart_drain_scheduled = true;
+    if (app_sched_event_put(NULL, 0, serial_drain) != NRF_SUCCESS)
+        uart_drain_scheduled = false;
+}
 
-    switch (p_event->evt_type) {
+// Deliver what has been received to whichever module is on the UART
+static void serial_drain(void *p_event_data, uint16_t event_size) {
+    uint8_t databyte;
 
-    case APP_UART_DATA_READY: {
-        int i;
-        // We're called here at interrupt level, with serial
-        // interrupts disabled.  On the one hand, if we only process
-        // a single byte per interrupt, we may never catch up
-        // if in fact the fifo starts to fill up and we are behind.
-        // On the other hand, if we stay here too long (such as a
-        // "while app_uart_get()==success"), we could cause significant
-        // problems staying in the interrupt handler for too long.
-        // This number is chosen as a "reasonable" number that
-        // enables us to consume several bytes from the rx queue
-        // without hanging us in here for too too long.
-        for (i=0; i<4; i++) {
-            if (app_uart_get(&databyte) != NRF_SUCCESS)
-                break;
+    // Clear this first, so that anything arriving while we drain will schedule us again
+    uart_drain_scheduled = false;
+
+    while (fSerialInit && ring_get(&uart_ring, &databyte)) {
 #ifdef SERIALRECEIVEDEBUG
-            if (gpio_current_uart() != UART_NONE)
-                add_to_debug_log(databyte);
+        if (gpio_current_uart() != UART_NONE)
+            add_to_debug_log(databyte);
 #endif
-            switch (gpio_current_uart()) {
+        switch (gpio_current_uart()) {
 #if defined(PMSX) && PMSX==IOUART
-            case UART_PMS:
-                pms_received_byte(databyte);
-                break;
+        case UART_PMS:
+            pms_received_byte(databyte);
+            break;
 #endif
 #ifdef LORA
-            case UART_LORA:
-                lora_received_byte(databyte);
-                break;
+        case UART_LORA:
+            lora_received_byte(databyte);
+            break;
 #endif
 #ifdef FONA
-            case UART_FONA:
-                fona_received_byte(databyte);
-                break;
+        case UART_FONA:
+            fona_received_byte(databyte);
+            break;
 #endif
 #ifdef UGPS
-            case UART_GPS:
-                s_ugps_received_byte(databyte);
-                break;
+        case UART_GPS:
+            s_ugps_received_byte(databyte);
+            break;
 #endif
-            }
         }
+        // Let whatever a completed line has scheduled run before delivering any more,
+        // just as if the rest had arrived afterward, so the command buffer isn't flooded
+        if (databyte == '\n' && !ring_empty(&uart_ring)) {
+            serial_schedule_drain();
+            break;
+        }
+    }
+
+}
+#endif // DISABLE_UART
+
+// Handle serial input events
+#ifndef DISABLE_UART
+void uart_event_handler(app_uart_evt_t *p_event) {
+    uint8_t databyte;
+
+    // Exit if we're in the middle of switching uarts
+    if (!fSerialInit)
+        return;
+
+    switch (p_event->evt_type) {
+
+    case APP_UART_DATA_READY: {
+        // We're called here at interrupt level, with serial interrupts disabled, so
+        // do no more than move what's arrived into the ring, leaving it to be
+        // processed by the scheduler.  Because that's all we do, we can afford to
+        // take everything that's waiting rather than just a few bytes at a time.
+        // What doesn't fit is counted by the ring, in the overrun stats.
+        while (app_uart_get(&databyte) == NRF_SUCCESS)
+            ring_put(&uart_ring, databyte);
+        if (!uart_drain_scheduled && !ring_empty(&uart_ring))
+            serial_schedule_drain();
         break;
     }
 
@@ -277,12 +313,13 @@ void serial_init(uint32_t speed, bool hwfc) {
         return;
 #endif
 
-        // Close the UART.
+        // Close the UART, discarding anything received that hasn't yet been processed
         fSerialInit = false;
         fTransmitDisabled = true;
 #ifndef DISABLE_UART
         app_uart_close();
 #endif
+        ring_flush(&uart_ring);
 
         // Disable the pins, to ensure there is no leakage path
         gpio_cfg_input(RX_PIN);
@@ -357,6 +394,7 @@ void serial_init(uint32_t speed, bool hwfc) {
     app_irq_priority_t priority;
     static uint8_t rx_buf[UART_RX_BUF_SIZE];
     static uint8_t tx_buf[UART_TX_BUF_SIZE];
+    ring_init(&uart_ring, uart_ring_buffer, sizeof(uart_ring_buffer), &stats()->errors_overrun);
     buffer_params.rx_buf      = rx_buf;
     buffer_params.rx_buf_size = sizeof (rx_buf);
     buffer_params.tx_buf      = tx_buf;
@@ -11,14 +11,17 @@
 #include "stats.h"
 #include "storage.h"
 #include "misc.h"
+#include "timer.h"
 #include "io.h"
 
 // Static statistics
 static stats_t st;
 
-// Update uptime stats
+// Update uptime stats, counting every minute that has passed because when idle
+// we aren't necessarily called once a minute
 void stats_update() {
-    if (!ShouldSuppress(&st.last_minute, 60)) {
+    while (!WouldSuppress(&st.last_minute, 60)) {
+        st.last_minute = (st.last_minute == 0) ? get_seconds_since_boot() : (st.last_minute + 60);
         st.uptime_minutes++;
         if (st.uptime_minutes >= 60) {
             st.uptime_minutes = 0;
@@ -72,6 +75,22 @@ void stats_io(uint16_t transmitted, uint16_t received) {
     }
 }
 
+// Bump stats about the bytes actually exchanged with the cellular modem, which
+// include HTTP headers and any hex encoding that wraps what was sent or received
+void stats_cell_io(uint16_t transmitted, uint16_t received) {
+    st.cell_wire_transmitted += transmitted;
+    st.cell_wire_received += received;
+}
+
+// Note the time taken for the service to reply to a cellular request
+void stats_cell_reply(uint32_t milliseconds) {
+    st.cell_replies++;
+    st.cell_reply_ms_last = milliseconds;
+    st.cell_reply_ms_total += milliseconds;
+    if (milliseconds > st.cell_reply_ms_max)
+        st.cell_reply_ms_max = milliseconds;
+}
+
 // Quick status check
 void stats_status_check(bool fVerbose) {
     if (fVerbose) {
@@ -82,5 +101,12 @@ void stats_status_check(bool fVerbose) {
             DEBUG_PRINTF("FULLDAY: xmt:%d mxmt:%d rcv:%d cnt:%d j:%d d:%d\n",
                          st.transmitted_fullday, st.max_transmitted_fullday, st.received_fullday, st.messages_fullday,
                          st.joins_fullday, st.denies_fullday);
+        if (st.cell_requests)
+            DEBUG_PRINTF("CELL: xmt:%d rcv:%d ses:%d req:%d rpl:%d ms:%d avg:%d max:%d\n",
+                         st.cell_wire_transmitted, st.cell_wire_received, st.cell_sessions, st.cell_requests, st.cell_replies,
+                         st.cell_reply_ms_last, st.cell_replies ? st.cell_reply_ms_total / st.cell_replies : 0,
+                         st.cell_reply_ms_max);
+        if (st.errors_overrun || st.errors_framing)
+            DEBUG_PRINTF("RX: ovr:%d frm:%d\n", st.errors_overrun, st.errors_framing);
     }
 }
@@ -53,6 +53,8 @@ struct stats_s {
     char errors_twi_info[128];
     uint32_t errors_lis;
     uint32_t errors_spi;
+    uint32_t errors_overrun;
+    uint32_t errors_framing;
     uint32_t errors_connect_lora;
     uint32_t errors_connect_fona;
     uint32_t errors_connect_gateway;
@@ -60,6 +62,14 @@ struct stats_s {
     uint32_t errors_connect_data;
     uint32_t errors_connect_service;
     uint32_t mtu_failures;
+    uint32_t cell_wire_transmitted;
+    uint32_t cell_wire_received;
+    uint32_t cell_sessions;
+    uint32_t cell_requests;
+    uint32_t cell_replies;
+    uint32_t cell_reply_ms_last;
+    uint32_t cell_reply_ms_max;
+    uint32_t cell_reply_ms_total;
     uint32_t seqno;
 };
 typedef struct stats_s stats_t;
@@ -69,5 +79,7 @@ stats_t *stats();
 void stats_update();
 void stats_status_check(bool fVerbose);
 void stats_io(uint16_t transmitted, uint16_t received);
+void stats_cell_io(uint16_t transmitted, uint16_t received);
+void stats_cell_reply(uint32_t milliseconds);
 
 #endif // STATS_H__
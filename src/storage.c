@@ -5,16 +5,19 @@
 // Flash storage support
 
 #include <stdint.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include "debug.h"
 #include "comm.h"
 #include "timer.h"
+#include "app_scheduler.h"
 #include "nrf_delay.h"
 #include "app_error.h"
 #include "config.h"
 #include "storage.h"
 #include "softdevice_handler.h"
+#include "crc32.h"
 
 #define DEBUGSTORAGE false
 
@@ -60,6 +63,64 @@ const uint32_t * address_of_db_page(uint16_t page_num) {
 #endif
 #endif  // OLDSTORAGE
 
+// The DB region is an append-only journal.  Each record is a header followed by
+// its data padded to a word, and records never span pages.  Pages are erased
+// only when the tail wraps around onto them.  Every record carries the sequence
+// number through which entries have been released, so that the newest record
+// always holds it even after older pages are erased.  Uploaded entries are
+// released by appending a data-less release record, so any number of them are
+// released in one write.  Writes and erases complete asynchronously, and an
+// entry is only counted once it is intact in flash.  A record that fails to
+// write ends its page, exactly as a torn one found at boot would, and any
+// release that didn't make it into flash is written again.
+#if DB_ENABLED
+typedef struct {
+    uint16_t length;
+    uint16_t request_type;
+    uint32_t sequence;
+    uint32_t released;
+    uint32_t crc;
+} db_record_t;
+#define DB_BLANK                0xFFFF
+#define DB_RELEASE              0xFFFE
+#define DB_NONE                 0xFFFFFFFFL
+#define db_record_bytes(len)    (sizeof(db_record_t) + ((((uint32_t)(len))+PHY_WORD_SIZE-1) & ~(PHY_WORD_SIZE-1)))
+#define DB_RECORD_WORDS         (db_record_bytes(DB_ENTRY_BYTES)/PHY_WORD_SIZE)
+#define DB_RELEASE_WORDS        (db_record_bytes(0)/PHY_WORD_SIZE)
+
+// Journal state, recovered from flash at boot
+static uint16_t db_count = 0;
+static uint32_t db_head = 0;
+static uint32_t db_tail = 0;
+static uint32_t db_sequence = 1;
+static uint32_t db_released_through = 0;
+
+// Records being appended, which must stay intact until fstorage is done with
+// them, where each is being written, or DB_NONE, and the page being erased
+static uint32_t db_record[DB_RECORD_WORDS];
+static uint32_t db_record_offset = DB_NONE;
+static bool db_record_retried = false;
+static uint32_t db_release_record[DB_RELEASE_WORDS];
+static uint32_t db_release_offset = DB_NONE;
+static bool db_release_deferred = false;
+static uint32_t db_erase_offset = DB_NONE;
+
+// A write that failed, which strands whatever was queued after it on its page
+static uint32_t db_failed_offset = DB_NONE;
+
+// The entry last found by db_peek, so that walking them in order is linear
+static uint16_t db_cursor_index = 0;
+static uint32_t db_cursor_offset = DB_NONE;
+
+// Completions handed from the fstorage callback to the scheduler
+#define DB_OP_RECORD            0
+#define DB_OP_RELEASE           1
+#define DB_OP_ERASE             2
+
+static void db_init();
+static void db_completed(void *p_event_data, uint16_t event_size);
+#endif
+
 // Storage context
 static bool storage_initialized = false;
 static bool storage_save_pending = false;
@@ -98,10 +159,19 @@ static void tt_fs_event_handler(fs_evt_t const * const evt, fs_ret_t result)
 #if DB_ENABLED
 static void db_fs_event_handler(fs_evt_t const * const evt, fs_ret_t result)
 {
-    if (result != FS_SUCCESS)
-    {
-        // An error occurred.
-    }
+    uint32_t completion;
+
+    if (evt->id == FS_EVT_ERASE)
+        completion = DB_OP_ERASE;
+    else if (evt->p_context == db_record)
+        completion = DB_OP_RECORD;
+    else
+        completion = DB_OP_RELEASE;
+    completion |= ((uint32_t) result) << 8;
+
+    // This is at interrupt level, so the journal is updated at app_sched level if we can
+    if (app_sched_event_put(&completion, sizeof(completion), db_completed) != NRF_SUCCESS)
+        db_completed(&completion, sizeof(completion));
 }
 #endif
 
@@ -191,6 +261,11 @@ void storage_init() {
     // Load it
     initSuccess = storage_load();
 
+    // Recover the state of the data buffer journal
+#if DB_ENABLED
+    db_init();
+#endif
+
     // Determine whether or not what we've read is valid
     reinitStorage = true;
     if (initSuccess && tt.storage.signature_top == VALID_SIGNATURE && tt.storage.signature_bottom == VALID_SIGNATURE)
@@ -199,6 +274,15 @@ void storage_init() {
             reinitStorage = false;
         }
 
+    // Version 1 may have left part of the old data buffer index where the LoRaWAN history now is
+    if (!reinitStorage && tt.storage.version < 2) {
+        DEBUG_PRINTF("Migrating storage from version %d\n", tt.storage.version);
+        tt.storage.version = 2;
+        memset(&tt.storage.versions.v1.lorawan_sf, 0, sizeof(tt.storage.versions.v1.lorawan_sf));
+        memset(&tt.storage.versions.v1.lorawan_snr, 0, sizeof(tt.storage.versions.v1.lorawan_snr));
+        storage_save(true);
+    }
+
     // Reinitialize storage if we must
     if (reinitStorage) {
         // Initialize the in-memory structure
@@ -225,8 +309,8 @@ void storage_set_to_default() {
     // Set the storage signature
     tt.storage.signature_top = tt.storage.signature_bottom = VALID_SIGNATURE;
 
-    // We're operating on v1 as the most current version
-    tt.storage.version = 1;
+    // We're operating on v1, as extended by the most current version
+    tt.storage.version = MAX_SUPPORTED_VERSION;
 
     // Initialize ALL fields of our in-memory structure to the current version
 #ifdef STORAGE_PRODUCT
@@ -358,15 +442,15 @@ void storage_set_to_default() {
     tt.storage.versions.v1.dfu_error = DFU_ERR_NONE;
     tt.storage.versions.v1.dfu_count = 0;
 
-    // Initialize data buffers
+    // Clear the retired data buffer index
 #if DB_ENABLED
-    tt.storage.versions.v1.db_filled = 0;
-    tt.storage.versions.v1.db_next_to_fill = 0;
-    tt.storage.versions.v1.db_next_to_upload = 0;
-    memset(&tt.storage.versions.v1.db_length, 0, sizeof(tt.storage.versions.v1.db_length));
-    memset(&tt.storage.versions.v1.db_request_type, 0, sizeof(tt.storage.versions.v1.db_request_type));
+    memset(&tt.storage.versions.v1.db_unused, 0, sizeof(tt.storage.versions.v1.db_unused));
 #endif
-    
+
+    // No spreading factor has yet been learned in any region
+    memset(&tt.storage.versions.v1.lorawan_sf, 0, sizeof(tt.storage.versions.v1.lorawan_sf));
+    memset(&tt.storage.versions.v1.lorawan_snr, 0, sizeof(tt.storage.versions.v1.lorawan_snr));
+
 }
 
 // Get a static help string indicating how the as_string stuff works
@@ -746,7 +830,7 @@ char *storage_get_sensor_params_as_string_help() {
 bool storage_get_sensor_params_as_string(char *buffer, uint16_t length) {
     if (buffer != NULL)
         strlcpy(buffer, tt.storage.versions.v1.sensor_params, length);
-    if (buffer[0] == '\0')
+    if (tt.storage.versions.v1.sensor_params[0] == '\0')
         return false;
     return true;
 }
@@ -823,113 +907,366 @@ void storage_save(bool fSynchronous) {
 
 }
 
+
+#if DB_ENABLED
+// Locate a journal record by its byte offset within the DB region
+static db_record_t *db_record_at(uint32_t offset) {
+    return (db_record_t *) ((uint8_t *) address_of_db_page(0) + offset);
+}
+
+// Checksum of a record's header fields and data
+static uint32_t db_record_crc(db_record_t *rec) {
+    uint32_t crc = crc32_compute((uint8_t *) rec, offsetof(db_record_t, crc), NULL);
+    return crc32_compute((uint8_t *) &rec[1], rec->length, &crc);
+}
+
+// See if there is a complete, intact record at this offset
+static bool db_record_is_valid(uint32_t offset) {
+    uint32_t page_left = PHY_PAGE_SIZE_BYTES - (offset % PHY_PAGE_SIZE_BYTES);
+    db_record_t *rec = db_record_at(offset);
+    if (page_left < sizeof(db_record_t))
+        return false;
+    if (rec->length == DB_BLANK || rec->length > DB_ENTRY_BYTES)
+        return false;
+    if (db_record_bytes(rec->length) > page_left)
+        return false;
+    return (rec->crc == db_record_crc(rec));
+}
+
+// See if a range of flash is erased, and thus can be written without an erase
+static bool db_is_erased(uint32_t offset, uint32_t bytes) {
+    uint32_t *word = (uint32_t *) db_record_at(offset);
+    uint32_t i;
+    // A page being erased will be by the time anything queued after the erase is written
+    if (db_erase_offset != DB_NONE && (offset / PHY_PAGE_SIZE_BYTES) == (db_erase_offset / PHY_PAGE_SIZE_BYTES))
+        return true;
+    for (i=0; i<bytes/PHY_WORD_SIZE; i++)
+        if (word[i] != 0xFFFFFFFF)
+            return false;
+    return true;
+}
+
+// Offset of the start of the page following the one containing this offset
+static uint32_t db_next_page(uint32_t offset) {
+    offset = ((offset / PHY_PAGE_SIZE_BYTES) + 1) * PHY_PAGE_SIZE_BYTES;
+    return (offset >= DB_BYTES ? 0 : offset);
+}
+
+// Offset of the record following this one, which is either adjacent or,
+// if it didn't fit in what remained of this page, at the start of the next.
+static uint32_t db_next_record(uint32_t offset) {
+    offset += db_record_bytes(db_record_at(offset)->length);
+    if (offset >= DB_BYTES)
+        offset = 0;
+    if ((offset % PHY_PAGE_SIZE_BYTES) != 0 && !db_record_is_valid(offset))
+        offset = db_next_page(offset);
+    return offset;
+}
+
+// Offset of the data entry following this one, skipping release records
+static uint32_t db_next_entry(uint32_t offset) {
+    uint16_t i;
+    for (i=0; i<DB_BYTES/sizeof(db_record_t); i++) {
+        offset = db_next_record(offset);
+        if (!db_record_is_valid(offset) || db_record_at(offset)->request_type != DB_RELEASE)
+            break;
+    }
+    return offset;
+}
+
+// Recover the journal state by scanning the records in flash
+static void db_init() {
+    uint32_t page, offset, oldest = 0;
+    bool found = false;
+
+    db_count = 0;
+    db_head = db_tail = 0;
+    db_sequence = 1;
+    db_released_through = 0;
+    db_cursor_offset = DB_NONE;
+
+    // Find the most recent record, after which we append, and how far we've released
+    for (page = 0; page < DB_BYTES; page += PHY_PAGE_SIZE_BYTES) {
+        offset = page;
+        while (offset < page + PHY_PAGE_SIZE_BYTES && db_record_is_valid(offset)) {
+            db_record_t *rec = db_record_at(offset);
+            if (!found || rec->sequence >= db_sequence) {
+                db_sequence = rec->sequence + 1;
+                db_tail = offset + db_record_bytes(rec->length);
+                found = true;
+            }
+            if (rec->released > db_released_through)
+                db_released_through = rec->released;
+            offset += db_record_bytes(rec->length);
+        }
+    }
+    if (db_tail >= DB_BYTES)
+        db_tail = 0;
+
+    // Entries beyond that are awaiting upload, the oldest of which is the head
+    for (page = 0; page < DB_BYTES; page += PHY_PAGE_SIZE_BYTES) {
+        offset = page;
+        while (offset < page + PHY_PAGE_SIZE_BYTES && db_record_is_valid(offset)) {
+            db_record_t *rec = db_record_at(offset);
+            if (rec->request_type != DB_RELEASE && rec->sequence > db_released_through) {
+                if (db_count == 0 || rec->sequence < oldest) {
+                    oldest = rec->sequence;
+                    db_head = offset;
+                }
+                db_count++;
+            }
+            offset += db_record_bytes(rec->length);
+        }
+    }
+
+    if (db_count != 0)
+        DEBUG_PRINTF("db: %d entries awaiting upload\n", db_count);
+
+}
+
+// Append a fully-formed record at the tail, returning where it was placed.  The
+// reserve is space that must remain at the end of the page after the record.
+static uint32_t db_append(uint32_t *record, uint32_t bytes, uint32_t reserve) {
+    uint32_t err_code;
+    uint32_t offset = db_tail;
+
+    // Records never span pages, and are only ever written into erased space
+    if ((offset % PHY_PAGE_SIZE_BYTES) != 0)
+        if ((PHY_PAGE_SIZE_BYTES - (offset % PHY_PAGE_SIZE_BYTES)) < (bytes + reserve) || !db_is_erased(offset, bytes))
+            offset = db_next_page(offset);
+
+    // Wrapping onto a page requires erasing it, which we may only do if none of
+    // its entries are still awaiting upload.  If they are, we're full.
+    if ((offset % PHY_PAGE_SIZE_BYTES) == 0 && !db_is_erased(offset, PHY_PAGE_SIZE_BYTES)) {
+        if (db_count != 0 && (db_head / PHY_PAGE_SIZE_BYTES) == (offset / PHY_PAGE_SIZE_BYTES)) {
+            DEBUG_PRINTF("db: full (%d entries)\n", db_count);
+            return DB_NONE;
+        }
+#if DEBUGSTORAGE
+        DEBUG_PRINTF("db: erasing page at 0x%04lx\n", offset);
+#endif
+        err_code = fs_erase(&db_fs_config, (uint32_t *) db_record_at(offset), 1, NULL);
+        if (err_code != NRF_SUCCESS) {
+            DEBUG_PRINTF("Flash storage erase error: 0x%04x\n", err_code);
+            return DB_NONE;
+        }
+        db_erase_offset = offset;
+    }
+
+    err_code = fs_store(&db_fs_config, (uint32_t *) db_record_at(offset), record, bytes/PHY_WORD_SIZE, record);
+    if (err_code != NRF_SUCCESS) {
+        DEBUG_PRINTF("Flash storage save error: 0x%04x\n", err_code);
+        return DB_NONE;
+    }
+
+    db_sequence++;
+    db_tail = offset + bytes;
+    if (db_tail >= DB_BYTES)
+        db_tail = 0;
+    return offset;
+}
+
+// Stamp the entry that is in the record buffer, and append it
+static bool db_record_write() {
+    db_record_t *rec = (db_record_t *) db_record;
+    rec->sequence = db_sequence;
+    rec->released = db_released_through;
+    rec->crc = db_record_crc(rec);
+    db_record_offset = db_append(db_record, db_record_bytes(rec->length), sizeof(db_release_record));
+    return (db_record_offset != DB_NONE);
+}
+
+// Record how far we've released, or if a release record is already being written,
+// write another once it's done.  They're cumulative, so the newest covers them all.
+static void db_release_write() {
+    db_record_t *rec = (db_record_t *) db_release_record;
+    if (db_release_offset != DB_NONE) {
+        DEBUG_PRINTF("db: release deferred\n");
+        db_release_deferred = true;
+        return;
+    }
+    rec->length = 0;
+    rec->request_type = DB_RELEASE;
+    rec->sequence = db_sequence;
+    rec->released = db_released_through;
+    rec->crc = db_record_crc(rec);
+    db_release_offset = db_append(db_release_record, sizeof(db_release_record), 0);
+    db_release_deferred = (db_release_offset == DB_NONE);
+}
+
+// An append or erase has completed, so bring the journal up to date with what's in flash
+static void db_completed(void *p_event_data, uint16_t event_size) {
+    uint32_t completion = * (uint32_t *) p_event_data;
+    fs_ret_t result = (fs_ret_t) (completion >> 8);
+    uint8_t op = completion & 0xff;
+    uint32_t offset;
+    bool stranded;
+
+    if (op == DB_OP_ERASE) {
+        if (result != FS_SUCCESS)
+            DEBUG_PRINTF("db: erase at 0x%04lx failed: %d\n", db_erase_offset, result);
+        db_erase_offset = DB_NONE;
+    } else {
+
+        if (op == DB_OP_RECORD) {
+            offset = db_record_offset;
+            db_record_offset = DB_NONE;
+        } else {
+            offset = db_release_offset;
+            db_release_offset = DB_NONE;
+        }
+
+        // Verify what was written, because a failed erase beneath it would leave it corrupt,
+        // and anything after a failed write on the same page can never be reached.
+        stranded = (db_failed_offset != DB_NONE && offset > db_failed_offset
+                    && (offset / PHY_PAGE_SIZE_BYTES) == (db_failed_offset / PHY_PAGE_SIZE_BYTES));
+        if (result != FS_SUCCESS || stranded || !db_record_is_valid(offset)) {
+            DEBUG_PRINTF("db: write at 0x%04lx failed: %d\n", offset, result);
+            if (!stranded)
+                db_failed_offset = offset;
+            if ((db_tail / PHY_PAGE_SIZE_BYTES) == (offset / PHY_PAGE_SIZE_BYTES) && db_tail > offset)
+                db_tail = db_next_page(offset);
+            if (op == DB_OP_RELEASE)
+                db_release_deferred = true;
+            else if (db_record_retried || !db_record_write())
+                DEBUG_PRINTF("db: entry lost\n");
+            else
+                db_record_retried = true;
+        } else if (op == DB_OP_RECORD) {
+            // Only now that it's intact is it the newest entry awaiting upload
+            if (db_count++ == 0)
+                db_head = offset;
+        }
+
+    }
+
+    if (db_record_offset == DB_NONE && db_release_offset == DB_NONE)
+        db_failed_offset = DB_NONE;
+    if (db_release_deferred)
+        db_release_write();
+}
+#endif
+
+// Peek at the Nth entry awaiting upload, returning its data in place in flash
+uint8_t *db_peek(uint16_t index, uint16_t *length, uint16_t *request_type) {
+#if defined(OLDSTORAGE) || !DB_ENABLED
+    return NULL;
+#else
+    uint32_t offset = db_head;
+    uint16_t i = 0;
+    db_record_t *rec;
+    if (index >= db_count)
+        return NULL;
+    if (db_cursor_offset != DB_NONE && index >= db_cursor_index) {
+        i = db_cursor_index;
+        offset = db_cursor_offset;
+    }
+    for (; i < index; i++)
+        offset = db_next_entry(offset);
+    // Defensive, in case the flash has been disturbed underneath us.  Stop here rather
+    // than discarding what's queued, because the scan at the next boot will recover it.
+    if (!db_record_is_valid(offset)) {
+        DEBUG_PRINTF("db: unreadable entry at 0x%04lx\n", offset);
+        return NULL;
+    }
+    db_cursor_index = index;
+    db_cursor_offset = offset;
+    rec = db_record_at(offset);
+    if (length != NULL)
+        *length = rec->length;
+    if (request_type != NULL)
+        *request_type = rec->request_type;
+    return (uint8_t *) &rec[1];
+#endif
+}
+
 // Peek at the next to be uploaded, returning its length or the buffer itself
 uint16_t db_get(uint8_t *buffer, uint16_t *length, uint16_t *request_type) {
 #if defined(OLDSTORAGE) || !DB_ENABLED
     return 0;
 #else
-    STORAGE *st = storage();
-    uint8_t *db = (uint8_t *) address_of_db_page(0);
-    uint8_t *page = &db[db_offset_of_page(st->db_next_to_upload)];
-    uint8_t *entry = &page[page_offset_of_entry(st->db_next_to_upload)];
-    if (st->db_filled != 0) {
+    uint16_t entry_length;
+    uint8_t *entry = db_peek(0, &entry_length, request_type);
+    if (entry != NULL) {
         if (buffer != NULL) {
-            memcpy(buffer, entry, DB_ENTRY_BYTES);
+            memcpy(buffer, entry, entry_length);
 #if DEBUGSTORAGE
-            DEBUG_PRINTF("db: retrieved %d-byte buff #%d\n", st->db_length[st->db_next_to_upload], st->db_next_to_upload);
+            DEBUG_PRINTF("db: retrieved %d-byte buff #%lu\n", entry_length, db_record_at(db_head)->sequence);
 #endif
         }
         if (length != NULL)
-            *length = st->db_length[st->db_next_to_upload];
-        if (request_type != NULL)
-            *request_type = st->db_request_type[st->db_next_to_upload];
+            *length = entry_length;
     }
-    return st->db_filled;
+    return db_count;
 #endif
 }
 
-// Peek at the next to be uploaded, returning its length
-void db_get_release() {
+// Release the oldest N entries, together, as having been uploaded
+void db_release(uint16_t count) {
 #if defined(OLDSTORAGE) || !DB_ENABLED
     return;
 #else
-    STORAGE *st = storage();
-    if (st->db_filled != 0) {
-        st->db_filled--;
+    if (count > db_count)
+        count = db_count;
+    if (count == 0)
+        return;
+
+    while (count-- > 0) {
+        db_released_through = db_record_at(db_head)->sequence;
+        if (--db_count != 0)
+            db_head = db_next_entry(db_head);
+    }
+    db_cursor_offset = DB_NONE;
 #if DEBUGSTORAGE
-        DEBUG_PRINTF("db: released buff #%d (now %d remaining)\n", st->db_next_to_upload, st->db_filled);
+    DEBUG_PRINTF("db: released through #%lu (now %d remaining)\n", db_released_through, db_count);
 #endif
-        if (++st->db_next_to_upload >= DB_ENTRIES)
-            st->db_next_to_upload = 0;
-        storage_save(false);
-    }
+
+    db_release_write();
 #endif
 }
 
+// Release the oldest entry as having been uploaded
+void db_get_release() {
+    db_release(1);
+}
+
 // Is the db stuff enabled?
 bool db_enabled() {
     return DB_ENABLED;
 }
 
-// Save these readings, using a policy of preferring OLDER
+// Append these readings to the journal, using a policy of preferring OLDER
 // readings if we run out of buffering space.
 bool db_put(uint8_t *buffer, uint16_t length, uint16_t request_type) {
 #if defined(OLDSTORAGE) || !DB_ENABLED
     return false;
 #else
-    uint32_t err_code;
-    STORAGE *st = storage();
-    uint16_t db_filled = st->db_filled;
-    uint16_t db_next_to_fill = st->db_next_to_fill;
-
-    // Back up and overwrite the most recent if we run out of room, so that
-    // if there is a bad event that knocks out communications we save the data
-    // that is in closest proximity to the event.
-    if (db_filled == DB_ENTRIES) {
-        db_filled--;
-        if (db_next_to_fill-- == 0)
-            db_next_to_fill = DB_ENTRIES-1;
-    }
+    uint32_t bytes = db_record_bytes(length);
+    db_record_t *rec = (db_record_t *) db_record;
 
-    // Create a page buffer and replace just the entry
-    char pagebuf[PHY_PAGE_SIZE_BYTES];
-    uint8_t *db = (uint8_t *) address_of_db_page(0);
-    uint8_t *page = &db[db_offset_of_page(db_next_to_fill)];
-
-#if DEBUGSTORAGE
-    DEBUG_PRINTF("Base 0x%08lx at 0x%08lx, copyoff %d, erase %d pages, write %d words\n", address_of_db_page(0), page, page_offset_of_entry(db_next_to_fill), 1, PHY_PAGE_SIZE_WORDS);
-#endif
-
-    memcpy(pagebuf, page, sizeof(pagebuf));
-    memcpy(&pagebuf[page_offset_of_entry(db_next_to_fill)], buffer, DB_ENTRY_BYTES);
-
-    // Write it to flash
-#if DEBUGSTORAGE
-    DEBUG_PRINTF("db: queueing %d-byte buff #%d (now %d in queue)\n", length, db_next_to_fill, db_filled+1);
-#endif
-    err_code = fs_erase(&db_fs_config, (uint32_t *) page, 1, NULL);
-    if (err_code != NRF_SUCCESS) {
-        DEBUG_PRINTF("Flash storage erase error: 0x%04x\n", err_code);
+    if (length > DB_ENTRY_BYTES)
         return false;
-    }
-    err_code = fs_store(&db_fs_config, (uint32_t *) page, (uint32_t *) pagebuf, PHY_PAGE_SIZE_WORDS, NULL);
-    if (err_code != NRF_SUCCESS) {
-        DEBUG_PRINTF("Flash storage save error: 0x%04x\n", err_code);
+
+    // The record buffer is in use until the previous append completes
+    if (db_record_offset != DB_NONE) {
+        DEBUG_PRINTF("db: write in progress\n");
         return false;
     }
 
-    // Save length and request type before bumping to the next one
-    st->db_length[db_next_to_fill] = length;
-    st->db_request_type[db_next_to_fill] = request_type;
+    // Build the record, leaving padding erased
+    memset(db_record, 0xff, bytes);
+    rec->length = length;
+    rec->request_type = request_type;
+    memcpy(&rec[1], buffer, length);
 
-    // Now that it's successfully saved, advance the pointers and update them in storage
-    db_filled++;
-    if (++db_next_to_fill >= DB_ENTRIES)
-        db_next_to_fill = 0;
-    st->db_filled = db_filled;
-    st->db_next_to_fill = db_next_to_fill;
-    storage_save(true);
-    return true;
+    // Append it to flash, leaving room in the page so that even when the journal
+    // is full there is space to record the release of what's been uploaded
+#if DEBUGSTORAGE
+    DEBUG_PRINTF("db: queueing %d-byte buff #%lu (now %d in queue)\n", length, db_sequence, db_count+1);
+#endif
+    // It's counted once the write completes
+    db_record_retried = false;
+    return db_record_write();
 
 #endif
 }
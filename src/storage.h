@@ -72,11 +72,9 @@
 #define DB_ENTRY_BYTES      (DB_ENTRY_WORDS*PHY_WORD_SIZE)
 #define DB_PAGES            ((DB_MAX_TARGET/PHY_PAGE_SIZE_BYTES)+1)
 #define DB_BYTES            (DB_PAGES*PHY_PAGE_SIZE_BYTES)
+// Capacity of the fixed-slot index that the journal replaced, still used for its storage footprint
 #define DB_ENTRIES_PER_PAGE (PHY_PAGE_SIZE_BYTES/DB_ENTRY_BYTES)
 #define DB_ENTRIES          (DB_PAGES*DB_ENTRIES_PER_PAGE)
-#define page(x)             (x/DB_ENTRIES_PER_PAGE)
-#define db_offset_of_page(x) (page(x)*PHY_PAGE_SIZE_BYTES)
-#define page_offset_of_entry(x) ((x%DB_ENTRIES_PER_PAGE)*DB_ENTRY_BYTES)
 #endif
 
 // This structure must never exceed the above size
@@ -91,9 +89,10 @@ union ttstorage_ {
 
         uint32_t signature_top;
 
-// Anything outside this range is treated as uninitialized
+// Anything outside this range is treated as uninitialized.  Version 2 is the v1 structure
+// with the LoRaWAN history carved out of what had been the data buffer index.
 #define MIN_SUPPORTED_VERSION 1
-#define MAX_SUPPORTED_VERSION 1
+#define MAX_SUPPORTED_VERSION 2
 #define STORAGE struct v1_
         uint16_t version;
 
@@ -122,6 +121,8 @@ union ttstorage_ {
 #define FLAG_TEST               0x00000040
 // Flip the display upside down
 #define FLAG_FLIP               0x00000080
+// Send each section of stats as a message of its own, rather than together
+#define FLAG_STATS_SEPARATE     0x00000100
                 uint32_t flags;
 
 // Sensors
@@ -217,15 +218,22 @@ union ttstorage_ {
                 uint16_t dfu_count;
                 char dfu_filename[40];
 
-// Stored data awaiting upload
+// Formerly the index of stored data awaiting upload, which is now recovered
+// from the flash journal itself.  Retained so that the layout is unchanged.
 #if DB_ENABLED
-                uint16_t db_filled;
-                uint16_t db_next_to_fill;
-                uint16_t db_next_to_upload;
-                uint16_t db_length[DB_ENTRIES];
-                uint16_t db_request_type[DB_ENTRIES];
+                uint16_t db_unused[2*DB_ENTRIES];
 #endif
 
+// LoRaWAN spreading factor last chosen in each region, and the smoothed SNR in quarter dB of
+// the acknowledgements that led to it, in what was formerly the end of the above.  Cleared
+// when migrating from version 1, in which these bytes may hold part of the old index.
+#define LPWAN_REGION_EU     0
+#define LPWAN_REGION_US     1
+#define LPWAN_REGION_AS     2
+#define LPWAN_REGIONS       3
+                uint8_t lorawan_sf[LPWAN_REGIONS];
+                int8_t lorawan_snr[LPWAN_REGIONS];
+
             } v1;
 
         } versions;
@@ -267,7 +275,9 @@ char *storage_get_sensor_params_as_string_help();
 void storage_set_sensor_params_as_string(char *str);
 
 uint16_t db_get(uint8_t *buffer, uint16_t *length, uint16_t *request_type);
+uint8_t *db_peek(uint16_t index, uint16_t *length, uint16_t *request_type);
 void db_get_release();
+void db_release(uint16_t count);
 bool db_put(uint8_t *buffer, uint16_t length, uint16_t request_type);
 bool db_enabled();
 
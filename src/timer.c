@@ -30,16 +30,25 @@
 
 // Primary app-level timers
 #define TT_SLOW_TIMER_INTERVAL APP_TIMER_TICKS((TT_SLOW_TIMER_SECONDS*1000), APP_TIMER_PRESCALER)
-#define TT_FAST_TIMER_INTERVAL APP_TIMER_TICKS((TT_FAST_TIMER_SECONDS*1000), APP_TIMER_PRESCALER)
+#define TT_TIMEBASE_TIMER_INTERVAL APP_TIMER_TICKS((TT_TIMEBASE_TIMER_SECONDS*1000), APP_TIMER_PRESCALER)
+#define RTC_COUNTER_MASK 0x00FFFFFF
 APP_TIMER_DEF(tt_timer);
+APP_TIMER_DEF(tt_timebase_timer);
 
-// Primary clock, maintained by the primary app timer
+// Primary clock, maintained by the primary app timer from the RTC ticks that have elapsed.
 // Initialize non-zero because zero is the default init value of all counters, and we want to look later than that.
 static uint32_t seconds_since_boot = 1;
 static uint32_t ticks_at_measurement = 0;
 static bool tt_fast_timer_mode = false;
 static bool tt_request_timer_mode_reset = false;
 
+// The primary timer is single-shot, rearmed after each tick for the next deadline
+static bool tt_request_timer_rearm = false;
+static volatile bool tt_request_timer_poll = false;
+static uint32_t tt_timer_seconds = TT_SLOW_TIMER_SECONDS;
+static uint32_t tt_timer_expires = 0;
+static uint32_t tt_timer_ticks_at_fire = 0;
+
 // Date/time
 static uint32_t dt_seconds_since_boot_when_set = 0;
 static uint32_t dt_date = 0;
@@ -50,9 +59,10 @@ static char timebuf[32];;
 
 // Forwards
 void timer_refresh_mode();
+uint32_t timer_next_interval();
 
-// Access to our app-maintained system clock
-uint32_t get_seconds_since_boot() {
+// Current value of the 24-bit RTC
+static uint32_t rtc_ticks() {
     uint32_t ticks;
 
 #if defined(NSDKV10) || defined(NSDKV11)
@@ -61,19 +71,34 @@ uint32_t get_seconds_since_boot() {
     ticks = app_timer_cnt_get();
 #endif
 
-    // If the clock has wrapped, just return the clock in our clock's granularity
-    if (ticks < ticks_at_measurement)
-        return seconds_since_boot;
+    return ticks;
+}
+
+// Ticks of the RTC since a previous reading, which is correct across a wrap
+// because the primary timer always fires well within the RTC's period.
+static uint32_t rtc_ticks_since(uint32_t ticks_from) {
+    uint32_t elapsed_ticks;
+    app_timer_cnt_diff_compute(rtc_ticks(), ticks_from, &elapsed_ticks);
+    return elapsed_ticks;
+}
+
+// Access to our app-maintained system clock
+uint32_t get_seconds_since_boot() {
 
     // Compute seconds since last increment of our clock
-    uint32_t elapsed_ticks = ticks - ticks_at_measurement;
-    uint32_t elapsed_seconds = elapsed_ticks / APP_TIMER_TICKS_PER_SECOND;
+    uint32_t elapsed_seconds = rtc_ticks_since(ticks_at_measurement) / APP_TIMER_TICKS_PER_SECOND;
 
     // Return finer-grained time
     return (seconds_since_boot + elapsed_seconds);
 
 }
 
+// Milliseconds since boot, for timing things that take well under a second
+uint32_t get_milliseconds_since_boot() {
+    uint32_t elapsed_ticks = rtc_ticks_since(ticks_at_measurement);
+    return ((seconds_since_boot * 1000) + (uint32_t) (((uint64_t) elapsed_ticks * 1000) / APP_TIMER_TICKS_PER_SECOND));
+}
+
 // Set the date/time
 void set_timestamp(uint32_t ddmmyy, uint32_t hhmmss) {
 
@@ -188,17 +213,12 @@ void tt_timer_handler(void *p_context) {
     static bool overcurrent = false;
     static uint32_t overcurrent_report = 0;
 
-    // Remember the number of ticks the last time we set seconds_since_boot
-    uint32_t ticks;
-#if defined(NSDKV10) || defined(NSDKV11)
-    app_timer_cnt_get(&ticks);
-#else
-    ticks = app_timer_cnt_get();
-#endif
-
-    // Bump the number of seconds since boot, leaving overflow to be dealt with by users
-    seconds_since_boot += tt_fast_timer_mode ? TT_FAST_TIMER_SECONDS : TT_SLOW_TIMER_SECONDS;
-    ticks_at_measurement = ticks;
+    // Advance the number of seconds since boot by the whole seconds that have elapsed,
+    // carrying the fraction forward, and leaving overflow to be dealt with by users
+    tt_timer_ticks_at_fire = rtc_ticks();
+    uint32_t elapsed_seconds = rtc_ticks_since(ticks_at_measurement) / APP_TIMER_TICKS_PER_SECOND;
+    seconds_since_boot += elapsed_seconds;
+    ticks_at_measurement = (ticks_at_measurement + (elapsed_seconds * APP_TIMER_TICKS_PER_SECOND)) & RTC_COUNTER_MASK;
 
     // Exit if we've somehow gone re-entrant
     static int inside_timer = 0;
@@ -296,11 +316,19 @@ void tt_timer_handler(void *p_context) {
     // Report any UART errors, but only after comm_poll had a chance to check
     serial_uart_error_check(false);
 
+    // Ask for the timer to be rearmed for the next deadline
+    tt_timer_seconds = timer_next_interval();
+    tt_request_timer_rearm = true;
+
     // Exit
     inside_timer--;
 
 }
 
+// Time base timer, which has nothing to do but keep the RTC running
+void tt_timebase_timer_handler(void *p_context) {
+}
+
 // Initialize our app timers
 void timer_init() {
 
@@ -325,7 +353,8 @@ void timer_init() {
 #endif
 
     // Create our primary app timer
-    app_timer_create(&tt_timer, APP_TIMER_MODE_REPEATED, tt_timer_handler);
+    app_timer_create(&tt_timer, APP_TIMER_MODE_SINGLE_SHOT, tt_timer_handler);
+    app_timer_create(&tt_timebase_timer, APP_TIMER_MODE_REPEATED, tt_timebase_timer_handler);
 
     // Create our debug output timer
     btdebug_create_timer();
@@ -335,8 +364,13 @@ void timer_init() {
 // Start our primary app timer
 void timer_start() {
 
+    // Keep the RTC running for as long as we are, before anything else can stop the last timer
+    app_timer_start(tt_timebase_timer, TT_TIMEBASE_TIMER_INTERVAL, NULL);
+
     // Enable the slow timer
     tt_fast_timer_mode = false;
+    tt_timer_seconds = TT_SLOW_TIMER_SECONDS;
+    tt_timer_expires = get_seconds_since_boot() + tt_timer_seconds;
     app_timer_start(tt_timer, TT_SLOW_TIMER_INTERVAL, NULL);
 
     // Turn on the display immediately if it's available
@@ -366,14 +400,73 @@ void timer_refresh_mode() {
 
 }
 
+// Determine how long the primary timer can sleep.  Whenever anything is active it ticks at
+// the regular rate, and otherwise it sleeps until the next deadline that anyone has.
+uint32_t timer_next_interval() {
+    uint32_t interval = tt_fast_timer_mode ? TT_FAST_TIMER_SECONDS : TT_SLOW_TIMER_SECONDS;
+    uint32_t now = get_seconds_since_boot();
+    uint32_t next, due;
+
+    // Keep ticking through boot, until the indicators and advertising are shut down,
+    // and whenever someone is watching the display or connected over bluetooth.
+    if (tt_fast_timer_mode || now < (15*60) || can_send_to_bluetooth())
+        return interval;
+#ifdef SSD
+    if (ssd1306_active())
+        return interval;
+#endif
+
+    // Sleep until the next deadline of the sensor scheduler or the comms
+    next = sensor_next_due();
+    due = comm_next_due();
+    if (due < next)
+        next = due;
+    if (next <= (now + interval))
+        return interval;
+    if ((next - now) > TT_IDLE_TIMER_SECONDS_MAX)
+        return TT_IDLE_TIMER_SECONDS_MAX;
+    return (next - now);
+
+}
+
+// Request a timer tick at the regular rate, because something changed while we may be sleeping.
+// This may be called at interrupt level.
+void timer_request_poll() {
+    tt_request_timer_poll = true;
+}
+
 // Process timer change requests from the main scheduling loop, because we can't
 // stop or start a timer from within the timer handler itself.
 void timer_update_mode() {
+    uint32_t interval = tt_fast_timer_mode ? TT_FAST_TIMER_SECONDS : TT_SLOW_TIMER_SECONDS;
+
+    // If we've been asked to poll, and are sleeping longer than usual, fall back to the regular tick
+    if (tt_request_timer_poll) {
+        tt_request_timer_poll = false;
+        if (!tt_request_timer_rearm && tt_timer_expires > (get_seconds_since_boot() + interval)) {
+            tt_timer_seconds = interval;
+            tt_timer_ticks_at_fire = rtc_ticks();
+            tt_request_timer_rearm = true;
+        }
+    }
 
     if (tt_request_timer_mode_reset) {
         tt_request_timer_mode_reset = false;
+        tt_timer_seconds = interval;
+        tt_timer_ticks_at_fire = rtc_ticks();
+        tt_request_timer_rearm = true;
+    }
+
+    // Measure the interval from when the timer last fired, so that time spent
+    // in the handler doesn't make the ticks drift
+    if (tt_request_timer_rearm) {
+        uint32_t ticks = APP_TIMER_TICKS(tt_timer_seconds*1000, APP_TIMER_PRESCALER);
+        uint32_t elapsed_ticks = rtc_ticks_since(tt_timer_ticks_at_fire);
+        tt_request_timer_rearm = false;
+        ticks = (elapsed_ticks + APP_TIMER_MIN_TIMEOUT_TICKS < ticks) ? (ticks - elapsed_ticks) : APP_TIMER_MIN_TIMEOUT_TICKS;
+        tt_timer_expires = get_seconds_since_boot() + tt_timer_seconds;
         app_timer_stop(tt_timer);
-        app_timer_start(tt_timer, tt_fast_timer_mode ? TT_FAST_TIMER_INTERVAL :  TT_SLOW_TIMER_INTERVAL, NULL);
+        app_timer_start(tt_timer, ticks, NULL);
     }
 
 }
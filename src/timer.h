@@ -30,8 +30,10 @@ void timer_init(void);
 void timer_start();
 char *time_since_boot();
 void timer_update_mode();
+void timer_request_poll();
 
 uint32_t get_seconds_since_boot(void);
+uint32_t get_milliseconds_since_boot(void);
 void set_timestamp(uint32_t date, uint32_t time);
 bool get_current_timestamp(uint32_t *date, uint32_t *time, uint32_t *offset);
 
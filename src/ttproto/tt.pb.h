@@ -1,12 +1,11 @@
 /* Automatically generated nanopb header */
-/* Generated by nanopb-0.3.5 at Mon Oct  9 15:30:39 2017. */
+/* Generated by nanopb-0.4.0 */
 
-#ifndef PB_TT_PB_H_INCLUDED
-#define PB_TT_PB_H_INCLUDED
+#ifndef PB_TTPROTO_TT_PB_H_INCLUDED
+#define PB_TTPROTO_TT_PB_H_INCLUDED
 #include <pb.h>
 
-/* @@protoc_insertion_point(includes) */
-#if PB_PROTO_HEADER_VERSION != 30
+#if PB_PROTO_HEADER_VERSION != 40
 #error Regenerate this file with the current version of nanopb generator.
 #endif
 
@@ -38,8 +37,7 @@ typedef struct _ttproto_Telecast {
     pb_callback_t DEPRECATED2017FEBDeviceIDString;
     bool has_device_id;
     uint32_t device_id;
-    bool has_message;
-    char message[250];
+    pb_callback_t message;
     bool has_captured_at;
     char captured_at[40];
     bool has_reply_type;
@@ -78,10 +76,8 @@ typedef struct _ttproto_Telecast {
     uint32_t lnd_7128ec;
     bool has_stats_uptime_minutes;
     uint32_t stats_uptime_minutes;
-    bool has_stats_app_version;
-    char stats_app_version[64];
-    bool has_stats_device_params;
-    char stats_device_params[64];
+    pb_callback_t stats_app_version;
+    pb_callback_t stats_device_params;
     bool has_stats_transmitted_bytes;
     uint32_t stats_transmitted_bytes;
     bool has_stats_received_bytes;
@@ -136,12 +132,10 @@ typedef struct _ttproto_Telecast {
     uint32_t stats_comms_power_fails;
     bool has_bat_current;
     float bat_current;
-    bool has_stats_iccid;
-    char stats_iccid[128];
+    pb_callback_t stats_iccid;
     bool has_stats_motion_events;
     uint32_t stats_motion_events;
-    bool has_stats_dfu;
-    char stats_dfu[128];
+    pb_callback_t stats_dfu;
     bool has_captured_at_date;
     uint32_t captured_at_date;
     bool has_captured_at_time;
@@ -154,28 +148,19 @@ typedef struct _ttproto_Telecast {
     uint32_t stamp;
     bool has_stamp_version;
     uint32_t stamp_version;
-    bool has_stats_cpsi;
-    char stats_cpsi[250];
+    pb_callback_t stats_cpsi;
     bool has_stats_uptime_days;
     uint32_t stats_uptime_days;
-    bool has_stats_device_label;
-    char stats_device_label[64];
-    bool has_stats_gps_params;
-    char stats_gps_params[64];
-    bool has_stats_service_params;
-    char stats_service_params[64];
-    bool has_stats_ttn_params;
-    char stats_ttn_params[64];
-    bool has_stats_sensor_params;
-    char stats_sensor_params[64];
+    pb_callback_t stats_device_label;
+    pb_callback_t stats_gps_params;
+    pb_callback_t stats_service_params;
+    pb_callback_t stats_ttn_params;
+    pb_callback_t stats_sensor_params;
     bool has_lnd_7318c;
     uint32_t lnd_7318c;
-    bool has_stats_battery;
-    char stats_battery[64];
-    bool has_stats_module_fona;
-    char stats_module_fona[64];
-    bool has_stats_module_lora;
-    char stats_module_lora[64];
+    pb_callback_t stats_battery;
+    pb_callback_t stats_module_fona;
+    pb_callback_t stats_module_lora;
     bool has_motion;
     bool motion;
     bool has_test;
@@ -206,8 +191,7 @@ typedef struct _ttproto_Telecast {
     uint32_t errors_ugps;
     bool has_errors_twi;
     uint32_t errors_twi;
-    bool has_errors_twi_info;
-    char errors_twi_info[128];
+    pb_callback_t errors_twi_info;
     bool has_errors_lis;
     uint32_t errors_lis;
     bool has_errors_spi;
@@ -250,14 +234,34 @@ typedef struct _ttproto_Telecast {
     uint32_t errors_mtu;
     bool has_stats_seqno;
     uint32_t stats_seqno;
-/* @@protoc_insertion_point(struct:ttproto_Telecast) */
+    bool has_stamp_fields;
+    uint32_t stamp_fields;
+    bool has_lnd_7318u_error;
+    uint32_t lnd_7318u_error;
+    bool has_lnd_7318c_error;
+    uint32_t lnd_7318c_error;
+    bool has_lnd_7128ec_error;
+    uint32_t lnd_7128ec_error;
+    bool has_lnd_712u_error;
+    uint32_t lnd_712u_error;
+    bool has_lnd_78017w_error;
+    uint32_t lnd_78017w_error;
 } ttproto_Telecast;
 
-/* Default values for struct fields */
+
+/* Helper constants for enums */
+#define _ttproto_Telecast_deviceType_MIN ttproto_Telecast_deviceType_UNKNOWN_DEVICE_TYPE
+#define _ttproto_Telecast_deviceType_MAX ttproto_Telecast_deviceType_TTGATEPING
+#define _ttproto_Telecast_deviceType_ARRAYSIZE ((ttproto_Telecast_deviceType)(ttproto_Telecast_deviceType_TTGATEPING+1))
+
+#define _ttproto_Telecast_replyType_MIN ttproto_Telecast_replyType_NO_REPLY
+#define _ttproto_Telecast_replyType_MAX ttproto_Telecast_replyType_ALLOWED
+#define _ttproto_Telecast_replyType_ARRAYSIZE ((ttproto_Telecast_replyType)(ttproto_Telecast_replyType_ALLOWED+1))
+
 
 /* Initializer values for message structs */
-#define ttproto_Telecast_init_default            {false, (ttproto_Telecast_deviceType)0, {{NULL}, NULL}, false, 0, false, "", false, "", false, (ttproto_Telecast_replyType)0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, 0, false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, 0, false, "", false, "", false, "", false, "", false, "", false, 0, false, "", false, "", false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0}
-#define ttproto_Telecast_init_zero               {false, (ttproto_Telecast_deviceType)0, {{NULL}, NULL}, false, 0, false, "", false, "", false, (ttproto_Telecast_replyType)0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, 0, false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, 0, false, "", false, "", false, "", false, "", false, "", false, 0, false, "", false, "", false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, "", false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0}
+#define ttproto_Telecast_init_default            {false, _ttproto_Telecast_deviceType_MIN, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, false, "", false, _ttproto_Telecast_replyType_MIN, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0}
+#define ttproto_Telecast_init_zero               {false, _ttproto_Telecast_deviceType_MIN, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, false, "", false, _ttproto_Telecast_replyType_MIN, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, false, 0, {{NULL}, NULL}, {{NULL}, NULL}, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, {{NULL}, NULL}, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0, false, 0}
 
 /* Field tags (for use in manual encoding/decoding) */
 #define ttproto_Telecast_device_type_tag         1
@@ -369,23 +373,143 @@ typedef struct _ttproto_Telecast {
 #define ttproto_Telecast_opc_std10_0_tag         107
 #define ttproto_Telecast_errors_mtu_tag          108
 #define ttproto_Telecast_stats_seqno_tag         109
+#define ttproto_Telecast_stamp_fields_tag        110
+#define ttproto_Telecast_lnd_7318u_error_tag     111
+#define ttproto_Telecast_lnd_7318c_error_tag     112
+#define ttproto_Telecast_lnd_7128ec_error_tag    113
+#define ttproto_Telecast_lnd_712u_error_tag      114
+#define ttproto_Telecast_lnd_78017w_error_tag    115
 
 /* Struct field encoding specification for nanopb */
-extern const pb_field_t ttproto_Telecast_fields[110];
-
-/* Maximum encoded size of messages (where known) */
-
-/* Message IDs (where set with "msgid" option) */
-#ifdef PB_MSGID
+#define ttproto_Telecast_FIELDLIST(X, a) \
+X(a, STATIC,   OPTIONAL, UENUM,    device_type,       1) \
+X(a, CALLBACK, OPTIONAL, STRING,   DEPRECATED2017FEBDeviceIDString,   2) \
+X(a, STATIC,   OPTIONAL, UINT32,   device_id,         3) \
+X(a, CALLBACK, OPTIONAL, STRING,   message,           4) \
+X(a, STATIC,   OPTIONAL, STRING,   captured_at,       5) \
+X(a, STATIC,   OPTIONAL, UENUM,    reply_type,        6) \
+X(a, STATIC,   OPTIONAL, UINT32,   DEPRECATED2017FEBValue,   7) \
+X(a, STATIC,   OPTIONAL, FLOAT,    latitude,          8) \
+X(a, STATIC,   OPTIONAL, FLOAT,    longitude,         9) \
+X(a, STATIC,   OPTIONAL, INT32,    altitude,         10) \
+X(a, STATIC,   OPTIONAL, FLOAT,    bat_voltage,      11) \
+X(a, STATIC,   OPTIONAL, FLOAT,    bat_soc,          12) \
+X(a, STATIC,   OPTIONAL, FLOAT,    wireless_snr,     13) \
+X(a, STATIC,   OPTIONAL, FLOAT,    env_temp,         14) \
+X(a, STATIC,   OPTIONAL, FLOAT,    env_humid,        15) \
+X(a, STATIC,   OPTIONAL, UINT32,   relay_device1,    16) \
+X(a, STATIC,   OPTIONAL, UINT32,   relay_device2,    17) \
+X(a, STATIC,   OPTIONAL, UINT32,   relay_device3,    18) \
+X(a, STATIC,   OPTIONAL, UINT32,   relay_device4,    19) \
+X(a, STATIC,   OPTIONAL, UINT32,   relay_device5,    20) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_7318u,        21) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_7128ec,       22) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_uptime_minutes,  23) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_app_version,  24) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_device_params,  25) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_transmitted_bytes,  26) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_received_bytes,  27) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_oneshots,   28) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_comms_resets,  29) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_pm01_0,       30) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_pm02_5,       31) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_pm10_0,       32) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_c00_30,       33) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_c00_50,       34) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_c01_00,       35) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_c02_50,       36) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_c05_00,       37) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_c10_00,       38) \
+X(a, STATIC,   OPTIONAL, UINT32,   pms_csecs,        39) \
+X(a, STATIC,   OPTIONAL, FLOAT,    opc_pm01_0,       40) \
+X(a, STATIC,   OPTIONAL, FLOAT,    opc_pm02_5,       41) \
+X(a, STATIC,   OPTIONAL, FLOAT,    opc_pm10_0,       42) \
+X(a, STATIC,   OPTIONAL, UINT32,   opc_c00_38,       43) \
+X(a, STATIC,   OPTIONAL, UINT32,   opc_c00_54,       44) \
+X(a, STATIC,   OPTIONAL, UINT32,   opc_c01_00,       45) \
+X(a, STATIC,   OPTIONAL, UINT32,   opc_c02_10,       46) \
+X(a, STATIC,   OPTIONAL, UINT32,   opc_c05_00,       47) \
+X(a, STATIC,   OPTIONAL, UINT32,   opc_c10_00,       48) \
+X(a, STATIC,   OPTIONAL, UINT32,   opc_csecs,        49) \
+X(a, STATIC,   OPTIONAL, FLOAT,    env_pressure,     50) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_comms_power_fails,  51) \
+X(a, STATIC,   OPTIONAL, FLOAT,    bat_current,      52) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_iccid,      53) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_motion_events,  54) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_dfu,        55) \
+X(a, STATIC,   OPTIONAL, UINT32,   captured_at_date,  56) \
+X(a, STATIC,   OPTIONAL, UINT32,   captured_at_time,  57) \
+X(a, STATIC,   OPTIONAL, UINT32,   captured_at_offset,  58) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_oneshot_seconds,  59) \
+X(a, STATIC,   OPTIONAL, UINT32,   stamp,            60) \
+X(a, STATIC,   OPTIONAL, UINT32,   stamp_version,    61) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_cpsi,       62) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_uptime_days,  63) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_device_label,  64) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_gps_params,  65) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_service_params,  66) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_ttn_params,  67) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_sensor_params,  68) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_7318c,        69) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_battery,    70) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_module_fona,  71) \
+X(a, CALLBACK, OPTIONAL, STRING,   stats_module_lora,  72) \
+X(a, STATIC,   OPTIONAL, BOOL,     motion,           73) \
+X(a, STATIC,   OPTIONAL, BOOL,     test,             74) \
+X(a, STATIC,   OPTIONAL, FLOAT,    enc_temp,         75) \
+X(a, STATIC,   OPTIONAL, FLOAT,    enc_humid,        76) \
+X(a, STATIC,   OPTIONAL, FLOAT,    enc_pressure,     77) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_opc,       78) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_pms,       79) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_bme0,      80) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_bme1,      81) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_lora,      82) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_fona,      83) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_geiger,    84) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_max01,     85) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_ugps,      86) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_twi,       87) \
+X(a, CALLBACK, OPTIONAL, STRING,   errors_twi_info,  88) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_lis,       89) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_spi,       90) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_connect_lora,  91) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_connect_fona,  92) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_connect_wireless,  93) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_connect_data,  94) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_connect_service,  95) \
+X(a, STATIC,   OPTIONAL, UINT32,   motion_began_offset,  96) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_connect_gateway,  97) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_comms_ant_fails,  98) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_712u,         99) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_78017w,      100) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_overcurrent_events, 101) \
+X(a, STATIC,   OPTIONAL, FLOAT,    pms_std01_0,     102) \
+X(a, STATIC,   OPTIONAL, FLOAT,    pms_std02_5,     103) \
+X(a, STATIC,   OPTIONAL, FLOAT,    pms_std10_0,     104) \
+X(a, STATIC,   OPTIONAL, FLOAT,    opc_std01_0,     105) \
+X(a, STATIC,   OPTIONAL, FLOAT,    opc_std02_5,     106) \
+X(a, STATIC,   OPTIONAL, FLOAT,    opc_std10_0,     107) \
+X(a, STATIC,   OPTIONAL, UINT32,   errors_mtu,      108) \
+X(a, STATIC,   OPTIONAL, UINT32,   stats_seqno,     109) \
+X(a, STATIC,   OPTIONAL, UINT32,   stamp_fields,    110) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_7318u_error, 111) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_7318c_error, 112) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_7128ec_error, 113) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_712u_error,  114) \
+X(a, STATIC,   OPTIONAL, UINT32,   lnd_78017w_error, 115)
+#define ttproto_Telecast_CALLBACK pb_default_field_callback
+#define ttproto_Telecast_DEFAULT NULL
 
-#define TT_MESSAGES \
+extern const pb_msgdesc_t ttproto_Telecast_msg;
 
+/* Defines for backwards compatibility with code written before nanopb-0.4.0 */
+#define ttproto_Telecast_fields &ttproto_Telecast_msg
 
-#endif
+/* Maximum encoded size of messages (where known) */
+/* ttproto_Telecast_size depends on runtime parameters */
 
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
-/* @@protoc_insertion_point(eof) */
 
 #endif
@@ -32,18 +32,11 @@
 #include "stats.h"
 #include "battery.h"
 
-// Serial I/O Buffers
-#define IOBUFFERS 8
+// Sentences are framed as lines as they are taken from the serial ring by the scheduler,
+// and so can be processed as soon as they are complete.
 #define MAXLINE 250
-
-typedef struct {
-    uint16_t linesize;
-    char linebuf[MAXLINE];
-} iobuf_t;
-static iobuf_t iobuf[IOBUFFERS];
-static uint16_t iobuf_completed;
-static uint16_t iobuf_filling;
-static int completed_iobufs_available;
+static uint8_t sentence_buffer[MAXLINE];
+static frame_t sentence;
 
 static float reported_latitude = 0.0;
 static float reported_longitude = 0.0;
@@ -153,10 +146,8 @@ bool s_ugps_init(void *s, uint16_t param) {
         return false;
 
     // Proceed
-    completed_iobufs_available = 0;
+    frame_init(&sentence, FRAME_LINE, sentence_buffer, sizeof(sentence_buffer), &stats()->errors_framing);
     sentences_received = 0;
-    iobuf_filling = 0;
-    iobuf[0].linesize = 0;
     initialized = initialized_ever = true;
     seconds = 0;
     shutdown = false;
@@ -172,22 +163,6 @@ bool s_ugps_init(void *s, uint16_t param) {
     return true;
 }
 
-// Reset the buffer
-void iobuf_reset() {
-    iobuf[iobuf_filling].linesize = 0;
-}
-
-// Drain the completed I/O buffer and point to the next
-bool iobuf_pop(iobuf_t *piobuf) {
-    if (completed_iobufs_available <= 0)
-        return false;
-    *piobuf = iobuf[iobuf_completed];
-    completed_iobufs_available--;
-    if (++iobuf_completed >= IOBUFFERS)
-        iobuf_completed = 0;
-    return true;
-}
-
 // Process a data-received events
 void gps_process_sentence(char *line, uint16_t linelen) {
 
@@ -467,33 +442,6 @@ void gps_process_sentence(char *line, uint16_t linelen) {
 
 }
 
-// Process a data-received events
-void line_event_handler(void *unused1, uint16_t unused2) {
-    iobuf_t iobuf_popped;
-    if (!initialized)
-        return;
-    while (iobuf_pop(&iobuf_popped))
-        gps_process_sentence(iobuf_popped.linebuf, iobuf_popped.linesize);
-}
-
-// Bump to the next I/O buffer, dropping the line if we overflow I/O buffers
-bool iobuf_push() {
-    bool dropped = false;
-
-    if (completed_iobufs_available < IOBUFFERS) {
-        if (++iobuf_filling >= IOBUFFERS)
-            iobuf_filling = 0;
-        iobuf_reset();
-        completed_iobufs_available++;
-        app_sched_event_put(NULL, 0, line_event_handler);
-    } else {
-        iobuf_reset();
-        dropped = true;
-    }
-
-    return !dropped;
-}
-
 // Process byte received from gps
 void s_ugps_received_byte(uint8_t databyte) {
 
@@ -501,34 +449,9 @@ void s_ugps_received_byte(uint8_t databyte) {
     if (!initialized)
         return;
 
-    // If we get here, we're expecting to receive an ASCII text command terminated in \r\n.
-    // If this is the CR of the CRLF sequence, skip it.
-    if (databyte == '\r')
-        return;
-
-    // If this the final byte of the CRLF sequence, process it
-    if (databyte == '\n') {
-
-        // If it's just a blank line (or the second char of \r\n), skip it
-        if (iobuf[iobuf_filling].linesize == 0)
-            return;
-
-        // Null terminate the line because it's a string
-        iobuf[iobuf_filling].linebuf[iobuf[iobuf_filling].linesize] = '\0';
-
-        // Enqueue it
-        iobuf_push();
-
-        return;
-    }
-
-    // If somehow a non-text character got here, substitute.
-    if (databyte < 0x20 || databyte > 0x7f)
-        databyte = '.';
-
-    // Add the char to the line buffer
-    if (iobuf[iobuf_filling].linesize < (sizeof(iobuf[iobuf_filling].linebuf)-2))
-        iobuf[iobuf_filling].linebuf[iobuf[iobuf_filling].linesize++] = (char) databyte;
+    // We're expecting to receive ASCII sentences terminated in \r\n
+    if (frame_byte(&sentence, databyte))
+        gps_process_sentence((char *) sentence.buffer, sentence.length);
 
 }
 